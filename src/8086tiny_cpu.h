@@ -0,0 +1,714 @@
+// =============================================================================
+// File: 8086tiny_cpu.h
+//
+// Description:
+// 8086tiny CPU class.
+//
+// Holds the complete state of one emulated machine: CPU registers, decode
+// state, RAM, IO ports and disk handles. The core has no other mutable
+// state, so several machines can run in the same process, on threads of
+// their own, as long as each has its own interface object and the interface
+// supports that (the headless one does, the Win32 one does not, see
+// 8086tiny_interface.h).
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+#ifndef __8086TINY_CPU_H
+#define __8086TINY_CPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "8086tiny_interface.h"
+#include "emulator/XTmemory.h"
+#include "emulator/XTdecode.h"
+#include "emulator/XTsnapshot.h"
+#include "emulator/XTrewind.h"
+#include "emulator/XTcounters.h"
+
+// Dynamic translation.
+//
+// When JIT is non-zero, blocks of guest code that run often are translated
+// into x86-64 host code and run from a code cache, see the "Dynamic
+// translation" section of 8086tiny_new.cpp. It needs an x86-64 GCC/Clang
+// host with mmap(), other builds always interpret. When JIT_DIFF is also
+// non-zero every translated block is run a second time by the interpreter
+// and any difference in the registers, flags, IP or stored memory is
+// reported on stderr, to test the translator.
+#if !defined(JIT) || !defined(__GNUC__) || !defined(__x86_64__) || defined(_WIN32)
+  #undef  JIT
+  #define JIT                                    0
+#endif
+
+#if !JIT || !defined(JIT_DIFF)
+  #undef  JIT_DIFF
+  #define JIT_DIFF                               0
+#endif
+
+#if JIT
+  #include "emulator/XTjit.h"
+#endif
+
+// Guest profiler.
+//
+// When PROFILE is non-zero the CPU can sample where the guest spends its
+// time and report it, see ProfileEnable(). It is off by default, so normal
+// builds carry no trace of it. The Profile32 target and the Profile target
+// of the headless runner build it in.
+#ifndef PROFILE
+  #define PROFILE                                0
+#endif
+
+#if PROFILE
+  #include "emulator/XTprofile.h"
+#endif
+
+// Instruction trace.
+//
+// When TRACE is non-zero the CPU can keep a ring of the last instructions
+// it has run and write it to a file, see TraceEnable(). Off by default like
+// PROFILE, the Trace32 target and the Trace target of the headless runner
+// build it in.
+#ifndef TRACE
+  #define TRACE                                  0
+#endif
+
+#if TRACE
+  #include "emulator/XTtrace.h"
+#endif
+
+// Size and alignment of the register file
+#define REGS_SIZE                                64
+
+// Decoded instruction cache.
+//
+// Every instruction fetched from guest memory is decoded once into a
+// stDecoded_t record, which is stored in a direct mapped cache indexed by the
+// linear address of the instruction. A record is only valid for the exact
+// instruction bytes it was decoded from, so the first bytes are kept in the
+// record and compared on every lookup: if the guest writes over cached code
+// the comparison fails and the instruction is decoded again.
+
+#define DECODE_CACHE_BITS                        12
+#define DECODE_CACHE_SIZE                        ( 1 << DECODE_CACHE_BITS )
+#define DECODE_CACHE_MASK                        ( DECODE_CACHE_SIZE - 1 )
+
+// Longest 8086 instruction decoded in one step is 6 bytes (opcode, ModRM,
+// 16-bit displacement and 16-bit immediate).
+#define DECODE_BYTES_MASK                        0x0000FFFFFFFFFFFFULL
+#define DECODE_VALID                             0x8000000000000000ULL
+
+// Translated block cache.
+//
+// Blocks are found through a direct mapped table indexed by the linear
+// address of their first instruction and keyed by CS:IP. An entry counts
+// how often the interpreter reaches its address and the block is translated
+// once the count reaches JIT_HOT_THRESHOLD. The code itself lives in one
+// executable buffer that is flushed as a whole when it fills up or when the
+// guest changes code that was translated.
+#define JIT_BLOCK_BITS                           12
+#define JIT_BLOCK_COUNT                          ( 1 << JIT_BLOCK_BITS )
+#define JIT_BLOCK_MASK                           ( JIT_BLOCK_COUNT - 1 )
+
+#define JIT_HOT_THRESHOLD                        16
+#define JIT_UNTRANSLATABLE                       0xFFFF
+
+// Most guest instructions in one block and host code bytes kept free for it
+#define JIT_BLOCK_INSTR                          32
+#define JIT_BLOCK_BYTES                          8192
+#define JIT_CODE_SIZE                            ( 4 * 1024 * 1024 )
+
+typedef struct STJITBLOCK_T
+{
+  uint32_t  key   ; // CS << 16 | IP
+  uint16_t  count ; // Times reached, JIT_UNTRANSLATABLE if it cannot be
+  uint8_t * code  ; // Translated code, NULL until translated
+} stJitBlock_t ;
+
+// Guest store made by translated code, logged in differential mode
+typedef struct STJITSTORE_T
+{
+  uint32_t  addr ;
+  uint32_t  old  ; // Word at addr before the store
+} stJitStore_t ;
+
+typedef struct STDECODED_T
+{
+  uint64_t   raw_bytes    ; // Instruction bytes | DECODE_VALID, 0 when empty
+  stOpcode_t stOpcode     ;
+  uint16_t   i_data0      ;
+  uint16_t   i_data1      ;
+  uint16_t   i_data2      ;
+  uint16_t   ea_disp      ; // Displacement part of the effective address
+  uint8_t    i_reg4bit    ;
+  uint8_t    i_w          ;
+  uint8_t    i_d          ;
+  uint8_t    i_mod        ;
+  uint8_t    i_reg        ;
+  uint8_t    i_rm         ;
+  uint8_t    ea_reg1      ; // regs16[] index of the first address register
+  uint8_t    ea_reg2      ; // regs16[] index of the second address register
+  uint8_t    ea_seg       ; // regs16[] index of the default segment
+  uint8_t    reg_offset   ; // regs8[] offset of the i_reg operand
+  uint8_t    rm_offset    ; // regs8[] offset of the i_rm operand when i_mod == 3
+  uint8_t    cycles       ; // 8088 clocks, effective address included
+  uint8_t    mem_access   ; // XT_MEM_xx use of the memory operand
+} stDecoded_t ;
+
+// Register file.
+//
+// The registers are kept on the host side, in a block of their own aligned to
+// a cache line, rather than in guest memory at F000:0000. regs16[]/regs8[]
+// keep the original layout: 16-bit registers at REG_xx, 8-bit registers at
+// ( 2 * r + r / 4 ) & 7, one byte per flag at FLAG_xx and the always-zero XF
+// at byte 49.
+typedef union alignas( REGS_SIZE ) REGFILE_T
+{
+  uint16_t w[ REGS_SIZE / 2 ] ;
+  uint8_t  b[ REGS_SIZE ] ;
+} regfile_t ;
+
+class CPU8086
+{
+public:
+  CPU8086( T8086TinyInterface_t & InterfaceIn ) ;
+  ~CPU8086() ;
+
+  // The register file must be cache line aligned and the RAM page aligned,
+  // which plain new does not guarantee before C++17.
+  static void * operator new( size_t size ) ;
+  static void operator delete( void * p ) ;
+
+  // Function: Reset
+  //
+  // Description:
+  // Reloads the BIOS and disk images, clears RAM and registers and sets
+  // CS:IP to F000:0100.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void Reset( void ) ;
+
+  // Function: Run
+  //
+  // Description:
+  // Executes instructions until n_instructions have been run or the
+  // emulation exits.
+  //
+  // Parameters:
+  //
+  //   n_instructions : The maximum number of instructions to execute.
+  //
+  // Returns:
+  //
+  //   uint32_t : The number of instructions executed. The passes over a HLT
+  //              or an INT the CPU is halted on, see IDLE_DETECT, are not
+  //              counted, so it is less than n_instructions while halted.
+  //
+  uint32_t Run( uint32_t n_instructions ) ;
+
+  // Function: Exited
+  //
+  // Description:
+  // Check if the emulation has stopped, either because the interface asked
+  // to exit or because of an unsupported instruction.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true once the emulation has stopped.
+  //
+  bool Exited( void ) const { return( exit_emulation ) ; }
+
+  // Function: MapMemory
+  //
+  // Description:
+  // Set the type of the memory pages from base to base + size - 1. All pages
+  // are RAM after construction.
+  //
+  // Parameters:
+  //
+  //   base : Linear address of the first page.
+  //
+  //   size : Size in bytes, rounded up to whole pages.
+  //
+  //   type : MEM_PAGE_RAM, MEM_PAGE_ROM or MEM_PAGE_VIDEO.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void MapMemory( uint32_t base , uint32_t size , uint8_t type ) ;
+
+  // Function: SaveSnapshot
+  //
+  // Description:
+  // Saves the whole machine, RAM, CPU and the hardware emulated by the
+  // interface, to a snapshot file. Call between Run() calls.
+  //
+  // Parameters:
+  //
+  //   filename : The snapshot file, replaced if it exists.
+  //
+  // Returns:
+  //
+  //   bool : true if the snapshot was saved.
+  //
+  bool SaveSnapshot( const char * filename ) ;
+
+  // Function: LoadSnapshot
+  //
+  // Description:
+  // Restores a machine saved by SaveSnapshot(). The disk images must be the
+  // ones in use when it was saved. Where the host has mmap() the RAM image is
+  // mapped copy-on-write from the file instead of being read, so the file
+  // must not be modified while the machine runs; SaveSnapshot() replaces
+  // the file rather than writing over it.
+  //
+  // Parameters:
+  //
+  //   filename : The snapshot file.
+  //
+  // Returns:
+  //
+  //   bool : true if the machine was restored. If the file is not a
+  //          snapshot, or is too short for its RAM image and CPU state,
+  //          nothing is changed. If only the hardware state of the
+  //          interface is cut short the machine needs a Reset().
+  //
+  bool LoadSnapshot( const char * filename ) ;
+
+  // Function: Fork
+  //
+  // Description:
+  // Clones the running machine into child processes that carry on from the
+  // current state, for example to try several inputs from the same point.
+  // The children share the RAM of the parent copy-on-write, and each one
+  // gets a private copy-on-write image of the disks, so their disk writes
+  // are neither seen by the others nor saved to the image files. The
+  // hardware emulated by the interface is cloned with the process. Call
+  // between Run() calls, and do not let the parent write to the disks while
+  // the children run. The parent collects the children with waitpid().
+  // Needs a host with fork() and mmap().
+  //
+  // Parameters:
+  //
+  //   children : The number of children to start.
+  //
+  // Returns:
+  //
+  //   int : 0 in the parent, 1 to children in each child, or -1 if no more
+  //         children could be started. A child that cannot set up its disk
+  //         images exits with status 1 without running.
+  //
+  int Fork( int children ) ;
+
+  // Function: GetDirtyPages
+  //
+  // Description:
+  // Gets the pages of guest memory written since the dirty pages were last
+  // cleared. Stores made by the CPU, through video memory and by the BIOS
+  // disk and clock calls are tracked; Reset() and LoadSnapshot() mark every
+  // page. Writes the interface makes to the memory itself are not tracked.
+  //
+  // Parameters:
+  //
+  //   bitmap : MEM_DIRTY_BITMAP_SIZE bytes that receive one bit per page,
+  //            bit ( page & 7 ) of byte page / 8. May be NULL.
+  //
+  //   clear : true to clear the dirty pages once they are read.
+  //
+  // Returns:
+  //
+  //   uint32_t : The number of dirty pages.
+  //
+  uint32_t GetDirtyPages( uint8_t * bitmap , bool clear ) ;
+
+  // Function: RewindEnable
+  //
+  // Description:
+  // Starts or stops keeping checkpoints to Rewind() to. A checkpoint is
+  // taken at the start of a Run() call once interval_ms of emulated time
+  // has passed since the last one. Each holds the RAM pages and the CPU, IO
+  // port and interface state that changed since the one before, see
+  // XTrewind.h, and the oldest are dropped to keep them within the budget.
+  // One full copy of RAM and of the state is kept on top of that.
+  //
+  // Parameters:
+  //
+  //   interval_ms : Emulated time between checkpoints in milliseconds.
+  //
+  //   budget_kb : Memory for the checkpoints in KB, 0 to stop.
+  //
+  //   clock_hz : CPU clocks in a second of emulated time.
+  //
+  // Returns:
+  //
+  //   bool : true if rewind is on.
+  //
+  bool RewindEnable( uint32_t interval_ms , uint32_t budget_kb , uint32_t clock_hz ) ;
+
+  // Function: Rewind
+  //
+  // Description:
+  // Takes the machine back to the newest checkpoint that is at least ms of
+  // emulated time old, or to the oldest one kept. The checkpoints after it
+  // are dropped. Disk image contents are not rewound. Call between Run()
+  // calls.
+  //
+  // Parameters:
+  //
+  //   ms : How far back to go, in milliseconds of emulated time.
+  //
+  // Returns:
+  //
+  //   bool : true if the machine was rewound.
+  //
+  bool Rewind( uint32_t ms ) ;
+
+  // Function: GetCounters
+  //
+  // Description:
+  // Gets the performance counters of the CPU, see XTcounters.h. Call
+  // between Run() calls.
+  //
+  // Parameters:
+  //
+  //   counters : Set to the counters.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GetCounters( stCpuCounters_t & counters ) const ;
+
+#if PROFILE
+  // Function: ProfileEnable
+  //
+  // Description:
+  // Starts or stops sampling the guest, see XTprofile.h. The samples taken
+  // so far are kept until the profiler is stopped.
+  //
+  // Parameters:
+  //
+  //   period : CPU clocks between samples, 0 to stop.
+  //
+  //   symbol_file : Symbol map of the guest code, may be NULL.
+  //
+  // Returns:
+  //
+  //   bool : true if the profiler is on.
+  //
+  bool ProfileEnable( uint32_t period , const char * symbol_file ) ;
+
+  // Function: ProfileReport
+  //
+  // Description:
+  // Writes the hotspots, the time in each symbol of the map, the opcode mix
+  // and the time in each BIOS service sampled so far.
+  //
+  // Parameters:
+  //
+  //   fp : The file to write the report to.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void ProfileReport( FILE * fp ) ;
+#endif
+
+#if TRACE
+  // Function: TraceEnable
+  //
+  // Description:
+  // Starts or stops keeping a ring of the last instructions run, see
+  // XTtrace.h. While it is on translated code is not run, so that every
+  // instruction is traced. The trace is written to fault_file the first
+  // time the CPU meets an instruction it does not support or an 8087
+  // instruction.
+  //
+  // Parameters:
+  //
+  //   records : Instructions to keep, rounded up to a power of 2, 0 to stop.
+  //
+  //   fault_file : The trace file to write on a fault.
+  //
+  // Returns:
+  //
+  //   bool : true if the trace is on.
+  //
+  bool TraceEnable( uint32_t records , const char * fault_file ) ;
+
+  // Function: TraceDump
+  //
+  // Description:
+  // Writes the instructions in the ring to a trace file. They are kept, so
+  // the next dump writes them again with the ones run since.
+  //
+  // Parameters:
+  //
+  //   filename : The trace file.
+  //
+  //   reason : Why the trace is written, goes in the file header.
+  //
+  // Returns:
+  //
+  //   bool : true if the trace was written.
+  //
+  bool TraceDump( const char * filename , const char * reason ) ;
+#endif
+
+private:
+  inline uint8_t * operand_ptr( uint32_t addr ) ;
+
+  int8_t set_CF( int new_CF ) ;
+  int8_t set_AF( int new_AF ) ;
+  int8_t set_OF( int new_OF ) ;
+  int8_t set_AF_OF_arith( void ) ;
+  void   sync_flags( uint16_t flags ) ;
+  void   make_flags( void ) ;
+  void   set_flags( int new_flags ) ;
+  void   set_opcode( uint8_t opcode ) ;
+  void   decode_instruction( uint8_t * opcode_stream , uint64_t raw_bytes , stDecoded_t * decoded ) ;
+  void   fetch_instruction( void ) ;
+  void   sync_devices( void ) ;
+  void   retire_instruction( void ) ;
+
+  template< typename T > void alu_reg_rm( void ) ;
+  template< bool S >     void alu_immediate( void ) ;
+  template< bool D >     void mov_sreg( void ) ;
+
+  uint32_t mem_operand( uint32_t addr , uint8_t access ) ;
+  void     mem_retire( void ) ;
+  uint32_t mem_read( uint8_t w , uint32_t addr ) ;
+  void     mem_write( uint8_t w , uint32_t addr , uint32_t value ) ;
+  void     mem_dirty_range( uint32_t addr , uint32_t bytes ) ;
+
+  bool     string_block( uint8_t seg , uint8_t reg , uint32_t count , bool write , uint32_t & addr ) ;
+  uint32_t rep_movs_block( uint8_t seg , uint32_t count ) ;
+  uint32_t rep_cmps_block( uint8_t seg , uint32_t count ) ;
+
+  int8_t pc_interrupt( uint8_t interrupt_num ) ;
+  bool   disk_overlay_open( int drive ) ;
+  void   disk_overlay_close( int drive ) ;
+  int    disk_transfer( uint8_t drive , uint32_t pos , uint32_t addr , uint32_t count , bool write ) ;
+  void     snapshot_state( stSnapshotCPU_t & state ) ;
+  void     snapshot_restore( const stSnapshotCPU_t & state ) ;
+  uint32_t rewind_capture( void ) ;
+  void     rewind_checkpoint( void ) ;
+  void     rewind_clear( void ) ;
+#if PROFILE
+  void     profile_sample( void ) ;
+  void     profile_bios_map( void ) ;
+#endif
+#if TRACE
+  void     trace_record( void ) ;
+  void     trace_fault( const char * reason ) ;
+#endif
+  void   idle_skip( void ) ;
+  bool   idle_wait( uint8_t interrupt_num ) ;
+  int    AAA_AAS( int8_t which_operation ) ;
+
+#if JIT
+  void      jit_init( void ) ;
+  void      jit_flush( void ) ;
+  uint8_t * jit_translate( uint16_t cs , uint16_t ip ) ;
+  uint32_t  jit_run( uint32_t max_instructions ) ;
+#if JIT_DIFF
+  void      jit_diff( const regfile_t & before , uint16_t ip_before , uint32_t count ) ;
+#endif
+#endif
+
+  T8086TinyInterface_t & Interface ;
+
+  regfile_t regfile ;
+
+  stOpcode_t stOpcode ;
+
+  uint32_t op_source      ;
+  uint32_t op_dest        ;
+  uint32_t rm_addr        ;
+  uint32_t op_to_addr     ;
+  uint32_t op_from_addr   ;
+  uint32_t scratch_uint   ;
+  uint32_t scratch2_uint  ;
+
+  int op_result , disk[ 3 ] , scratch_int ;
+
+  // Disk images of a forked machine, mapped copy-on-write, see Fork()
+  uint8_t  * disk_overlay[ 3 ]      ;
+  uint32_t   disk_overlay_size[ 3 ] ;
+  uint32_t   disk_overlay_pos[ 3 ]  ;
+  bool       forked                 ;
+
+  uint16_t   reg_ip       ;
+  uint16_t   seg_override ;
+  uint16_t   i_data0      ;
+  uint16_t   i_data1      ;
+  uint16_t   i_data2      ;
+
+  // The decode and prefix bytes below are written one at a time and then
+  // tested together. Adjacent byte members would let the compiler fold those
+  // tests into a single wide load, which cannot be forwarded from the pending
+  // byte stores and stalls every instruction, so each gets its own word.
+  alignas( 8 ) uint8_t i_rm            ;
+  alignas( 8 ) uint8_t i_w             ;
+  alignas( 8 ) uint8_t i_reg           ;
+  alignas( 8 ) uint8_t i_mod           ;
+  alignas( 8 ) uint8_t i_d             ;
+  alignas( 8 ) uint8_t seg_override_en ;
+  alignas( 8 ) uint8_t rep_override_en ;
+  alignas( 8 ) uint8_t trap_flag       ;
+
+  uint8_t   i_reg4bit       ;
+  uint8_t   rep_mode        ;
+  uint8_t   scratch_uchar   ;
+
+  bool      exit_emulation  ;
+  int       instr_since_int8 ;
+  uint32_t  instr_cycles     ; // Clocks taken by the current instruction
+
+  // Device event scheduling: the interface only runs once cycles_pending
+  // reaches cycles_deadline, the ticks to its next event, or before a port
+  // access. devices_changed records that TimerTick() reported a change.
+  uint32_t  cycles_pending   ;
+  uint32_t  cycles_deadline  ;
+  uint64_t  cycles_elapsed   ; // Clocks passed to TimerTick() since power on
+  bool      devices_changed  ;
+
+  // Waiting for an interrupt, see IDLE_DETECT. halt_state is one of HALT_xx,
+  // idle_woken lets the INT that was waited on run once it is retried.
+  uint8_t   halt_state       ;
+  bool      idle_woken       ;
+  uint32_t  halt_passes      ; // Passes of this Run() made halted
+  uint8_t   idle_polls       ; // INT 16h AH=01 calls in a row with no key
+  uint64_t  idle_poll_time   ; // cycles_elapsed at the last one
+
+  // Lazy flags state: the SZP record holds the result of the last instruction
+  // that updated SF/ZF/PF, the AO record holds the operands of the last
+  // arithmetic instruction that updated AF/OF, with op_source already folded
+  // as set_AF_OF_arith() does and the CF it would have seen.
+  uint16_t  lazy_flags_pending ;
+  int       lazy_szp_result    ;
+  uint8_t   lazy_szp_w         ;
+  uint32_t  lazy_ao_result     ;
+  uint32_t  lazy_ao_source     ;
+  uint32_t  lazy_ao_dest       ;
+  uint8_t   lazy_ao_w          ;
+  uint8_t   lazy_ao_cf         ;
+
+#if JIT
+  // Dynamic translation state. Translated code reaches reg_ip and the
+  // members below through their offset from regfile.
+  uint8_t      * jit_code          ; // Code cache, NULL if it could not be mapped
+  uint8_t      * jit_code_free     ; // First unused byte of the code cache
+  uint8_t      * jit_exit          ; // Return to jit_run()
+  uint8_t      * jit_exit_stale    ; // Return to jit_run(), guest code changed
+  uint8_t      * jit_link_site     ; // Exit jump waiting to be chained
+  int32_t        jit_budget_cycles ; // Clocks left before the next device event
+  int32_t        jit_budget_instr  ; // Instructions left in this Run() call
+#if JIT_DIFF
+  uint32_t       jit_store_count   ;
+  stJitStore_t   jit_store_log[ JIT_BLOCK_INSTR ] ;
+  bool           jit_suspended     ; // Interpreting a block to check it
+#endif
+  stJitBlock_t   jit_blocks[ JIT_BLOCK_COUNT ] ;
+#endif
+
+  // Flags read by each Jcc condition, built from xt_jcc_table
+  uint16_t  jcc_flags_used[ 8 ] ;
+
+  // Memory map, MEM_PAGE_xx type of each page. A memory operand in a page
+  // that is not RAM is moved to the bounce buffer, see mem_operand(), and
+  // mem_bounce_addr is its real address until the instruction retires.
+  uint8_t   mem_map[ MEM_PAGE_COUNT ] ;
+  uint32_t  mem_bounce_addr   ;
+  uint8_t   mem_bounce_access ;
+
+  // MEM_DIRTY_xx bits of each page, set when it is written and cleared by
+  // each reader. A byte per page, so marking a page is a plain store.
+  uint8_t   mem_dirty[ MEM_PAGE_COUNT ] ;
+
+  // Rewind checkpoints, see RewindEnable(). The ring holds rewind_count
+  // checkpoints from rewind_first, rewind_ram and rewind_state are RAM and
+  // the state at the newest one and rewind_work is room to build the next.
+  stRewindPoint_t * rewind_points     ;
+  uint32_t          rewind_capacity   ;
+  uint32_t          rewind_first      ;
+  uint32_t          rewind_count      ;
+  size_t            rewind_bytes      ; // Checkpoint memory in use
+  size_t            rewind_budget     ;
+  uint64_t          rewind_interval   ; // In clocks
+  uint64_t          rewind_next       ; // cycles_elapsed for the next one
+  uint32_t          rewind_clock_hz   ;
+  uint32_t          rewind_state_size ;
+  uint8_t         * rewind_ram        ;
+  uint8_t         * rewind_state      ;
+  uint8_t         * rewind_work       ;
+  FILE            * rewind_fp         ; // Scratch file for the interface state
+
+  // Performance counters, see GetCounters()
+  uint64_t          counter_instructions    ;
+  uint64_t          counter_interrupts[ 256 ] ;
+  uint64_t          counter_disk_sectors[ 2 ] ; // Read, written
+
+#if PROFILE
+  // Profiler, see ProfileEnable(). profile_hits counts the samples at each
+  // linear address, profile_bios those in each BIOS service.
+  // profile_bios_vector gives the service of each BIOS offset, and is built
+  // again when the vector table holds a BIOS entry point not seen before.
+  uint64_t            profile_period        ; // In clocks, 0 when off
+  uint64_t            profile_next          ; // Clock of the next sample, UINT64_MAX when off
+  uint64_t            profile_samples       ;
+  uint64_t            profile_halted        ; // Samples waiting for an interrupt
+  uint32_t          * profile_hits          ;
+  uint32_t            profile_opcodes[ 256 ] ; // By raw opcode
+  uint32_t            profile_bios[ PROFILE_BIOS_OTHER + 1 ] ;
+  int32_t             profile_bios_entry[ 256 ] ; // BIOS offset of each vector, -1 if none seen
+  uint16_t          * profile_bios_vector   ;
+  uint32_t            profile_ivt[ 256 ]    ; // The vector table when the map was checked
+  stProfileSymbol_t * profile_symbols       ;
+  uint32_t            profile_symbol_count  ;
+#endif
+
+#if TRACE
+  // Instruction trace, see TraceEnable(). trace_record() fills in record
+  // trace_total of the ring from what fetch_instruction() and MEM_DIRTY()
+  // kept of the instruction, and trace_regs holds the registers after the
+  // record before.
+  stTraceRecord_t   * trace_ring            ; // NULL when off
+  uint32_t            trace_mask            ; // Ring size - 1
+  uint64_t            trace_total           ;
+  uint16_t            trace_regs[ TRACE_REG_COUNT ] ;
+  uint64_t            trace_bytes           ;
+  uint16_t            trace_cs              ;
+  uint16_t            trace_ip              ;
+  uint32_t            trace_write           ; // TRACE_NO_WRITE if none
+  uint8_t             trace_info            ;
+  uint8_t             trace_interrupt       ;
+  const char        * trace_fault_file      ;
+  const char        * trace_fault_reason    ; // Set until the fault is dumped
+  bool                trace_faulted         ; // The fault dump has been written
+#endif
+
+  stDecoded_t decode_cache[ DECODE_CACHE_SIZE ] ;
+
+  // Emulated RAM and IO port space. RAM_SIZE covers the 1MB address space
+  // plus the 64K-16 bytes reachable above it with FFFF:xxxx, the bounce
+  // buffer and the fetch slack follow it. Page aligned so LoadSnapshot()
+  // can map it.
+  alignas( MEM_PAGE_SIZE ) uint8_t mem[ RAM_SIZE + MEM_BOUNCE_SIZE + MEM_FETCH_SLACK ] ;
+  uint8_t   io_ports[ IO_PORT_COUNT ] ;
+} ;
+
+#endif
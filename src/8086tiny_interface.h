@@ -4,6 +4,12 @@
 // Description:
 // 8086tiny interface class.
 //
+// An interface object emulates the hardware of one machine for the CPU.
+// The headless interface keeps that state in the object, so a process can
+// run several machines, each with its own interface object and CPU8086.
+// The Win32 interface drives the window of the process and keeps its state
+// in the module, so it only supports one.
+//
 // This work is licensed under the MIT License. See included LICENSE.TXT.
 //
 #ifndef __8086TINY_INTERFACE_H
@@ -13,6 +19,15 @@
 #include <Windows.h>
 #endif
 
+#include <stdio.h>
+#include <sys/timeb.h>
+
+#include "emulator/XTcounters.h"
+
+#if !defined(_WIN32)
+struct FarmResult_t;
+#endif
+
 class T8086TinyInterface_t
 {
 public:
@@ -34,6 +49,39 @@ public:
   //   None.
   //
   void SetInstance(HINSTANCE hInst);
+#else
+  // Function: SetArgs
+  //
+  // Description:
+  // Passes the command line to the interface.
+  //
+  // Parameters :
+  //
+  //   argc : The number of arguments, including the program name.
+  //
+  //   argv : The arguments.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void SetArgs(int argc, char **argv);
+
+  // Function: SetFarmResult
+  //
+  // Description:
+  // Makes the machine a job of the farm, see headless_farm.h. Cleanup()
+  // fills in the result of the job.
+  //
+  // Parameters :
+  //
+  //   Result : The result of the job.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void SetFarmResult(FarmResult_t *Result);
 #endif
 
   // Function: Initialise
@@ -79,6 +127,103 @@ public:
   //
   bool ExitEmulation(void);
 
+  // Function: GuestHalted
+  //
+  // Description:
+  // Called when the guest runs HLT with interrupts disabled, which nothing
+  // but a reset can end.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true if the emulation should exit.
+  //
+  bool GuestHalted(void);
+
+  // Function: GuestQuit
+  //
+  // Description:
+  // Called when the guest runs JMP FAR 0000:0000, which 8086tiny programs
+  // such as QUITEMU.COM use to end the emulation.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true if the emulation should exit. The guest is left at
+  //          0000:0000.
+  //
+  bool GuestQuit(void);
+
+  // Function: GuestWaitsForKey
+  //
+  // Description:
+  // Called when the guest waits for a key: INT 16h AH=00h or 10h with the
+  // keyboard buffer empty, or the DOS idle call INT 28h. A guest that only
+  // polls with INT 16h AH=01h, as the FreeDOS kernel does for F5/F8, is not
+  // waiting: it takes the key it finds.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GuestWaitsForKey(void);
+
+  // Function: PutChar
+  //
+  // Description:
+  // Writes a character of the guest's text output, from the PUTCHAR_AL
+  // emulator opcode 0F 00.
+  //
+  // Parameters:
+  //
+  //   c : The character.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void PutChar(unsigned char c);
+
+  // Function: GetInstructionLimit
+  //
+  // Description:
+  // Gets the number of instructions to run before the emulation exits.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   unsigned long long : The instruction limit, 0 for none.
+  //
+  unsigned long long GetInstructionLimit(void);
+
+  // Function: ExitStatus
+  //
+  // Description:
+  // Called once the emulation has exited, before Cleanup().
+  //
+  // Parameters:
+  //
+  //   Instructions : The number of instructions run.
+  //
+  // Returns:
+  //
+  //   int : The exit status of the process.
+  //
+  int ExitStatus(unsigned long long Instructions);
+
   // Function: Reset
   //
   // Description:
@@ -154,14 +299,236 @@ public:
   //
   bool FDChanged(void);
 
+  // Function: DiskCopyOnWrite
+  //
+  // Description:
+  // Checks if the guest's disk writes should be kept in memory, so that the
+  // image files are left as they were.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true to keep the disk writes from the image files.
+  //
+  bool DiskCopyOnWrite(void);
+
+  // Function: SnapshotRequest
+  //
+  // Description:
+  // Checks if the user has asked to save or load a machine snapshot.
+  // Called before the first instruction, after each slice of instructions
+  // and once more after ExitStatus().
+  //
+  // Parameters:
+  //
+  //   Filename : Set to the snapshot file name.
+  //
+  //   Save : Set to true to save a snapshot, false to load one.
+  //
+  // Returns:
+  //
+  //   bool : true if a snapshot should be saved or loaded now.
+  //
+  bool SnapshotRequest(const char *&Filename, bool &Save);
+
+  // Function: ForkRequest
+  //
+  // Description:
+  // Checks if the machine should be forked now, see CPU8086::Fork(). Called
+  // after each slice of instructions.
+  //
+  // Parameters:
+  //
+  //   Children : Set to the number of children to start.
+  //
+  // Returns:
+  //
+  //   bool : true if the machine should be forked now.
+  //
+  bool ForkRequest(int &Children);
+
+  // Function: ForkStarted
+  //
+  // Description:
+  // Called in the parent and in each child once CPU8086::Fork() returns.
+  // The instruction limit is read again after it.
+  //
+  // Parameters:
+  //
+  //   Child : What Fork() returned: 0 in the parent, the child number in
+  //           a child, -1 if not all the children could be started.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void ForkStarted(int Child);
+
+  // Function: GetRewindConfig
+  //
+  // Description:
+  // Gets the rewind settings, see CPU8086::RewindEnable().
+  //
+  // Parameters:
+  //
+  //   IntervalMs : Set to the emulated time between checkpoints in ms.
+  //
+  //   BudgetKB : Set to the memory for the checkpoints in KB, 0 for none.
+  //
+  //   ClockHz : Set to the emulated CPU clock in Hz.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GetRewindConfig(unsigned int &IntervalMs, unsigned int &BudgetKB, unsigned int &ClockHz);
+
+  // Function: RewindRequest
+  //
+  // Description:
+  // Checks if the user has asked to rewind the machine.
+  //
+  // Parameters:
+  //
+  //   Ms : Set to how far back to go in milliseconds of emulated time.
+  //
+  // Returns:
+  //
+  //   bool : true if the machine should be rewound now.
+  //
+  bool RewindRequest(unsigned int &Ms);
+
+  // Function: GetProfileConfig
+  //
+  // Description:
+  // Gets the guest profiler settings, see CPU8086::ProfileEnable(). Only
+  // builds with PROFILE call this.
+  //
+  // Parameters:
+  //
+  //   PeriodClocks : Set to the CPU clocks between samples, 0 for none.
+  //
+  //   SymbolFilename : Set to the symbol map file name, NULL for none.
+  //
+  //   ReportFilename : Set to the report file name, NULL for stdout.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GetProfileConfig(unsigned int &PeriodClocks, const char *&SymbolFilename, const char *&ReportFilename);
+
+  // Function: GetTraceConfig
+  //
+  // Description:
+  // Gets the instruction trace settings, see CPU8086::TraceEnable(). Only
+  // builds with TRACE call this.
+  //
+  // Parameters:
+  //
+  //   Records : Set to the number of instructions to keep, 0 for none.
+  //
+  //   Filename : Set to the trace file name.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GetTraceConfig(unsigned int &Records, const char *&Filename);
+
+  // Function: TraceRequest
+  //
+  // Description:
+  // Checks if the user has asked to write the instruction trace.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true if the trace should be written now.
+  //
+  bool TraceRequest(void);
+
+  // Function: StatsRequest
+  //
+  // Description:
+  // Checks if the performance counters are due to be written, which they
+  // are once every stats period of host time while the stats output is on.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true if WriteStats() should be called now.
+  //
+  bool StatsRequest(void);
+
+  // Function: WriteStats
+  //
+  // Description:
+  // Writes the performance counters of the CPU with those of the interface
+  // to the stats output, if it is on.
+  //
+  // Parameters:
+  //
+  //   Counters : The CPU counters, see CPU8086::GetCounters().
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void WriteStats(const stCpuCounters_t &Counters);
+
+  // Function: SaveState
+  //
+  // Description:
+  // Writes the state of the emulated hardware to a snapshot file: timers,
+  // interrupt controller, keyboard, video, serial ports and speaker.
+  // Host resources (windows, sockets, sound output) are not included.
+  //
+  // Parameters:
+  //
+  //   fp : The snapshot file, positioned where the state goes.
+  //
+  // Returns:
+  //
+  //   bool : true if the state was written.
+  //
+  bool SaveState(FILE *fp);
+
+  // Function: LoadState
+  //
+  // Description:
+  // Reads back the hardware state written by SaveState().
+  //
+  // Parameters:
+  //
+  //   fp : The snapshot file, positioned at the state.
+  //
+  // Returns:
+  //
+  //   bool : true if the state was read.
+  //
+  bool LoadState(FILE *fp);
+
   // Function: TimerTick
   //
   // Description:
-  // Call this every instruction to update the HW emulation.
+  // Call this to update the HW emulation with the CPU ticks run since the
+  // last call. It must be called once NextEventTicks() ticks have run, and
+  // before every ReadPort()/WritePort(), but need not be called for every
+  // instruction. nTicks may be large, e.g. for a REP string instruction.
   //
   // Parameters:
   //
-  //   nTicks : The number of CPU ticks elapsed in the instruction
+  //   nTicks : The number of CPU ticks elapsed since the last call
   //
   // Returns:
   //
@@ -174,6 +541,26 @@ public:
   //
   bool TimerTick(int nTicks);
 
+  // Function: NextEventTicks
+  //
+  // Description:
+  // Gets the deadline of the next HW event: the next PIT channel 0 reload,
+  // the next 4 ms frame (screen, keyboard, mouse and serial processing) or,
+  // while channel 2 drives the speaker, the next sound sample.
+  // The CPU can run this many ticks before it has to call TimerTick().
+  // Call again after every TimerTick() and after every WritePort(), which
+  // may reprogram the timers.
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   int : The number of CPU ticks to the next event, at least 1.
+  //
+  int NextEventTicks(void);
+
   // Function: WritePort
   //
   // Description:
@@ -206,6 +593,23 @@ public:
   //
   unsigned char ReadPort(int Address);
 
+  // Function: GetRTCTime
+  //
+  // Description:
+  // Gets the time of day of the emulated real time clock. It follows the
+  // host clock, plus or minus the time the emulation has gained or lost
+  // while it was not tied to real time (turbo mode).
+  //
+  // Parameters:
+  //
+  //   Now : Set to the current time of day.
+  //
+  // Returns:
+  //
+  //   None.
+  //
+  void GetRTCTime(struct timeb &Now);
+
   unsigned int VMemRead(int i_w, int addr);
 
   unsigned int VMemWrite(int i_w, int addr, unsigned int val);
@@ -227,13 +631,47 @@ public:
   //
   bool IntPending(int &IntNumber);
 
+  // Function: IntRequest
+  //
+  // Description:
+  // The interrupt line: cheap check, for every instruction, of whether
+  // IntPending() has an interrupt. It only changes in TimerTick(),
+  // ReadPort(), WritePort(), IntPending() and Reset().
+  //
+  // Parameters:
+  //
+  //   None.
+  //
+  // Returns:
+  //
+  //   bool : true when a device asserts an interrupt.
+  //
+  bool IntRequest(void) const { return IntLine; }
+
 private:
+  // Each object is the hardware of one machine
+  T8086TinyInterface_t(const T8086TinyInterface_t &) = delete;
+  T8086TinyInterface_t &operator=(const T8086TinyInterface_t &) = delete;
 
   unsigned char Port[65536];
   unsigned char *mem;
 
+  // Interrupt line state returned by IntRequest()
+  bool IntLine;
+
+  // Sets IntLine from the devices that can request an interrupt.
+  void UpdateIntLine(void);
+
+  // Runs the timers for nTicks CPU ticks, which must not pass the end of
+  // the current frame. Returns as TimerTick.
+  bool FrameTick(int nTicks);
+
 #if defined(_WIN32)
   HINSTANCE hInstance;
+#else
+  // The emulated hardware and the options of this machine
+  struct State_t;
+  State_t *State;
 #endif
 };
 
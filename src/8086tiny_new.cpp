@@ -17,12 +17,17 @@
 
 #include <time.h>
 #include <memory.h>
+#include <stdlib.h>
+#include <new>
 #include <stdio.h>
 
-#include <windows.h>
+#if defined(_WIN32)
+  #include <windows.h>
+  #include <conio.h>
+#endif
 #include <sys/timeb.h>
+#include <sys/stat.h>
 #include <fcntl.h>
-#include <conio.h>
 
 #include <unistd.h>
 
@@ -31,16 +36,35 @@
 #endif
 
 #include "8086tiny_interface.h"
-#include "emulator/XTmemory.h"
+#include "8086tiny_cpu.h"
+#include "shared/timeline.h"
+
+#if !defined(_WIN32)
+  #include <sys/mman.h>
+#endif
 
-T8086TinyInterface_t Interface ;
+// Only Windows has binary/inheritable file modes
+#ifndef O_BINARY
+  #define O_BINARY                               0
+#endif
+#ifndef O_NOINHERIT
+  #define O_NOINHERIT                            0
+#endif
 
 #define XFALSE                                   ( ( uint8_t ) 0x00 )
 #define XTRUE                                    ( ( uint8_t ) 0x01 )
 
 // Emulator system constants
 
-#define REGS_BASE                                0xF0000
+#define BIOS_BASE                                0xF0000
+
+// BIOS data area keyboard buffer head and tail pointers
+#define BDA_KEYBUF_HEAD                          0x41A
+#define BDA_KEYBUF_TAIL                          0x41C
+
+// Operand addresses at or above REGS_BASE select the host side register
+// file instead of guest memory, see operand_ptr().
+#define REGS_BASE                                0x110000
 
 // 16-bit register decodes
 
@@ -85,83 +109,355 @@ T8086TinyInterface_t Interface ;
 #define FLAG_DF                                  47
 #define FLAG_OF                                  48
 
-// Lookup tables in the BIOS binary
-#define TABLE_XLAT_OPCODE                        8
-#define TABLE_XLAT_SUBFUNCTION                   9
-#define TABLE_STD_FLAGS                          10
-#define TABLE_PARITY_FLAG                        11
-#define TABLE_BASE_INST_SIZE                     12
-#define TABLE_I_W_SIZE                           13
-#define TABLE_I_MOD_SIZE                         14
-#define TABLE_COND_JUMP_DECODE_A                 15
-#define TABLE_COND_JUMP_DECODE_B                 16
-#define TABLE_COND_JUMP_DECODE_C                 17
-#define TABLE_COND_JUMP_DECODE_D                 18
-#define TABLE_FLAGS_BITFIELDS                    19
-
-// Bitfields for TABLE_STD_FLAGS values
+// Bitfields for stOpcode_t set_flags_type values
 #define FLAGS_UPDATE_SZP                         1
 #define FLAGS_UPDATE_AO_ARITH                    2
 #define FLAGS_UPDATE_OC_LOGIC                    4
 
+// Lazy flag evaluation.
+//
+// When LAZY_FLAGS is non-zero SF, ZF, PF, AF and OF are not computed at the
+// end of each instruction. Instead the operands of the last instruction that
+// updated them are recorded and each flag is only materialised into
+// regs8[FLAG_xx] when something reads it (Jcc, LOOPZ/NZ, INTO, DAA/DAS,
+// AAA/AAS and make_flags() for PUSHF/LAHF/SAHF/interrupts).
+// Set to 0 to update the flags eagerly after every instruction.
+#ifndef LAZY_FLAGS
+  #define LAZY_FLAGS                             1
+#endif
+
+// Bitfields for lazy_flags_pending, one bit per FLAG_xx offset from FLAG_CF
+#define LAZY_PF                                  ( 1 << ( FLAG_PF - FLAG_CF ) )
+#define LAZY_AF                                  ( 1 << ( FLAG_AF - FLAG_CF ) )
+#define LAZY_ZF                                  ( 1 << ( FLAG_ZF - FLAG_CF ) )
+#define LAZY_SF                                  ( 1 << ( FLAG_SF - FLAG_CF ) )
+#define LAZY_OF                                  ( 1 << ( FLAG_OF - FLAG_CF ) )
+
+#define LAZY_SZP                                 ( LAZY_SF | LAZY_ZF | LAZY_PF )
+#define LAZY_AO                                  ( LAZY_AF | LAZY_OF )
+#define LAZY_ALL                                 ( LAZY_SZP | LAZY_AO )
+
+// Materialise the given lazy flags before they are read
+#if LAZY_FLAGS
+  #define FLAGS_SYNC(flags)                      if( lazy_flags_pending & ( flags ) ) sync_flags( flags )
+#else
+  #define FLAGS_SYNC(flags)
+#endif
+
+// Instruction trace hooks, see CPU8086::TraceEnable(). TRACE_FAULT() marks
+// the instruction running as one that should not happen and
+// TRACE_INTERRUPT() the interrupt taken before the next one.
+#if TRACE
+  #define TRACE_NO_WRITE                         0xFFFFFFFF
+  #define TRACE_FAULT(reason)                    trace_fault( reason )
+  #define TRACE_INTERRUPT(num)                   ( trace_info |= TRACE_INFO_INTERRUPT , trace_interrupt = ( uint8_t ) ( num ) )
+#else
+  #define TRACE_FAULT(reason)
+  #define TRACE_INTERRUPT(num)
+#endif
+
+// Threaded dispatch.
+//
+// When THREADED_DISPATCH is non-zero each opcode handler ends by retiring its
+// instruction, fetching the next one and jumping straight to that handler
+// through a table of label addresses, so every handler has its own indirect
+// branch for the host branch predictor to learn. This needs the GCC/Clang
+// labels-as-values extension, other compilers always use the switch.
+// It is off by default: on current hosts, whose predictors already handle
+// the single switch branch well, the extra code costs more than it saves.
+// Build the Bench32 and Bench32Threaded targets to compare both on a host.
+// JIT builds always use the switch, translated blocks are entered from the
+// top of the instruction loop.
+#if !defined(THREADED_DISPATCH) || !defined(__GNUC__) || JIT
+  #undef  THREADED_DISPATCH
+  #define THREADED_DISPATCH                      0
+#endif
+
+// Cycle timing.
+//
+// When CYCLE_TIMING is non-zero each instruction counts its 8088 clocks
+// towards Interface.TimerTick(), from the tables in XTdecode.h plus the clocks
+// that depend on the run time state: taken jumps, shift counts and the
+// repetitions of REP string instructions. The timers, the screen refresh and
+// programs that time themselves with a delay loop then see the speed of a
+// real PC/XT. Set to 0 to count 4 clocks for every instruction.
+#ifndef CYCLE_TIMING
+  #define CYCLE_TIMING                           1
+#endif
+
+// Idle detection.
+//
+// HLT always waits for the next interrupt, skipping the clocks up to the next
+// device event instead of running them one instruction at a time. When
+// IDLE_DETECT is non-zero the emulator also treats these as a HLT in front of
+// the INT, so a program waiting for a key does not keep the host busy:
+//
+//   INT 16h AH=00 with an empty keyboard buffer, while INT 16h still points
+//                 at the BIOS. It waits on the INT until a key arrives.
+//   INT 16h AH=01 with an empty keyboard buffer, once it has been called
+//                 IDLE_POLLS times in a row less than IDLE_POLL_CLOCKS apart.
+//   INT 28h       the DOS idle call.
+//
+// The last two wait once, for the next interrupt, then run the INT.
+#ifndef IDLE_DETECT
+  #define IDLE_DETECT                            1
+#endif
+
+#define IDLE_POLLS                               16
+#define IDLE_POLL_CLOCKS                         1000
+
+// halt_state values
+#define HALT_NONE                                0
+#define HALT_HLT                                 1 // On a HLT, resume after it
+#define HALT_IDLE                                2 // On an INT, resume on it
+
+#if CYCLE_TIMING
+  #define CYCLES_ADD(n)                          instr_cycles += ( n )
+#else
+  #define CYCLES_ADD(n)
+#endif
+
+#if THREADED_DISPATCH
+  #define OPCODE(id)                             case id : opcode_##id
+  #define OPCODE_DEFAULT                         default : opcode_default
+  #define DISPATCH_OPCODE                        goto *dispatch_table[ stOpcode.xlat_opcode_id ]
+  #define NEXT_OPCODE                            do { retire_instruction() ; \
+                                                      if( ( ++executed >= n_instructions ) || exit_emulation ) goto run_exit ; \
+                                                      fetch_instruction() ; \
+                                                      DISPATCH_OPCODE ; } while( 0 )
+  #define FETCH_INLINE                           inline __attribute__(( always_inline ))
+  #define RETIRE_INLINE                          __attribute__(( noinline ))
+#else
+  #define OPCODE(id)                             case id
+  #define OPCODE_DEFAULT                         default
+  #define DISPATCH_OPCODE
+  #define NEXT_OPCODE                            break
+  #define FETCH_INLINE                           inline
+  #define RETIRE_INLINE                          inline
+#endif
+
+// The width and direction specialised arm helpers are expanded in place
+#ifdef __GNUC__
+  #define ARM_INLINE                             inline __attribute__(( always_inline ))
+#else
+  #define ARM_INLINE                             inline
+#endif
+
+// Instructions executed per CPU8086::Run() call from the main loop
+#define RUN_SLICE                                100000
+
+// Benchmark builds define BENCHMARK as a number of instructions. They run that
+// many instructions without real time throttling, then report the speed.
+
 // Helper macros
 
-// [I]MUL/[I]DIV/DAA/DAS/ADC/SBB helpers
+// [I]MUL/[I]DIV/DAA/DAS helpers
 #define DAA_DAS(op1,op2) set_AF((((scratch_uchar = regs8[REG_AL]) & 0x0F) > 9) || regs8[FLAG_AF]) && (op_result = (regs8[REG_AL] op1 6), set_CF(regs8[FLAG_CF] || (regs8[REG_AL] op2 scratch_uchar))), \
                                   set_CF((regs8[REG_AL] > 0x9f) || regs8[FLAG_CF]) && (op_result = (regs8[REG_AL] op1 0x60))
 
-#define ADC_SBB_MACRO(a) (i_w ? op_dest = *(uint16_t*)&mem[ op_to_addr ], op_result = *(uint16_t*)&mem[ op_to_addr ] a##= regs8[FLAG_CF] + (op_source = *(uint16_t*)&mem[ op_from_addr ]) : (op_dest = mem[ op_to_addr ], op_result = mem[ op_to_addr ] a##= regs8[FLAG_CF] + (op_source = *(uint8_t*)&mem[ op_from_addr ]))), \
-                         set_CF((regs8[FLAG_CF] && (op_result == op_dest)) || (a op_result < a(int)op_dest)), \
-                         set_AF_OF_arith()
-
-// Global variable definitions
-
-typedef struct STOPCODE_T
-{
-  uint32_t set_flags_type  ;
-  uint8_t  raw_opcode_id   ;
-  uint8_t  xlat_opcode_id  ;
-  uint8_t  extra           ;
-  uint8_t  i_mod_size      ;
-} stOpcode_t ;
-
-stOpcode_t stOpcode ;
-
-uint32_t op_source      ;
-uint32_t op_dest        ;
-uint32_t rm_addr        ;
-uint32_t op_to_addr     ;
-uint32_t op_from_addr   ;
-uint32_t scratch_uint   ;
-uint32_t scratch2_uint  ;
-
-int op_result , disk[ 3 ] , scratch_int ;
-
-uint16_t * regs16       ;
-uint16_t   reg_ip       ;
-uint16_t   seg_override ;
-uint16_t   i_data0      ;
-uint16_t   i_data1      ;
-uint16_t   i_data2      ;
-
-uint8_t   bios_table_lookup[ 20 ][ 256 ] ;
-uint8_t * regs8           ;
-uint8_t   i_rm            ;
-uint8_t   i_w             ;
-uint8_t   i_reg           ;
-uint8_t   i_mod           ;
-uint8_t   i_d             ;
-uint8_t   i_reg4bit       ;
-uint8_t   rep_mode        ;
-uint8_t   seg_override_en ;
-uint8_t   rep_override_en ;
-uint8_t   trap_flag       ;
-uint8_t   scratch_uchar   ;
+
+// Register file views
+
+#define regs16                                   regfile.w
+#define regs8                                    regfile.b
+
+// Mark the pages of the word at linear address addr as written. addr is
+// evaluated more than once. STACK_DIRTY() follows a push to SS:SP.
+#if TRACE
+  #define MEM_DIRTY(addr)                        ( trace_write = ( addr ) , \
+                                                   mem_dirty[ ( addr ) >> MEM_PAGE_BITS ] = mem_dirty[ ( ( addr ) + 1 ) >> MEM_PAGE_BITS ] = MEM_DIRTY_ALL )
+#else
+  #define MEM_DIRTY(addr)                        ( mem_dirty[ ( addr ) >> MEM_PAGE_BITS ] = mem_dirty[ ( ( addr ) + 1 ) >> MEM_PAGE_BITS ] = MEM_DIRTY_ALL )
+#endif
+#define STACK_DIRTY()                            MEM_DIRTY( 16 * regs16[ REG_SS ] + regs16[ REG_SP ] )
+
+// Page type of the byte, or with w of the word, at linear address addr:
+// MEM_PAGE_RAM only if every byte is in a RAM page. A word at the end of a
+// page may reach into a video or ROM page. addr is evaluated more than once.
+#define MEM_PAGE_TYPE(addr, w)                   ( mem_map[ ( addr ) >> MEM_PAGE_BITS ] | mem_map[ ( ( addr ) + ( w ) ) >> MEM_PAGE_BITS ] )
 
 // Helper functions
 
+// Return the host pointer for an operand address, either guest memory or,
+// from REGS_BASE up, the register file.
+inline uint8_t * CPU8086::operand_ptr( uint32_t addr )
+{
+  return( ( addr < REGS_BASE ) ? ( mem + addr ) : ( regfile.b + ( addr - REGS_BASE ) ) ) ;
+}
+
+// Memory map.
+//
+// Memory operands in RAM pages are used in place in mem[]. When an operand
+// is in a ROM or video page, fetch_instruction() copies it to the bounce
+// buffer at mem[ RAM_SIZE ], reading video memory through the interface,
+// and points rm_addr there, so the handlers use it unchanged.
+// retire_instruction() then writes it back if the instruction stores to it.
+// String instructions check the map themselves. Stack accesses, interrupt
+// vectors and instruction fetch always use mem[] directly.
+
+void CPU8086::MapMemory( uint32_t base , uint32_t size , uint8_t type )
+{
+  uint32_t page ;
+
+  for( page = base >> MEM_PAGE_BITS ; ( page < MEM_PAGE_COUNT ) && ( ( page << MEM_PAGE_BITS ) < base + size ) ; page++ )
+  {
+    mem_map[ page ] = type ;
+  }
+}
+
+// Move the memory operand at addr, in a page that is not RAM, to the bounce
+// buffer. Returns the operand address to use instead.
+uint32_t CPU8086::mem_operand( uint32_t addr , uint8_t access )
+{
+  // LEA and ESC do not access their operand
+  if( !access )
+  {
+    return( addr ) ;
+  }
+
+  // Already moved, MOV sreg works out its operand again
+  if( mem_bounce_access && ( mem_bounce_addr == addr ) )
+  {
+    return( RAM_SIZE ) ;
+  }
+
+  // Copy the whole buffer, LES/LDS and far CALL/JMP read 4 bytes
+  memcpy( &mem[ RAM_SIZE ] , &mem[ addr ] , MEM_BOUNCE_SIZE ) ;
+  if( access & XT_MEM_READ )
+  {
+    if( i_w )
+    {
+      *( uint16_t * )&mem[ RAM_SIZE ] = mem_read( 1 , addr ) ;
+    }
+    else
+    {
+      mem[ RAM_SIZE ] = mem_read( 0 , addr ) ;
+    }
+  }
+
+  mem_bounce_addr   = addr   ;
+  mem_bounce_access = access ;
+
+  return( RAM_SIZE ) ;
+}
+
+// Write the bounce buffer back if the instruction stored to it
+void CPU8086::mem_retire( void )
+{
+  if( mem_bounce_access & XT_MEM_WRITE )
+  {
+    mem_write( i_w , mem_bounce_addr , *( uint16_t * )&mem[ RAM_SIZE ] ) ;
+  }
+
+  mem_bounce_access = 0 ;
+}
+
+// Read a byte or word through the memory map
+uint32_t CPU8086::mem_read( uint8_t w , uint32_t addr )
+{
+  // A word split between pages of different types is read a byte at a time
+  if( w && ( mem_map[ addr >> MEM_PAGE_BITS ] != mem_map[ ( addr + 1 ) >> MEM_PAGE_BITS ] ) )
+  {
+    return( mem_read( 0 , addr ) | ( mem_read( 0 , addr + 1 ) << 8 ) ) ;
+  }
+
+  if( mem_map[ addr >> MEM_PAGE_BITS ] == MEM_PAGE_VIDEO )
+  {
+    return( Interface.VMemRead( w , addr ) ) ;
+  }
+
+  return( ( w ) ? ( *( uint16_t * )&mem[ addr ] ) : ( mem[ addr ] ) ) ;
+}
+
+// Write a byte or word through the memory map
+void CPU8086::mem_write( uint8_t w , uint32_t addr , uint32_t value )
+{
+  MEM_DIRTY( addr ) ;
+
+  // A word split between pages of different types is written a byte at a time
+  if( w && ( mem_map[ addr >> MEM_PAGE_BITS ] != mem_map[ ( addr + 1 ) >> MEM_PAGE_BITS ] ) )
+  {
+    mem_write( 0 , addr , value & 0xFF ) ;
+    mem_write( 0 , addr + 1 , ( value >> 8 ) & 0xFF ) ;
+    return ;
+  }
+
+  switch( mem_map[ addr >> MEM_PAGE_BITS ] )
+  {
+  case MEM_PAGE_RAM :
+    if( w )
+    {
+      *( uint16_t * )&mem[ addr ] = value ;
+    }
+    else
+    {
+      mem[ addr ] = value ;
+    }
+    break ;
+
+  case MEM_PAGE_VIDEO :
+    Interface.VMemWrite( w , addr , value ) ;
+    break ;
+
+  // ROM
+  default :
+    break ;
+  }
+}
+
+// Mark the pages from addr to addr + bytes - 1 as written
+void CPU8086::mem_dirty_range( uint32_t addr , uint32_t bytes )
+{
+  uint32_t page ;
+
+  for( page = addr >> MEM_PAGE_BITS ; page <= ( addr + bytes - 1 ) >> MEM_PAGE_BITS ; page++ )
+  {
+    mem_dirty[ page ] = MEM_DIRTY_ALL ;
+  }
+}
+
+uint32_t CPU8086::GetDirtyPages( uint8_t * bitmap , bool clear )
+{
+  uint32_t count ;
+  uint32_t page  ;
+
+  if( bitmap != NULL )
+  {
+    memset( bitmap , 0x00 , MEM_DIRTY_BITMAP_SIZE ) ;
+  }
+
+  count = 0 ;
+  for( page = 0 ; page < MEM_PAGE_COUNT ; page++ )
+  {
+    if( mem_dirty[ page ] & MEM_DIRTY_USER )
+    {
+      count++ ;
+      if( bitmap != NULL )
+      {
+        bitmap[ page >> 3 ] |= 1 << ( page & 7 ) ;
+      }
+
+      if( clear )
+      {
+        mem_dirty[ page ] &= ~MEM_DIRTY_USER ;
+      }
+    }
+  }
+
+  return( count ) ;
+}
+
+void CPU8086::GetCounters( stCpuCounters_t & counters ) const
+{
+  counters.instructions         = counter_instructions ;
+  counters.cycles               = cycles_elapsed + cycles_pending ;
+  memcpy( counters.interrupts , counter_interrupts , sizeof( counters.interrupts ) ) ;
+  counters.disk_sectors_read    = counter_disk_sectors[ 0 ] ;
+  counters.disk_sectors_written = counter_disk_sectors[ 1 ] ;
+}
+
 // Set carry flag
-int8_t set_CF( int new_CF )
+int8_t CPU8086::set_CF( int new_CF )
 {
   uint8_t reg ;
 
@@ -172,29 +468,31 @@ int8_t set_CF( int new_CF )
 }
 
 // Set auxiliary flag
-int8_t set_AF( int new_AF )
+int8_t CPU8086::set_AF( int new_AF )
 {
   uint8_t reg ;
 
   reg = ( new_AF ) ? XTRUE : XFALSE ;
   regs8[ FLAG_AF ] = reg ;
+  lazy_flags_pending &= ~LAZY_AF ;
 
   return( reg ) ;
 }
 
 // Set overflow flag
-int8_t set_OF( int new_OF )
+int8_t CPU8086::set_OF( int new_OF )
 {
   uint8_t reg ;
 
   reg = ( new_OF ) ? XTRUE : XFALSE ;
   regs8[ FLAG_OF ] = reg ;
+  lazy_flags_pending &= ~LAZY_OF ;
 
   return( reg ) ;
 }
 
 // Set auxiliary and overflow flag after arithmetic operations
-int8_t set_AF_OF_arith( void )
+int8_t CPU8086::set_AF_OF_arith( void )
 {
   uint8_t reg ;
 
@@ -220,44 +518,229 @@ int8_t set_AF_OF_arith( void )
   return( reg ) ;
 }
 
+// Materialise lazily evaluated flags into regs8[FLAG_xx]
+void CPU8086::sync_flags( uint16_t flags )
+{
+  flags &= lazy_flags_pending ;
+  lazy_flags_pending &= ~flags ;
+
+  if( flags & LAZY_SF )
+  {
+    // Returns sign bit of an 8-bit or 16-bit operand
+    regs8[ FLAG_SF ] = ( 1 & ( ( lazy_szp_w ) ? *( int16_t * )&( lazy_szp_result ) : ( lazy_szp_result ) ) >> ( 8 * ( lazy_szp_w + 1 ) - 1 ) ) ;
+  }
+
+  if( flags & LAZY_ZF )
+  {
+    regs8[ FLAG_ZF ] = !lazy_szp_result ;
+  }
+
+  if( flags & LAZY_PF )
+  {
+    regs8[ FLAG_PF ] = xt_parity_table[ ( uint8_t ) lazy_szp_result ] ;
+  }
+
+  if( flags & LAZY_AF )
+  {
+    regs8[ FLAG_AF ] = ( lazy_ao_source & 0x10 ) ? XTRUE : XFALSE ;
+  }
+
+  if( flags & LAZY_OF )
+  {
+    if( lazy_ao_result == lazy_ao_dest )
+    {
+      regs8[ FLAG_OF ] = XFALSE ;
+    }
+    else if( lazy_ao_w )
+    {
+      regs8[ FLAG_OF ] = 1 & ( lazy_ao_cf ^ lazy_ao_source >> 15 ) ;
+    }
+    else
+    {
+      regs8[ FLAG_OF ] = 1 & ( lazy_ao_cf ^ lazy_ao_source >> 7 ) ;
+    }
+  }
+}
+
 // Assemble and return emulated CPU FLAGS register in scratch_uint
-void make_flags( void )
+void CPU8086::make_flags( void )
 {
   uint8_t i ;
 
+  FLAGS_SYNC( LAZY_ALL ) ;
+
   // 8086 has reserved and unused flags set to 1
   scratch_uint = 0xF002 ;
   for( i = 0 ; i < 9 ; i++ )
   {
-    scratch_uint += regs8[ FLAG_CF + i ] << bios_table_lookup[ TABLE_FLAGS_BITFIELDS ][ i ] ;
+    scratch_uint += regs8[ FLAG_CF + i ] << xt_flags_bitfields[ i ] ;
   }
 }
 
 // Set emulated CPU FLAGS register from regs8[FLAG_xx] values
-void set_flags( int new_flags )
+void CPU8086::set_flags( int new_flags )
 {
   uint8_t i ;
 
   for( i = 0 ; i < 9 ; i++ )
   {
-    regs8[ FLAG_CF + i ] = ( 1 << bios_table_lookup[ TABLE_FLAGS_BITFIELDS ][ i ] & new_flags ) ? XTRUE : XFALSE ;
+    regs8[ FLAG_CF + i ] = ( 1 << xt_flags_bitfields[ i ] & new_flags ) ? XTRUE : XFALSE ;
   }
+
+  lazy_flags_pending = 0 ;
 }
 
 // Convert raw opcode to translated opcode index. This condenses a large number of different encodings of similar
 // instructions into a much smaller number of distinct functions, which we then execute
-void set_opcode( uint8_t opcode )
+void CPU8086::set_opcode( uint8_t opcode )
+{
+  stOpcode = xt_opcode_table[ opcode ] ;
+}
+
+// Decode the instruction at opcode_stream into a decoded instruction cache
+// record. Everything stored here depends only on the instruction bytes and
+// the decode tables, never on the CPU state.
+void CPU8086::decode_instruction( uint8_t * opcode_stream , uint64_t raw_bytes , stDecoded_t * decoded )
 {
-  stOpcode.raw_opcode_id  = opcode ;
-  stOpcode.xlat_opcode_id = bios_table_lookup[ TABLE_XLAT_OPCODE      ][ opcode ] ;
-  stOpcode.extra          = bios_table_lookup[ TABLE_XLAT_SUBFUNCTION ][ opcode ] ;
-  stOpcode.i_mod_size     = bios_table_lookup[ TABLE_I_MOD_SIZE       ][ opcode ] ;
-  stOpcode.set_flags_type = bios_table_lookup[ TABLE_STD_FLAGS        ][ opcode ] ;
+  set_opcode( *opcode_stream ) ;
+  decoded->stOpcode = stOpcode ;
+
+  /**********
+   *
+   *      7     6     5     4     3     2     1     0
+   *   +-----+-----+-----+-----+-----+-----+-----+-----+
+   *   |     |     |     |     |     |       REG       |
+   *   +-----+-----+-----+-----+-----+-----+-----+-----+
+   *                                        \_ _/ \_ _/
+   *                                          |     |
+   *                                          |     +---> W
+   *                                          +---------> D
+   *
+   **********/
+  // Extract i_w and i_d fields from instruction.
+
+  decoded->i_reg4bit = stOpcode.raw_opcode_id & 0x07 ;
+  decoded->i_w       = ( decoded->i_reg4bit & 0x01 ) == 0x01 ;
+  decoded->i_d       = ( decoded->i_reg4bit & 0x02 ) == 0x02 ;
+
+  // Extract instruction data fields
+  decoded->i_data0 = *( int16_t * )&opcode_stream[ 1 ] ;
+  decoded->i_data1 = *( int16_t * )&opcode_stream[ 2 ] ;
+  decoded->i_data2 = *( int16_t * )&opcode_stream[ 3 ] ;
+
+  // i_mod_size > 0 indicates that opcode uses i_mod/i_rm/i_reg, so decode them
+  if( stOpcode.i_mod_size )
+  {
+
+    /**********
+     *
+     *      7     6     5     4     3     2     1     0
+     *   +-----+-----+-----+-----+-----+-----+-----+-----+
+     *   |           |                 |                 |
+     *   +-----+-----+-----+-----+-----+-----+-----+-----+
+     *    \____ ____/ \_______ _______/ \_______ _______/
+     *         |              |                 |
+     *         |              |                 +---------> i_rm
+     *         |              +---------------------------> i_reg
+     *         +------------------------------------------> i_mod
+     *
+     **********/
+    decoded->i_mod = ( decoded->i_data0 >> 6 ) & 0x03 ; // ##......
+    decoded->i_reg = ( decoded->i_data0 >> 3 ) & 0x07 ; // ..###...
+    decoded->i_rm  =   decoded->i_data0        & 0x07 ; // .....###
+
+    if( ( !decoded->i_mod && decoded->i_rm == 6 ) || ( decoded->i_mod == 2 ) )
+    {
+      decoded->i_data2 = *( int16_t * )&opcode_stream[ 4 ] ;
+    }
+    else if( decoded->i_mod != 1 )
+    {
+      decoded->i_data2 = decoded->i_data1 ;
+    }
+    else // If i_mod is 1, operand is (usually) 8 bits rather than 16 bits
+    {
+      decoded->i_data1 = ( int8_t ) decoded->i_data1 ;
+    }
+
+    // Pre-resolve the effective address look-ups, the registers are only
+    // read when the instruction executes.
+    const stModRM_t & modrm = xt_modrm_table[ !decoded->i_mod ][ decoded->i_rm ] ;
+
+    decoded->ea_reg1 = modrm.ea_reg1 ;
+    decoded->ea_reg2 = modrm.ea_reg2 ;
+    decoded->ea_seg  = modrm.ea_seg  ;
+    decoded->ea_disp = ( uint16_t ) ( modrm.disp_mult * decoded->i_data1 ) ;
+
+    decoded->rm_offset  = ( decoded->i_w ) ? ( 2 * decoded->i_rm  ) : ( ( 2 * decoded->i_rm  + decoded->i_rm  / 4 ) & 7 ) ;
+    decoded->reg_offset = ( decoded->i_w ) ? ( 2 * decoded->i_reg ) : ( ( 2 * decoded->i_reg + decoded->i_reg / 4 ) & 7 ) ;
+  }
+
+  // Clock count, the run time part is added when the instruction executes.
+  // The group opcodes (80-83, F6, F7, FE and FF) look it and the use of the
+  // memory operand up by i_reg.
+  stCycles_t cycles = xt_cycles_table[ stOpcode.raw_opcode_id ] ;
+  decoded->mem_access = xt_mem_access[ stOpcode.raw_opcode_id ] ;
+  if( ( ( stOpcode.raw_opcode_id & 0xFC ) == 0x80 ) || ( ( stOpcode.raw_opcode_id & 0xF6 ) == 0xF6 ) )
+  {
+    uint8_t group ;
+
+    group = ( stOpcode.raw_opcode_id < 0x84 ) ? ( stOpcode.raw_opcode_id & 3 ) :
+            ( 4 + ( ( stOpcode.raw_opcode_id >> 2 ) & 2 ) + ( stOpcode.raw_opcode_id & 1 ) ) ;
+    cycles = xt_group_cycles[ group ][ decoded->i_reg ] ;
+    decoded->mem_access = xt_group_mem_access[ group ][ decoded->i_reg ] ;
+  }
+
+  if( stOpcode.i_mod_size && ( decoded->i_mod < 3 ) )
+  {
+    decoded->cycles = cycles.mem + xt_ea_cycles[ !decoded->i_mod ][ decoded->i_rm ] ;
+  }
+  else
+  {
+    decoded->cycles = cycles.reg ;
+  }
+
+  decoded->raw_bytes = raw_bytes ;
 }
 
 // Execute INT #interrupt_num on the emulated machine
-int8_t pc_interrupt( uint8_t interrupt_num )
+int8_t CPU8086::pc_interrupt( uint8_t interrupt_num )
 {
+  counter_interrupts[ interrupt_num ]++ ;
+
+  // The typed keys of the interface wait for this
+  if( ( interrupt_num == 0x28 ) ||
+      ( ( interrupt_num == 0x16 ) && ( ( regs8[ REG_AH ] & 0xEF ) == 0x00 ) &&
+        ( *( uint16_t * )&mem[ BDA_KEYBUF_HEAD ] == *( uint16_t * )&mem[ BDA_KEYBUF_TAIL ] ) ) )
+  {
+    Interface.GuestWaitsForKey() ;
+  }
+
+#if TIMELINE
+  // Guest events for the timeline: disk calls and video mode switches
+  if( interrupt_num == 0x13 )
+  {
+    TIMELINE_INSTANT( "INT 13h" , "ah" , regs8[ REG_AH ] , "dl" , regs8[ REG_DL ] ) ;
+  }
+  else if( ( interrupt_num == 0x10 ) && ( regs8[ REG_AH ] == 0x00 ) )
+  {
+    TIMELINE_INSTANT( "video mode" , "mode" , regs8[ REG_AL ] , NULL , 0 ) ;
+  }
+#endif
+
+  // A halted CPU carries on after the HLT, or retries the INT it waited on
+  if( halt_state != HALT_NONE )
+  {
+    if( halt_state == HALT_HLT )
+    {
+      reg_ip++ ;
+    }
+    else
+    {
+      idle_woken = true ;
+    }
+    halt_state = HALT_NONE ;
+  }
+
   // Decode like INT.
   set_opcode( 0xCD ) ;
 
@@ -269,33 +752,36 @@ int8_t pc_interrupt( uint8_t interrupt_num )
   op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
   op_source = *( uint16_t * )&scratch_uint ;
   op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+  STACK_DIRTY() ;
 
   // PUSH regs16[ REG_CS ].
   op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
   op_source = *( uint16_t * )&regs16[ REG_CS ] ;
   op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+  STACK_DIRTY() ;
 
   // PUSH reg_ip.
   op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
   op_source = *( uint16_t * )&reg_ip ;
   op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+  STACK_DIRTY() ;
 
   // Execute arithmetic/logic operations in emulator memory/registers
   if( i_w )
   {
-    op_dest   = *( uint16_t * )&mem[ REGS_BASE + 2 * REG_CS ] ;
+    op_dest   = regs16[ REG_CS ] ;
 
     op_source = *( uint16_t * )&mem[ 4 * interrupt_num + 2 ] ;
     op_result = op_source ;
-    *( uint16_t * )&mem[ REGS_BASE + 2 * REG_CS ] = op_source ;
+    regs16[ REG_CS ] = op_source ;
   }
   else
   {
-    op_dest = mem[ REGS_BASE + 2 * REG_CS ] ;
+    op_dest = regs8[ 2 * REG_CS ] ;
 
     op_source = *( uint8_t * )&mem[ 4 * interrupt_num + 2 ] ;
     op_result = op_source  ;
-    mem[ REGS_BASE + 2 * REG_CS ] = op_source ;
+    regs8[ 2 * REG_CS ] = op_source ;
   }
 
   // Execute arithmetic/logic operations in emulator memory/registers
@@ -323,271 +809,3798 @@ int8_t pc_interrupt( uint8_t interrupt_num )
 }
 
 // AAA and AAS instructions - which_operation is +1 for AAA, and -1 for AAS
-int AAA_AAS(int8_t which_operation)
+int CPU8086::AAA_AAS(int8_t which_operation)
 {
+  FLAGS_SYNC( LAZY_AF ) ;
+
   return( regs16[ REG_AX ] += 262 * which_operation * set_AF( set_CF( ( ( regs8[ REG_AL ] & 0x0F) > 9) || regs8[FLAG_AF])), regs8[REG_AL] &= 0x0F);
 }
 
-void Reset( void )
+// Width and direction specialised arms.
+//
+// The decode table gives the word and byte forms of the common ALU and MOV
+// instructions, and each form of MOV sreg, LEA and POP r/m, an xlat id of
+// their own, so the operand width and direction are fixed by the arm that
+// runs them rather than tested on every instruction. The helpers below are
+// expanded inside those arms in Run().
+
+// ADD|OR|ADC|SBB|AND|SUB|XOR|CMP|MOV of T sized operands, from op_from_addr
+// to op_to_addr. stOpcode.extra is the operation.
+template< typename T > ARM_INLINE void CPU8086::alu_reg_rm( void )
 {
-  uint32_t i ;
+  T * dest = ( T * )operand_ptr( op_to_addr ) ;
 
-  // Fill RAM with 00h.
-  // BIOS area is 64K from F0000h.
-  memset( ( void * ) mem , 0x00 , ( size_t ) RAM_SIZE ) ;
+  op_dest   = *dest ;
+  op_source = *( T * )operand_ptr( op_from_addr ) ;
 
-  for( i = 0 ; i < 3 ; i++ )
+  switch( stOpcode.extra )
   {
-    if( disk[ i ] != 0 )
-    {
-      close( disk[ i ] ) ;
-      disk[ i ] = 0 ;
-    }
-  }
+    // ADD
+    case 0x00 :
+      op_result = *dest += op_source ;
+      set_CF( ( uint32_t ) op_result < op_dest ) ;
+      break ;
 
-  if( Interface.GetBIOSFilename() != NULL )
-  {
-    disk[ 2 ] = open( Interface.GetBIOSFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
-  }
+    // OR
+    case 0x01 :
+      op_result = *dest |= op_source ;
+      break ;
 
-  if( Interface.GetFDImageFilename() != NULL )
-  {
-    disk[ 1 ] = open( Interface.GetFDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
-  }
+    // ADC
+    case 0x02 :
+      op_result = *dest += regs8[ FLAG_CF ] + op_source ;
+      set_CF( ( regs8[ FLAG_CF ] && ( ( uint32_t ) op_result == op_dest ) ) || ( op_result < ( int ) op_dest ) ) ;
+      set_AF_OF_arith() ;
+      break ;
 
-  if( Interface.GetHDImageFilename() != NULL )
-  {
-    disk[ 0 ] = open( Interface.GetHDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
-  }
+    // SBB
+    case 0x03 :
+      op_result = *dest -= regs8[ FLAG_CF ] + op_source ;
+      set_CF( ( regs8[ FLAG_CF ] && ( ( uint32_t ) op_result == op_dest ) ) || ( - op_result < - ( int ) op_dest ) ) ;
+      set_AF_OF_arith() ;
+      break ;
 
-  // Set CX:AX equal to the hard disk image size, if present
-  *( uint32_t * )&regs16[ REG_AX ] = ( disk[ 0 ] ) ? ( lseek( disk[ 0 ] , 0 , 2 ) >> 9 ) : ( 0 ) ;
+    // AND
+    case 0x04 :
+      op_result = *dest &= op_source ;
+      break ;
 
-  // CS is initialised to F000
-  regs16[ REG_CS ] = ( REGS_BASE >> 4 ) ;
+    // SUB
+    case 0x05 :
+      op_result = *dest -= op_source ;
+      set_CF( ( uint32_t ) op_result > op_dest ) ;
+      break ;
 
-  // Load BIOS image into F000:0100, and set IP to 0100
-  reg_ip = 0x100 ;
-  read( disk[ 2 ] , ( regs8 + 0x100 ) , 0xFF00 ) ;
+    // XOR
+    case 0x06 :
+      op_result = *dest ^= op_source ;
+      break ;
 
-  // Initialise CPU state variables
-  seg_override_en = 0 ;
-  rep_override_en = 0 ;
+    // CMP
+    case 0x07 :
+      op_result = op_dest - op_source ;
+      set_CF( ( uint32_t ) op_result > op_dest ) ;
+      break ;
+
+    // MOV
+    case 0x08 :
+      op_result = op_source ;
+      *dest = op_source ;
+      break ;
+  }
+}
+
+// Immediate operand of ADD|OR|ADC|SBB|AND|SUB|XOR|CMP r/m, immed. S is true
+// for an 8-bit immediate, sign extended to the operand width, and false for
+// a 16-bit one.
+template< bool S > ARM_INLINE void CPU8086::alu_immediate( void )
+{
+  op_to_addr = rm_addr ;
+  if( S )
+  {
+    regs16[ REG_SCRATCH ] = ( int8_t ) i_data2 ;
+  }
+  else
+  {
+    regs16[ REG_SCRATCH ] = i_data2 ;
+  }
+
+  op_from_addr = REGS_BASE + 2 * REG_SCRATCH ;
+  reg_ip += ( S ) ? ( 1 ) : ( 2 ) ;
+  stOpcode.extra = i_reg ;
+  set_opcode( 0x08 * i_reg ) ;
+}
+
+// MOV r/m, sreg when D is false, MOV sreg, r/m when D is true. The segment
+// registers follow the general registers in regs16.
+template< bool D > ARM_INLINE void CPU8086::mov_sreg( void )
+{
+  i_w = 1 ;
+  i_reg += 8 ;
 
-  // Load instruction decoding helper table vectors
-  for( i = 0 ; i < 20 ; i++ )
+  if( i_mod < 3 )
   {
-    for( int j = 0 ; j < 256 ; j++ )
+    uint16_t localIndex ;
+    uint16_t localAddr  ;
+
+    if( seg_override_en )
     {
-      bios_table_lookup[ i ][ j ] = regs8[ regs16[ 0x81 + i ] + j ] ;
+      localIndex = seg_override ;
     }
+    else
+    {
+      localIndex = xt_modrm_table[ !i_mod ][ i_rm ].ea_seg ;
+    }
+
+    localAddr  = ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg1 ] ;
+    localAddr += ( uint16_t ) xt_modrm_table[ !i_mod ][ i_rm ].disp_mult * i_data1 ;
+    localAddr += ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg2 ] ;
+    rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
+    if( MEM_PAGE_TYPE( rm_addr , 1 ) != MEM_PAGE_RAM )
+    {
+      rm_addr = mem_operand( rm_addr , ( D ) ? ( XT_MEM_READ ) : ( XT_MEM_WRITE ) ) ;
+    }
+    else if( !D )
+    {
+      MEM_DIRTY( rm_addr ) ;
+    }
+  }
+  else
+  {
+    rm_addr = REGS_BASE + 2 * i_rm ;
+  }
+
+  if( D )
+  {
+    op_to_addr   = REGS_BASE + 2 * i_reg ;
+    op_from_addr = rm_addr ;
+  }
+  else
+  {
+    op_to_addr   = rm_addr ;
+    op_from_addr = REGS_BASE + 2 * i_reg ;
   }
+
+  op_dest   = *( uint16_t * )operand_ptr( op_to_addr ) ;
+  op_source = *( uint16_t * )operand_ptr( op_from_addr ) ;
+  op_result = op_source ;
+  *( uint16_t * )operand_ptr( op_to_addr ) = op_source ;
 }
 
-// Emulator entry point
+// REP string fast path.
+//
+// REP MOVSx/STOSx/LODSx and REP CMPSx/SCASx run all their iterations in one
+// instruction. The helpers below run the first count elements of one as a
+// block, with memmove()/memset()/memchr() style loops, and return how many
+// they did. The generic loop then runs the rest, the last element at least,
+// so op_dest/op_source/op_result end up exactly as it would leave them.
+// They do nothing, and return 0, when a block would not give the same result
+// as running the elements one at a time:
+//  - SI or DI wraps around 64K within the block. The generic loop wraps each
+//    offset separately, so the bytes touched are not contiguous.
+//  - A MOVS destination overlaps the source ahead of it, so the block would
+//    copy bytes that an earlier element has already overwritten.
+//  - A block reads video memory or writes anything but RAM, see MapMemory().
+
+// Lowest linear address touched by count elements from seg:regs16[ reg ],
+// stepping down if DF is set. Returns false if the offsets wrap around 64K
+// or the elements are not all in RAM, or ROM when they are only read.
+bool CPU8086::string_block( uint8_t seg , uint8_t reg , uint32_t count , bool write , uint32_t & addr )
+{
+  uint32_t size   = i_w + 1 ;
+  uint32_t offset = regs16[ reg ] ;
+  uint32_t page   ;
 
-#if defined(_WIN32)
-int CALLBACK WinMain(
-  HINSTANCE hInstance,
-  HINSTANCE /* hPrevInstance */,
-  LPSTR     /* lpCmdLine */,
-  int       /* nCmdShow */)
-#else
-int main(int argc, char **argv)
-#endif
+  if( regs8[ FLAG_DF ] )
+  {
+    if( ( offset + size > 0x10000 ) || ( offset < ( count - 1 ) * size ) )
+    {
+      return( false ) ;
+    }
+    offset -= ( count - 1 ) * size ;
+  }
+  else if( offset + count * size > 0x10000 )
+  {
+    return( false ) ;
+  }
+
+  addr = 16 * regs16[ seg ] + offset ;
+
+  // The page types are ordered RAM, ROM then devices
+  for( page = addr >> MEM_PAGE_BITS ; page <= ( addr + count * size - 1 ) >> MEM_PAGE_BITS ; page++ )
+  {
+    if( mem_map[ page ] > ( ( write ) ? ( MEM_PAGE_RAM ) : ( MEM_PAGE_ROM ) ) )
+    {
+      return( false ) ;
+    }
+  }
+
+  return( true ) ;
+}
+
+// MOVSx (extra=0)|STOSx (extra=1)|LODSx (extra=2), count elements
+uint32_t CPU8086::rep_movs_block( uint8_t seg , uint32_t count )
 {
-  uint8_t * opcode_stream   ;
+  uint32_t size  = i_w + 1 ;
+  uint32_t bytes = count * size ;
+  uint32_t src   = 0 ;
+  uint32_t dst   = 0 ;
 
-#if defined(_WIN32)
-  Interface.SetInstance(hInstance);
+  if( ( ( stOpcode.extra & 0x01 ) == 0x00 ) && !string_block( seg , REG_SI , count , false , src ) )
+  {
+    return( 0 ) ;
+  }
+
+  if( ( ( stOpcode.extra & 0x02 ) == 0x00 ) && !string_block( REG_ES , REG_DI , count , true , dst ) )
+  {
+    return( 0 ) ;
+  }
+
+  switch( stOpcode.extra )
+  {
+  // MOVS
+  case 0x00 :
+    if( ( dst < src + bytes ) && ( src < dst + bytes ) && ( ( regs8[ FLAG_DF ] ) ? ( dst < src ) : ( dst > src ) ) )
+    {
+      return( 0 ) ;
+    }
+    memmove( &mem[ dst ] , &mem[ src ] , bytes ) ;
+    mem_dirty_range( dst , bytes ) ;
+    break ;
+
+  // STOS
+  case 0x01 :
+    if( i_w && ( regs8[ REG_AL ] != regs8[ REG_AH ] ) )
+    {
+      uint32_t filled ;
+
+      // Store the first word, then keep doubling the filled part
+      *( uint16_t * )&mem[ dst ] = regs16[ REG_AX ] ;
+      for( filled = 2 ; filled < bytes ; filled *= 2 )
+      {
+        memcpy( &mem[ dst + filled ] , &mem[ dst ] , ( filled < bytes - filled ) ? ( filled ) : ( bytes - filled ) ) ;
+      }
+    }
+    else
+    {
+      memset( &mem[ dst ] , regs8[ REG_AL ] , bytes ) ;
+    }
+    mem_dirty_range( dst , bytes ) ;
+    break ;
+
+  // LODS, only the last element loaded matters
+  default :
+    src += ( regs8[ FLAG_DF ] ) ? ( 0 ) : ( bytes - size ) ;
+    if( i_w )
+    {
+      regs16[ REG_AX ] = *( uint16_t * )&mem[ src ] ;
+    }
+    else
+    {
+      regs8[ REG_AL ] = mem[ src ] ;
+    }
+    break ;
+  }
+
+  if( ( stOpcode.extra & 0x01 ) == 0x00 )
+  {
+    regs16[ REG_SI ] += ( regs8[ FLAG_DF ] ) ? ( - bytes ) : ( bytes ) ;
+  }
+
+  if( ( stOpcode.extra & 0x02 ) == 0x00 )
+  {
+    regs16[ REG_DI ] += ( regs8[ FLAG_DF ] ) ? ( - bytes ) : ( bytes ) ;
+  }
+
+  return( count ) ;
+}
+
+// CMPSx (extra=0)|SCASx (extra=1), at most count elements. Stops before
+// the first element that ends the REPZ/REPNZ, the generic loop runs that one.
+uint32_t CPU8086::rep_cmps_block( uint8_t seg , uint32_t count )
+{
+  uint32_t size = i_w + 1 ;
+  uint32_t si   = 0 ;
+  uint32_t di   = 0 ;
+  uint32_t done = 0 ;
+
+  if( !stOpcode.extra && !string_block( seg , REG_SI , count , false , si ) )
+  {
+    return( 0 ) ;
+  }
+
+  if( !string_block( REG_ES , REG_DI , count , false , di ) )
+  {
+    return( 0 ) ;
+  }
+
+  if( !regs8[ FLAG_DF ] && stOpcode.extra && !i_w && !rep_mode )
+  {
+    // REPNZ SCASB, look for AL
+    uint8_t * found = ( uint8_t * ) memchr( &mem[ di ] , regs8[ REG_AL ] , count ) ;
+
+    done = ( found ) ? ( uint32_t ) ( found - &mem[ di ] ) : ( count ) ;
+  }
+  else
+  {
+    if( !regs8[ FLAG_DF ] && rep_mode )
+    {
+      // REPZ forward, skip over equal blocks of 8 bytes first
+      uint64_t pattern = ( i_w ) ? ( 0x0001000100010001ULL * regs16[ REG_AX ] ) : ( 0x0101010101010101ULL * regs8[ REG_AL ] ) ;
+
+      while( ( done + 8 / size <= count ) &&
+             !memcmp( &mem[ di + done * size ] , ( stOpcode.extra ) ? ( void * ) &pattern : ( void * ) &mem[ si + done * size ] , 8 ) )
+      {
+        done += 8 / size ;
+      }
+    }
+
+    for( ; done < count ; done++ )
+    {
+      // Element index from the low end of the blocks
+      uint32_t index = ( regs8[ FLAG_DF ] ) ? ( count - 1 - done ) : ( done ) ;
+      uint32_t value ;
+      uint32_t match ;
+
+      if( i_w )
+      {
+        value = ( stOpcode.extra ) ? ( regs16[ REG_AX ] ) : ( *( uint16_t * )&mem[ si + index * 2 ] ) ;
+        match = *( uint16_t * )&mem[ di + index * 2 ] ;
+      }
+      else
+      {
+        value = ( stOpcode.extra ) ? ( regs8[ REG_AL ] ) : ( mem[ si + index ] ) ;
+        match = mem[ di + index ] ;
+      }
+
+      if( ( value == match ) != rep_mode )
+      {
+        break ;
+      }
+    }
+  }
+
+  if( !stOpcode.extra )
+  {
+    regs16[ REG_SI ] += ( regs8[ FLAG_DF ] ) ? ( - done * size ) : ( done * size ) ;
+  }
+  regs16[ REG_DI ] += ( regs8[ FLAG_DF ] ) ? ( - done * size ) : ( done * size ) ;
+  regs16[ REG_CX ] -= done ;
+
+  return( done ) ;
+}
+
+void CPU8086::Reset( void )
+{
+  uint32_t i ;
+
+  // Fill RAM, the bounce buffer and the fetch slack with 00h.
+  // BIOS area is 64K from F0000h.
+  memset( ( void * ) mem , 0x00 , sizeof( mem ) ) ;
+  memset( ( void * ) mem_dirty , MEM_DIRTY_ALL , sizeof( mem_dirty ) ) ;
+
+  // Clear all registers, including the always-zero REG_ZERO and XF.
+  memset( ( void * ) &regfile , 0x00 , sizeof( regfile ) ) ;
+
+  // A forked machine keeps its private disk images
+  for( i = 0 ; i < 3 ; i++ )
+  {
+    if( ( disk[ i ] != 0 ) && ( disk_overlay[ i ] == NULL ) )
+    {
+      close( disk[ i ] ) ;
+      disk[ i ] = 0 ;
+    }
+  }
+
+  if( Interface.GetBIOSFilename() != NULL )
+  {
+    disk[ 2 ] = open( Interface.GetBIOSFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
+  }
+
+  if( ( disk[ 1 ] == 0 ) && ( Interface.GetFDImageFilename() != NULL ) )
+  {
+    disk[ 1 ] = open( Interface.GetFDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
+  }
+
+  if( ( disk[ 0 ] == 0 ) && ( Interface.GetHDImageFilename() != NULL ) )
+  {
+    disk[ 0 ] = open( Interface.GetHDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
+  }
+
+  // The guest's disk writes can be kept from the image files, as in a fork
+  if( Interface.DiskCopyOnWrite() )
+  {
+    for( i = 0 ; i < 2 ; i++ )
+    {
+      if( ( disk[ i ] > 0 ) && ( disk_overlay[ i ] == NULL ) )
+      {
+        disk_overlay_open( i ) ;
+      }
+    }
+  }
+
+  // Set CX:AX equal to the hard disk image size, if present
+  *( uint32_t * )&regs16[ REG_AX ] = ( disk[ 0 ] ) ? ( lseek( disk[ 0 ] , 0 , 2 ) >> 9 ) : ( 0 ) ;
+
+  // CS is initialised to F000
+  regs16[ REG_CS ] = ( BIOS_BASE >> 4 ) ;
+
+  // Load BIOS image into F000:0100, and set IP to 0100
+  reg_ip = 0x100 ;
+  read( disk[ 2 ] , ( mem + BIOS_BASE + 0x100 ) , 0xFF00 ) ;
+
+  // Initialise CPU state variables
+  seg_override_en   = 0 ;
+  rep_override_en   = 0 ;
+  mem_bounce_access = 0 ;
+  halt_state        = HALT_NONE ;
+  idle_woken        = false ;
+  idle_polls        = 0 ;
+  idle_poll_time    = 0 ;
+
+  // RAM has been reloaded, so start with an empty decode cache.
+  memset( ( void * ) decode_cache , 0x00 , sizeof( decode_cache ) ) ;
+#if JIT
+  jit_flush() ;
 #endif
-  Interface.Initialise( mem ) ;
 
-  // regs16 and reg8 point to F000:0, the start of memory-mapped registers
-  regs8  = ( uint8_t  * ) ( mem + REGS_BASE ) ; // Base + 000F.0000
-  regs16 = ( uint16_t * ) ( mem + REGS_BASE ) ; // Base + 000F.0000
+  lazy_flags_pending = 0 ;
+
+  // The checkpoints are of the machine before the reset
+  rewind_clear() ;
+}
+
+CPU8086::CPU8086( T8086TinyInterface_t & InterfaceIn ) : Interface( InterfaceIn )
+{
+  Interface.Initialise( mem ) ;
 
   // Clear BIOS and disk filed.
   disk[ 0 ] = 0 ;
   disk[ 1 ] = 0 ;
   disk[ 2 ] = 0 ;
+  for( int i = 0 ; i < 3 ; i++ )
+  {
+    disk_overlay[ i ]      = NULL ;
+    disk_overlay_size[ i ] = 0 ;
+    disk_overlay_pos[ i ]  = 0 ;
+  }
+  forked = false ;
+
+  // Ports the guest has not read yet, saved in snapshots as they are
+  memset( ( void * ) io_ports , 0x00 , sizeof( io_ports ) ) ;
+
+  // Rewind is off until RewindEnable()
+  rewind_points     = NULL ;
+  rewind_capacity   = 0 ;
+  rewind_first      = 0 ;
+  rewind_count      = 0 ;
+  rewind_bytes      = 0 ;
+  rewind_budget     = 0 ;
+  rewind_interval   = 0 ;
+  rewind_next       = 0 ;
+  rewind_clock_hz   = 0 ;
+  rewind_state_size = 0 ;
+  rewind_ram        = NULL ;
+  rewind_state      = NULL ;
+  rewind_work       = NULL ;
+  rewind_fp         = NULL ;
+
+  // The counters only go up from here, Reset() leaves them alone
+  counter_instructions = 0 ;
+  memset( counter_interrupts , 0 , sizeof( counter_interrupts ) ) ;
+  counter_disk_sectors[ 0 ] = 0 ;
+  counter_disk_sectors[ 1 ] = 0 ;
+
+#if PROFILE
+  // The profiler is off until ProfileEnable()
+  profile_period       = 0 ;
+  profile_next         = UINT64_MAX ;
+  profile_samples      = 0 ;
+  profile_halted       = 0 ;
+  profile_hits         = NULL ;
+  profile_bios_vector  = NULL ;
+  profile_symbols      = NULL ;
+  profile_symbol_count = 0 ;
+#endif
+
+#if TRACE
+  // The trace is off until TraceEnable()
+  trace_ring         = NULL ;
+  trace_mask         = 0 ;
+  trace_total        = 0 ;
+  trace_write        = TRACE_NO_WRITE ;
+  trace_info         = 0 ;
+  trace_interrupt    = 0 ;
+  trace_fault_file   = NULL ;
+  trace_fault_reason = NULL ;
+  trace_faulted      = false ;
+#endif
+
+  // Decode state that survives between instructions.
+  i_mod            = 0 ;
+  i_reg            = 0 ;
+  i_rm             = 0 ;
+  i_w              = 0 ;
+  rep_mode         = 0 ;
+  seg_override     = 0 ;
+  trap_flag        = 0 ;
+  exit_emulation   = false ;
+  instr_since_int8 = 0 ;
+  cycles_pending   = 0 ;
+  cycles_deadline  = 0 ;
+  cycles_elapsed   = 0 ;
+  devices_changed  = false ;
+
+  // Memory map: RAM, except for the video windows
+  memset( ( void * ) mem_map , MEM_PAGE_RAM , sizeof( mem_map ) ) ;
+  mem_bounce_addr   = 0 ;
+  mem_bounce_access = 0 ;
+  MapMemory( MEM_VIDEO_MCGA_BASE , MEM_VIDEO_MCGA_SIZE , MEM_PAGE_VIDEO ) ;
+  MapMemory( MEM_VIDEO_CGA_BASE  , MEM_VIDEO_CGA_SIZE  , MEM_PAGE_VIDEO ) ;
+
+  // Work out which flags each conditional jump reads. Entries pointing
+  // outside the flags (the always-zero XF) do not need a lazy flag.
+  for( int i = 0 ; i < 8 ; i++ )
+  {
+    jcc_flags_used[ i ] = 0 ;
+    for( int j = 0 ; j < 4 ; j++ )
+    {
+      uint8_t flag = xt_jcc_table[ j ][ i ] ;
+
+      if( ( flag >= FLAG_CF ) && ( flag <= FLAG_OF ) )
+      {
+        jcc_flags_used[ i ] |= 1 << ( flag - FLAG_CF ) ;
+      }
+    }
+  }
+
+#if JIT
+  jit_init() ;
+#endif
 
   // Reset, loads initial disk and bios images, clears RAM and sets CS & IP.
   Reset() ;
+}
 
-  // Instruction execution loop.
-  bool ExitEmulation = false ;
-  while( !ExitEmulation )
+CPU8086::~CPU8086()
+{
+  for( int i = 0 ; i < 3 ; i++ )
   {
-    opcode_stream = mem + 16 * regs16[ REG_CS ] + reg_ip ;
+    disk_overlay_close( i ) ;
+    if( disk[ i ] != 0 )
+    {
+      close( disk[ i ] ) ;
+    }
+  }
 
-    // Set up variables to prepare for decoding an opcode.
-    set_opcode( *opcode_stream ) ;
+  RewindEnable( 0 , 0 , 0 ) ;
 
-    /**********
-     *
-     *      7     6     5     4     3     2     1     0
-     *   +-----+-----+-----+-----+-----+-----+-----+-----+
-     *   |     |     |     |     |     |       REG       |
-     *   +-----+-----+-----+-----+-----+-----+-----+-----+
-     *                                        \_ _/ \_ _/
-     *                                          |     |
-     *                                          |     +---> W
-     *                                          +---------> D
-     *
-     **********/
-    // Extract i_w and i_d fields from instruction.
+#if PROFILE
+  ProfileEnable( 0 , NULL ) ;
+#endif
+
+#if TRACE
+  TraceEnable( 0 , NULL ) ;
+#endif
+
+#if JIT
+  if( jit_code != NULL )
+  {
+    munmap( jit_code , JIT_CODE_SIZE ) ;
+  }
+#endif
+
+  Interface.Cleanup() ;
+}
+
+void * CPU8086::operator new( size_t size )
+{
+  uint8_t * raw ;
+  uint8_t * aligned ;
+
+  // Over-allocate, align and keep the malloc() pointer just below the object.
+  raw = ( uint8_t * ) malloc( size + MEM_PAGE_SIZE + sizeof( void * ) ) ;
+  if( raw == NULL )
+  {
+    throw std::bad_alloc() ;
+  }
+
+  aligned  = raw + sizeof( void * ) ;
+  aligned += ( MEM_PAGE_SIZE - ( ( uintptr_t ) aligned % MEM_PAGE_SIZE ) ) % MEM_PAGE_SIZE ;
+  ( ( void ** ) aligned )[ -1 ] = raw ;
+
+  return( aligned ) ;
+}
+
+void CPU8086::operator delete( void * p )
+{
+  if( p != NULL )
+  {
+    free( ( ( void ** ) p )[ -1 ] ) ;
+  }
+}
+
+// Machine snapshots.
+//
+// See XTsnapshot.h for the file layout. SaveSnapshot() writes a temporary
+// file and renames it over the old one, so a machine whose RAM is mapped
+// from the old file keeps seeing the old contents.
+
+// Fill in the CPU state of a snapshot or rewind checkpoint
+void CPU8086::snapshot_state( stSnapshotCPU_t & state )
+{
+  // The snapshot keeps no lazy flags
+  FLAGS_SYNC( LAZY_ALL ) ;
+
+  memset( ( void * ) &state , 0x00 , sizeof( state ) ) ;
+  memcpy( state.regs , regfile.b , sizeof( state.regs ) ) ;
+  state.reg_ip           = reg_ip ;
+  state.seg_override     = seg_override ;
+  state.seg_override_en  = seg_override_en ;
+  state.rep_override_en  = rep_override_en ;
+  state.rep_mode         = rep_mode ;
+  state.trap_flag        = trap_flag ;
+  state.halt_state       = halt_state ;
+  state.idle_woken       = idle_woken ;
+  state.idle_polls       = idle_polls ;
+  state.instr_since_int8 = instr_since_int8 ;
+  state.cycles_pending   = cycles_pending ;
+  state.cycles_elapsed   = cycles_elapsed ;
+  state.idle_poll_time   = idle_poll_time ;
+  for( int i = 0 ; i < 2 ; i++ )
+  {
+    if( disk_overlay[ i ] != NULL )
+    {
+      state.disk_pos[ i ] = disk_overlay_pos[ i ] ;
+    }
+    else
+    {
+      state.disk_pos[ i ] = ( disk[ i ] ) ? ( lseek( disk[ i ] , 0 , SEEK_CUR ) ) : ( 0 ) ;
+    }
+  }
+}
+
+// Restore the CPU state of a snapshot or rewind checkpoint, once RAM has
+// been restored
+void CPU8086::snapshot_restore( const stSnapshotCPU_t & state )
+{
+  memcpy( regfile.b , state.regs , sizeof( state.regs ) ) ;
+  reg_ip             = state.reg_ip ;
+  seg_override       = state.seg_override ;
+  seg_override_en    = state.seg_override_en ;
+  rep_override_en    = state.rep_override_en ;
+  rep_mode           = state.rep_mode ;
+  trap_flag          = state.trap_flag ;
+  halt_state         = state.halt_state ;
+  idle_woken         = ( state.idle_woken != 0 ) ;
+  idle_polls         = state.idle_polls ;
+  instr_since_int8   = state.instr_since_int8 ;
+  cycles_pending     = state.cycles_pending ;
+  cycles_elapsed     = state.cycles_elapsed ;
+  idle_poll_time     = state.idle_poll_time ;
+  lazy_flags_pending = 0 ;
+  mem_bounce_access  = 0 ;
+
+  // Run the devices before the next instruction, for their new deadline
+  cycles_deadline    = 0 ;
+  devices_changed    = false ;
+
+#if PROFILE
+  // The clock may have gone back
+  if( profile_period )
+  {
+    profile_next = cycles_elapsed + cycles_pending + profile_period ;
+  }
+#endif
+
+  for( int i = 0 ; i < 2 ; i++ )
+  {
+    if( disk_overlay[ i ] != NULL )
+    {
+      disk_overlay_pos[ i ] = ( uint32_t ) state.disk_pos[ i ] ;
+    }
+    else if( disk[ i ] != 0 )
+    {
+      lseek( disk[ i ] , ( long ) state.disk_pos[ i ] , SEEK_SET ) ;
+    }
+  }
+
+  // RAM has been replaced, so start with an empty decode cache.
+  memset( ( void * ) decode_cache , 0x00 , sizeof( decode_cache ) ) ;
+#if JIT
+  jit_flush() ;
+#endif
+}
+
+bool CPU8086::SaveSnapshot( const char * filename )
+{
+  stSnapshotHeader_t header ;
+  stSnapshotCPU_t    state  ;
+  char               temp_name[ 1024 ] ;
+  FILE             * fp ;
+  bool               ok ;
+
+  snprintf( temp_name , sizeof( temp_name ) , "%s.tmp" , filename ) ;
+  fp = fopen( temp_name , "wb" ) ;
+  if( fp == NULL )
+  {
+    return( false ) ;
+  }
+
+  memset( ( void * ) &header , 0x00 , sizeof( header ) ) ;
+  memcpy( header.magic , SNAPSHOT_MAGIC , sizeof( header.magic ) ) ;
+  header.version      = SNAPSHOT_VERSION ;
+  header.ram_offset   = SNAPSHOT_RAM_OFFSET ;
+  header.ram_size     = RAM_SIZE ;
+  header.state_offset = SNAPSHOT_RAM_OFFSET + MEM_PAGE_COUNT * MEM_PAGE_SIZE ;
+
+  snapshot_state( state ) ;
+
+  ok = ( fwrite( &header , sizeof( header ) , 1 , fp ) == 1 ) &&
+       ( fseek( fp , header.ram_offset , SEEK_SET ) == 0 ) &&
+       ( fwrite( mem , RAM_SIZE , 1 , fp ) == 1 ) &&
+       ( fseek( fp , header.state_offset , SEEK_SET ) == 0 ) &&
+       ( fwrite( &state , sizeof( state ) , 1 , fp ) == 1 ) &&
+       ( fwrite( io_ports , sizeof( io_ports ) , 1 , fp ) == 1 ) &&
+       ( Interface.SaveState( fp ) ) ;
+
+  if( fclose( fp ) != 0 )
+  {
+    ok = false ;
+  }
+
+  if( !ok )
+  {
+    remove( temp_name ) ;
+    return( false ) ;
+  }
+
+#if defined(_WIN32)
+  // Windows rename() does not replace an existing file
+  remove( filename ) ;
+#endif
+
+  return( rename( temp_name , filename ) == 0 ) ;
+}
+
+bool CPU8086::LoadSnapshot( const char * filename )
+{
+  stSnapshotHeader_t header ;
+  stSnapshotCPU_t    state  ;
+  struct stat        info   ;
+  FILE             * fp ;
+  size_t             mapped ;
+  bool               ok ;
+
+  fp = fopen( filename , "rb" ) ;
+  if( fp == NULL )
+  {
+    return( false ) ;
+  }
+
+  ok = ( fread( &header , sizeof( header ) , 1 , fp ) == 1 ) &&
+       ( memcmp( header.magic , SNAPSHOT_MAGIC , sizeof( header.magic ) ) == 0 ) &&
+       ( header.version == SNAPSHOT_VERSION ) &&
+       ( header.ram_size == RAM_SIZE ) &&
+       ( fstat( fileno( fp ) , &info ) == 0 ) &&
+       ( ( uint64_t ) info.st_size >= ( uint64_t ) header.ram_offset + RAM_SIZE ) &&
+       ( ( uint64_t ) info.st_size >= ( uint64_t ) header.state_offset + sizeof( state ) + sizeof( io_ports ) ) &&
+       ( fseek( fp , header.state_offset , SEEK_SET ) == 0 ) &&
+       ( fread( &state , sizeof( state ) , 1 , fp ) == 1 ) ;
+
+  // Nothing of the machine has changed yet. The checks above keep a short
+  // file from being mapped, where reading past its end would fault.
+  if( !ok )
+  {
+    fclose( fp ) ;
+    return( false ) ;
+  }
+
+  // Map the whole pages of the RAM image, read the rest
+  mapped = 0 ;
+#if !defined(_WIN32)
+  if( ( sysconf( _SC_PAGESIZE ) == MEM_PAGE_SIZE ) && ( header.ram_offset % MEM_PAGE_SIZE == 0 ) &&
+      ( mmap( mem , SNAPSHOT_RAM_PAGES * MEM_PAGE_SIZE , PROT_READ | PROT_WRITE ,
+              MAP_PRIVATE | MAP_FIXED , fileno( fp ) , header.ram_offset ) == ( void * ) mem ) )
+  {
+    mapped = SNAPSHOT_RAM_PAGES * MEM_PAGE_SIZE ;
+  }
+#endif
+
+  ok = ( fseek( fp , header.ram_offset + mapped , SEEK_SET ) == 0 ) &&
+       ( fread( mem + mapped , RAM_SIZE - mapped , 1 , fp ) == 1 ) &&
+       ( fseek( fp , header.state_offset + sizeof( state ) , SEEK_SET ) == 0 ) &&
+       ( fread( io_ports , sizeof( io_ports ) , 1 , fp ) == 1 ) &&
+       ( Interface.LoadState( fp ) ) ;
+
+  fclose( fp ) ;
+
+  snapshot_restore( state ) ;
+  memset( ( void * ) mem_dirty , MEM_DIRTY_ALL , sizeof( mem_dirty ) ) ;
+
+  // The checkpoints are of another run
+  rewind_clear() ;
+
+  return( ok ) ;
+}
+
+// Forked machines.
+//
+// Fork() relies on the host fork() for RAM and for the state of the
+// interface, so the only thing left to clone by hand is the disks. A child
+// maps each image MAP_PRIVATE and serves the BIOS disk calls from the
+// mapping, so its writes only ever reach its own copy of the pages.
+
+bool CPU8086::disk_overlay_open( int drive )
+{
+#if defined(_WIN32)
+  ( void ) drive ;
+  return( false ) ;
+#else
+  off_t  pos  ;
+  off_t  size ;
+  void * image ;
+
+  pos  = lseek( disk[ drive ] , 0 , SEEK_CUR ) ;
+  size = lseek( disk[ drive ] , 0 , SEEK_END ) ;
+  if( ( pos < 0 ) || ( size <= 0 ) || ( size > ( off_t ) UINT32_MAX ) )
+  {
+    return( false ) ;
+  }
+  lseek( disk[ drive ] , pos , SEEK_SET ) ;
+
+  image = mmap( NULL , ( size_t ) size , PROT_READ | PROT_WRITE , MAP_PRIVATE , disk[ drive ] , 0 ) ;
+  if( image == MAP_FAILED )
+  {
+    return( false ) ;
+  }
+
+  disk_overlay[ drive ]      = ( uint8_t * ) image ;
+  disk_overlay_size[ drive ] = ( uint32_t ) size ;
+  disk_overlay_pos[ drive ]  = ( uint32_t ) pos ;
+
+  return( true ) ;
+#endif
+}
+
+void CPU8086::disk_overlay_close( int drive )
+{
+#if !defined(_WIN32)
+  if( disk_overlay[ drive ] != NULL )
+  {
+    munmap( disk_overlay[ drive ] , disk_overlay_size[ drive ] ) ;
+  }
+#endif
+
+  disk_overlay[ drive ]      = NULL ;
+  disk_overlay_size[ drive ] = 0 ;
+  disk_overlay_pos[ drive ]  = 0 ;
+}
+
+// Reads or writes count bytes at pos of a disk image for the BIOS disk
+// calls. Returns what read()/write() would, or 0 if the seek failed.
+int CPU8086::disk_transfer( uint8_t drive , uint32_t pos , uint32_t addr , uint32_t count , bool write )
+{
+  if( ( !write ) && ( count != 0 ) )
+  {
+    mem_dirty_range( addr , count ) ;
+  }
+
+  if( disk_overlay[ drive ] != NULL )
+  {
+    if( pos >= disk_overlay_size[ drive ] )
+    {
+      count = 0 ;
+    }
+    else if( count > disk_overlay_size[ drive ] - pos )
+    {
+      count = disk_overlay_size[ drive ] - pos ;
+    }
+
+    if( write )
+    {
+      memcpy( disk_overlay[ drive ] + pos , mem + addr , count ) ;
+    }
+    else
+    {
+      memcpy( mem + addr , disk_overlay[ drive ] + pos , count ) ;
+    }
+    disk_overlay_pos[ drive ] = pos + count ;
+
+    return( ( int ) count ) ;
+  }
+
+  if( lseek( disk[ drive ] , pos , 0 ) == -1 )
+  {
+    return( 0 ) ;
+  }
+
+  if( write )
+  {
+    return( ( int ) ::write( disk[ drive ] , ( mem + addr ) , count ) ) ;
+  }
+
+  return( ( int ) read( disk[ drive ] , ( mem + addr ) , count ) ) ;
+}
+
+int CPU8086::Fork( int children )
+{
+#if defined(_WIN32)
+  ( void ) children ;
+  return( -1 ) ;
+#else
+  // Buffered output would be written again by every child
+  fflush( NULL ) ;
+
+  for( int child = 1 ; child <= children ; child++ )
+  {
+    pid_t pid ;
+
+    pid = fork() ;
+    if( pid < 0 )
+    {
+      return( -1 ) ;
+    }
+
+    if( pid == 0 )
+    {
+      forked = true ;
+
+      // The scratch file is shared with the parent
+      if( rewind_fp != NULL )
+      {
+        fclose( rewind_fp ) ;
+        rewind_fp = tmpfile() ;
+        if( rewind_fp == NULL )
+        {
+          RewindEnable( 0 , 0 , 0 ) ;
+        }
+      }
+
+      for( int i = 0 ; i < 2 ; i++ )
+      {
+        if( ( disk[ i ] != 0 ) && ( disk_overlay[ i ] == NULL ) && ( !disk_overlay_open( i ) ) )
+        {
+          _exit( 1 ) ;
+        }
+      }
+
+      return( child ) ;
+    }
+  }
+
+  return( 0 ) ;
+#endif
+}
+
+// Rewind checkpoints.
+//
+// See XTrewind.h for the delta format. A checkpoint only looks at the pages
+// written since the one before, which the MEM_DIRTY_REWIND bit of mem_dirty
+// keeps track of, and Rewind() only copies back the pages that differ.
+
+static inline void rewind_put32( uint8_t * p , uint32_t value )
+{
+  memcpy( p , &value , sizeof( value ) ) ;
+}
+
+static inline uint32_t rewind_get32( const uint8_t * p )
+{
+  uint32_t value ;
+
+  memcpy( &value , p , sizeof( value ) ) ;
+  return( value ) ;
+}
+
+// Write the delta between cur and ref to out and copy cur to ref. Returns
+// the size of the delta, which is never more than len + REWIND_RUN_BYTES.
+static uint32_t rewind_encode( uint8_t * out , const uint8_t * cur , uint8_t * ref , uint32_t len )
+{
+  uint32_t size = 0 ;
+  uint32_t i    = 0 ;
+
+  while( i < len )
+  {
+    uint32_t same_start ;
+    uint32_t diff_start ;
+    uint32_t diff_end   ;
+    uint32_t equal      ;
+
+    same_start = i ;
+    while( ( i < len ) && ( cur[ i ] == ref[ i ] ) )
+    {
+      i++ ;
+    }
+
+    // A changed run goes on over short runs of unchanged bytes
+    diff_start = i ;
+    diff_end   = i ;
+    for( equal = 0 ; ( i < len ) && ( equal < REWIND_MIN_SKIP ) ; i++ )
+    {
+      if( cur[ i ] == ref[ i ] )
+      {
+        equal++ ;
+      }
+      else
+      {
+        equal    = 0 ;
+        diff_end = i + 1 ;
+      }
+    }
+    i = diff_end ;
+
+    if( size + REWIND_RUN_BYTES + ( diff_end - diff_start ) > len )
+    {
+      // No smaller than the page itself, so keep one run of it all
+      size = 0 ;
+      diff_start = 0 ;
+      diff_end   = len ;
+      same_start = 0 ;
+      i          = len ;
+    }
+
+    rewind_put32( out + size     , diff_start - same_start ) ;
+    rewind_put32( out + size + 4 , diff_end - diff_start ) ;
+    size += REWIND_RUN_BYTES ;
+    for( uint32_t j = diff_start ; j < diff_end ; j++ )
+    {
+      out[ size++ ] = cur[ j ] ^ ref[ j ] ;
+    }
+  }
+
+  memcpy( ref , cur , len ) ;
+
+  return( size ) ;
+}
+
+// Apply the delta at in to ref. Returns the end of the delta.
+static const uint8_t * rewind_apply( const uint8_t * in , uint8_t * ref , uint32_t len )
+{
+  uint32_t pos = 0 ;
+
+  while( pos < len )
+  {
+    uint32_t same = rewind_get32( in ) ;
+    uint32_t diff = rewind_get32( in + 4 ) ;
+
+    in  += REWIND_RUN_BYTES ;
+    pos += same ;
+    for( uint32_t j = 0 ; j < diff ; j++ )
+    {
+      ref[ pos++ ] ^= *in++ ;
+    }
+  }
+
+  return( in ) ;
+}
+
+// Bytes of RAM in a page
+static inline uint32_t rewind_page_len( uint32_t page )
+{
+  uint32_t base = page << MEM_PAGE_BITS ;
+
+  return( ( RAM_SIZE - base < MEM_PAGE_SIZE ) ? ( RAM_SIZE - base ) : ( MEM_PAGE_SIZE ) ) ;
+}
+
+bool CPU8086::RewindEnable( uint32_t interval_ms , uint32_t budget_kb , uint32_t clock_hz )
+{
+  rewind_clear() ;
+  free( rewind_points ) ;
+  free( rewind_ram ) ;
+  free( rewind_state ) ;
+  free( rewind_work ) ;
+  if( rewind_fp != NULL )
+  {
+    fclose( rewind_fp ) ;
+  }
+  rewind_points     = NULL ;
+  rewind_capacity   = 0 ;
+  rewind_ram        = NULL ;
+  rewind_state      = NULL ;
+  rewind_work       = NULL ;
+  rewind_state_size = 0 ;
+  rewind_fp         = NULL ;
+
+  if( ( interval_ms == 0 ) || ( budget_kb == 0 ) || ( clock_hz == 0 ) )
+  {
+    return( false ) ;
+  }
+
+  rewind_ram = ( uint8_t * ) malloc( RAM_SIZE ) ;
+  rewind_fp  = tmpfile() ;
+  if( ( rewind_ram == NULL ) || ( rewind_fp == NULL ) )
+  {
+    RewindEnable( 0 , 0 , 0 ) ;
+    return( false ) ;
+  }
+
+  rewind_interval = ( uint64_t ) interval_ms * clock_hz / 1000 ;
+  rewind_budget   = ( size_t ) budget_kb * 1024 ;
+  rewind_clock_hz = clock_hz ;
+
+  return( true ) ;
+}
+
+// Drop all the checkpoints and take a new one at the next Run()
+void CPU8086::rewind_clear( void )
+{
+  for( uint32_t i = 0 ; i < rewind_count ; i++ )
+  {
+    free( rewind_points[ ( rewind_first + i ) % rewind_capacity ].delta ) ;
+  }
+
+  rewind_first = 0 ;
+  rewind_count = 0 ;
+  rewind_bytes = 0 ;
+  rewind_next  = cycles_elapsed ;
+}
+
+// Write the machine state to rewind_fp. Returns its size, 0 on failure.
+uint32_t CPU8086::rewind_capture( void )
+{
+  stSnapshotCPU_t state ;
+  long            size  ;
+
+  snapshot_state( state ) ;
+
+  if( ( fseek( rewind_fp , 0 , SEEK_SET ) != 0 ) ||
+      ( fwrite( &state , sizeof( state ) , 1 , rewind_fp ) != 1 ) ||
+      ( fwrite( io_ports , sizeof( io_ports ) , 1 , rewind_fp ) != 1 ) ||
+      ( !Interface.SaveState( rewind_fp ) ) )
+  {
+    return( 0 ) ;
+  }
+
+  size = ftell( rewind_fp ) ;
+  if( ( size <= 0 ) || ( fseek( rewind_fp , 0 , SEEK_SET ) != 0 ) )
+  {
+    return( 0 ) ;
+  }
+
+  return( ( uint32_t ) size ) ;
+}
+
+void CPU8086::rewind_checkpoint( void )
+{
+  stRewindPoint_t point ;
+  uint32_t        state_size ;
+  uint8_t       * state ;
+  uint8_t       * out ;
+  uint16_t        end = REWIND_PAGE_END ;
+
+  rewind_next = cycles_elapsed + rewind_interval ;
+
+  state_size = rewind_capture() ;
+  if( state_size == 0 )
+  {
+    return ;
+  }
+
+  // Room for the delta of every page and of the state, then the state.
+  if( state_size != rewind_state_size )
+  {
+    rewind_clear() ;
+    rewind_next = cycles_elapsed + rewind_interval ;
+
+    free( rewind_state ) ;
+    free( rewind_work ) ;
+    rewind_state_size = state_size ;
+    rewind_state      = ( uint8_t * ) malloc( state_size ) ;
+    rewind_work       = ( uint8_t * ) malloc( MEM_PAGE_COUNT * ( 2 + MEM_PAGE_SIZE + REWIND_RUN_BYTES ) +
+                                              2 + ( REWIND_RUN_BYTES + state_size ) + state_size ) ;
+    if( ( rewind_state == NULL ) || ( rewind_work == NULL ) )
+    {
+      RewindEnable( 0 , 0 , 0 ) ;
+      return ;
+    }
+  }
+
+  state = rewind_work + MEM_PAGE_COUNT * ( 2 + MEM_PAGE_SIZE + REWIND_RUN_BYTES ) + 2 + REWIND_RUN_BYTES + state_size ;
+  if( fread( state , state_size , 1 , rewind_fp ) != 1 )
+  {
+    return ;
+  }
+
+  point.cycles = cycles_elapsed ;
+  point.delta  = NULL ;
+  point.size   = 0 ;
+
+  if( rewind_count == 0 )
+  {
+    // The oldest checkpoint is just the full copy
+    memcpy( rewind_ram , mem , RAM_SIZE ) ;
+    memcpy( rewind_state , state , state_size ) ;
+    for( uint32_t page = 0 ; page < MEM_PAGE_COUNT ; page++ )
+    {
+      mem_dirty[ page ] &= ~MEM_DIRTY_REWIND ;
+    }
+  }
+  else
+  {
+    out = rewind_work ;
+    for( uint32_t page = 0 ; page < MEM_PAGE_COUNT ; page++ )
+    {
+      if( mem_dirty[ page ] & MEM_DIRTY_REWIND )
+      {
+        uint32_t size ;
+
+        mem_dirty[ page ] &= ~MEM_DIRTY_REWIND ;
+
+        // Leave out pages written back with what they held
+        size = rewind_encode( out + 2 , mem + ( page << MEM_PAGE_BITS ) , rewind_ram + ( page << MEM_PAGE_BITS ) , rewind_page_len( page ) ) ;
+        if( rewind_get32( out + 2 + 4 ) != 0 )
+        {
+          uint16_t number = ( uint16_t ) page ;
+
+          memcpy( out , &number , sizeof( number ) ) ;
+          out += 2 + size ;
+        }
+      }
+    }
+    memcpy( out , &end , sizeof( end ) ) ;
+    out += 2 ;
+    out += rewind_encode( out , state , rewind_state , state_size ) ;
+
+    point.size  = ( uint32_t ) ( out - rewind_work ) ;
+    point.delta = ( uint8_t * ) malloc( point.size ) ;
+    if( point.delta == NULL )
+    {
+      // The copy has moved on, so the older checkpoints are lost
+      rewind_clear() ;
+      rewind_next = cycles_elapsed + rewind_interval ;
+      point.size  = 0 ;
+    }
+    else
+    {
+      memcpy( point.delta , rewind_work , point.size ) ;
+    }
+  }
+
+  if( rewind_count == rewind_capacity )
+  {
+    stRewindPoint_t * points ;
+    uint32_t          capacity ;
+
+    capacity = ( rewind_capacity ) ? ( rewind_capacity * 2 ) : ( 64 ) ;
+    points   = ( stRewindPoint_t * ) malloc( capacity * sizeof( stRewindPoint_t ) ) ;
+    if( points == NULL )
+    {
+      free( point.delta ) ;
+      RewindEnable( 0 , 0 , 0 ) ;
+      return ;
+    }
+
+    for( uint32_t i = 0 ; i < rewind_count ; i++ )
+    {
+      points[ i ] = rewind_points[ ( rewind_first + i ) % rewind_capacity ] ;
+    }
+    free( rewind_points ) ;
+    rewind_points   = points ;
+    rewind_capacity = capacity ;
+    rewind_first    = 0 ;
+  }
+
+  rewind_points[ ( rewind_first + rewind_count ) % rewind_capacity ] = point ;
+  rewind_count++ ;
+  rewind_bytes += sizeof( point ) + point.size ;
+
+  // Drop the oldest checkpoints over the budget. The next oldest then
+  // needs no delta of its own.
+  while( ( rewind_bytes > rewind_budget ) && ( rewind_count > 1 ) )
+  {
+    stRewindPoint_t & oldest = rewind_points[ ( rewind_first + 1 ) % rewind_capacity ] ;
+
+    rewind_bytes -= sizeof( point ) + oldest.size ;
+    free( oldest.delta ) ;
+    oldest.delta = NULL ;
+    oldest.size  = 0 ;
+
+    rewind_first = ( rewind_first + 1 ) % rewind_capacity ;
+    rewind_count-- ;
+  }
+}
+
+bool CPU8086::Rewind( uint32_t ms )
+{
+  stSnapshotCPU_t state ;
+  uint64_t        back ;
+  uint64_t        target ;
+  uint32_t        keep ;
+  bool            ok ;
+
+  if( ( rewind_ram == NULL ) || ( rewind_count == 0 ) )
+  {
+    return( false ) ;
+  }
+
+  back   = ( uint64_t ) ms * rewind_clock_hz / 1000 ;
+  target = ( cycles_elapsed > back ) ? ( cycles_elapsed - back ) : ( 0 ) ;
+
+  // Keep up to the newest checkpoint old enough, or just the oldest
+  for( keep = rewind_count ; keep > 1 ; keep-- )
+  {
+    if( rewind_points[ ( rewind_first + keep - 1 ) % rewind_capacity ].cycles <= target )
+    {
+      break ;
+    }
+  }
+
+  // Take the full copy back to that checkpoint
+  for( uint32_t i = rewind_count ; i > keep ; i-- )
+  {
+    stRewindPoint_t & point = rewind_points[ ( rewind_first + i - 1 ) % rewind_capacity ] ;
+    const uint8_t   * in    = point.delta ;
+    uint16_t          page ;
+
+    for( ;; )
+    {
+      memcpy( &page , in , sizeof( page ) ) ;
+      in += 2 ;
+      if( page == REWIND_PAGE_END )
+      {
+        break ;
+      }
+
+      in = rewind_apply( in , rewind_ram + ( ( uint32_t ) page << MEM_PAGE_BITS ) , rewind_page_len( page ) ) ;
+      mem_dirty[ page ] |= MEM_DIRTY_REWIND ;
+    }
+    rewind_apply( in , rewind_state , rewind_state_size ) ;
+
+    rewind_bytes -= sizeof( point ) + point.size ;
+    free( point.delta ) ;
+  }
+  rewind_count = keep ;
+
+  // Copy back the pages written since, which now differ from the copy
+  for( uint32_t page = 0 ; page < MEM_PAGE_COUNT ; page++ )
+  {
+    if( mem_dirty[ page ] & MEM_DIRTY_REWIND )
+    {
+      memcpy( mem + ( page << MEM_PAGE_BITS ) , rewind_ram + ( page << MEM_PAGE_BITS ) , rewind_page_len( page ) ) ;
+      mem_dirty[ page ] = MEM_DIRTY_ALL & ~MEM_DIRTY_REWIND ;
+    }
+  }
+
+  ok = ( fseek( rewind_fp , 0 , SEEK_SET ) == 0 ) &&
+       ( fwrite( rewind_state , rewind_state_size , 1 , rewind_fp ) == 1 ) &&
+       ( fseek( rewind_fp , 0 , SEEK_SET ) == 0 ) &&
+       ( fread( &state , sizeof( state ) , 1 , rewind_fp ) == 1 ) &&
+       ( fread( io_ports , sizeof( io_ports ) , 1 , rewind_fp ) == 1 ) &&
+       ( Interface.LoadState( rewind_fp ) ) ;
+
+  if( ok )
+  {
+    snapshot_restore( state ) ;
+  }
+
+  rewind_next = cycles_elapsed + rewind_interval ;
+
+  return( ok ) ;
+}
+
+#if PROFILE
+// Guest profiler.
+//
+// See XTprofile.h. retire_instruction() takes a sample once profile_next is
+// reached. Translated blocks and idle skips can run past it, so a sample
+// counts once for each period that has gone by.
+
+static int profile_symbol_compare( const void * a , const void * b )
+{
+  uint32_t addr_a = ( ( const stProfileSymbol_t * ) a )->addr ;
+  uint32_t addr_b = ( ( const stProfileSymbol_t * ) b )->addr ;
+
+  return( ( addr_a > addr_b ) - ( addr_a < addr_b ) ) ;
+}
+
+// Most samples first, then lowest key first
+static int profile_hits_compare( const void * a , const void * b )
+{
+  const stProfileHits_t * hits_a = ( const stProfileHits_t * ) a ;
+  const stProfileHits_t * hits_b = ( const stProfileHits_t * ) b ;
+
+  if( hits_a->hits != hits_b->hits )
+  {
+    return( ( hits_a->hits < hits_b->hits ) ? 1 : -1 ) ;
+  }
+
+  return( ( hits_a->key > hits_b->key ) - ( hits_a->key < hits_b->key ) ) ;
+}
+
+// The last symbol at or below addr, NULL if there is none within 64KB
+static const stProfileSymbol_t * profile_symbol_at( const stProfileSymbol_t * symbols , uint32_t count , uint32_t addr )
+{
+  uint32_t low  = 0     ;
+  uint32_t high = count ;
+
+  while( low < high )
+  {
+    uint32_t mid = ( low + high ) / 2 ;
+
+    if( symbols[ mid ].addr <= addr )
+    {
+      low = mid + 1 ;
+    }
+    else
+    {
+      high = mid ;
+    }
+  }
+
+  if( ( low == 0 ) || ( addr - symbols[ low - 1 ].addr >= 0x10000 ) )
+  {
+    return( NULL ) ;
+  }
+
+  return( &symbols[ low - 1 ] ) ;
+}
+
+// Count the samples due at CS:IP and set the time of the next one
+void CPU8086::profile_sample( void )
+{
+  stDecoded_t * decoded   ;
+  stOpcode_t    saved     ;
+  uint64_t      raw_bytes ;
+  uint32_t      addr      ;
+  uint32_t      weight    ;
+
+  weight        = ( uint32_t ) ( ( cycles_elapsed + cycles_pending - profile_next ) / profile_period ) + 1 ;
+  profile_next += weight * profile_period ;
+
+  addr = 16 * regs16[ REG_CS ] + reg_ip ;
+
+  profile_samples      += weight ;
+  profile_hits[ addr ] += weight ;
+
+  if( halt_state != HALT_NONE )
+  {
+    profile_halted += weight ;
+  }
+
+  // The opcode comes from the decode cache like in fetch_instruction(), but
+  // decoding it must leave the current opcode alone.
+  decoded   = &decode_cache[ addr & DECODE_CACHE_MASK ] ;
+  memcpy( &raw_bytes , &mem[ addr ] , sizeof( raw_bytes ) ) ;
+  raw_bytes = ( raw_bytes & DECODE_BYTES_MASK ) | DECODE_VALID ;
+  if( decoded->raw_bytes != raw_bytes )
+  {
+    saved = stOpcode ;
+    decode_instruction( &mem[ addr ] , raw_bytes , decoded ) ;
+    stOpcode = saved ;
+  }
+  profile_opcodes[ decoded->stOpcode.raw_opcode_id ] += weight ;
+
+  if( regs16[ REG_CS ] == ( BIOS_BASE >> 4 ) )
+  {
+    if( memcmp( profile_ivt , mem , sizeof( profile_ivt ) ) )
+    {
+      profile_bios_map() ;
+    }
+
+    profile_bios[ profile_bios_vector[ reg_ip ] ] += weight ;
+  }
+}
+
+// Take the BIOS entry points from the vector table, and if there are new
+// ones, work out the service of each BIOS offset again
+void CPU8086::profile_bios_map( void )
+{
+  bool changed = false ;
+
+  memcpy( profile_ivt , mem , sizeof( profile_ivt ) ) ;
+
+  for( int i = 0 ; i < 256 ; i++ )
+  {
+    if( ( ( profile_ivt[ i ] >> 16 ) == ( BIOS_BASE >> 4 ) ) &&
+        ( profile_bios_entry[ i ] != ( int32_t ) ( profile_ivt[ i ] & 0xFFFF ) ) )
+    {
+      profile_bios_entry[ i ] = profile_ivt[ i ] & 0xFFFF ;
+      changed = true ;
+    }
+  }
+
+  if( !changed )
+  {
+    return ;
+  }
+
+  // Mark each entry point with its vector, the lowest one if they share it,
+  // then carry it on up to the next entry point.
+  for( uint32_t offset = 0 ; offset < 0x10000 ; offset++ )
+  {
+    profile_bios_vector[ offset ] = PROFILE_BIOS_OTHER ;
+  }
+
+  for( int i = 255 ; i >= 0 ; i-- )
+  {
+    if( profile_bios_entry[ i ] >= 0 )
+    {
+      profile_bios_vector[ profile_bios_entry[ i ] ] = i ;
+    }
+  }
+
+  for( uint32_t offset = 1 ; offset < 0x10000 ; offset++ )
+  {
+    if( profile_bios_vector[ offset ] == PROFILE_BIOS_OTHER )
+    {
+      profile_bios_vector[ offset ] = profile_bios_vector[ offset - 1 ] ;
+    }
+  }
+}
+
+bool CPU8086::ProfileEnable( uint32_t period , const char * symbol_file )
+{
+  if( period == 0 )
+  {
+    free( profile_hits ) ;
+    free( profile_bios_vector ) ;
+    free( profile_symbols ) ;
+
+    profile_period       = 0 ;
+    profile_next         = UINT64_MAX ;
+    profile_hits         = NULL ;
+    profile_bios_vector  = NULL ;
+    profile_symbols      = NULL ;
+    profile_symbol_count = 0 ;
+
+    return( false ) ;
+  }
+
+  if( profile_hits == NULL )
+  {
+    profile_hits        = ( uint32_t * ) calloc( RAM_SIZE , sizeof( uint32_t ) ) ;
+    profile_bios_vector = ( uint16_t * ) malloc( 0x10000 * sizeof( uint16_t ) ) ;
+    if( ( profile_hits == NULL ) || ( profile_bios_vector == NULL ) )
+    {
+      return( ProfileEnable( 0 , NULL ) ) ;
+    }
+
+    profile_samples = 0 ;
+    profile_halted  = 0 ;
+    memset( profile_opcodes , 0 , sizeof( profile_opcodes ) ) ;
+    memset( profile_bios , 0 , sizeof( profile_bios ) ) ;
+    for( int i = 0 ; i < 256 ; i++ )
+    {
+      profile_bios_entry[ i ] = -1 ;
+    }
+
+    // The map is built on the first BIOS sample
+    memset( profile_ivt , 0 , sizeof( profile_ivt ) ) ;
+    for( uint32_t offset = 0 ; offset < 0x10000 ; offset++ )
+    {
+      profile_bios_vector[ offset ] = PROFILE_BIOS_OTHER ;
+    }
+  }
+
+  if( symbol_file != NULL )
+  {
+    FILE         * fp       ;
+    char           line[ 256 ] ;
+    char           name[ PROFILE_NAME_SIZE ] ;
+    unsigned int   segment  ;
+    unsigned int   offset   ;
+    uint32_t       capacity = 0 ;
+
+    fp = fopen( symbol_file , "r" ) ;
+    if( fp == NULL )
+    {
+      return( ProfileEnable( 0 , NULL ) ) ;
+    }
+
+    free( profile_symbols ) ;
+    profile_symbols      = NULL ;
+    profile_symbol_count = 0 ;
+
+    while( fgets( line , sizeof( line ) , fp ) != NULL )
+    {
+      // The width is PROFILE_NAME_SIZE - 1
+      if( ( line[ 0 ] == ';' ) || ( line[ 0 ] == '#' ) ||
+          ( sscanf( line , "%x:%x %47s" , &segment , &offset , name ) != 3 ) )
+      {
+        continue ;
+      }
+
+      if( profile_symbol_count == capacity )
+      {
+        stProfileSymbol_t * grown ;
+
+        capacity = ( capacity ) ? ( 2 * capacity ) : 64 ;
+        grown    = ( stProfileSymbol_t * ) realloc( profile_symbols , capacity * sizeof( stProfileSymbol_t ) ) ;
+        if( grown == NULL )
+        {
+          break ;
+        }
+        profile_symbols = grown ;
+      }
+
+      profile_symbols[ profile_symbol_count ].addr = ( ( segment & 0xFFFF ) << 4 ) + ( offset & 0xFFFF ) ;
+      strcpy( profile_symbols[ profile_symbol_count ].name , name ) ;
+      profile_symbol_count++ ;
+    }
+
+    fclose( fp ) ;
+
+    qsort( profile_symbols , profile_symbol_count , sizeof( stProfileSymbol_t ) , profile_symbol_compare ) ;
+  }
+
+  profile_period = period ;
+  profile_next   = cycles_elapsed + cycles_pending + period ;
+
+  return( true ) ;
+}
+
+void CPU8086::ProfileReport( FILE * fp )
+{
+  stProfileHits_t * table ;
+  uint32_t          count ;
+  double            scale ;
+
+  if( ( profile_hits == NULL ) || ( profile_samples == 0 ) )
+  {
+    fprintf( fp , "Profile: no samples\n" ) ;
+    return ;
+  }
+
+  scale = 100.0 / profile_samples ;
+
+  fprintf( fp , "Profile: %llu samples, one every %llu clocks, %.1f%% halted\n" ,
+           ( unsigned long long ) profile_samples , ( unsigned long long ) profile_period ,
+           profile_halted * scale ) ;
+
+  // One table for all the sections, sized for the addresses sampled
+  count = 0 ;
+  for( uint32_t addr = 0 ; addr < RAM_SIZE ; addr++ )
+  {
+    count += ( profile_hits[ addr ] != 0 ) ;
+  }
+
+  table = ( stProfileHits_t * ) malloc( ( count + PROFILE_BIOS_OTHER + 1 ) * sizeof( stProfileHits_t ) ) ;
+  if( table == NULL )
+  {
+    return ;
+  }
+
+  // Hotspots
+  count = 0 ;
+  for( uint32_t addr = 0 ; addr < RAM_SIZE ; addr++ )
+  {
+    if( profile_hits[ addr ] )
+    {
+      table[ count ].key  = addr ;
+      table[ count ].hits = profile_hits[ addr ] ;
+      count++ ;
+    }
+  }
+  qsort( table , count , sizeof( stProfileHits_t ) , profile_hits_compare ) ;
+
+  fprintf( fp , "\nHotspots:\n" ) ;
+  for( uint32_t i = 0 ; ( i < count ) && ( i < PROFILE_TOP_COUNT ) ; i++ )
+  {
+    const stProfileSymbol_t * symbol = profile_symbol_at( profile_symbols , profile_symbol_count , table[ i ].key ) ;
+
+    fprintf( fp , "  %05X %10u %6.2f%%" , table[ i ].key , table[ i ].hits , table[ i ].hits * scale ) ;
+    if( symbol != NULL )
+    {
+      fprintf( fp , "  %s+%X" , symbol->name , table[ i ].key - symbol->addr ) ;
+    }
+    fprintf( fp , "\n" ) ;
+  }
+
+  // Symbols, the key is the index in profile_symbols and profile_symbol_count
+  // stands for the addresses outside the map.
+  if( profile_symbol_count )
+  {
+    uint32_t * totals = ( uint32_t * ) calloc( profile_symbol_count + 1 , sizeof( uint32_t ) ) ;
+
+    if( totals != NULL )
+    {
+      for( uint32_t i = 0 ; i < count ; i++ )
+      {
+        const stProfileSymbol_t * symbol = profile_symbol_at( profile_symbols , profile_symbol_count , table[ i ].key ) ;
+
+        totals[ ( symbol != NULL ) ? ( uint32_t ) ( symbol - profile_symbols ) : profile_symbol_count ] += table[ i ].hits ;
+      }
+
+      count = 0 ;
+      for( uint32_t i = 0 ; i <= profile_symbol_count ; i++ )
+      {
+        if( totals[ i ] )
+        {
+          table[ count ].key  = i ;
+          table[ count ].hits = totals[ i ] ;
+          count++ ;
+        }
+      }
+      qsort( table , count , sizeof( stProfileHits_t ) , profile_hits_compare ) ;
+
+      fprintf( fp , "\nSymbols:\n" ) ;
+      for( uint32_t i = 0 ; ( i < count ) && ( i < PROFILE_TOP_COUNT ) ; i++ )
+      {
+        fprintf( fp , "  %10u %6.2f%%  %s\n" , table[ i ].hits , table[ i ].hits * scale ,
+                 ( table[ i ].key < profile_symbol_count ) ? profile_symbols[ table[ i ].key ].name : "(no symbol)" ) ;
+      }
+
+      free( totals ) ;
+    }
+  }
+
+  // Opcode mix
+  count = 0 ;
+  for( uint32_t i = 0 ; i < 256 ; i++ )
+  {
+    if( profile_opcodes[ i ] )
+    {
+      table[ count ].key  = i ;
+      table[ count ].hits = profile_opcodes[ i ] ;
+      count++ ;
+    }
+  }
+  qsort( table , count , sizeof( stProfileHits_t ) , profile_hits_compare ) ;
+
+  fprintf( fp , "\nOpcodes:\n" ) ;
+  for( uint32_t i = 0 ; i < count ; i++ )
+  {
+    fprintf( fp , "  %02X  xlat %2u %10u %6.2f%%\n" , table[ i ].key ,
+             xt_opcode_table[ table[ i ].key ].xlat_opcode_id , table[ i ].hits , table[ i ].hits * scale ) ;
+  }
+
+  // BIOS services
+  count = 0 ;
+  for( uint32_t i = 0 ; i <= PROFILE_BIOS_OTHER ; i++ )
+  {
+    if( profile_bios[ i ] )
+    {
+      table[ count ].key  = i ;
+      table[ count ].hits = profile_bios[ i ] ;
+      count++ ;
+    }
+  }
+  qsort( table , count , sizeof( stProfileHits_t ) , profile_hits_compare ) ;
+
+  fprintf( fp , "\nBIOS services:\n" ) ;
+  for( uint32_t i = 0 ; i < count ; i++ )
+  {
+    if( table[ i ].key == PROFILE_BIOS_OTHER )
+    {
+      fprintf( fp , "  other   %10u %6.2f%%\n" , table[ i ].hits , table[ i ].hits * scale ) ;
+    }
+    else
+    {
+      fprintf( fp , "  INT %02Xh %10u %6.2f%%\n" , table[ i ].key , table[ i ].hits , table[ i ].hits * scale ) ;
+    }
+  }
+
+  free( table ) ;
+}
+#endif
+
+#if TRACE
+// Instruction trace.
+//
+// See XTtrace.h. The ring is written in place, record trace_total & trace_mask
+// is the next one, so keeping a trace costs the same whatever its size.
+
+// Fill in the record of the instruction just run
+void CPU8086::trace_record( void )
+{
+  stTraceRecord_t * record ;
+  uint32_t          saved  ;
+  uint16_t          mask   ;
+  int               count  ;
+
+  record = &trace_ring[ trace_total & trace_mask ] ;
+  trace_total++ ;
+
+  record->cs        = trace_cs ;
+  record->ip        = trace_ip ;
+  record->interrupt = trace_interrupt ;
+  record->info      = trace_info ;
+  memcpy( record->bytes , &trace_bytes , TRACE_BYTES ) ;
+  trace_info = 0 ;
+
+  if( trace_write != TRACE_NO_WRITE )
+  {
+    record->info        |= TRACE_INFO_WRITE ;
+    record->write_addr   = trace_write ;
+    record->write_value  = *( uint16_t * )&mem[ trace_write ] ;
+  }
+  else
+  {
+    record->write_addr  = 0 ;
+    record->write_value = 0 ;
+  }
+
+  // The registers that changed since the record before
+  mask  = 0 ;
+  count = 0 ;
+  for( int i = 0 ; i < TRACE_REG_COUNT ; i++ )
+  {
+    if( regs16[ i ] != trace_regs[ i ] )
+    {
+      trace_regs[ i ] = regs16[ i ] ;
+      mask |= 1 << i ;
+      if( count < TRACE_REG_VALUES )
+      {
+        record->reg_value[ count++ ] = regs16[ i ] ;
+      }
+      else
+      {
+        mask |= TRACE_REG_MORE ;
+      }
+    }
+  }
+  while( count < TRACE_REG_VALUES )
+  {
+    record->reg_value[ count++ ] = 0 ;
+  }
+  record->reg_mask = mask ;
+
+  // make_flags() leaves FLAGS in scratch_uint, which the instruction may
+  // still need
+  saved = scratch_uint ;
+  make_flags() ;
+  record->flags = ( uint16_t ) scratch_uint ;
+  scratch_uint  = saved ;
+
+  record->clock = ( uint32_t ) ( cycles_elapsed + cycles_pending ) ;
+}
+
+// Have the trace written once the instruction running has been recorded
+void CPU8086::trace_fault( const char * reason )
+{
+  if( ( trace_ring != NULL ) && ( !trace_faulted ) )
+  {
+    trace_info         |= TRACE_INFO_FAULT ;
+    trace_fault_reason  = reason ;
+  }
+}
+
+bool CPU8086::TraceEnable( uint32_t records , const char * fault_file )
+{
+  uint32_t size ;
+
+  free( trace_ring ) ;
+  trace_ring = NULL ;
+  trace_mask = 0 ;
+
+  if( ( records == 0 ) || ( records > 0x80000000 ) )
+  {
+    return( false ) ;
+  }
+
+  for( size = 1 ; size < records ; size <<= 1 )
+  {
+  }
+
+  trace_ring = ( stTraceRecord_t * ) calloc( size , sizeof( stTraceRecord_t ) ) ;
+  if( trace_ring == NULL )
+  {
+    return( false ) ;
+  }
+
+  trace_mask         = size - 1 ;
+  trace_total        = 0 ;
+  trace_write        = TRACE_NO_WRITE ;
+  trace_info         = 0 ;
+  trace_fault_file   = fault_file ;
+  trace_fault_reason = NULL ;
+  trace_faulted      = false ;
+  memcpy( trace_regs , regs16 , sizeof( trace_regs ) ) ;
+
+  return( true ) ;
+}
+
+bool CPU8086::TraceDump( const char * filename , const char * reason )
+{
+  stTraceHeader_t header ;
+  FILE          * fp     ;
+  uint32_t        first  ;
+  uint32_t        part   ;
+  bool            ok     ;
+
+  if( ( trace_ring == NULL ) || ( filename == NULL ) )
+  {
+    return( false ) ;
+  }
+
+  memset( &header , 0 , sizeof( header ) ) ;
+  memcpy( header.magic , TRACE_MAGIC , sizeof( header.magic ) ) ;
+  header.record_size = sizeof( stTraceRecord_t ) ;
+  header.count       = ( trace_total > trace_mask ) ? ( trace_mask + 1 ) : ( uint32_t ) trace_total ;
+  header.total       = trace_total ;
+  header.ip          = reg_ip ;
+  memcpy( header.regs , regs16 , sizeof( header.regs ) ) ;
+  strncpy( header.reason , reason , sizeof( header.reason ) - 1 ) ;
+
+  make_flags() ;
+  header.flags = ( uint16_t ) scratch_uint ;
+
+  fp = fopen( filename , "wb" ) ;
+  if( fp == NULL )
+  {
+    return( false ) ;
+  }
+
+  // The oldest record runs to the end of the ring, then on from the start
+  first = ( uint32_t ) ( ( trace_total - header.count ) & trace_mask ) ;
+  part  = ( first + header.count > trace_mask + 1 ) ? ( trace_mask + 1 - first ) : header.count ;
+
+  ok = ( fwrite( &header , sizeof( header ) , 1 , fp ) == 1 ) &&
+       ( fwrite( &trace_ring[ first ] , sizeof( stTraceRecord_t ) , part , fp ) == part ) &&
+       ( fwrite( trace_ring , sizeof( stTraceRecord_t ) , header.count - part , fp ) == header.count - part ) ;
+
+  if( fclose( fp ) != 0 )
+  {
+    ok = false ;
+  }
+
+  return( ok ) ;
+}
+#endif
+
+// Fetch the instruction at CS:IP from the decode cache and set up its operands
+FETCH_INLINE void CPU8086::fetch_instruction( void )
+{
+  uint8_t     * opcode_stream ;
+  stDecoded_t * decoded       ;
+  uint64_t      raw_bytes     ;
+
+  scratch_uint  = 16 * regs16[ REG_CS ] + reg_ip ;
+  opcode_stream = mem + scratch_uint ;
+
+  // Look up the decoded instruction, decoding it again if this is the first
+  // time it is executed or the guest has changed the instruction bytes.
+  // The bytes are read with one unaligned load, see MEM_FETCH_SLACK.
+  decoded   = &decode_cache[ scratch_uint & DECODE_CACHE_MASK ] ;
+  memcpy( &raw_bytes , opcode_stream , sizeof( raw_bytes ) ) ;
+  raw_bytes = ( raw_bytes & DECODE_BYTES_MASK ) | DECODE_VALID ;
+  if( decoded->raw_bytes != raw_bytes )
+  {
+    decode_instruction( opcode_stream , raw_bytes , decoded ) ;
+  }
+
+#if TRACE
+  trace_bytes = raw_bytes ;
+  trace_cs    = regs16[ REG_CS ] ;
+  trace_ip    = reg_ip ;
+  trace_write = TRACE_NO_WRITE ;
+#endif
+
+  stOpcode  = decoded->stOpcode  ;
+  i_reg4bit = decoded->i_reg4bit ;
+  i_w       = decoded->i_w       ;
+  i_d       = decoded->i_d       ;
+  i_data0   = decoded->i_data0   ;
+  i_data1   = decoded->i_data1   ;
+  i_data2   = decoded->i_data2   ;
+
+#if CYCLE_TIMING
+  instr_cycles = decoded->cycles ;
+#endif
+
+  // seg_override_en and rep_override_en contain number of instructions to hold segment override and REP prefix respectively
+  if( seg_override_en )
+  {
+    seg_override_en-- ;
+  }
+
+  if( rep_override_en )
+  {
+    rep_override_en-- ;
+  }
+
+  // i_mod_size > 0 indicates that opcode uses i_mod/i_rm/i_reg
+  if( stOpcode.i_mod_size )
+  {
+    i_mod = decoded->i_mod ;
+    i_reg = decoded->i_reg ;
+    i_rm  = decoded->i_rm  ;
+
+    if( i_mod < 3 )
+    {
+      uint16_t localIndex ;
+      uint16_t localAddr  ;
+
+      if( seg_override_en )
+      {
+        localIndex = seg_override ;
+      }
+      else
+      {
+        localIndex = decoded->ea_seg ;
+      }
+
+      localAddr  = ( uint16_t ) regs16[ decoded->ea_reg1 ] ;
+      localAddr += decoded->ea_disp ;
+      localAddr += ( uint16_t ) regs16[ decoded->ea_reg2 ] ;
+      rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
+      if( MEM_PAGE_TYPE( rm_addr , i_w ) != MEM_PAGE_RAM )
+      {
+        rm_addr = mem_operand( rm_addr , decoded->mem_access ) ;
+      }
+      else if( decoded->mem_access & XT_MEM_WRITE )
+      {
+        MEM_DIRTY( rm_addr ) ;
+      }
+    }
+    else
+    {
+      rm_addr = REGS_BASE + decoded->rm_offset ;
+    }
+
+    op_to_addr   = rm_addr ;
+    op_from_addr = REGS_BASE + decoded->reg_offset ;
+    if( i_d )
+    {
+      scratch_uint = op_from_addr ;
+      op_from_addr = rm_addr      ;
+      op_to_addr   = scratch_uint ;
+    }
+  }
+}
+
+// Run the interface for the clocks of the instructions retired since it last
+// ran. Port accesses call this first, so the devices are up to date when the
+// port is read or written, and then clear cycles_deadline so the next retire
+// picks up the new deadline.
+void CPU8086::sync_devices( void )
+{
+  if( cycles_pending )
+  {
+    cycles_elapsed += cycles_pending ;
+    if( Interface.TimerTick( cycles_pending ) )
+    {
+      devices_changed = true ;
+    }
+    cycles_pending = 0 ;
+  }
+}
+
+// Advance IP, update the flags and service the interface after an instruction
+RETIRE_INLINE void CPU8086::retire_instruction( void )
+{
+  // Store an operand moved out of ROM or video memory
+  if( mem_bounce_access )
+  {
+    mem_retire() ;
+  }
+
+  // Increment instruction pointer by computed instruction length. Tables in the BIOS binary
+  // help us here.
+  reg_ip += ( i_mod * ( i_mod != 3 ) + 2 * ( !i_mod && i_rm == 6 ) ) * stOpcode.i_mod_size ;
+  reg_ip += stOpcode.base_size ;
+  reg_ip += stOpcode.i_w_size * ( i_w + 1 ) ;
+
+  // If instruction needs to update SF, ZF and PF, set them as appropriate
+  if( stOpcode.set_flags_type & FLAGS_UPDATE_SZP )
+  {
+#if LAZY_FLAGS
+    // Record the result, the flags are worked out when they are read.
+    lazy_szp_result     = op_result ;
+    lazy_szp_w          = i_w ;
+    lazy_flags_pending |= LAZY_SZP ;
+
+    // If instruction is an arithmetic or logic operation, also set AF/OF/CF as appropriate.
+    if( stOpcode.set_flags_type & FLAGS_UPDATE_AO_ARITH )
+    {
+      op_source ^= ( op_dest ^ op_result ) ;
+
+      lazy_ao_source      = op_source ;
+      lazy_ao_dest        = op_dest ;
+      lazy_ao_result      = ( uint32_t ) op_result ;
+      lazy_ao_w           = i_w ;
+      lazy_ao_cf          = regs8[ FLAG_CF ] ;
+      lazy_flags_pending |= LAZY_AO ;
+    }
+    if( stOpcode.set_flags_type & FLAGS_UPDATE_OC_LOGIC )
+    {
+      set_CF( 0 ) ;
+      set_OF( 0 ) ;
+    }
+#else
+    // Returns sign bit of an 8-bit or 16-bit operand
+    regs8[ FLAG_SF ] = ( 1 & ( ( i_w ) ? *( int16_t * )&( op_result ) : ( op_result ) ) >> ( 8 * ( i_w + 1 ) - 1 ) ) ;
+    regs8[ FLAG_ZF ] = !op_result ;
+    regs8[ FLAG_PF ] = xt_parity_table[ ( uint8_t ) op_result ] ;
+
+    // If instruction is an arithmetic or logic operation, also set AF/OF/CF as appropriate.
+    if( stOpcode.set_flags_type & FLAGS_UPDATE_AO_ARITH )
+    {
+      set_AF_OF_arith() ;
+    }
+    if( stOpcode.set_flags_type & FLAGS_UPDATE_OC_LOGIC )
+    {
+      set_CF( 0 ) ;
+      set_OF( 0 ) ;
+    }
+#endif
+  }
+
+  regs16[ REG_IP ] = reg_ip ;
+
+  // Update the interface module once its next event is due
+#if CYCLE_TIMING
+  cycles_pending += instr_cycles ;
+#else
+  cycles_pending += 4 ;
+#endif
+
+#if TRACE
+  if( trace_ring != NULL )
+  {
+    trace_record() ;
+  }
+#endif
+
+#if PROFILE
+  // Sampling leaves the device deadline alone, so the guest runs just as it
+  // does with the profiler off.
+  if( cycles_elapsed + cycles_pending >= profile_next )
+  {
+    profile_sample() ;
+  }
+#endif
+
+  if( cycles_pending >= cycles_deadline )
+  {
+    sync_devices() ;
+    cycles_deadline = Interface.NextEventTicks() ;
+
+    if( devices_changed )
+    {
+      devices_changed = false ;
+      if( Interface.ExitEmulation() )
+      {
+        exit_emulation = true ;
+      }
+      else
+      {
+        if( Interface.FDChanged() )
+        {
+          disk_overlay_close( 1 ) ;
+          close( disk[ 1 ] ) ;
+          disk[ 1 ] = open( Interface.GetFDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
+          if( ( forked ) || ( Interface.DiskCopyOnWrite() ) )
+          {
+            disk_overlay_open( 1 ) ;
+          }
+        }
+
+        if( Interface.Reset() )
+        {
+          Reset() ;
+        }
+      }
+    }
+  }
+
+  // Application has set trap flag, so fire INT 1
+  if( trap_flag )
+  {
+    pc_interrupt( 1 ) ;
+    TRACE_INTERRUPT( 1 ) ;
+  }
+
+  trap_flag = regs8[ FLAG_TF ] ;
+
+  // Check for interrupts triggered by system interfaces
+  int IntNo ;
+  instr_since_int8++ ;
+  if( Interface.IntRequest() && !seg_override_en && !rep_override_en && regs8[ FLAG_IF ] && !regs8[ FLAG_TF ] && Interface.IntPending( IntNo ) )
+  {
+    if( ( IntNo == 8 ) && ( instr_since_int8 < 300 ) && ( halt_state == HALT_NONE ) )
+    {
+      //printf("*** Int8 after %d instructions\n", instr_since_int8);
+    }
+    else
+    {
+      if( IntNo == 8 )
+      {
+        instr_since_int8 = 0 ;
+      }
+      pc_interrupt( IntNo ) ;
+      TRACE_INTERRUPT( IntNo ) ;
+
+      regs16[ REG_IP ] = reg_ip ;
+    }
+  }
+}
+
+// Let the clocks up to the next device event pass in the current instruction,
+// for a CPU that is waiting for an interrupt.
+void CPU8086::idle_skip( void )
+{
+#if CYCLE_TIMING
+  if( cycles_deadline > cycles_pending + instr_cycles )
+  {
+    instr_cycles = cycles_deadline - cycles_pending ;
+  }
+#else
+  if( cycles_deadline > cycles_pending + 4 )
+  {
+    cycles_pending = cycles_deadline - 4 ;
+  }
+#endif
+}
+
+#if IDLE_DETECT
+// Check whether INT interrupt_num is a program waiting for input, see
+// IDLE_DETECT. If so, halt on the INT and return true.
+bool CPU8086::idle_wait( uint8_t interrupt_num )
+{
+  bool     empty ;
+  bool     idle  ;
+  uint64_t now   ;
+
+  // Nothing could wake it up
+  if( !regs8[ FLAG_IF ] )
+  {
+    return( false ) ;
+  }
+
+  empty = ( *( uint16_t * )&mem[ BDA_KEYBUF_HEAD ] == *( uint16_t * )&mem[ BDA_KEYBUF_TAIL ] ) ;
+  idle  = false ;
+
+  if( interrupt_num == 0x16 )
+  {
+    if( !empty )
+    {
+      idle_polls = 0 ;
+    }
+    else if( regs8[ REG_AH ] == 0x00 )
+    {
+      // The BIOS only returns once there is a key.
+      idle = ( *( uint16_t * )&mem[ 4 * 0x16 + 2 ] == ( BIOS_BASE >> 4 ) ) ;
+    }
+    else if( regs8[ REG_AH ] == 0x01 )
+    {
+      now = cycles_elapsed + cycles_pending ;
+      if( ( now - idle_poll_time ) < IDLE_POLL_CLOCKS )
+      {
+        if( idle_polls < IDLE_POLLS )
+        {
+          idle_polls++ ;
+        }
+      }
+      else
+      {
+        idle_polls = 0 ;
+      }
+      idle_poll_time = now ;
+
+      idle       = ( idle_polls >= IDLE_POLLS ) && !idle_woken ;
+      idle_woken = false ;
+    }
+  }
+  else if( interrupt_num == 0x28 )
+  {
+    idle       = !idle_woken ;
+    idle_woken = false ;
+  }
+
+  if( idle )
+  {
+    halt_state = HALT_IDLE ;
+    halt_passes++ ;
+    idle_skip() ;
+  }
+
+  return( idle ) ;
+}
+#endif
+
+#if JIT
+// Dynamic translation.
+//
+// jit_run() is called before each interpreted instruction. It counts how
+// often each CS:IP is reached and, once it is hot, translates the block of
+// instructions starting there with jit_translate() and runs it instead of
+// the interpreter. A block is a straight run of the instructions below,
+// ended by a conditional jump, LOOPxx/JCXZ, a short or near JMP, an
+// instruction that is not translated or JIT_BLOCK_INSTR instructions:
+//
+//   MOV, ADD|OR|ADC|SBB|AND|SUB|XOR|CMP, TEST, INC|DEC, XCHG, LEA, CBW, CWD,
+//   PUSH|POP reg/sreg, CLC|STC|CMC|CLD|STD and the segment prefixes.
+//
+// Everything else, I/O, interrupts, string instructions and the emulator
+// specific 0F opcodes included, stays with the interpreter.
+//
+// Translated code updates the flags eagerly and keeps the lazy flags clear.
+// It is only entered when no interrupt can be taken, no prefix is pending
+// and the block fits in the clocks left before the next device event and in
+// the instructions left in this Run() call, so the interpreter would have
+// done nothing between its instructions either. Each exit leaves the guest
+// IP and the clocks and instructions used in reg_ip and the two budgets.
+//
+// A block starts by comparing the guest bytes with the ones it was
+// translated from, so code changed by anything (the interpreter, disk
+// reads, other blocks) is never run stale: the check fails and the whole
+// cache is flushed. A store into the running block itself leaves the block
+// after that instruction. So does a memory operand outside RAM, before
+// the instruction, which the interpreter then runs through the memory map.
+//
+// Exits whose target is known jump to a stub that asks jit_run() to chain
+// them. Once the target block exists the jump is patched to go straight to
+// it, so hot loops run without returning to the interpreter until a budget
+// runs out.
+
+// Offset of a CPU8086 member from the register file, as [rbx + offset]
+#define JIT_OFFSET(member)                       ( ( int32_t ) ( ( uint8_t * )&( member ) - regs8 ) )
+
+// Clocks of a translated instruction and of a taken branch
+#if CYCLE_TIMING
+  #define JIT_CYCLES(decoded)                    ( ( decoded ).cycles )
+  #define JIT_BRANCH_CYCLES                      12
+#else
+  #define JIT_CYCLES(decoded)                    4
+  #define JIT_BRANCH_CYCLES                      0
+#endif
+
+// Bytes at the start of the code cache kept for the entry and exit code
+#define JIT_STUB_BYTES                           64
+
+// Flags written by jit_flags(), LAZY_xx bits plus CF
+#define JIT_CF                                   ( 1 << ( FLAG_CF - FLAG_CF ) )
+#define JIT_FLAGS_LOGIC                          ( JIT_CF | LAZY_SZP | LAZY_OF )
+#define JIT_FLAGS_ARITH                          ( JIT_FLAGS_LOGIC | LAZY_AF )
+#define JIT_FLAGS_INC_DEC                        ( LAZY_SZP | LAZY_AO )
+
+// Translated code entry: rbx = regs, r12 = ram, then jumps to code.
+// Returns 1 if a block found its guest code changed.
+typedef int ( * jit_entry_t )( uint8_t * regs , uint8_t * ram , uint8_t * code ) ;
+
+// One instruction of the block being translated
+typedef struct STJITINSTR_T
+{
+  stDecoded_t decoded ;
+  uint16_t    ip      ;
+  uint8_t     opcode  ;
+  uint8_t     len     ;
+  uint8_t     seg     ; // Segment override, 0 if none
+} stJitInstr_t ;
+
+// Exit emitted after the body of the block
+typedef struct STJITEXIT_T
+{
+  uint8_t * site   ;
+  uint16_t  ip     ;
+  uint32_t  cycles ;
+  uint32_t  instr  ;
+} stJitExit_t ;
+
+// Translation context
+typedef struct STJITCONTEXT_T
+{
+  XTJitEmitter e ;
+  int32_t      off_ip            ;
+  int32_t      off_budget_cycles ;
+  int32_t      off_budget_instr  ;
+  int32_t      off_link_site     ;
+  int32_t      off_store_count   ;
+  int32_t      off_mem_map       ;
+  int32_t      off_mem_dirty     ;
+  uint8_t    * exit              ;
+  uint8_t    * store_log         ;
+  bool         chain             ;
+  uint32_t     lin               ; // Linear address and length of the guest code
+  uint32_t     len               ;
+  stJitExit_t  exits[ 3 * JIT_BLOCK_INSTR ] ; // Up to two memory and one store check each
+  uint32_t     n_exits           ;
+} stJitContext_t ;
+
+static stJitOperand_t jit_operand( uint8_t kind , int32_t value )
+{
+  stJitOperand_t op ;
+
+  op.kind  = kind  ;
+  op.value = value ;
+
+  return( op ) ;
+}
+
+// regs8[] offset of an 8-bit register
+static int32_t jit_reg8( uint8_t reg )
+{
+  return( ( 2 * reg + reg / 4 ) & 7 ) ;
+}
+
+// Length of a translated instruction, 0 if it is not translated
+static uint8_t jit_length( uint8_t opcode , const stDecoded_t & decoded )
+{
+  uint8_t disp ;
+
+  disp = ( decoded.i_mod == 1 ) ? ( 1 ) : ( ( ( decoded.i_mod == 2 ) || ( !decoded.i_mod && ( decoded.i_rm == 6 ) ) ) ? ( 2 ) : ( 0 ) ) ;
+
+  if( opcode < 0x40 )
+  {
+    switch( opcode & 0x07 )
+    {
+    case 0x00 :
+    case 0x01 :
+    case 0x02 :
+    case 0x03 :
+      return( 2 + disp ) ;
+
+    case 0x04 :
+      return( 2 ) ;
+
+    case 0x05 :
+      return( 3 ) ;
+
+    case 0x06 :
+      // PUSH sreg | segment override
+      return( 1 ) ;
+
+    default :
+      // POP sreg, except POP CS which is the emulator specific 0F
+      return( ( opcode < 0x20 ) && ( opcode != 0x0F ) ) ;
+    }
+  }
+
+  if( opcode < 0x60 )
+  {
+    // INC|DEC|PUSH|POP reg, but not PUSH|POP SP
+    return( ( opcode & 0xF7 ) != 0x54 ) ;
+  }
+
+  if( ( opcode & 0xF0 ) == 0x70 )
+  {
+    return( 2 ) ;
+  }
+
+  if( ( opcode & 0xF0 ) == 0xB0 )
+  {
+    return( ( opcode & 0x08 ) ? ( 3 ) : ( 2 ) ) ;
+  }
+
+  switch( opcode )
+  {
+  case 0x80 :
+  case 0x82 :
+  case 0x83 :
+    return( 3 + disp ) ;
+
+  case 0x81 :
+    return( 4 + disp ) ;
+
+  case 0x84 :
+  case 0x85 :
+  case 0x86 :
+  case 0x87 :
+  case 0x88 :
+  case 0x89 :
+  case 0x8A :
+  case 0x8B :
+    return( 2 + disp ) ;
+
+  case 0x8C :
+    return( ( decoded.i_reg < 4 ) ? ( 2 + disp ) : ( 0 ) ) ;
+
+  case 0x8D :
+    return( ( decoded.i_mod < 3 ) ? ( 2 + disp ) : ( 0 ) ) ;
+
+  case 0x8E :
+    return( ( ( decoded.i_reg < 4 ) && ( decoded.i_reg != 1 ) ) ? ( 2 + disp ) : ( 0 ) ) ;
+
+  case 0x90 :
+  case 0x91 :
+  case 0x92 :
+  case 0x93 :
+  case 0x94 :
+  case 0x95 :
+  case 0x96 :
+  case 0x97 :
+  case 0x98 :
+  case 0x99 :
+  case 0xF5 :
+  case 0xF8 :
+  case 0xF9 :
+  case 0xFC :
+  case 0xFD :
+    return( 1 ) ;
+
+  case 0xA0 :
+  case 0xA1 :
+  case 0xA2 :
+  case 0xA3 :
+  case 0xA9 :
+  case 0xE9 :
+    return( 3 ) ;
+
+  case 0xA8 :
+  case 0xE0 :
+  case 0xE1 :
+  case 0xE2 :
+  case 0xE3 :
+  case 0xEB :
+    return( 2 ) ;
+
+  case 0xC6 :
+    return( ( decoded.i_reg == 0 ) ? ( 3 + disp ) : ( 0 ) ) ;
+
+  case 0xC7 :
+    return( ( decoded.i_reg == 0 ) ? ( 4 + disp ) : ( 0 ) ) ;
+
+  case 0xFE :
+  case 0xFF :
+    // INC|DEC r/m
+    return( ( decoded.i_reg < 2 ) ? ( 2 + disp ) : ( 0 ) ) ;
+  }
+
+  return( 0 ) ;
+}
+
+// Instructions that end a block
+static bool jit_ends_block( uint8_t opcode )
+{
+  return( ( ( opcode & 0xF0 ) == 0x70 ) || ( ( opcode & 0xFC ) == 0xE0 ) || ( opcode == 0xE9 ) || ( opcode == 0xEB ) ) ;
+}
+
+// ecx = linear address seg:( reg1 + reg2 + disp ), or just the offset if
+// seg is REG_ZERO
+static void jit_ea( stJitContext_t & c , uint8_t reg1 , uint8_t reg2 , uint16_t disp , uint8_t seg )
+{
+  if( reg1 == REG_ZERO )
+  {
+    reg1 = reg2 ;
+    reg2 = REG_ZERO ;
+  }
+
+  if( reg1 == REG_ZERO )
+  {
+    // mov ecx, disp
+    c.e.b( 0xB9 ) ;
+    c.e.d( disp ) ;
+  }
+  else
+  {
+    c.e.movzx_rf( JIT_ECX , 2 * reg1 ) ;
+    if( reg2 != REG_ZERO )
+    {
+      c.e.movzx_rf( JIT_EDX , 2 * reg2 ) ;
+      c.e.add_r_r( JIT_ECX , JIT_EDX ) ;
+    }
+    if( disp )
+    {
+      c.e.grp1_32_r_imm( 0 , JIT_ECX , disp ) ;
+    }
+    c.e.movzx_r_r16( JIT_ECX , JIT_ECX ) ;
+  }
+
+  if( seg != REG_ZERO )
+  {
+    c.e.movzx_rf( JIT_EDX , 2 * seg ) ;
+    c.e.shl_r_imm( JIT_EDX , 4 ) ;
+    c.e.add_r_r( JIT_ECX , JIT_EDX ) ;
+  }
+}
+
+// ecx = linear address of SS:SP after adding delta to SP
+static void jit_stack( stJitContext_t & c , int8_t delta )
+{
+  c.e.movzx_rf( JIT_ECX , 2 * REG_SP ) ;
+  if( delta < 0 )
+  {
+    // PUSH: SP -= 2, the word goes at the new SP
+    c.e.grp1_32_r_imm( 5 , JIT_ECX , 2 ) ;
+    c.e.store16_rf( JIT_ECX , 2 * REG_SP ) ;
+    c.e.movzx_r_r16( JIT_ECX , JIT_ECX ) ;
+  }
+  else
+  {
+    // POP: the word comes from the old SP, lea edx, [rcx + 2]
+    c.e.b( 0x8D ) ;
+    c.e.b( 0x51 ) ;
+    c.e.b( 0x02 ) ;
+    c.e.store16_rf( JIT_EDX , 2 * REG_SP ) ;
+  }
+  c.e.movzx_rf( JIT_EDX , 2 * REG_SS ) ;
+  c.e.shl_r_imm( JIT_EDX , 4 ) ;
+  c.e.add_r_r( JIT_ECX , JIT_EDX ) ;
+}
+
+// Before a word or byte is stored to [r12 + rcx], mark its pages dirty and,
+// in differential mode, log the word there. Must come before the
+// instruction sets the host flags.
+static void jit_before_store( stJitContext_t & c )
+{
+  // mov edx, ecx ; shr edx, MEM_PAGE_BITS ; mov byte [rbx + rdx + mem_dirty], MEM_DIRTY_ALL
+  // and the same for ecx + 1, keeping rdx
+  c.e.b( 0x52 ) ;                               // push rdx
+  c.e.mov_r_r( JIT_EDX , JIT_ECX ) ;
+  c.e.shr_r_imm( JIT_EDX , MEM_PAGE_BITS ) ;
+  c.e.b( 0xC6 ) ;
+  c.e.rf_index( 0 , JIT_EDX , c.off_mem_dirty ) ;
+  c.e.b( MEM_DIRTY_ALL ) ;
+  c.e.b( 0x8D ) ;                               // lea edx, [rcx + 1]
+  c.e.b( 0x51 ) ;
+  c.e.b( 0x01 ) ;
+  c.e.shr_r_imm( JIT_EDX , MEM_PAGE_BITS ) ;
+  c.e.b( 0xC6 ) ;
+  c.e.rf_index( 0 , JIT_EDX , c.off_mem_dirty ) ;
+  c.e.b( MEM_DIRTY_ALL ) ;
+  c.e.b( 0x5A ) ;                               // pop rdx
+
+#if JIT_DIFF
+  c.e.b( 0x50 ) ;                               // push rax
+  c.e.b( 0x52 ) ;                               // push rdx
+  c.e.b( 0x8B ) ;                               // mov edx, [store_count]
+  c.e.rf( JIT_EDX , c.off_store_count ) ;
+  c.e.b( 0x48 ) ;                               // mov rax, store_log
+  c.e.b( 0xB8 ) ;
+  c.e.q( ( uint64_t ) c.store_log ) ;
+  c.e.b( 0x48 ) ;                               // lea rax, [rax + rdx * 8]
+  c.e.b( 0x8D ) ;
+  c.e.b( 0x04 ) ;
+  c.e.b( 0xD0 ) ;
+  c.e.b( 0x89 ) ;                               // mov [rax], ecx
+  c.e.b( 0x08 ) ;
+  c.e.b( 0x41 ) ;                               // movzx edx, word [r12 + rcx]
+  c.e.b( 0x0F ) ;
+  c.e.b( 0xB7 ) ;
+  c.e.guest( JIT_EDX ) ;
+  c.e.b( 0x89 ) ;                               // mov [rax + 4], edx
+  c.e.b( 0x50 ) ;
+  c.e.b( 0x04 ) ;
+  c.e.b( 0xFF ) ;                               // inc dword [store_count]
+  c.e.rf( 0 , c.off_store_count ) ;
+  c.e.b( 0x5A ) ;                               // pop rdx
+  c.e.b( 0x58 ) ;                               // pop rax
+#endif
+}
+
+// Copy the host flags the guest instruction defines into regs8[FLAG_xx]
+static void jit_flags( stJitContext_t & c , uint16_t flags )
+{
+  if( flags & JIT_CF )
+  {
+    c.e.setcc( JIT_CC_C , FLAG_CF ) ;
+  }
+  if( flags & LAZY_ZF )
+  {
+    c.e.setcc( JIT_CC_Z , FLAG_ZF ) ;
+  }
+  if( flags & LAZY_SF )
+  {
+    c.e.setcc( JIT_CC_S , FLAG_SF ) ;
+  }
+  if( flags & LAZY_PF )
+  {
+    c.e.setcc( JIT_CC_P , FLAG_PF ) ;
+  }
+  if( flags & LAZY_OF )
+  {
+    c.e.setcc( JIT_CC_O , FLAG_OF ) ;
+  }
+  if( flags & LAZY_AF )
+  {
+    c.e.b( 0x9F ) ;                             // lahf
+    c.e.b( 0xF6 ) ;                             // test ah, 0x10
+    c.e.b( 0xC4 ) ;
+    c.e.b( 0x10 ) ;
+    c.e.setcc( JIT_CC_NZ , FLAG_AF ) ;
+  }
+}
+
+// After a store to guest memory at ecx, leave the block if the store hit
+// the block's own code. The exit is emitted after the body.
+static void jit_store_check( stJitContext_t & c , bool w16 , uint16_t next_ip , uint32_t cycles , uint32_t instr )
+{
+  stJitExit_t & exit = c.exits[ c.n_exits++ ] ;
+
+  // lea edx, [rcx - first byte the store can reach] ; cmp edx, range ; jb exit
+  c.e.b( 0x8D ) ;
+  c.e.b( 0x91 ) ;
+  c.e.d( ( uint32_t ) ( w16 ) - c.lin ) ;
+  c.e.grp1_32_r_imm( 7 , JIT_EDX , c.len + w16 ) ;
+
+  exit.site   = c.e.jcc( JIT_CC_C ) ;
+  exit.ip     = next_ip ;
+  exit.cycles = cycles ;
+  exit.instr  = instr ;
+}
+
+// Leave the block before an instruction whose memory operand at ecx is not
+// in RAM. Both the first byte and the next one are checked, as a word at the
+// end of a RAM page may reach into a video or ROM page; a byte operand there
+// only leaves the block early. The exits are emitted after the body.
+static void jit_mem_check( stJitContext_t & c , uint16_t ip , uint32_t cycles , uint32_t instr )
+{
+  for( int i = 0 ; i < 2 ; i++ )
+  {
+    stJitExit_t & exit = c.exits[ c.n_exits++ ] ;
+
+    // mov edx, ecx | lea edx, [rcx + 1] ; shr edx, MEM_PAGE_BITS ; cmp byte [rbx + rdx + mem_map], MEM_PAGE_RAM ; jne exit
+    if( i )
+    {
+      c.e.b( 0x8D ) ;
+      c.e.b( 0x51 ) ;
+      c.e.b( 0x01 ) ;
+    }
+    else
+    {
+      c.e.mov_r_r( JIT_EDX , JIT_ECX ) ;
+    }
+    c.e.shr_r_imm( JIT_EDX , MEM_PAGE_BITS ) ;
+    c.e.b( 0x80 ) ;
+    c.e.rf_index( 7 , JIT_EDX , c.off_mem_map ) ;
+    c.e.b( MEM_PAGE_RAM ) ;
+
+    exit.site   = c.e.jcc( JIT_CC_NZ ) ;
+    exit.ip     = ip     ;
+    exit.cycles = cycles ;
+    exit.instr  = instr  ;
+  }
+}
+
+// Leave the block for ip after cycles clocks and instr instructions,
+// through a jump that jit_run() may chain to the next block.
+static void jit_exit_to( stJitContext_t & c , uint16_t ip , uint32_t cycles , uint32_t instr , bool chain )
+{
+  uint8_t * site ;
+
+  c.e.mov16_rf_imm( c.off_ip , ip ) ;
+  c.e.grp1_32_rf_imm( 5 , c.off_budget_cycles , cycles ) ;
+  c.e.grp1_32_rf_imm( 5 , c.off_budget_instr , instr ) ;
+
+  if( chain && c.chain )
+  {
+    // Until it is chained the jump goes on to store its own address in
+    // jit_link_site: mov rax, site ; mov [link_site], rax
+    site = c.e.jmp() ;
+    XTJitEmitter::link( site , c.e.p ) ;
+    c.e.b( 0x48 ) ;
+    c.e.b( 0xB8 ) ;
+    c.e.q( ( uint64_t ) site ) ;
+    c.e.b( 0x48 ) ;
+    c.e.b( 0x89 ) ;
+    c.e.rf( JIT_EAX , c.off_link_site ) ;
+  }
+
+  XTJitEmitter::link( c.e.jmp() , c.exit ) ;
+}
+
+// ALU operation 0..7 (ADD..CMP) of dst with src. store is false for CMP
+// and TEST, which only update the flags.
+static void jit_alu( stJitContext_t & c , uint8_t alu_op , bool w16 , const stJitOperand_t & dst , const stJitOperand_t & src , bool store )
+{
+  c.e.load( w16 , JIT_EAX , dst ) ;
+  c.e.load( w16 , JIT_EDX , src ) ;
+
+  if( store && ( dst.kind == JIT_OPERAND_MEM ) )
+  {
+    jit_before_store( c ) ;
+  }
+
+  if( ( alu_op == 2 ) || ( alu_op == 3 ) )
+  {
+    // ADC|SBB: bt dword [rbx + FLAG_CF], 0 puts the guest CF in the host CF
+    c.e.b( 0x0F ) ;
+    c.e.b( 0xBA ) ;
+    c.e.rf( 4 , FLAG_CF ) ;
+    c.e.b( 0x00 ) ;
+  }
+
+  c.e.alu( alu_op , w16 ) ;
+
+  if( store )
+  {
+    c.e.store( w16 , JIT_EAX , dst ) ;
+  }
+
+  if( ( alu_op == 1 ) || ( alu_op == 4 ) || ( alu_op == 6 ) )
+  {
+    jit_flags( c , JIT_FLAGS_LOGIC ) ;
+  }
+  else
+  {
+    jit_flags( c , JIT_FLAGS_ARITH ) ;
+  }
+}
+
+// Set up the code cache and the entry and exit code at its start
+void CPU8086::jit_init( void )
+{
+  void        * buffer ;
+  XTJitEmitter  e ;
+
+  jit_code = NULL ;
+  jit_link_site = NULL ;
+#if JIT_DIFF
+  jit_suspended = false ;
+#endif
+
+  buffer = mmap( NULL , JIT_CODE_SIZE , PROT_READ | PROT_WRITE | PROT_EXEC , MAP_PRIVATE | MAP_ANONYMOUS , -1 , 0 ) ;
+  if( buffer == MAP_FAILED )
+  {
+    return ;
+  }
+
+  jit_code = ( uint8_t * ) buffer ;
+  e.p = jit_code ;
+
+  // Entry: push rbx ; push r12 ; mov rbx, rdi ; mov r12, rsi ; jmp rdx
+  e.b( 0x53 ) ;
+  e.b( 0x41 ) ; e.b( 0x54 ) ;
+  e.b( 0x48 ) ; e.b( 0x89 ) ; e.b( 0xFB ) ;
+  e.b( 0x49 ) ; e.b( 0x89 ) ; e.b( 0xF4 ) ;
+  e.b( 0xFF ) ; e.b( 0xE2 ) ;
+
+  // Exit: xor eax, eax ; pop r12 ; pop rbx ; ret
+  jit_exit = e.p ;
+  e.b( 0x31 ) ; e.b( 0xC0 ) ;
+  e.b( 0x41 ) ; e.b( 0x5C ) ;
+  e.b( 0x5B ) ;
+  e.b( 0xC3 ) ;
+
+  // Stale exit: mov eax, 1 ; pop r12 ; pop rbx ; ret
+  jit_exit_stale = e.p ;
+  e.b( 0xB8 ) ; e.d( 1 ) ;
+  e.b( 0x41 ) ; e.b( 0x5C ) ;
+  e.b( 0x5B ) ;
+  e.b( 0xC3 ) ;
+
+  jit_flush() ;
+}
+
+// Drop every translated block
+void CPU8086::jit_flush( void )
+{
+  memset( ( void * ) jit_blocks , 0x00 , sizeof( jit_blocks ) ) ;
+
+  if( jit_code != NULL )
+  {
+    jit_code_free = jit_code + JIT_STUB_BYTES ;
+  }
+  jit_link_site = NULL ;
+}
+
+// Translate the block at cs:ip. Returns its entry point, or NULL if its
+// first instruction is not translated.
+uint8_t * CPU8086::jit_translate( uint16_t cs , uint16_t ip )
+{
+  stJitInstr_t   instr[ JIT_BLOCK_INSTR ] ;
+  stJitContext_t c ;
+  stOpcode_t     saved_opcode ;
+  uint8_t      * entry ;
+  uint32_t       n ;
+  uint32_t       n_safe ;
+  uint32_t       i ;
+  uint32_t       cycles ;
+  uint8_t        seg_pending ;
+  uint16_t       restart_ip ;
+  uint32_t       restart_cycles ;
+  uint32_t       restart_instr ;
+
+  if( jit_code_free + JIT_BLOCK_BYTES > jit_code + JIT_CODE_SIZE )
+  {
+    jit_flush() ;
+  }
+
+  // decode_instruction() goes through set_opcode()
+  saved_opcode = stOpcode ;
+
+  // First pass: find the instructions of the block. A segment prefix is
+  // only kept together with the instruction it applies to.
+  c.lin       = 16 * cs + ip ;
+  c.len       = 0 ;
+  n           = 0 ;
+  n_safe      = 0 ;
+  seg_pending = 0 ;
+  while( n < JIT_BLOCK_INSTR )
+  {
+    stJitInstr_t & in = instr[ n ] ;
+
+    memset( ( void * ) &in.decoded , 0x00 , sizeof( in.decoded ) ) ;
+    decode_instruction( mem + c.lin + c.len , 0 , &in.decoded ) ;
+    in.opcode = mem[ c.lin + c.len ] ;
+    in.ip     = ip + c.len ;
+    in.len    = jit_length( in.opcode , in.decoded ) ;
+    in.seg    = seg_pending ;
+    if( !in.len || ( ( uint32_t ) in.ip + in.len > 0x10000 ) )
+    {
+      break ;
+    }
+
+    c.len += in.len ;
+    n++ ;
+
+    if( ( in.opcode & 0xE7 ) == 0x26 )
+    {
+      seg_pending = in.decoded.stOpcode.extra ;
+      continue ;
+    }
+
+    seg_pending = 0 ;
+    n_safe = n ;
+    if( jit_ends_block( in.opcode ) )
+    {
+      break ;
+    }
+  }
+
+  stOpcode = saved_opcode ;
+
+  n = n_safe ;
+  if( n == 0 )
+  {
+    return( NULL ) ;
+  }
+
+  c.len = 0 ;
+  cycles = 0 ;
+  for( i = 0 ; i < n ; i++ )
+  {
+    c.len  += instr[ i ].len ;
+    cycles += JIT_CYCLES( instr[ i ].decoded ) ;
+  }
+  if( jit_ends_block( instr[ n - 1 ].opcode ) )
+  {
+    cycles += JIT_BRANCH_CYCLES ;
+  }
+
+  c.e.p               = jit_code_free ;
+  c.off_ip            = JIT_OFFSET( reg_ip ) ;
+  c.off_budget_cycles = JIT_OFFSET( jit_budget_cycles ) ;
+  c.off_budget_instr  = JIT_OFFSET( jit_budget_instr ) ;
+  c.off_link_site     = JIT_OFFSET( jit_link_site ) ;
+  c.off_mem_map       = JIT_OFFSET( mem_map[ 0 ] ) ;
+  c.off_mem_dirty     = JIT_OFFSET( mem_dirty[ 0 ] ) ;
+  c.exit              = jit_exit ;
+  c.chain             = !JIT_DIFF ;
+  c.n_exits           = 0 ;
+#if JIT_DIFF
+  c.off_store_count   = JIT_OFFSET( jit_store_count ) ;
+  c.store_log         = ( uint8_t * ) jit_store_log ;
+#else
+  c.off_store_count   = 0 ;
+  c.store_log         = NULL ;
+#endif
+
+  entry = c.e.p ;
+
+  // Check the guest code is still what was translated
+  for( i = 0 ; i < c.len ; )
+  {
+    uint32_t addr ;
+
+    addr = c.lin + i ;
+    if( c.len - i >= 8 )
+    {
+      // mov rax, imm64 ; cmp [r12 + addr], rax
+      c.e.b( 0x48 ) ;
+      c.e.b( 0xB8 ) ;
+      c.e.q( *( uint64_t * )&mem[ addr ] ) ;
+      c.e.b( 0x49 ) ;
+      c.e.b( 0x3B ) ;
+      c.e.guest_abs( JIT_EAX , addr ) ;
+      i += 8 ;
+    }
+    else if( c.len - i >= 4 )
+    {
+      // cmp dword [r12 + addr], imm32
+      c.e.b( 0x41 ) ;
+      c.e.b( 0x81 ) ;
+      c.e.guest_abs( 7 , addr ) ;
+      c.e.d( *( uint32_t * )&mem[ addr ] ) ;
+      i += 4 ;
+    }
+    else if( c.len - i >= 2 )
+    {
+      // cmp word [r12 + addr], imm16
+      c.e.b( 0x66 ) ;
+      c.e.b( 0x41 ) ;
+      c.e.b( 0x81 ) ;
+      c.e.guest_abs( 7 , addr ) ;
+      c.e.w( *( uint16_t * )&mem[ addr ] ) ;
+      i += 2 ;
+    }
+    else
+    {
+      // cmp byte [r12 + addr], imm8
+      c.e.b( 0x41 ) ;
+      c.e.b( 0x80 ) ;
+      c.e.guest_abs( 7 , addr ) ;
+      c.e.b( mem[ addr ] ) ;
+      i += 1 ;
+    }
+    XTJitEmitter::link( c.e.jcc( JIT_CC_NZ ) , jit_exit_stale ) ;
+  }
+
+  // Check the whole block fits in both budgets
+  c.e.grp1_32_rf_imm( 7 , c.off_budget_cycles , cycles ) ;
+  XTJitEmitter::link( c.e.jcc( JIT_CC_L ) , jit_exit ) ;
+  c.e.grp1_32_rf_imm( 7 , c.off_budget_instr , n ) ;
+  XTJitEmitter::link( c.e.jcc( JIT_CC_L ) , jit_exit ) ;
+
+  // Second pass: the instructions. A memory check leaves the block at the
+  // start of the instruction, its segment prefix included.
+  cycles         = 0  ;
+  restart_ip     = ip ;
+  restart_cycles = 0  ;
+  restart_instr  = 0  ;
+  for( i = 0 ; i < n ; i++ )
+  {
+    const stJitInstr_t & in = instr[ i ] ;
+    const stDecoded_t  & d  = in.decoded ;
+    stJitOperand_t       rm ;
+    stJitOperand_t       reg ;
+    stJitOperand_t       acc ;
+    uint16_t             next_ip ;
+    uint8_t              op ;
+    bool                 w ;
+    bool                 rm_stored ;
+
+    op       = in.opcode ;
+    w        = op & 0x01 ;
+    next_ip  = in.ip + in.len ;
+    cycles  += JIT_CYCLES( d ) ;
+    rm_stored = false ;
+
+    acc = jit_operand( JIT_OPERAND_REG , 0 ) ;
+    reg = jit_operand( JIT_OPERAND_REG , d.reg_offset ) ;
+    rm  = jit_operand( JIT_OPERAND_REG , d.rm_offset ) ;
+    if( d.stOpcode.i_mod_size && ( d.i_mod < 3 ) && ( op != 0x8D ) )
+    {
+      jit_ea( c , d.ea_reg1 , d.ea_reg2 , d.ea_disp , ( in.seg ) ? ( in.seg ) : ( d.ea_seg ) ) ;
+      jit_mem_check( c , restart_ip , restart_cycles , restart_instr ) ;
+      rm = jit_operand( JIT_OPERAND_MEM , 0 ) ;
+    }
+
+    if( ( op < 0x40 ) && ( ( op & 0x07 ) < 0x06 ) )
+    {
+      // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP
+      uint8_t alu_op = op >> 3 ;
+
+      if( op & 0x04 )
+      {
+        jit_alu( c , alu_op , w , acc , jit_operand( JIT_OPERAND_IMM , ( w ) ? ( d.i_data0 ) : ( d.i_data0 & 0xFF ) ) , alu_op != 7 ) ;
+      }
+      else if( op & 0x02 )
+      {
+        jit_alu( c , alu_op , w , reg , rm , alu_op != 7 ) ;
+      }
+      else
+      {
+        jit_alu( c , alu_op , w , rm , reg , alu_op != 7 ) ;
+        rm_stored = ( alu_op != 7 ) ;
+      }
+    }
+    else if( op < 0x40 )
+    {
+      if( ( op & 0x07 ) == 0x06 )
+      {
+        if( op < 0x20 )
+        {
+          // PUSH sreg
+          jit_stack( c , -2 ) ;
+          jit_before_store( c ) ;
+          c.e.load( true , JIT_EAX , jit_operand( JIT_OPERAND_REG , 2 * d.stOpcode.extra ) ) ;
+          c.e.store( true , JIT_EAX , jit_operand( JIT_OPERAND_MEM , 0 ) ) ;
+          jit_store_check( c , true , next_ip , cycles , i + 1 ) ;
+        }
+        // Segment overrides only change the EA of the next instruction
+      }
+      else
+      {
+        // POP sreg
+        jit_stack( c , 2 ) ;
+        c.e.load( true , JIT_EAX , jit_operand( JIT_OPERAND_MEM , 0 ) ) ;
+        c.e.store( true , JIT_EAX , jit_operand( JIT_OPERAND_REG , 2 * d.stOpcode.extra ) ) ;
+      }
+    }
+    else if( op < 0x50 )
+    {
+      // INC|DEC reg16: inc|dec ax
+      reg = jit_operand( JIT_OPERAND_REG , 2 * ( op & 0x07 ) ) ;
+      c.e.load( true , JIT_EAX , reg ) ;
+      c.e.b( 0x66 ) ;
+      c.e.b( 0xFF ) ;
+      c.e.b( ( op & 0x08 ) ? ( 0xC8 ) : ( 0xC0 ) ) ;
+      c.e.store( true , JIT_EAX , reg ) ;
+      jit_flags( c , JIT_FLAGS_INC_DEC ) ;
+    }
+    else if( op < 0x58 )
+    {
+      // PUSH reg16
+      jit_stack( c , -2 ) ;
+      jit_before_store( c ) ;
+      c.e.load( true , JIT_EAX , jit_operand( JIT_OPERAND_REG , 2 * ( op & 0x07 ) ) ) ;
+      c.e.store( true , JIT_EAX , jit_operand( JIT_OPERAND_MEM , 0 ) ) ;
+      jit_store_check( c , true , next_ip , cycles , i + 1 ) ;
+    }
+    else if( op < 0x60 )
+    {
+      // POP reg16
+      jit_stack( c , 2 ) ;
+      c.e.load( true , JIT_EAX , jit_operand( JIT_OPERAND_MEM , 0 ) ) ;
+      c.e.store( true , JIT_EAX , jit_operand( JIT_OPERAND_REG , 2 * ( op & 0x07 ) ) ) ;
+    }
+    else if( ( op & 0xF0 ) == 0x70 )
+    {
+      // Jcc: the same flags as xt_jcc_table, in al
+      uint8_t   cond = ( op >> 1 ) & 0x07 ;
+      uint8_t * taken ;
+
+      c.e.load( false , JIT_EAX , jit_operand( JIT_OPERAND_REG , xt_jcc_table[ 2 ][ cond ] ) ) ;
+      c.e.op8_al_rf( 0x32 , xt_jcc_table[ 3 ][ cond ] ) ;
+      c.e.op8_al_rf( 0x0A , xt_jcc_table[ 1 ][ cond ] ) ;
+      c.e.op8_al_rf( 0x0A , xt_jcc_table[ 0 ][ cond ] ) ;
+      c.e.b( 0x84 ) ;                           // test al, al
+      c.e.b( 0xC0 ) ;
+      taken = c.e.jcc( ( op & 0x01 ) ? ( JIT_CC_Z ) : ( JIT_CC_NZ ) ) ;
+
+      jit_exit_to( c , next_ip , cycles , i + 1 , true ) ;
+      XTJitEmitter::link( taken , c.e.p ) ;
+      jit_exit_to( c , next_ip + ( int8_t ) d.i_data0 , cycles + JIT_BRANCH_CYCLES , i + 1 , true ) ;
+    }
+    else if( ( op & 0xF8 ) == 0x90 )
+    {
+      // XCHG AX, reg16 (NOP for 0x90)
+      if( op != 0x90 )
+      {
+        reg = jit_operand( JIT_OPERAND_REG , 2 * ( op & 0x07 ) ) ;
+        c.e.load( true , JIT_EAX , acc ) ;
+        c.e.load( true , JIT_EDX , reg ) ;
+        c.e.store( true , JIT_EDX , acc ) ;
+        c.e.store( true , JIT_EAX , reg ) ;
+      }
+    }
+    else if( ( op & 0xF0 ) == 0xB0 )
+    {
+      // MOV reg, imm
+      if( op & 0x08 )
+      {
+        c.e.mov16_rf_imm( 2 * ( op & 0x07 ) , d.i_data0 ) ;
+      }
+      else
+      {
+        c.e.mov8_rf_imm( jit_reg8( op & 0x07 ) , ( uint8_t ) d.i_data0 ) ;
+      }
+    }
+    else
+    {
+      switch( op )
+      {
+      // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP r/m, immed
+      case 0x80 :
+      case 0x81 :
+      case 0x82 :
+      case 0x83 :
+        {
+          uint16_t imm ;
+
+          imm = ( op == 0x81 ) ? ( d.i_data2 ) : ( ( op == 0x83 ) ? ( ( uint16_t ) ( int8_t ) d.i_data2 ) : ( d.i_data2 & 0xFF ) ) ;
+          jit_alu( c , d.i_reg , w , rm , jit_operand( JIT_OPERAND_IMM , imm ) , d.i_reg != 7 ) ;
+          rm_stored = ( d.i_reg != 7 ) ;
+        }
+        break ;
+
+      // TEST r/m, reg
+      case 0x84 :
+      case 0x85 :
+        jit_alu( c , 4 , w , rm , reg , false ) ;
+        break ;
+
+      // XCHG r/m, reg
+      case 0x86 :
+      case 0x87 :
+        c.e.load( w , JIT_EAX , rm ) ;
+        c.e.load( w , JIT_EDX , reg ) ;
+        if( rm.kind == JIT_OPERAND_MEM )
+        {
+          jit_before_store( c ) ;
+        }
+        c.e.store( w , JIT_EDX , rm ) ;
+        c.e.store( w , JIT_EAX , reg ) ;
+        rm_stored = true ;
+        break ;
+
+      // MOV r/m, reg | MOV reg, r/m
+      case 0x88 :
+      case 0x89 :
+        c.e.load( w , JIT_EAX , reg ) ;
+        if( rm.kind == JIT_OPERAND_MEM )
+        {
+          jit_before_store( c ) ;
+        }
+        c.e.store( w , JIT_EAX , rm ) ;
+        rm_stored = true ;
+        break ;
+
+      case 0x8A :
+      case 0x8B :
+        c.e.load( w , JIT_EAX , rm ) ;
+        c.e.store( w , JIT_EAX , reg ) ;
+        break ;
+
+      // MOV r/m, sreg | MOV sreg, r/m. Always 16-bit.
+      case 0x8C :
+      case 0x8E :
+        w   = true ;
+        reg = jit_operand( JIT_OPERAND_REG , 2 * ( 8 + d.i_reg ) ) ;
+        if( rm.kind == JIT_OPERAND_REG )
+        {
+          rm = jit_operand( JIT_OPERAND_REG , 2 * d.i_rm ) ;
+        }
+
+        if( op == 0x8C )
+        {
+          c.e.load( true , JIT_EAX , reg ) ;
+          if( rm.kind == JIT_OPERAND_MEM )
+          {
+            jit_before_store( c ) ;
+          }
+          c.e.store( true , JIT_EAX , rm ) ;
+          rm_stored = true ;
+        }
+        else
+        {
+          c.e.load( true , JIT_EAX , rm ) ;
+          c.e.store( true , JIT_EAX , reg ) ;
+        }
+        break ;
+
+      // LEA reg, r/m: the offset only
+      case 0x8D :
+        jit_ea( c , d.ea_reg1 , d.ea_reg2 , d.ea_disp , REG_ZERO ) ;
+        c.e.store16_rf( JIT_ECX , 2 * d.i_reg ) ;
+        break ;
+
+      // CBW: movsx eax, byte [AL] ; mov [AX], ax
+      case 0x98 :
+        c.e.b( 0x0F ) ;
+        c.e.b( 0xBE ) ;
+        c.e.rf( JIT_EAX , REG_AL ) ;
+        c.e.store16_rf( JIT_EAX , 2 * REG_AX ) ;
+        break ;
+
+      // CWD: mov ax, [AX] ; cwd ; mov [DX], dx
+      case 0x99 :
+        c.e.load( true , JIT_EAX , acc ) ;
+        c.e.b( 0x66 ) ;
+        c.e.b( 0x99 ) ;
+        c.e.store16_rf( JIT_EDX , 2 * REG_DX ) ;
+        break ;
+
+      // MOV AL/AX, [loc] | MOV [loc], AL/AX
+      case 0xA0 :
+      case 0xA1 :
+      case 0xA2 :
+      case 0xA3 :
+        jit_ea( c , REG_ZERO , REG_ZERO , d.i_data0 , ( in.seg ) ? ( in.seg ) : ( REG_DS ) ) ;
+        jit_mem_check( c , restart_ip , restart_cycles , restart_instr ) ;
+        rm = jit_operand( JIT_OPERAND_MEM , 0 ) ;
+        if( op & 0x02 )
+        {
+          c.e.load( w , JIT_EAX , acc ) ;
+          jit_before_store( c ) ;
+          c.e.store( w , JIT_EAX , rm ) ;
+          rm_stored = true ;
+        }
+        else
+        {
+          c.e.load( w , JIT_EAX , rm ) ;
+          c.e.store( w , JIT_EAX , acc ) ;
+        }
+        break ;
+
+      // TEST AL/AX, immed
+      case 0xA8 :
+      case 0xA9 :
+        jit_alu( c , 4 , w , acc , jit_operand( JIT_OPERAND_IMM , ( w ) ? ( d.i_data0 ) : ( d.i_data0 & 0xFF ) ) , false ) ;
+        break ;
+
+      // MOV r/m, immed
+      case 0xC6 :
+      case 0xC7 :
+        c.e.load( w , JIT_EAX , jit_operand( JIT_OPERAND_IMM , ( w ) ? ( d.i_data2 ) : ( d.i_data2 & 0xFF ) ) ) ;
+        if( rm.kind == JIT_OPERAND_MEM )
+        {
+          jit_before_store( c ) ;
+        }
+        c.e.store( w , JIT_EAX , rm ) ;
+        rm_stored = true ;
+        break ;
+
+      // LOOPNZ|LOOPZ|LOOP|JCXZ
+      case 0xE0 :
+      case 0xE1 :
+      case 0xE2 :
+      case 0xE3 :
+        {
+          uint8_t * taken ;
+          uint8_t * not_taken ;
+
+          not_taken = NULL ;
+          if( op == 0xE3 )
+          {
+            // cmp word [CX], 0 ; je taken
+            c.e.b( 0x66 ) ;
+            c.e.b( 0x83 ) ;
+            c.e.rf( 7 , 2 * REG_CX ) ;
+            c.e.b( 0x00 ) ;
+            taken = c.e.jcc( JIT_CC_Z ) ;
+          }
+          else
+          {
+            // dec word [CX]
+            c.e.b( 0x66 ) ;
+            c.e.b( 0xFF ) ;
+            c.e.rf( 1 , 2 * REG_CX ) ;
+            if( op == 0xE2 )
+            {
+              taken = c.e.jcc( JIT_CC_NZ ) ;
+            }
+            else
+            {
+              // CX == 0 is not taken, then cmp byte [ZF], 0
+              not_taken = c.e.jcc( JIT_CC_Z ) ;
+              c.e.b( 0x80 ) ;
+              c.e.rf( 7 , FLAG_ZF ) ;
+              c.e.b( 0x00 ) ;
+              taken = c.e.jcc( ( op == 0xE1 ) ? ( JIT_CC_NZ ) : ( JIT_CC_Z ) ) ;
+            }
+          }
+
+          if( not_taken != NULL )
+          {
+            XTJitEmitter::link( not_taken , c.e.p ) ;
+          }
+          jit_exit_to( c , next_ip , cycles , i + 1 , true ) ;
+          XTJitEmitter::link( taken , c.e.p ) ;
+          jit_exit_to( c , next_ip + ( int8_t ) d.i_data0 , cycles + JIT_BRANCH_CYCLES , i + 1 , true ) ;
+        }
+        break ;
+
+      // JMP near | JMP short
+      case 0xE9 :
+        jit_exit_to( c , next_ip + d.i_data0 , cycles , i + 1 , true ) ;
+        break ;
+
+      case 0xEB :
+        jit_exit_to( c , next_ip + ( int8_t ) d.i_data0 , cycles , i + 1 , true ) ;
+        break ;
+
+      // CMC
+      case 0xF5 :
+        // xor byte [CF], 1
+        c.e.b( 0x80 ) ;
+        c.e.rf( 6 , FLAG_CF ) ;
+        c.e.b( 0x01 ) ;
+        break ;
+
+      // CLC|STC|CLD|STD
+      case 0xF8 :
+      case 0xF9 :
+      case 0xFC :
+      case 0xFD :
+        c.e.mov8_rf_imm( d.stOpcode.extra / 2 , d.stOpcode.extra & 0x01 ) ;
+        break ;
+
+      // INC|DEC r/m
+      case 0xFE :
+      case 0xFF :
+        c.e.load( w , JIT_EAX , rm ) ;
+        if( rm.kind == JIT_OPERAND_MEM )
+        {
+          jit_before_store( c ) ;
+        }
+        if( w )
+        {
+          c.e.b( 0x66 ) ;
+        }
+        c.e.b( op ) ;
+        c.e.b( ( d.i_reg ) ? ( 0xC8 ) : ( 0xC0 ) ) ;
+        c.e.store( w , JIT_EAX , rm ) ;
+        jit_flags( c , JIT_FLAGS_INC_DEC ) ;
+        rm_stored = true ;
+        break ;
+      }
+    }
+
+    if( rm_stored && ( rm.kind == JIT_OPERAND_MEM ) )
+    {
+      jit_store_check( c , w , next_ip , cycles , i + 1 ) ;
+    }
+
+    if( ( op & 0xE7 ) != 0x26 )
+    {
+      restart_ip     = next_ip ;
+      restart_cycles = cycles  ;
+      restart_instr  = i + 1   ;
+    }
+  }
+
+  // Fell off the end of the block
+  if( !jit_ends_block( instr[ n - 1 ].opcode ) )
+  {
+    jit_exit_to( c , instr[ n - 1 ].ip + instr[ n - 1 ].len , cycles , n , true ) ;
+  }
+
+  // Exits taken after a store into the block
+  for( i = 0 ; i < c.n_exits ; i++ )
+  {
+    XTJitEmitter::link( c.exits[ i ].site , c.e.p ) ;
+    jit_exit_to( c , c.exits[ i ].ip , c.exits[ i ].cycles , c.exits[ i ].instr , false ) ;
+  }
+
+  jit_code_free = c.e.p ;
+
+  return( entry ) ;
+}
+
+// Run translated code from CS:IP if there is a block for it, translating
+// it once it is hot. Returns the number of instructions executed.
+uint32_t CPU8086::jit_run( uint32_t max_instructions )
+{
+  stJitBlock_t * block  ;
+  uint32_t       lin    ;
+  uint32_t       key    ;
+  uint32_t       count  ;
+  int32_t        budget ;
+  int            stale  ;
+
+  if( ( jit_code == NULL ) || seg_override_en || rep_override_en || trap_flag || regs8[ FLAG_TF ] ||
+      ( Interface.IntRequest() && regs8[ FLAG_IF ] ) )
+  {
+    return( 0 ) ;
+  }
+
+#if JIT_DIFF
+  if( jit_suspended )
+  {
+    return( 0 ) ;
+  }
+#endif
+
+#if TRACE
+  // A traced instruction has to go through retire_instruction()
+  if( trace_ring != NULL )
+  {
+    return( 0 ) ;
+  }
+#endif
+
+  lin   = 16 * regs16[ REG_CS ] + reg_ip ;
+  key   = ( regs16[ REG_CS ] << 16 ) | reg_ip ;
+  block = &jit_blocks[ lin & JIT_BLOCK_MASK ] ;
+
+  if( block->key != key )
+  {
+    block->key   = key  ;
+    block->count = 0    ;
+    block->code  = NULL ;
+  }
+
+  if( block->code == NULL )
+  {
+    uint8_t * code ;
+
+    if( ( block->count == JIT_UNTRANSLATABLE ) || ( ++block->count < JIT_HOT_THRESHOLD ) )
+    {
+      return( 0 ) ;
+    }
+
+    // Translating may flush the cache, and this entry with it
+    code = jit_translate( regs16[ REG_CS ] , reg_ip ) ;
+    block->key   = key  ;
+    block->code  = code ;
+    block->count = ( code != NULL ) ? ( 0 ) : ( JIT_UNTRANSLATABLE ) ;
+    if( code == NULL )
+    {
+      return( 0 ) ;
+    }
+  }
+
+  // Translated code works on the materialised flags
+  FLAGS_SYNC( LAZY_ALL ) ;
+
+  if( max_instructions > 0x7FFFFFFF )
+  {
+    max_instructions = 0x7FFFFFFF ;
+  }
+  budget            = ( int32_t ) ( cycles_deadline - 1 - cycles_pending ) ;
+  jit_budget_cycles = budget ;
+  jit_budget_instr  = ( int32_t ) max_instructions ;
+
+#if JIT_DIFF
+  regfile_t before    = regfile ;
+  uint16_t  ip_before = reg_ip  ;
+
+  jit_store_count = 0 ;
+#endif
+
+  stale = ( ( jit_entry_t ) jit_code )( regs8 , mem , block->code ) ;
+  count = max_instructions - jit_budget_instr ;
+
+  if( count )
+  {
+#if JIT_DIFF
+    // The interpreter runs the block again and does the bookkeeping
+    jit_diff( before , ip_before , count ) ;
+#else
+    regs16[ REG_IP ]  = reg_ip ;
+    cycles_pending   += budget - jit_budget_cycles ;
+    instr_since_int8 += count ;
+#endif
+  }
+
+  if( stale )
+  {
+    jit_flush() ;
+  }
+  else if( jit_link_site != NULL )
+  {
+    // Chain the exit that was taken to the block at its target, if any
+    lin   = 16 * regs16[ REG_CS ] + reg_ip ;
+    key   = ( regs16[ REG_CS ] << 16 ) | reg_ip ;
+    block = &jit_blocks[ lin & JIT_BLOCK_MASK ] ;
+    if( ( block->key == key ) && ( block->code != NULL ) )
+    {
+      XTJitEmitter::link( jit_link_site , block->code ) ;
+    }
+    jit_link_site = NULL ;
+  }
+
+  return( count ) ;
+}
+
+#if JIT_DIFF
+// Undo the block just run by translated code, run the same instructions
+// through the interpreter and report any difference. The interpreter's
+// results are kept.
+void CPU8086::jit_diff( const regfile_t & before , uint16_t ip_before , uint32_t count )
+{
+  static const char * reg_names[ REG_DS + 1 ] = { "AX" , "CX" , "DX" , "BX" , "SP" , "BP" , "SI" , "DI" , "ES" , "CS" , "SS" , "DS" } ;
+  static const char * flag_names[ 9 ] = { "CF" , "PF" , "AF" , "ZF" , "SF" , "TF" , "IF" , "DF" , "OF" } ;
 
-    i_reg4bit = stOpcode.raw_opcode_id & 0x07 ;
-    i_w       = ( i_reg4bit & 0x01 ) == 0x01 ;
-    i_d       = ( i_reg4bit & 0x02 ) == 0x02 ;
+  regfile_t after    = regfile ;
+  uint16_t  ip_after = reg_ip  ;
+  uint16_t  written[ JIT_BLOCK_INSTR ] ;
+  uint32_t  i ;
 
-    // Extract instruction data fields
-    i_data0 = *( int16_t * )&opcode_stream[ 1 ] ;
-    i_data1 = *( int16_t * )&opcode_stream[ 2 ] ;
-    i_data2 = *( int16_t * )&opcode_stream[ 3 ] ;
+  for( i = 0 ; i < jit_store_count ; i++ )
+  {
+    written[ i ] = *( uint16_t * )&mem[ jit_store_log[ i ].addr ] ;
+  }
 
-    // seg_override_en and rep_override_en contain number of instructions to hold segment override and REP prefix respectively
-    if( seg_override_en )
-    {
-      seg_override_en-- ;
-    }
+  for( i = jit_store_count ; i-- > 0 ; )
+  {
+    *( uint16_t * )&mem[ jit_store_log[ i ].addr ] = ( uint16_t ) jit_store_log[ i ].old ;
+  }
 
-    if( rep_override_en )
-    {
-      rep_override_en-- ;
-    }
+  regfile = before    ;
+  reg_ip  = ip_before ;
 
-    // i_mod_size > 0 indicates that opcode uses i_mod/i_rm/i_reg, so decode them
-    if( stOpcode.i_mod_size )
-    {
+  jit_suspended = true ;
+  Run( count ) ;
+  jit_suspended = false ;
 
-    /**********
-     *
-     *      7     6     5     4     3     2     1     0
-     *   +-----+-----+-----+-----+-----+-----+-----+-----+
-     *   |           |                 |                 |
-     *   +-----+-----+-----+-----+-----+-----+-----+-----+
-     *    \____ ____/ \_______ _______/ \_______ _______/
-     *         |              |                 |
-     *         |              |                 +---------> i_rm
-     *         |              +---------------------------> i_reg
-     *         +------------------------------------------> i_mod
-     *
-     **********/
-    i_mod = ( i_data0 >> 6 ) & 0x03 ; // ##......
-    i_reg = ( i_data0 >> 3 ) & 0x07 ; // ..###...
-    i_rm  =   i_data0        & 0x07 ; // .....###
+  FLAGS_SYNC( LAZY_ALL ) ;
 
-    if( ( !i_mod && i_rm == 6 ) || ( i_mod == 2 ) )
+  for( i = 0 ; i <= REG_DS ; i++ )
+  {
+    if( regs16[ i ] != after.w[ i ] )
     {
-      i_data2 = *( int16_t * )&opcode_stream[ 4 ] ;
+      fprintf( stderr , "JIT %04X:%04X +%u: %s is %04X, translated %04X\n" ,
+               before.w[ REG_CS ] , ip_before , count , reg_names[ i ] , regs16[ i ] , after.w[ i ] ) ;
     }
-    else if( i_mod != 1 )
+  }
+
+  for( i = 0 ; i < 9 ; i++ )
+  {
+    if( regs8[ FLAG_CF + i ] != after.b[ FLAG_CF + i ] )
     {
-      i_data2 = i_data1 ;
+      fprintf( stderr , "JIT %04X:%04X +%u: %s is %u, translated %u\n" ,
+               before.w[ REG_CS ] , ip_before , count , flag_names[ i ] , regs8[ FLAG_CF + i ] , after.b[ FLAG_CF + i ] ) ;
     }
-    else // If i_mod is 1, operand is (usually) 8 bits rather than 16 bits
+  }
+
+  if( reg_ip != ip_after )
+  {
+    fprintf( stderr , "JIT %04X:%04X +%u: IP is %04X, translated %04X\n" ,
+             before.w[ REG_CS ] , ip_before , count , reg_ip , ip_after ) ;
+  }
+
+  for( i = 0 ; i < jit_store_count ; i++ )
+  {
+    if( *( uint16_t * )&mem[ jit_store_log[ i ].addr ] != written[ i ] )
     {
-      i_data1 = ( int8_t ) i_data1 ;
+      fprintf( stderr , "JIT %04X:%04X +%u: [%05X] is %04X, translated %04X\n" ,
+               before.w[ REG_CS ] , ip_before , count , jit_store_log[ i ].addr ,
+               *( uint16_t * )&mem[ jit_store_log[ i ].addr ] , written[ i ] ) ;
     }
+  }
+}
+#endif
 
-    scratch2_uint = 4 * !i_mod ;
-    if( i_mod < 3 )
-    {
-      uint16_t localIndex ;
-      uint16_t localAddr  ;
+#endif // JIT
 
-      if( seg_override_en )
-      {
-        localIndex = seg_override ;
-      }
-      else
-      {
-        localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
-      }
+#if THREADED_DISPATCH
+// Label addresses and computed goto are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
 
-      localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-      localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-      localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
-      rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
-    }
-    else
-    {
-      rm_addr = ( REGS_BASE + ( ( i_w ) ? ( 2 * i_rm ) : ( 2 * i_rm + i_rm / 4 ) & 7 ) ) ;
-    }
+uint32_t CPU8086::Run( uint32_t n_instructions )
+{
+  uint32_t executed ;
 
-    op_to_addr   = rm_addr ;
-    op_from_addr = ( REGS_BASE + ( ( i_w ) ? ( 2 * i_reg ) : ( 2 * i_reg + i_reg / 4 ) & 7 ) ) ;
-    if( i_d )
+#if THREADED_DISPATCH
+  // Handler address for every xlat_opcode_id. Filled in on each call rather
+  // than once into a static, which machines running on other threads would
+  // race on; 256 stores are nothing next to a RUN_SLICE of instructions.
+  const void * dispatch_table[ 256 ] ;
+
+  for( int i = 0 ; i < 256 ; i++ )
+  {
+    dispatch_table[ i ] = &&opcode_default ;
+  }
+
+  dispatch_table[ 0x00 ] = &&opcode_0x00 ;
+  dispatch_table[ 0x01 ] = &&opcode_0x01 ;
+  dispatch_table[ 0x02 ] = &&opcode_0x02 ;
+  dispatch_table[ 0x03 ] = &&opcode_0x03 ;
+  dispatch_table[ 0x04 ] = &&opcode_0x04 ;
+  dispatch_table[ 0x05 ] = &&opcode_0x05 ;
+  dispatch_table[ 0x06 ] = &&opcode_0x06 ;
+  dispatch_table[ 0x07 ] = &&opcode_0x07 ;
+  dispatch_table[ 0x08 ] = &&opcode_0x08 ;
+  dispatch_table[ 0x09 ] = &&opcode_0x09 ;
+  dispatch_table[ 0x0A ] = &&opcode_0x0A ;
+  dispatch_table[ 0x0B ] = &&opcode_0x0B ;
+  dispatch_table[ 0x0C ] = &&opcode_0x0C ;
+  dispatch_table[ 0x0D ] = &&opcode_0x0D ;
+  dispatch_table[ 0x0E ] = &&opcode_0x0E ;
+  dispatch_table[ 0x0F ] = &&opcode_0x0F ;
+  dispatch_table[ 0x10 ] = &&opcode_0x10 ;
+  dispatch_table[ 0x11 ] = &&opcode_0x11 ;
+  dispatch_table[ 0x12 ] = &&opcode_0x12 ;
+  dispatch_table[ 0x13 ] = &&opcode_0x13 ;
+  dispatch_table[ 0x14 ] = &&opcode_0x14 ;
+  dispatch_table[ 0x15 ] = &&opcode_0x15 ;
+  dispatch_table[ 0x16 ] = &&opcode_0x16 ;
+  dispatch_table[ 0x17 ] = &&opcode_0x17 ;
+  dispatch_table[ 0x18 ] = &&opcode_0x18 ;
+  dispatch_table[ 0x19 ] = &&opcode_0x19 ;
+  dispatch_table[ 0x1A ] = &&opcode_0x1A ;
+  dispatch_table[ 0x1B ] = &&opcode_0x1B ;
+  dispatch_table[ 0x1C ] = &&opcode_0x1C ;
+  dispatch_table[ 0x1D ] = &&opcode_0x1D ;
+  dispatch_table[ 0x1E ] = &&opcode_0x1E ;
+  dispatch_table[ 0x1F ] = &&opcode_0x1F ;
+  dispatch_table[ 0x20 ] = &&opcode_0x20 ;
+  dispatch_table[ 0x21 ] = &&opcode_0x21 ;
+  dispatch_table[ 0x22 ] = &&opcode_0x22 ;
+  dispatch_table[ 0x23 ] = &&opcode_0x23 ;
+  dispatch_table[ 0x24 ] = &&opcode_0x24 ;
+  dispatch_table[ 0x25 ] = &&opcode_0x25 ;
+  dispatch_table[ 0x26 ] = &&opcode_0x26 ;
+  dispatch_table[ 0x27 ] = &&opcode_0x27 ;
+  dispatch_table[ 0x28 ] = &&opcode_0x28 ;
+  dispatch_table[ 0x29 ] = &&opcode_0x29 ;
+  dispatch_table[ 0x2A ] = &&opcode_0x2A ;
+  dispatch_table[ 0x2B ] = &&opcode_0x2B ;
+  dispatch_table[ 0x2C ] = &&opcode_0x2C ;
+  dispatch_table[ 0x2D ] = &&opcode_0x2D ;
+  dispatch_table[ 0x2E ] = &&opcode_0x2E ;
+  dispatch_table[ 0x2F ] = &&opcode_0x2F ;
+  dispatch_table[ 0x30 ] = &&opcode_0x30 ;
+  dispatch_table[ 0x31 ] = &&opcode_0x31 ;
+  dispatch_table[ 0x32 ] = &&opcode_0x32 ;
+  dispatch_table[ 0x33 ] = &&opcode_0x33 ;
+  dispatch_table[ 0x34 ] = &&opcode_0x34 ;
+  dispatch_table[ 0x35 ] = &&opcode_0x35 ;
+  dispatch_table[ 0x37 ] = &&opcode_0x37 ;
+  dispatch_table[ 0x38 ] = &&opcode_0x38 ;
+  dispatch_table[ 0x39 ] = &&opcode_0x39 ;
+  dispatch_table[ 0x3A ] = &&opcode_0x3A ;
+  dispatch_table[ 0x3B ] = &&opcode_0x3B ;
+  dispatch_table[ 0x3C ] = &&opcode_0x3C ;
+  dispatch_table[ 0x3D ] = &&opcode_0x3D ;
+  dispatch_table[ 0x3E ] = &&opcode_0x3E ;
+  dispatch_table[ 0x3F ] = &&opcode_0x3F ;
+  dispatch_table[ 0x40 ] = &&opcode_0x40 ;
+  dispatch_table[ 0x41 ] = &&opcode_0x41 ;
+  dispatch_table[ 0x42 ] = &&opcode_0x42 ;
+  dispatch_table[ 0x43 ] = &&opcode_0x43 ;
+  dispatch_table[ 0x44 ] = &&opcode_0x44 ;
+  dispatch_table[ 0x45 ] = &&opcode_0x45 ;
+  dispatch_table[ 0x46 ] = &&opcode_0x46 ;
+  dispatch_table[ 0x47 ] = &&opcode_0x47 ;
+  dispatch_table[ 0x48 ] = &&opcode_0x48 ;
+  dispatch_table[ 0x63 ] = &&opcode_0x63 ;
+#endif
+
+  // Take a rewind checkpoint once one is due
+  if( ( rewind_ram != NULL ) && ( cycles_elapsed >= rewind_next ) )
+  {
+    rewind_checkpoint() ;
+  }
+
+  halt_passes = 0 ;
+
+  // Instruction execution loop.
+  for( executed = 0 ; ( executed < n_instructions ) && ( !exit_emulation ) ; executed++ )
+  {
+#if JIT
+    // Run translated code from here if there is any, see jit_run()
+    executed += jit_run( n_instructions - executed ) ;
+    if( executed >= n_instructions )
     {
-      scratch_uint = op_from_addr ;
-      op_from_addr = rm_addr      ;
-      op_to_addr   = scratch_uint ;
+      break ;
     }
-  }
+#endif
+
+    fetch_instruction() ;
 
   // Instruction execution unit.
+  DISPATCH_OPCODE ;
   switch( stOpcode.xlat_opcode_id )
   {
   // Conditional jump (JAE, JNAE, etc.)
-  case 0x00 :
+  OPCODE( 0x00 ) :
     // i_w is the invert flag, e.g. i_w == 1 means JNAE, whereas i_w == 0 means JAE
     scratch_uchar  = stOpcode.raw_opcode_id ;
     scratch_uchar >>= 1 ;
     scratch_uchar  &= 7 ;
 
-    reg_ip += (int8_t)i_data0 * ( i_w ^ ( regs8[ bios_table_lookup[ TABLE_COND_JUMP_DECODE_A ][ scratch_uchar ] ] ||
-                                          regs8[ bios_table_lookup[ TABLE_COND_JUMP_DECODE_B ][ scratch_uchar ] ] ||
-                                          regs8[ bios_table_lookup[ TABLE_COND_JUMP_DECODE_C ][ scratch_uchar ] ] ^
-                                          regs8[ bios_table_lookup[ TABLE_COND_JUMP_DECODE_D ][ scratch_uchar ] ] ) ) ;
-    break ;
-
-  // MOV reg, imm
-  case 0x01 :
-    i_w = ( stOpcode.raw_opcode_id & 8 ) ? ( XTRUE ) : ( XFALSE ) ;
-    if( i_w )
-    {
-      *( uint16_t * )&op_dest   = *( uint16_t * )&mem[ REGS_BASE + ( 2 * i_reg4bit ) ] ;
-      *( uint16_t * )&op_source = *( uint16_t * )&i_data0 ;
-      *( uint16_t * )&op_result = *( uint16_t * )&i_data0 ;
-      *( uint16_t * )&mem[ REGS_BASE + ( 2 * i_reg4bit ) ] = *( uint16_t * )&i_data0 ;
-    }
-    else
-    {
-      *( uint8_t * )&op_dest   = *( uint8_t * )&mem[ REGS_BASE + ( ( 2 * i_reg4bit + i_reg4bit / 4 ) & 0x07 ) ] ;
-      *( uint8_t * )&op_source = *( uint8_t * )&i_data0 ;
-      *( uint8_t * )&op_result = *( uint8_t * )&i_data0 ;
-      *( uint8_t * )&mem[ REGS_BASE + ( ( 2 * i_reg4bit + i_reg4bit / 4 ) & 0x07 ) ] = *( uint8_t * )&i_data0 ;
-    }
-    break ;
+    FLAGS_SYNC( jcc_flags_used[ scratch_uchar ] ) ;
+
+    scratch_uint = i_w ^ ( regs8[ xt_jcc_table[ 0 ][ scratch_uchar ] ] ||
+                           regs8[ xt_jcc_table[ 1 ][ scratch_uchar ] ] ||
+                           regs8[ xt_jcc_table[ 2 ][ scratch_uchar ] ] ^
+                           regs8[ xt_jcc_table[ 3 ][ scratch_uchar ] ] ) ;
+
+    reg_ip += (int8_t)i_data0 * scratch_uint ;
+    CYCLES_ADD( 12 * scratch_uint ) ;
+    NEXT_OPCODE ;
+
+  // MOV reg8, imm8
+  OPCODE( 0x01 ) :
+    i_w = XFALSE ;
+    *( uint8_t * )&op_dest   = regs8[ ( 2 * i_reg4bit + i_reg4bit / 4 ) & 0x07 ] ;
+    *( uint8_t * )&op_source = *( uint8_t * )&i_data0 ;
+    *( uint8_t * )&op_result = *( uint8_t * )&i_data0 ;
+    regs8[ ( 2 * i_reg4bit + i_reg4bit / 4 ) & 0x07 ] = *( uint8_t * )&i_data0 ;
+    NEXT_OPCODE ;
+
+  // MOV reg16, imm16
+  OPCODE( 0x44 ) :
+    i_w = XTRUE ;
+    *( uint16_t * )&op_dest   = regs16[ i_reg4bit ] ;
+    *( uint16_t * )&op_source = *( uint16_t * )&i_data0 ;
+    *( uint16_t * )&op_result = *( uint16_t * )&i_data0 ;
+    regs16[ i_reg4bit ] = *( uint16_t * )&i_data0 ;
+    NEXT_OPCODE ;
 
   // PUSH regs16.
-  case 0x03 :
+  OPCODE( 0x03 ) :
     i_w = 1 ;
     op_dest   = *( uint16_t * ) &mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
     op_source = *( uint16_t * ) &regs16[ i_reg4bit ] ;
     op_result = op_source ;
     *( uint16_t * ) &mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-    break ;
+    STACK_DIRTY() ;
+    NEXT_OPCODE ;
 
   // POP regs16.
-  case 0x04 :
+  OPCODE( 0x04 ) :
     i_w = 1 ;
     regs16[ REG_SP ] += 2 ;
     op_dest   = *( uint16_t * ) &regs16[ i_reg4bit ] ;
     op_source = *( uint16_t * ) &( mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( - 2 + regs16[ REG_SP ] ) ] ) ;
     op_result = op_source ;
     *( uint16_t * ) &regs16[ i_reg4bit ] = op_source ;
-    break ;
+    NEXT_OPCODE ;
 
   // INC|DEC regs16
-  case 0x02 :
+  OPCODE( 0x02 ) :
     i_w   = 1 ;
     i_d   = 0 ;
     i_reg = i_reg4bit ;
 
-    scratch2_uint = 4 * !i_mod ;
     if( i_mod < 3 )
     {
       uint16_t localIndex ;
@@ -599,12 +4612,12 @@ int main(int argc, char **argv)
       }
       else
       {
-        localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
+        localIndex = xt_modrm_table[ !i_mod ][ i_rm ].ea_seg ;
       }
 
-      localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-      localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-      localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
+      localAddr  = ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg1 ] ;
+      localAddr += ( uint16_t ) xt_modrm_table[ !i_mod ][ i_rm ].disp_mult * i_data1 ;
+      localAddr += ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg2 ] ;
       rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
     }
     else
@@ -621,9 +4634,10 @@ int main(int argc, char **argv)
     }
 
     i_reg = stOpcode.extra ;
+    // Fall through
 
   // INC|DEC|JMP|CALL|PUSH
-  case 0x05 :
+  OPCODE( 0x05 ) :
     // INC|DEC
     if( i_reg < 2 )
     {
@@ -635,19 +4649,19 @@ int main(int argc, char **argv)
 
       if( i_w )
       {
-        op_dest = *( uint16_t * )&mem[ op_from_addr ] ;
-        op_source = *( uint16_t * )&mem[ addr ] ;
+        op_dest = *( uint16_t * )operand_ptr( op_from_addr ) ;
+        op_source = *( uint16_t * )operand_ptr( addr ) ;
 
-        *( uint16_t * )&mem[ op_from_addr ] += 1 - 2 * i_reg + op_source ;
-        op_result = *( uint16_t * )&mem[ op_from_addr ] ;
+        *( uint16_t * )operand_ptr( op_from_addr ) += 1 - 2 * i_reg + op_source ;
+        op_result = *( uint16_t * )operand_ptr( op_from_addr ) ;
       }
       else
       {
-        op_dest = mem[ op_from_addr ] ;
+        op_dest = *operand_ptr( op_from_addr ) ;
 
-        op_source = *( uint8_t * )&mem[ addr ] ;
-        mem[ op_from_addr ] += 1 - 2 * i_reg + op_source ;
-        op_result = mem[ op_from_addr ] ;
+        op_source = *( uint8_t * )operand_ptr( addr ) ;
+        *operand_ptr( op_from_addr ) += 1 - 2 * i_reg + op_source ;
+        op_result = *operand_ptr( op_from_addr ) ;
       }
 
       op_source = 1 ;
@@ -678,6 +4692,7 @@ int main(int argc, char **argv)
         op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
         op_source = *( uint16_t * )&regs16[ REG_CS ] ;
         op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+        STACK_DIRTY() ;
       }
 
       // CALL (near or far)
@@ -688,19 +4703,20 @@ int main(int argc, char **argv)
         op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
         op_source = *( uint16_t * )&reg_ip + 2 + i_mod * ( i_mod != 3 ) + 2 * ( !i_mod && i_rm == 6 ) ;
         op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+        STACK_DIRTY() ;
       }
 
       // JMP|CALL (far)
       if( i_reg & 0x01 )
       {
-        regs16[ REG_CS ] = *( int16_t * )&mem[ op_from_addr + 2 ] ;
+        regs16[ REG_CS ] = *( int16_t * )operand_ptr( op_from_addr + 2 ) ;
       }
 
       if( i_w )
       {
         op_dest = *( uint16_t * )&reg_ip ;
 
-        op_source = *(uint16_t*)&mem[ op_from_addr ] ;
+        op_source = *( uint16_t * )operand_ptr( op_from_addr ) ;
         op_result = op_source ;
         *(uint16_t*)&reg_ip = op_source ;
       }
@@ -708,7 +4724,7 @@ int main(int argc, char **argv)
       {
         op_dest = reg_ip ;
 
-        op_source = *(uint8_t*)&mem[ op_from_addr ] ;
+        op_source = *( uint8_t * )operand_ptr( op_from_addr ) ;
         op_result = op_source ;
         reg_ip = op_source ;
       }
@@ -718,16 +4734,17 @@ int main(int argc, char **argv)
     }
     else // PUSH
     {
-      // PUSH mem[ rm_addr ].
+      // PUSH *operand_ptr( rm_addr ).
       i_w = 1 ;
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
-      op_source = *( uint16_t * )&mem[ rm_addr ] ;
+      op_source = *( uint16_t * )operand_ptr( rm_addr ) ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
     }
-    break ;
+    NEXT_OPCODE ;
 
   // TEST r/m, imm16 / NOT|NEG|MUL|IMUL|DIV|IDIV reg
-  case 0x06 :
+  OPCODE( 0x06 ) :
     op_to_addr = op_from_addr ;
 
     switch( i_reg )
@@ -741,15 +4758,15 @@ int main(int argc, char **argv)
       // Execute arithmetic/logic operations.
       if( i_w )
       {
-        op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
+        op_dest   = *( uint16_t * )operand_ptr( op_to_addr ) ;
         op_source = *( uint16_t * )&i_data2  ;
-        op_result = *( uint16_t * )&mem[ op_to_addr ] & op_source ;
+        op_result = *( uint16_t * )operand_ptr( op_to_addr ) & op_source ;
       }
       else
       {
-        op_dest   = mem[ op_to_addr ] ;
+        op_dest   = *operand_ptr( op_to_addr ) ;
         op_source = *( uint8_t * )&i_data2 ;
-        op_result = mem[ op_to_addr ] & op_source ;
+        op_result = *operand_ptr( op_to_addr ) & op_source ;
       }
       break ;
 
@@ -758,15 +4775,15 @@ int main(int argc, char **argv)
       // Execute arithmetic/logic operations.
       if( i_w )
       {
-        op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-        op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-        op_result = *( uint16_t * )&mem[ op_to_addr ] =~ op_source ;
+        op_dest   = *( uint16_t * )operand_ptr( op_to_addr ) ;
+        op_source = *( uint16_t * )operand_ptr( op_from_addr )  ;
+        op_result = *( uint16_t * )operand_ptr( op_to_addr ) =~ op_source ;
       }
       else
       {
-        op_dest   = mem[ op_to_addr ] ;
-        op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-        op_result = mem[ op_to_addr ] =~ op_source ;
+        op_dest   = *operand_ptr( op_to_addr ) ;
+        op_source = *( uint8_t * )operand_ptr( op_from_addr ) ;
+        op_result = *operand_ptr( op_to_addr ) =~ op_source ;
       }
       break ;
 
@@ -775,13 +4792,13 @@ int main(int argc, char **argv)
       // Execute arithmetic/logic operations.
       if( i_w )
       {
-        op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-        op_result = *( uint16_t * )&mem[ op_to_addr ] =- op_source ;
+        op_source = *( uint16_t * )operand_ptr( op_from_addr )  ;
+        op_result = *( uint16_t * )operand_ptr( op_to_addr ) =- op_source ;
       }
       else
       {
-        op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-        op_result = mem[ op_to_addr ] =- op_source ;
+        op_source = *( uint8_t * )operand_ptr( op_from_addr ) ;
+        op_result = *operand_ptr( op_to_addr ) =- op_source ;
       }
 
       op_dest = 0 ;
@@ -800,7 +4817,7 @@ int main(int argc, char **argv)
         set_opcode( 0x10 ) ;
 
         op_result  = ( uint16_t ) regs16[ 0 ] ;
-        op_result *= *( uint16_t * )&mem[ rm_addr ] ;
+        op_result *= *( uint16_t * )operand_ptr( rm_addr ) ;
 
         regs16[ i_w + 1 ] = op_result >> 16 ;
         regs16[ REG_AX  ] = op_result ;
@@ -815,7 +4832,7 @@ int main(int argc, char **argv)
         set_opcode( 0x10 ) ;
 
         op_result  = ( uint8_t ) regs8[ 0 ] ;
-        op_result *= *( uint8_t * )&mem[ rm_addr ] ;
+        op_result *= *( uint8_t * )operand_ptr( rm_addr ) ;
 
         regs8[ i_w + 1 ] = op_result >> 16 ;
         regs16[ REG_AX ] = op_result ;
@@ -834,7 +4851,7 @@ int main(int argc, char **argv)
         set_opcode( 0x10 ) ;
 
         op_result  = ( int16_t ) regs16[ 0 ] ;
-        op_result *= *( int16_t * ) &mem[ rm_addr ] ;
+        op_result *= *( int16_t * )operand_ptr( rm_addr ) ;
 
         regs16[ i_w + 1 ] = op_result >> 16 ;
         regs16[ REG_AX  ] = op_result ;
@@ -849,7 +4866,7 @@ int main(int argc, char **argv)
         set_opcode( 0x10 ) ;
 
         op_result  = ( int8_t ) regs8[ 0 ] ;
-        op_result *= *( int8_t * ) &mem[ rm_addr ] ;
+        op_result *= *( int8_t * )operand_ptr( rm_addr ) ;
 
         regs8[ i_w + 1 ] = op_result >> 16 ;
         regs16[ REG_AX ] = op_result ;
@@ -863,7 +4880,7 @@ int main(int argc, char **argv)
     case 0x06 :
       if( i_w )
       {
-        scratch_int = *( uint16_t * ) &mem[ rm_addr ] ;
+        scratch_int = *( uint16_t * )operand_ptr( rm_addr ) ;
         if( scratch_int )
         {
           scratch_uint  = ( regs16[ 2 ] << 16 ) + regs16[ REG_AX ] ;
@@ -881,7 +4898,7 @@ int main(int argc, char **argv)
       }
       else
       {
-        scratch_int = *( uint8_t * ) &mem[ rm_addr ] ;
+        scratch_int = *( uint8_t * )operand_ptr( rm_addr ) ;
         if( scratch_int )
         {
           scratch_uint  = ( regs8[ 1 ] << 16 ) + regs16[ REG_AX ] ;
@@ -903,7 +4920,7 @@ int main(int argc, char **argv)
     case 0x07 :
       if( i_w )
       {
-        scratch_int   = *( int16_t * ) &mem[ rm_addr ] ;
+        scratch_int   = *( int16_t * )operand_ptr( rm_addr ) ;
         if( scratch_int )
         {
           scratch_uint  = ( regs16[ 2 ] << 16 ) + regs16[ REG_AX ] ;
@@ -921,7 +4938,7 @@ int main(int argc, char **argv)
       }
       else
       {
-        scratch_int = *( int8_t * ) &mem[ rm_addr ] ;
+        scratch_int = *( int8_t * )operand_ptr( rm_addr ) ;
         if( scratch_int )
         {
           scratch_uint  = ( regs8[ 1 ] << 16 ) + regs16[ REG_AX ] ;
@@ -939,334 +4956,128 @@ int main(int argc, char **argv)
       }
       break ;
     }
-    break ;
+    NEXT_OPCODE ;
 
-  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP AL/AX, immed
-  case 0x07 :
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP AL, immed
+  OPCODE( 0x07 ) :
     rm_addr = REGS_BASE ;
     i_data2 = i_data0   ;
     i_mod   = 3         ;
     i_reg   = stOpcode.extra ;
     reg_ip-- ;
+    // Fall through
 
-  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP reg, immed
-  case 0x08 :
-    op_to_addr = rm_addr ;
-    i_d |= !i_w ;
-    if( i_d )
-    {
-      regs16[ REG_SCRATCH ] = ( int8_t ) i_data2 ;
-    }
-    else
-    {
-      regs16[ REG_SCRATCH ] = i_data2 ;
-    }
-
-    op_from_addr = REGS_BASE + 2 * REG_SCRATCH ;
-    reg_ip += ( !i_d + 1 ) ;
-    stOpcode.extra = i_reg ;
-    set_opcode( 0x08 * i_reg ) ;
-
-  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP|MOV reg, r/m
-  case 0x09 :
-    switch( stOpcode.extra )
-    {
-      // ADD
-      case 0x00 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] += op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] += op_source ;
-        }
-
-        set_CF( op_result < op_dest ) ;
-        break ;
-
-      // OR
-      case 0x01 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] |= op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] |= op_source ;
-        }
-        break ;
-
-      // ADC
-      case 0x02 :
-        ADC_SBB_MACRO( + ) ;
-        break ;
-
-      // SBB
-      case 0x03 :
-        ADC_SBB_MACRO( - ) ;
-        break ;
-
-      // AND
-      case 0x04 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] &= op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] &= op_source ;
-        }
-        break ;
-
-      // SUB
-      case 0x05 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] -= op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] -= op_source ;
-        }
-
-        set_CF( op_result > op_dest ) ;
-        break ;
-
-      // XOR
-      case 0x06 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] ^= op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] ^= op_source ;
-        }
-        break ;
-
-      // CMP
-      case 0x07 :
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] - op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] - op_source ;
-        }
-
-        set_CF( op_result > op_dest ) ;
-        break ;
-
-      // MOV
-      case 0x08 :
-        if( i_w )
-        {
-          uint16_t aux ;
-
-          op_dest = *( uint16_t * )&mem[ op_to_addr ] ;
-
-          aux = *( uint16_t * )&mem[ op_from_addr ] ;
-          op_source = aux ;
-          op_result = aux ;
-          *( uint16_t * )&mem[ op_to_addr ] = aux ;
-        }
-        else
-        {
-          uint8_t aux ;
-
-          op_dest = mem[ op_to_addr ] ;
-
-          aux = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_source = aux ;
-          op_result = aux ;
-          mem[ op_to_addr ] = aux ;
-        }
-        break ;
-      }
-      break ;
-
-    // MOV sreg, r/m | POP r/m | LEA reg, r/m
-    case 0x0A :
-      // MOV
-      if( !i_w )
-      {
-        i_w = 1,
-        i_reg += 8,
-
-        scratch2_uint = 4 * !i_mod ;
-        if( i_mod < 3 )
-        {
-          uint16_t localIndex ;
-          uint16_t localAddr  ;
-
-          if( seg_override_en )
-          {
-            localIndex = seg_override ;
-          }
-          else
-          {
-            localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
-          }
-
-          localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-          localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-          localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
-          rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
-        }
-        else
-        {
-          rm_addr = ( REGS_BASE + ( ( i_w ) ? ( 2 * i_rm ) : ( 2 * i_rm + i_rm / 4 ) & 7 ) ) ;
-        }
-        op_to_addr = rm_addr ;
-        op_from_addr = (REGS_BASE + ( ( i_w ) ? ( 2 * i_reg ) : ( 2 * i_reg + i_reg / 4 ) & 7 ) ) ;
-        if( i_d )
-        {
-          scratch_uint = op_from_addr ;
-          op_from_addr = rm_addr      ;
-          op_to_addr   = scratch_uint ;
-        }
-
-        // Execute arithmetic/logic operations.
-        if( i_w )
-        {
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP r/m8, immed
+  OPCODE( 0x08 ) :
+    alu_immediate< true >() ;
+    alu_reg_rm< uint8_t >() ;
+    NEXT_OPCODE ;
 
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = op_source ;
-          *( uint16_t * )&mem[ op_to_addr ] = op_source ;
-        }
-        else
-        {
-          op_dest   = mem[ op_to_addr ] ;
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP AX, immed
+  OPCODE( 0x43 ) :
+    rm_addr = REGS_BASE ;
+    i_data2 = i_data0   ;
+    i_mod   = 3         ;
+    i_reg   = stOpcode.extra ;
+    reg_ip-- ;
+    // Fall through
+
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP r/m16, immed16
+  OPCODE( 0x41 ) :
+    alu_immediate< false >() ;
+    alu_reg_rm< uint16_t >() ;
+    NEXT_OPCODE ;
+
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP r/m16, sign extended immed8
+  OPCODE( 0x42 ) :
+    alu_immediate< true >() ;
+    alu_reg_rm< uint16_t >() ;
+    NEXT_OPCODE ;
+
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP|MOV reg8, r/m8
+  OPCODE( 0x09 ) :
+    alu_reg_rm< uint8_t >() ;
+    NEXT_OPCODE ;
+
+  // ADD|OR|ADC|SBB|AND|SUB|XOR|CMP|MOV reg16, r/m16
+  OPCODE( 0x40 ) :
+    alu_reg_rm< uint16_t >() ;
+    NEXT_OPCODE ;
+
+    // MOV r/m, sreg
+    OPCODE( 0x0A ) :
+      mov_sreg< false >() ;
+      NEXT_OPCODE ;
+
+    // MOV sreg, r/m
+    OPCODE( 0x3E ) :
+      mov_sreg< true >() ;
+      NEXT_OPCODE ;
+
+    // LEA reg, r/m
+    OPCODE( 0x3D ) :
+      seg_override_en = 1 ;
+      seg_override = REG_ZERO ;
 
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = op_source ;
-          mem[ op_to_addr ] = op_source ;
-        }
-      }
-      else if( !i_d ) // LEA
+      if( i_mod < 3 )
       {
-        seg_override_en = 1 ;
-        seg_override = REG_ZERO ;
-
-        scratch2_uint = 4 * !i_mod ;
-        if( i_mod < 3 )
-        {
-          uint16_t localIndex ;
-          uint16_t localAddr  ;
-
-          if( seg_override_en )
-          {
-            localIndex = seg_override ;
-          }
-          else
-          {
-            localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
-          }
-
-          localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-          localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-          localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
-          rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
-        }
-        else
-        {
-          rm_addr = ( REGS_BASE + ( ( i_w ) ? ( 2 * i_rm ) : ( 2 * i_rm + i_rm / 4 ) & 7 ) ) ;
-        }
-        op_to_addr = rm_addr ;
-        op_from_addr = ( REGS_BASE + ( ( i_w ) ? ( 2 * i_reg ) : ( 2 * i_reg + i_reg / 4 ) & 7 ) ) ;
-        if( i_d )
-        {
-          scratch_uint = op_from_addr ;
-          op_from_addr = rm_addr      ;
-          op_to_addr   = scratch_uint ;
-        }
-
-        // MOV
-        if( i_w )
-        {
-          uint16_t aux ;
-
-          op_dest = *( uint16_t * )&mem[ op_from_addr ] ;
-
-          aux = *( uint16_t * )&rm_addr ;
+        uint16_t localIndex ;
+        uint16_t localAddr  ;
 
-          op_source = aux ;
-          op_result = aux ;
-          *( uint16_t * )&mem[ op_from_addr ] = aux ;
+        if( seg_override_en )
+        {
+          localIndex = seg_override ;
         }
         else
         {
-          uint8_t aux ;
+          localIndex = xt_modrm_table[ !i_mod ][ i_rm ].ea_seg ;
+        }
 
-          op_dest = mem[ op_from_addr ] ;
+        localAddr  = ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg1 ] ;
+        localAddr += ( uint16_t ) xt_modrm_table[ !i_mod ][ i_rm ].disp_mult * i_data1 ;
+        localAddr += ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg2 ] ;
+        rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
+      }
+      else
+      {
+        rm_addr = REGS_BASE + 2 * i_rm ;
+      }
+      op_to_addr   = rm_addr ;
+      op_from_addr = REGS_BASE + 2 * i_reg ;
 
-          aux = *( uint8_t * )&rm_addr ;
+      op_dest   = *( uint16_t * )operand_ptr( op_from_addr ) ;
+      op_source = *( uint16_t * )&rm_addr ;
+      op_result = op_source ;
+      *( uint16_t * )operand_ptr( op_from_addr ) = op_source ;
+      NEXT_OPCODE ;
 
-          op_source = aux ;
-          op_result = aux ;
-          mem[ op_from_addr ] = aux ;
-        }
-      }
-      else // POP
+    // POP r/m
+    OPCODE( 0x3F ) :
       {
         uint32_t addr ;
 
         i_w = 1 ;
         regs16[ REG_SP ] += 2 ;
 
-        op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+        op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
 
         addr  = 16 ;
         addr *= regs16[ REG_SS ] ;
         addr += ( uint16_t ) ( regs16[ REG_SP ] - 2 ) ;
 
-        op_source = *( uint16_t * )&mem[ addr ]  ;
+        op_source = *( uint16_t * )operand_ptr( addr )  ;
         op_result = op_source ;
-        *( uint16_t * )&mem[ rm_addr ] = op_source ;
+        *( uint16_t * )operand_ptr( rm_addr ) = op_source ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // MOV AL/AX, [loc]
-    case 0x0B :
+    OPCODE( 0x0B ) :
       i_mod = 0 ;
       i_reg = 0 ;
       i_rm  = 6 ;
       i_data1 = i_data0 ;
 
-      scratch2_uint = 4 * !i_mod ;
       if( i_mod < 3 )
       {
         uint16_t localIndex ;
@@ -1278,13 +5089,21 @@ int main(int argc, char **argv)
         }
         else
         {
-          localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
+          localIndex = xt_modrm_table[ !i_mod ][ i_rm ].ea_seg ;
         }
 
-        localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-        localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-        localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
+        localAddr  = ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg1 ] ;
+        localAddr += ( uint16_t ) xt_modrm_table[ !i_mod ][ i_rm ].disp_mult * i_data1 ;
+        localAddr += ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg2 ] ;
         rm_addr = ( 16 * regs16[ localIndex ] ) + localAddr ;
+        if( MEM_PAGE_TYPE( rm_addr , i_w ) != MEM_PAGE_RAM )
+        {
+          rm_addr = mem_operand( rm_addr , ( i_d ) ? ( XT_MEM_WRITE ) : ( XT_MEM_READ ) ) ;
+        }
+        else if( i_d )
+        {
+          MEM_DIRTY( rm_addr ) ;
+        }
       }
       else
       {
@@ -1304,38 +5123,38 @@ int main(int argc, char **argv)
       {
         uint16_t aux ;
 
-        op_dest = *( uint16_t * )&mem[ op_from_addr ] ;
+        op_dest = *( uint16_t * )operand_ptr( op_from_addr ) ;
 
-        aux = *( uint16_t * )&mem[ op_to_addr ] ;
+        aux = *( uint16_t * )operand_ptr( op_to_addr ) ;
         op_source = aux ;
         op_result = aux ;
-        *( uint16_t * )&mem[ op_from_addr ] = aux ;
+        *( uint16_t * )operand_ptr( op_from_addr ) = aux ;
       }
       else
       {
         uint8_t aux ;
 
-        op_dest = mem[ op_from_addr ] ;
+        op_dest = *operand_ptr( op_from_addr ) ;
 
-        aux = *( uint8_t * )&mem[ op_to_addr ] ;
+        aux = *( uint8_t * )operand_ptr( op_to_addr ) ;
         op_source = aux ;
         op_result = aux ;
-        mem[ op_from_addr ] = aux ;
+        *operand_ptr( op_from_addr ) = aux ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // ROL|ROR|RCL|RCR|SHL|SHR|???|SAR reg/mem, 1/CL/imm (80186)
-    case 0x0C :
+    OPCODE( 0x0C ) :
 
       // Returns sign bit of an 8-bit or 16-bit operand.
       if( i_w )
       {
-        scratch2_uint = *( int16_t * )&( mem[ rm_addr ] ) ;
+        scratch2_uint = *( int16_t * )operand_ptr( rm_addr ) ;
         scratch2_uint >>= 15 ;
       }
       else
       {
-        scratch2_uint = ( mem[ rm_addr ] ) ;
+        scratch2_uint = ( *operand_ptr( rm_addr ) ) ;
         scratch2_uint >>= 7 ;
       }
       scratch2_uint &= 1 ;
@@ -1344,11 +5163,13 @@ int main(int argc, char **argv)
       {
         // xxx reg/mem, imm
         scratch_uint = ( int8_t ) i_data1 ;
+        CYCLES_ADD( scratch_uint & 0xFF ) ;
       }
       else if( i_d )
       {
         // xxx reg/mem, CL
         scratch_uint = 0x1F & regs8[ REG_CL ] ;
+        CYCLES_ADD( 4 * regs8[ REG_CL ] ) ;
       }
       else
       {
@@ -1366,13 +5187,13 @@ int main(int argc, char **argv)
           if( i_w )
           {
             op_dest   = *( uint16_t * )&scratch2_uint ;
-            op_source = *( uint16_t * )&mem[ rm_addr ]  ;
+            op_source = *( uint16_t * )operand_ptr( rm_addr )  ;
             op_result = *( uint16_t * )&scratch2_uint = op_source ;
           }
           else
           {
             op_dest   = scratch2_uint ;
-            op_source = *( uint8_t * )&mem[ rm_addr ] ;
+            op_source = *( uint8_t * )operand_ptr( rm_addr ) ;
             op_result = scratch2_uint = op_source ;
           }
         }
@@ -1382,15 +5203,15 @@ int main(int argc, char **argv)
           // Execute arithmetic/logic operations.
           if( i_w )
           {
-            op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+            op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
             op_source = *( uint16_t * )&scratch_uint  ;
-            op_result = *( uint16_t * )&mem[ rm_addr ] >>= op_source ;
+            op_result = *( uint16_t * )operand_ptr( rm_addr ) >>= op_source ;
           }
           else
           {
-            op_dest   = mem[ rm_addr ] ;
+            op_dest   = *operand_ptr( rm_addr ) ;
             op_source = *( uint8_t * )&scratch_uint ;
-            op_result = mem[ rm_addr ] >>= op_source ;
+            op_result = *operand_ptr( rm_addr ) >>= op_source ;
           }
         }
         else // Rotate/shift left operations
@@ -1398,15 +5219,15 @@ int main(int argc, char **argv)
           // Execute arithmetic/logic operations.
           if( i_w )
           {
-            op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+            op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
             op_source = *( uint16_t * )&scratch_uint  ;
-            op_result = *( uint16_t * )&mem[ rm_addr ] <<= op_source ;
+            op_result = *( uint16_t * )operand_ptr( rm_addr ) <<= op_source ;
           }
           else
           {
-            op_dest   = mem[ rm_addr ] ;
+            op_dest   = *operand_ptr( rm_addr ) ;
             op_source = *( uint8_t * )&scratch_uint ;
-            op_result = mem[ rm_addr ] <<= op_source ;
+            op_result = *operand_ptr( rm_addr ) <<= op_source ;
           }
         }
 
@@ -1431,18 +5252,18 @@ int main(int argc, char **argv)
         // Execute arithmetic/logic operations.
         if( i_w )
         {
-          op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
           op_source = *( uint16_t * )&scratch2_uint >> ( 16 - scratch_uint )  ;
-          op_result = *( uint16_t * )&mem[ rm_addr ] += op_source ;
+          op_result = *( uint16_t * )operand_ptr( rm_addr ) += op_source ;
 
           // Returns sign bit of an 8-bit or 16-bit operand
           set_OF( ( 1 & ( *( int16_t * )&( op_result ) ) >> 15 ) ^ set_CF( op_result & 1 ) ) ;
         }
         else
         {
-          op_dest   = mem[ rm_addr ] ;
+          op_dest   = *operand_ptr( rm_addr ) ;
           op_source = *( uint8_t * )&scratch2_uint >> ( 8 - scratch_uint ) ;
-          op_result = mem[ rm_addr ] += op_source ;
+          op_result = *operand_ptr( rm_addr ) += op_source ;
 
           // Returns sign bit of an 8-bit or 16-bit operand
           set_OF( ( 1 & op_result >> 7 ) ^ set_CF( op_result & 1 ) ) ;
@@ -1456,18 +5277,18 @@ int main(int argc, char **argv)
         if( i_w )
         {
           // Execute arithmetic/logic operations.
-          op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
           op_source = *( uint16_t * )&scratch2_uint << ( 16 - scratch_uint )  ;
-          op_result = *( uint16_t * )&mem[ rm_addr ] += op_source ;
+          op_result = *( uint16_t * )operand_ptr( rm_addr ) += op_source ;
 
           set_OF( ( 1 & ( *( int16_t * )&op_result * 2 ) >> 15 ) ^ set_CF( 1 & ( *( int16_t * )&( op_result ) ) >> 15 ) ) ;
         }
         else
         {
           // Execute arithmetic/logic operations.
-          op_dest   = mem[ rm_addr ] ;
+          op_dest   = *operand_ptr( rm_addr ) ;
           op_source = *( uint8_t * )&scratch2_uint << ( 8 - scratch_uint ) ;
-          op_result = mem[ rm_addr ] += op_source ;
+          op_result = *operand_ptr( rm_addr ) += op_source ;
 
           set_OF( ( 1 & ( op_result * 2 ) >> 7 ) ^ set_CF( 1 & ( op_result ) >> 7 ) ) ;
         }
@@ -1478,17 +5299,17 @@ int main(int argc, char **argv)
         // Execute arithmetic/logic operations.
         if( i_w )
         {
-          op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
           op_source = *( uint16_t * )&scratch2_uint >> ( 17 - scratch_uint )  ;
-          op_result = *( uint16_t * )&mem[ rm_addr ] += ( regs8[ FLAG_CF ] << ( scratch_uint - 1 ) ) + op_source ;
+          op_result = *( uint16_t * )operand_ptr( rm_addr ) += ( regs8[ FLAG_CF ] << ( scratch_uint - 1 ) ) + op_source ;
 
           set_OF( ( 1 & *( int16_t * )&( op_result ) >> 15 ) ^ set_CF( scratch2_uint & 1 << ( 16 - scratch_uint ) ) ) ;
         }
         else
         {
-          op_dest   = mem[ rm_addr ] ;
+          op_dest   = *operand_ptr( rm_addr ) ;
           op_source = *( uint8_t * )&scratch2_uint >> ( 9 - scratch_uint ) ;
-          op_result = mem[ rm_addr ] += ( regs8[ FLAG_CF ] << ( scratch_uint - 1 ) ) + op_source ;
+          op_result = *operand_ptr( rm_addr ) += ( regs8[ FLAG_CF ] << ( scratch_uint - 1 ) ) + op_source ;
 
           set_OF( ( ( 1 & op_result ) >> 7 ) ^ set_CF( scratch2_uint & 1 << ( 8 - scratch_uint ) ) ) ;
         }
@@ -1499,9 +5320,9 @@ int main(int argc, char **argv)
         if( i_w )
         {
           // Execute arithmetic/logic operations.
-          op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
           op_source = *( uint16_t * )&scratch2_uint << ( 17 - scratch_uint )  ;
-          op_result = *( uint16_t * )&mem[ rm_addr ] += ( regs8[ FLAG_CF ] << ( 16 - scratch_uint ) ) + op_source ;
+          op_result = *( uint16_t * )operand_ptr( rm_addr ) += ( regs8[ FLAG_CF ] << ( 16 - scratch_uint ) ) + op_source ;
 
           set_CF( scratch2_uint & 1 << ( scratch_uint - 1 ) ) ;
           set_OF( ( 1 & *( int16_t * )&( op_result ) >> 15 ) ^ ( 1 & *( int16_t * )&op_result * 2 >> 15 ) ) ;
@@ -1509,9 +5330,9 @@ int main(int argc, char **argv)
         else
         {
           // Execute arithmetic/logic operations.
-          op_dest   = mem[ rm_addr ] ;
+          op_dest   = *operand_ptr( rm_addr ) ;
           op_source = *( uint8_t * )&scratch2_uint << ( 9 - scratch_uint ) ;
-          op_result = mem[ rm_addr ] += ( regs8[ FLAG_CF ] << ( 8 - scratch_uint ) ) + op_source ;
+          op_result = *operand_ptr( rm_addr ) += ( regs8[ FLAG_CF ] << ( 8 - scratch_uint ) ) + op_source ;
 
           set_CF( scratch2_uint & 1 << ( scratch_uint - 1 ) ) ;
           set_OF( ( 1 & op_result >> 7 ) ^ ( 1 & ( op_result * 2 ) >> 7 ) ) ;
@@ -1553,24 +5374,25 @@ int main(int argc, char **argv)
         // Execute arithmetic/logic operations.
         if( i_w )
         {
-          op_dest   = *( uint16_t * )&mem[ rm_addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( rm_addr ) ;
           op_source = *( uint16_t * )&scratch2_uint *= ~( ( ( 1 << 16 ) - 1 ) >> scratch_uint )  ;
-          op_result = *( uint16_t * )&mem[ rm_addr ] += op_source ;
+          op_result = *( uint16_t * )operand_ptr( rm_addr ) += op_source ;
         }
         else
         {
-          op_dest   = mem[ rm_addr ] ;
+          op_dest   = *operand_ptr( rm_addr ) ;
           op_source = *( uint8_t * )&scratch2_uint *= ~( ( ( 1 << 8 ) - 1 ) >> scratch_uint ) ;
-          op_result = mem[ rm_addr ] += op_source ;
+          op_result = *operand_ptr( rm_addr ) += op_source ;
         }
         break ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // LOOPxx|JCZX
-    case 0x0D :
+    OPCODE( 0x0D ) :
       regs16[ REG_CX ]-- ;
       scratch_uint = ( regs16[ REG_CX ] ) ? ( XTRUE ) : ( XFALSE ) ;
+      FLAGS_SYNC( LAZY_ZF ) ;
 
       switch( i_reg4bit )
       {
@@ -1591,10 +5413,11 @@ int main(int argc, char **argv)
       }
 
       reg_ip += scratch_uint * ( ( int8_t ) i_data0 ) ;
-      break ;
+      CYCLES_ADD( 12 * scratch_uint ) ;
+      NEXT_OPCODE ;
 
     // JMP | CALL short/near
-    case 0x0E :
+    OPCODE( 0x0E ) :
       reg_ip += 3 - i_d ;
       if( !i_w )
       {
@@ -1602,6 +5425,12 @@ int main(int argc, char **argv)
         {
           reg_ip = 0 ;
           regs16[ REG_CS ] = i_data2 ;
+
+          // To 0000:0000 it ends the emulation, as in 8086tiny
+          if( ( !i_data0 ) && ( !i_data2 ) && ( Interface.GuestQuit() ) )
+          {
+            exit_emulation = true ;
+          }
         }
         else // CALL
         {
@@ -1610,72 +5439,88 @@ int main(int argc, char **argv)
           op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
           op_source = *( uint16_t * )&reg_ip ;
           op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+          STACK_DIRTY() ;
         }
       }
 
       reg_ip += ( i_d && i_w ) ? ( ( int8_t ) i_data0 ) : ( i_data0 ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // TEST reg, r/m
-    case 0x0F :
+    OPCODE( 0x0F ) :
       // Execute arithmetic/logic operations.
       if( i_w )
       {
-        op_dest   = *( uint16_t * )&mem[ op_from_addr ] ;
-        op_source = *( uint16_t * )&mem[ op_to_addr ]  ;
-        op_result = *( uint16_t * )&mem[ op_from_addr ] & op_source ;
+        op_dest   = *( uint16_t * )operand_ptr( op_from_addr ) ;
+        op_source = *( uint16_t * )operand_ptr( op_to_addr )  ;
+        op_result = *( uint16_t * )operand_ptr( op_from_addr ) & op_source ;
       }
       else
       {
-        op_dest   = mem[ op_from_addr ] ;
-        op_source = *( uint8_t * )&mem[ op_to_addr ] ;
-        op_result = mem[ op_from_addr ] & op_source ;
+        op_dest   = *operand_ptr( op_from_addr ) ;
+        op_source = *( uint8_t * )operand_ptr( op_to_addr ) ;
+        op_result = *operand_ptr( op_from_addr ) & op_source ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // XCHG AX, regs16
-    case 0x10 :
+    OPCODE( 0x10 ) :
       i_w = 1 ;
       op_to_addr = REGS_BASE ;
       op_from_addr = ( REGS_BASE + ( 2 * i_reg4bit ) ) ;
+      // Fall through
 
     // NOP|XCHG reg, r/m
-    case 0x18 :
+    OPCODE( 0x18 ) :
       if( op_to_addr != op_from_addr )
       {
         // Execute arithmetic/logic operations.
         if( i_w )
         {
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] ^= op_source ;
+          op_source = *( uint16_t * )operand_ptr( op_from_addr )  ;
+          op_result = *( uint16_t * )operand_ptr( op_to_addr ) ^= op_source ;
 
-          op_source = *( uint16_t * )&mem[ op_to_addr   ]  ;
-          op_result = *( uint16_t * )&mem[ op_from_addr ] ^= op_source ;
+          op_source = *( uint16_t * )operand_ptr( op_to_addr )  ;
+          op_result = *( uint16_t * )operand_ptr( op_from_addr ) ^= op_source ;
 
-          op_dest   = *( uint16_t * )&mem[ op_to_addr ] ;
-          op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
-          op_result = *( uint16_t * )&mem[ op_to_addr ] ^= op_source ;
+          op_dest   = *( uint16_t * )operand_ptr( op_to_addr ) ;
+          op_source = *( uint16_t * )operand_ptr( op_from_addr )  ;
+          op_result = *( uint16_t * )operand_ptr( op_to_addr ) ^= op_source ;
         }
         else
         {
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] ^= op_source ;
+          op_source = *( uint8_t * )operand_ptr( op_from_addr ) ;
+          op_result = *operand_ptr( op_to_addr ) ^= op_source ;
 
-          op_dest   = mem[ op_from_addr ] ;
-          op_source = *( uint8_t * )&mem[ op_to_addr   ] ;
-          op_result = mem[ op_from_addr ] ^= op_source ;
+          op_dest   = *operand_ptr( op_from_addr ) ;
+          op_source = *( uint8_t * )operand_ptr( op_to_addr ) ;
+          op_result = *operand_ptr( op_from_addr ) ^= op_source ;
 
-          op_source = *( uint8_t * )&mem[ op_from_addr ] ;
-          op_result = mem[ op_to_addr ] ^= op_source ;
+          op_source = *( uint8_t * )operand_ptr( op_from_addr ) ;
+          op_result = *operand_ptr( op_to_addr ) ^= op_source ;
         }
       }
-      break ;
+      NEXT_OPCODE ;
 
     // MOVSx (extra=0)|STOSx (extra=1)|LODSx (extra=2)
-    case 0x11 :
+    OPCODE( 0x11 ) :
       scratch2_uint = ( seg_override_en ) ? ( seg_override     ) : ( REG_DS ) ;
       scratch_uint  = ( rep_override_en ) ? ( regs16[ REG_CX ] ) : ( 1      ) ;
 
+#if CYCLE_TIMING
+      // REP: the clocks of each repetition, the prefix counted the rest
+      if( rep_override_en )
+      {
+        instr_cycles = scratch_uint * xt_rep_cycles[ stOpcode.raw_opcode_id - 0xA4 ] ;
+      }
+#endif
+
+      // REP: all but the last element as a block, if possible
+      if( scratch_uint > 1 )
+      {
+        scratch_uint -= rep_movs_block( scratch2_uint , scratch_uint - 1 ) ;
+      }
+
       while( scratch_uint )
       {
         uint32_t addrDst ;
@@ -1691,27 +5536,58 @@ int main(int argc, char **argv)
         addrDst += ( uint16_t ) regs16[ REG_DI ] ;
 
         // MOV
-        if( i_w )
+        if( ( ( ( stOpcode.extra & 1 ) ? ( MEM_PAGE_RAM ) : ( MEM_PAGE_TYPE( addrSrc , i_w ) ) ) |
+              ( ( stOpcode.extra < 2 ) ? ( MEM_PAGE_TYPE( addrDst , i_w ) ) : ( MEM_PAGE_RAM ) ) ) != MEM_PAGE_RAM )
+        {
+          // ROM or video memory, through the memory map
+          op_dest   = ( stOpcode.extra < 2 ) ? ( *( uint16_t * )&mem[ addrDst ] ) : ( regs16[ REG_AX ] ) ;
+          op_source = ( stOpcode.extra & 1 ) ? ( regs16[ REG_AX ] ) : ( mem_read( i_w , addrSrc ) ) ;
+          if( !i_w )
+          {
+            op_dest   &= 0xFF ;
+            op_source &= 0xFF ;
+          }
+          op_result = op_source ;
+
+          if( stOpcode.extra < 2 )
+          {
+            mem_write( i_w , addrDst , op_source ) ;
+          }
+          else if( i_w )
+          {
+            regs16[ REG_AX ] = op_source ;
+          }
+          else
+          {
+            regs8[ REG_AL ] = op_source ;
+          }
+        }
+        else if( i_w )
         {
           uint16_t aux ;
 
-          op_dest = *( uint16_t * )&( mem[ ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ] ) ;
+          op_dest = *( uint16_t * )operand_ptr( ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ) ;
 
-          aux = *( uint16_t * )&( mem[ ( stOpcode.extra & 1 ) ? REGS_BASE : addrSrc ] ) ;
+          aux = *( uint16_t * )operand_ptr( ( stOpcode.extra & 1 ) ? REGS_BASE : addrSrc ) ;
           op_source = aux ;
           op_result = aux ;
-          *( uint16_t * )&( mem[ ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ] ) = aux ;
+          *( uint16_t * )operand_ptr( ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ) = aux ;
         }
         else
         {
           uint8_t aux ;
 
-          op_dest = ( mem[ ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ] ) ;
+          op_dest = ( *operand_ptr( ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ) ) ;
 
-          aux = *( uint8_t * )&( mem[ ( stOpcode.extra & 1 ) ? REGS_BASE : addrSrc ] ) ;
+          aux = *( uint8_t * )operand_ptr( ( stOpcode.extra & 1 ) ? REGS_BASE : addrSrc ) ;
           op_source = aux ;
           op_result = aux ;
-          mem[ ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ] = aux ;
+          *operand_ptr( ( stOpcode.extra < 2 ) ? addrDst : REGS_BASE ) = aux ;
+        }
+
+        if( stOpcode.extra < 2 )
+        {
+          MEM_DIRTY( addrDst ) ;
         }
 
         if( ( stOpcode.extra & 0x01 ) == 0x00 )
@@ -1731,14 +5607,30 @@ int main(int argc, char **argv)
       {
         regs16[ REG_CX ] = 0 ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // CMPSx (extra=0)|SCASx (extra=1)
-    case 0x12 :
+    OPCODE( 0x12 ) :
       scratch2_uint = ( seg_override_en ) ? ( seg_override     ) : ( REG_DS ) ;
       scratch_uint  = ( rep_override_en ) ? ( regs16[ REG_CX ] ) : ( 1      ) ;
+
+#if CYCLE_TIMING
+      // REPZ/REPNZ: the clocks of each repetition, the ones that do not run
+      // are taken off below
+      if( rep_override_en )
+      {
+        instr_cycles = scratch_uint * xt_rep_cycles[ stOpcode.raw_opcode_id - 0xA4 ] ;
+      }
+#endif
+
       if( scratch_uint )
       {
+        // REPZ/REPNZ: the elements that do not end it as a block, if possible
+        if( scratch_uint > 1 )
+        {
+          rep_cmps_block( scratch2_uint , scratch_uint - 1 ) ;
+        }
+
         while( scratch_uint )
         {
           uint32_t addrSrc ;
@@ -1754,17 +5646,24 @@ int main(int argc, char **argv)
           addrDst += ( uint16_t ) regs16[ REG_SI ] ;
 
           // Execute arithmetic/logic operations.
-          if( i_w )
+          if( ( MEM_PAGE_TYPE( addrSrc , i_w ) | ( ( stOpcode.extra ) ? ( MEM_PAGE_RAM ) : ( MEM_PAGE_TYPE( addrDst , i_w ) ) ) ) != MEM_PAGE_RAM )
+          {
+            // ROM or video memory, through the memory map
+            op_dest   = ( stOpcode.extra ) ? ( ( i_w ) ? ( regs16[ REG_AX ] ) : ( regs8[ REG_AL ] ) ) : ( mem_read( i_w , addrDst ) ) ;
+            op_source = mem_read( i_w , addrSrc ) ;
+            op_result = op_dest - op_source ;
+          }
+          else if( i_w )
           {
-            op_dest   = *( uint16_t * )&mem[ stOpcode.extra ? REGS_BASE : addrDst ] ;
+            op_dest   = *( uint16_t * )operand_ptr( stOpcode.extra ? REGS_BASE : addrDst ) ;
             op_source = *( uint16_t * )&mem[ addrSrc ]  ;
-            op_result = *( uint16_t * )&mem[ stOpcode.extra ? REGS_BASE : addrDst ] - op_source ;
+            op_result = *( uint16_t * )operand_ptr( stOpcode.extra ? REGS_BASE : addrDst ) - op_source ;
           }
           else
           {
-            op_dest   = mem[ stOpcode.extra ? REGS_BASE : addrDst ] ;
+            op_dest   = *operand_ptr( stOpcode.extra ? REGS_BASE : addrDst ) ;
             op_source = *( uint8_t * )&mem[ addrSrc ] ;
-            op_result = mem[ stOpcode.extra ? REGS_BASE : addrDst ] - op_source ;
+            op_result = *operand_ptr( stOpcode.extra ? REGS_BASE : addrDst ) - op_source ;
           }
 
           if( !stOpcode.extra )
@@ -1792,11 +5691,18 @@ int main(int argc, char **argv)
         // Funge to set SZP/AO flags.
         stOpcode.set_flags_type = ( FLAGS_UPDATE_SZP | FLAGS_UPDATE_AO_ARITH ) ;
         set_CF( op_result > op_dest ) ;
+
+#if CYCLE_TIMING
+        if( rep_override_en )
+        {
+          instr_cycles -= regs16[ REG_CX ] * xt_rep_cycles[ stOpcode.raw_opcode_id - 0xA4 ] ;
+        }
+#endif
       }
-      break ;
+      NEXT_OPCODE ;
 
     // RET|RETF|IRET
-    case 0x13 :
+    OPCODE( 0x13 ) :
       {
         uint32_t addr ;
 
@@ -1812,14 +5718,14 @@ int main(int argc, char **argv)
         if( i_w )
         {
           op_dest   = *( uint16_t * )&reg_ip ;
-          op_source = *( uint16_t * )&mem[ addr ]  ;
+          op_source = *( uint16_t * )operand_ptr( addr )  ;
           op_result = op_source ;
           *( uint16_t * )&reg_ip = op_source ;
         }
         else
         {
           op_dest   = reg_ip ;
-          op_source = *( uint8_t * )&mem[ addr ] ;
+          op_source = *( uint8_t * )operand_ptr( addr ) ;
           op_result = op_source ;
           reg_ip = op_source ;
         }
@@ -1852,7 +5758,7 @@ int main(int argc, char **argv)
         addr *= regs16[ REG_SS ] ;
         addr += ( uint16_t ) ( regs16[ REG_SP ] - 2 ) ;
 
-        op_source = *( uint16_t * )&mem[ addr ] ;
+        op_source = *( uint16_t * )operand_ptr( addr ) ;
         op_result = *( uint16_t * )&scratch_uint = op_source ;
         set_flags( op_result ) ;
       }
@@ -1860,41 +5766,43 @@ int main(int argc, char **argv)
       {
         regs16[ REG_SP ] += i_data0 ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // MOV r/m, immed
-    case 0x14 :
+    OPCODE( 0x14 ) :
       regs16[ REG_TMP ] = i_data2 ;
 
       // MOV
       if( i_w )
       {
         uint16_t aux ;
-        op_dest = *( uint16_t * )&mem[ op_from_addr ] ;
+        op_dest = *( uint16_t * )operand_ptr( op_from_addr ) ;
 
-        aux = *( uint16_t * )&mem[ REGS_BASE + REG_TMP * 2 ] ;
+        aux = regs16[ REG_TMP ] ;
 
         op_source = aux ;
         op_result = aux ;
-        *( uint16_t * )&mem[ op_from_addr ] = aux ;
+        *( uint16_t * )operand_ptr( op_from_addr ) = aux ;
       }
       else
       {
         uint8_t aux ;
 
-        op_dest = mem[ op_from_addr ] ;
+        op_dest = *operand_ptr( op_from_addr ) ;
 
-        aux = *( uint8_t * )&mem[ REGS_BASE + REG_TMP * 2 ] ;
+        aux = regs8[ REG_TMP * 2 ] ;
 
         op_source = aux ;
         op_result = aux ;
-        mem[ op_from_addr ] = aux ;
+        *operand_ptr( op_from_addr ) = aux ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // IN AL/AX, DX/imm8
-    case 0x15 :
+    OPCODE( 0x15 ) :
       scratch_uint = ( stOpcode.extra ) ? ( regs16[ REG_DX ] ) : ( ( uint8_t ) i_data0 ) ;
+      sync_devices() ;
+      cycles_deadline = 0 ;
       io_ports[ scratch_uint ] = Interface.ReadPort( scratch_uint ) ;
 
       if( i_w )
@@ -1915,11 +5823,13 @@ int main(int argc, char **argv)
         op_result = op_source ;
         regs8[ REG_AL ] = op_source ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // OUT DX/imm8, AL/AX
-    case 0x16 :
+    OPCODE( 0x16 ) :
       scratch_uint = ( stOpcode.extra ) ? ( regs16[ REG_DX ] ) : ( ( uint8_t ) i_data0 ) ;
+      sync_devices() ;
+      cycles_deadline = 0 ;
 
       // Execute arithmetic/logic operations.
       if( i_w )
@@ -1943,10 +5853,10 @@ int main(int argc, char **argv)
 
         Interface.WritePort( scratch_uint , io_ports[ scratch_uint ] ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // REPxx
-    case 0x17 :
+    OPCODE( 0x17 ) :
       rep_override_en = 2   ;
       rep_mode        = i_w ;
 
@@ -1954,19 +5864,20 @@ int main(int argc, char **argv)
       {
         seg_override_en++ ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // PUSH reg
-    case 0x19 :
+    OPCODE( 0x19 ) :
       // PUSH regs16[ stOpcode.extra ].
       i_w = 1 ;
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ stOpcode.extra ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-      break ;
+      STACK_DIRTY() ;
+      NEXT_OPCODE ;
 
     // POP reg
-    case 0x1A :
+    OPCODE( 0x1A ) :
       i_w = 1 ;
       regs16[ REG_SP ] += 2 ;
 
@@ -1976,21 +5887,22 @@ int main(int argc, char **argv)
       op_source = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( regs16[ REG_SP ] - 2 ) ]  ;
       op_result = op_source ;
       *( uint16_t * )&regs16[ stOpcode.extra ] = op_source ;
-      break ;
+      NEXT_OPCODE ;
 
     // xS: segment overrides
-    case 0x1B :
+    OPCODE( 0x1B ) :
       seg_override_en = 2 ;
       seg_override = stOpcode.extra ;
       if( rep_override_en )
       {
         rep_override_en++ ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // DAA/DAS
-    case 0x1C :
+    OPCODE( 0x1C ) :
       i_w = 0 ;
+      FLAGS_SYNC( LAZY_AF ) ;
       if( stOpcode.extra )
       {
         // extra = 1 for DAS.
@@ -2001,15 +5913,15 @@ int main(int argc, char **argv)
         // extra = 0 for DAA.
         DAA_DAS( += , < ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // AAA/AAS
-    case 0x1D :
+    OPCODE( 0x1D ) :
       op_result = AAA_AAS( stOpcode.extra - 1 ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // CBW
-    case 0x1E :
+    OPCODE( 0x1E ) :
       if( i_w )
       {
         regs8[ REG_AH ] = -( 1 & *( int16_t * )&( regs8[ REG_AL ] ) >> 15 ) ;
@@ -2018,10 +5930,10 @@ int main(int argc, char **argv)
       {
         regs8[ REG_AH ] = -( 1 & regs8[ REG_AL ] >> 7 ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // CWD
-    case 0x1F :
+    OPCODE( 0x1F ) :
       if( i_w )
       {
         regs16[ REG_DX ] = -( 1 & *( int16_t * )&( regs16[ REG_AX ] ) >> 15 ) ;
@@ -2030,28 +5942,30 @@ int main(int argc, char **argv)
       {
         regs16[ REG_DX ] = -( 1 & regs16[ REG_AX ] >> 7 ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // CALL FAR imm16:imm16
-    case 0x20 :
+    OPCODE( 0x20 ) :
       i_w = 1 ;
 
       // PUSH regs16[ REG_CS ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_CS ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH reg_ip + 5.
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&reg_ip + 5 ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       regs16[ REG_CS ] = i_data2 ;
       reg_ip = i_data0 ;
-      break ;
+      NEXT_OPCODE ;
 
     // PUSHF
-    case 0x21 :
+    OPCODE( 0x21 ) :
       make_flags() ;
 
       // PUSH scratch_uint.
@@ -2059,10 +5973,11 @@ int main(int argc, char **argv)
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&scratch_uint ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-      break ;
+      STACK_DIRTY() ;
+      NEXT_OPCODE ;
 
     // POPF
-    case 0x22 :
+    OPCODE( 0x22 ) :
       i_w = 1 ;
       regs16[ REG_SP ] += 2 ;
       op_dest = *( uint16_t * )&scratch_uint ;
@@ -2080,26 +5995,25 @@ int main(int argc, char **argv)
       op_result = op_source ;
       *( uint16_t * )&scratch_uint = op_source ;
       set_flags( op_source ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // SAHF
-    case 0x23 :
+    OPCODE( 0x23 ) :
       make_flags() ;
       set_flags( (scratch_uint & 0xFF00 ) + regs8[ REG_AH ] ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // LAHF
-    case 0x24 :
+    OPCODE( 0x24 ) :
       make_flags() ;
       regs8[ REG_AH ] = scratch_uint ;
-      break ;
+      NEXT_OPCODE ;
 
     // LES|LDS reg, r/m
-    case 0x25 :
+    OPCODE( 0x25 ) :
       i_w = 1 ;
       i_d = 1 ;
 
-      scratch2_uint = 4 * !i_mod ;
       if( i_mod < 3 )
       {
         uint16_t localIndex ;
@@ -2111,12 +6025,12 @@ int main(int argc, char **argv)
         }
         else
         {
-          localIndex = bios_table_lookup[ scratch2_uint + 3 ][ i_rm ] ;
+          localIndex = xt_modrm_table[ !i_mod ][ i_rm ].ea_seg ;
         }
 
-        localAddr  = ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint + 1 ][ i_rm ] ] ;
-        localAddr += ( uint16_t ) bios_table_lookup[ scratch2_uint + 2 ][ i_rm ] * i_data1 ;
-        localAddr += ( uint16_t ) regs16[ bios_table_lookup[ scratch2_uint ][ i_rm ] ] ;
+        localAddr  = ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg1 ] ;
+        localAddr += ( uint16_t ) xt_modrm_table[ !i_mod ][ i_rm ].disp_mult * i_data1 ;
+        localAddr += ( uint16_t ) regs16[ xt_modrm_table[ !i_mod ][ i_rm ].ea_reg2 ] ;
 
         rm_addr  = 16 ;
         rm_addr *= regs16[ localIndex ] ;
@@ -2136,40 +6050,47 @@ int main(int argc, char **argv)
       }
 
       // Execute arithmetic/logic operations.
-      op_source = *( uint16_t * )&mem[ op_from_addr ]  ;
+      op_source = *( uint16_t * )operand_ptr( op_from_addr )  ;
       op_result = op_source ;
-      *( uint16_t * )&mem[ op_to_addr ] = op_source ;
+      *( uint16_t * )operand_ptr( op_to_addr ) = op_source ;
 
-      op_dest   = *( uint16_t * )&mem[ REGS_BASE + stOpcode.extra ] ;
+      op_dest   = *( uint16_t * )&regs8[ stOpcode.extra ] ;
 
-      op_source = *( uint16_t * )&mem[ rm_addr + 2 ]  ;
+      op_source = *( uint16_t * )operand_ptr( rm_addr + 2 )  ;
       op_result = op_source ;
-      *( uint16_t * )&mem[ REGS_BASE + stOpcode.extra ] = op_source ;
-      break ;
+      *( uint16_t * )&regs8[ stOpcode.extra ] = op_source ;
+      NEXT_OPCODE ;
 
     // INT 3
-    case 0x26 :
+    OPCODE( 0x26 ) :
       reg_ip++ ;
       pc_interrupt( 3 ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // INT imm8
-    case 0x27 :
+    OPCODE( 0x27 ) :
+#if IDLE_DETECT
+      if( idle_wait( ( uint8_t ) i_data0 ) )
+      {
+        NEXT_OPCODE ;
+      }
+#endif
       reg_ip += 2 ;
       pc_interrupt( ( uint8_t ) i_data0 ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // INTO
-    case 0x28 :
+    OPCODE( 0x28 ) :
       reg_ip++ ;
+      FLAGS_SYNC( LAZY_OF ) ;
       if( regs8[ FLAG_OF ] )
       {
         pc_interrupt( 4 ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // AAM
-    case 0x29 :
+    OPCODE( 0x29 ) :
       i_data0 &= 0xFF ;
       if( i_data0 )
       {
@@ -2181,37 +6102,37 @@ int main(int argc, char **argv)
       {
         pc_interrupt( 0 ) ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // AAD
-    case 0x2A :
+    OPCODE( 0x2A ) :
       i_w = 0 ;
       op_result = 0xFF & ( regs8[ REG_AL ] + i_data0 * regs8[ REG_AH ] ) ;
       regs16[ REG_AX ] = op_result ;
-      break ;
+      NEXT_OPCODE ;
 
     // SALC
-    case 0x2B :
+    OPCODE( 0x2B ) :
       regs8[ REG_AL ] = -regs8[ FLAG_CF ] ;
-      break ;
+      NEXT_OPCODE ;
 
     // XLAT
-    case 0x2C :
+    OPCODE( 0x2C ) :
       regs8[ REG_AL ] = mem[ 16 * regs16[seg_override_en ? seg_override : REG_DS] + (uint16_t)(regs8[ REG_AL ] + regs16[REG_BX]) ] ;
-      break ;
+      NEXT_OPCODE ;
 
     // CMC
-    case 0x2D :
+    OPCODE( 0x2D ) :
       regs8[ FLAG_CF ] ^= 1 ;
-      break ;
+      NEXT_OPCODE ;
 
     // CLC|STC|CLI|STI|CLD|STD
-    case 0x2E :
+    OPCODE( 0x2E ) :
       regs8[ stOpcode.extra / 2 ] = stOpcode.extra & 0x01 ;
-      break ;
+      NEXT_OPCODE ;
 
     // TEST AL/AX, immed
-    case 0x2F :
+    OPCODE( 0x2F ) :
       // Execute arithmetic/logic operations.
       if( i_w )
       {
@@ -2225,23 +6146,32 @@ int main(int argc, char **argv)
         op_source = *( uint8_t * )&i_data0 ;
         op_result = regs8[ REG_AL ] & op_source ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // LOCK
-    case 0x30 :
-      break ;
-
-    // HLT
-    case 0x31 :
-      break ;
+    OPCODE( 0x30 ) :
+      NEXT_OPCODE ;
+
+    // HLT - stay on it until an interrupt is taken
+    OPCODE( 0x31 ) :
+      reg_ip-- ;
+      // With interrupts disabled only a reset ends it
+      if( ( halt_state != HALT_HLT ) && ( !regs8[ FLAG_IF ] ) && ( Interface.GuestHalted() ) )
+      {
+        exit_emulation = true ;
+      }
+      halt_state = HALT_HLT ;
+      halt_passes++ ;
+      idle_skip() ;
+      NEXT_OPCODE ;
 
     // Emulator-specific 0F xx opcodes
-    case 0x32 :
+    OPCODE( 0x32 ) :
       switch( ( int8_t ) i_data0 )
       {
       // PUTCHAR_AL.
       case 0x00 :
-        putchar( regs8[ 0 ] ) ;
+        Interface.PutChar( regs8[ 0 ] ) ;
         break ;
 
       // GET_RTC
@@ -2249,17 +6179,30 @@ int main(int argc, char **argv)
         {
           time_t clock_buf ;
           struct timeb ms_clock ;
+          struct tm local_time ;
           uint32_t addr ;
 
-          time( &clock_buf ) ;
-          ftime( &ms_clock ) ;
+          Interface.GetRTCTime( ms_clock ) ;
+          clock_buf = ms_clock.time ;
+
+          // localtime() shares its result between the threads of the
+          // process everywhere but in the Windows C runtime
+#if defined(_WIN32)
+          local_time = *localtime( &clock_buf ) ;
+#else
+          localtime_r( &clock_buf , &local_time ) ;
+#endif
 
           // Convert segment:offset to linear address.
           addr  = 16 ;
           addr *= regs16[ REG_ES ] ;
           addr += ( uint16_t ) regs16[ REG_BX ] ;
 
-          memcpy( &mem[ addr ] , localtime( &clock_buf ) , sizeof( struct tm ) ) ;
+          // The nine int fields the BIOS reads. The C runtime may add
+          // fields of its own, such as the tm_zone pointer of glibc, which
+          // would make the guest memory depend on the host process.
+          memcpy( &mem[ addr ] , &local_time , 9 * sizeof( int ) ) ;
+          mem_dirty_range( addr , 9 * sizeof( int ) ) ;
 
           // Convert segment:offset to linear address.
           addr  = 16 ;
@@ -2267,6 +6210,7 @@ int main(int argc, char **argv)
           addr += ( uint16_t ) ( regs16[ REG_BX ] + 36 ) ;
 
           *( int16_t * )&mem[ addr ] = ms_clock.millitm ;
+          MEM_DIRTY( addr ) ;
         }
         break ;
 
@@ -2275,43 +6219,34 @@ int main(int argc, char **argv)
       // DISK_WRITE
       case 0x03 :
         {
-          long seekRet ;
+          // Convert segment:offset to linear address.
+          uint32_t addr ;
 
-          seekRet = ~lseek( disk[ regs8[ REG_DL ] ] , *( uint32_t * )&regs16[ REG_BP ] << 9 , 0 ) ;
-          if( seekRet )
-          {
-            // Convert segment:offset to linear address.
-            uint32_t addr ;
+          addr  = 16 ;
+          addr *= regs16[ REG_ES ] ;
+          addr += ( uint16_t ) regs16[ REG_BX ] ;
 
-            addr  = 16 ;
-            addr *= regs16[ REG_ES ] ;
-            addr += ( uint16_t ) regs16[ REG_BX ] ;
+          scratch_int = disk_transfer( regs8[ REG_DL ] , *( uint32_t * )&regs16[ REG_BP ] << 9 , addr ,
+                                       regs16[ REG_AX ] , ( ( int8_t ) i_data0 ) == 3 ) ;
+          regs8[ REG_AL ] = ( uint8_t ) scratch_int ;
 
-            if( ( ( int8_t ) i_data0 ) == 3 )
-            {
-              regs8[ REG_AL ] = write( disk[ regs8[ REG_DL ] ] , ( mem + addr ) , regs16[ REG_AX ] ) ;
-            }
-            else
-            {
-              regs8[ REG_AL ] = read( disk[ regs8[ REG_DL ] ] , ( mem + addr ) , regs16[ REG_AX ] ) ;
-            }
-          }
-          else
+          if( scratch_int > 0 )
           {
-            regs8[ REG_AL ] = 0 ;
+            counter_disk_sectors[ ( ( int8_t ) i_data0 ) == 3 ] += ( uint32_t ) scratch_int >> 9 ;
           }
         }
         break ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: ENTER
-    case 0x33 :
+    OPCODE( 0x33 ) :
       // PUSH regs16[ REG_BP ].
       i_w = 1 ;
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_BP ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       scratch_uint = regs16[ REG_SP ] ;
 
@@ -2330,6 +6265,7 @@ int main(int argc, char **argv)
           op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
           op_source = *( uint16_t * )&regs16[ REG_BP ] ;
           op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+          STACK_DIRTY() ;
         }
 
         // PUSH scratch_uint.
@@ -2337,14 +6273,15 @@ int main(int argc, char **argv)
         op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
         op_source = *( uint16_t * )&scratch_uint ;
         op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+        STACK_DIRTY() ;
       }
 
       regs16[ REG_BP ]  = scratch_uint ;
       regs16[ REG_SP ] -= i_data0      ;
-      break ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: LEAVE
-    case 0x34 :
+    OPCODE( 0x34 ) :
       regs16[ REG_SP ] = regs16[ REG_BP ] ;
 
       i_w = 1 ;
@@ -2360,14 +6297,14 @@ int main(int argc, char **argv)
         addr *= regs16[ REG_SS ] ;
         addr += ( uint16_t ) ( regs16[ REG_SP ] - 2 ) ;
 
-        op_source = *( uint16_t * )&mem[ addr ]  ;
+        op_source = *( uint16_t * )operand_ptr( addr )  ;
         op_result = op_source ;
         *( uint16_t * )&regs16[ REG_BP ] = op_source ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: PUSHA
-    case 0x35 :
+    OPCODE( 0x35 ) :
       // PUSH AX, PUSH CX, PUSH DX, PUSH BX, PUSH SP, PUSH BP, PUSH SI, PUSH DI
       i_w = 1 ;
 
@@ -2375,46 +6312,54 @@ int main(int argc, char **argv)
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_AX ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_CX ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_CX ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_DX ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_DX ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_BX ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_BX ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       scratch_uint = regs16[ REG_SP ] ;
       // PUSH scratch_uint.
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&scratch_uint ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_BP ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_BP ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_SI ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_SI ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
+      STACK_DIRTY() ;
 
       // PUSH regs16[ REG_DI ].
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&regs16[ REG_DI ] ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-      break ;
+      STACK_DIRTY() ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: POPA
-    case 0x63 :
+    OPCODE( 0x63 ) :
       // POP DI, POP SI, POP BP, ADD SP,2, POP BX, POP DX, POP CX, POP AX
       i_w = 1 ;
 
@@ -2461,44 +6406,49 @@ int main(int argc, char **argv)
       op_dest   = *( uint16_t * )&regs16[ REG_AX ] ;
       op_source = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( -2+ regs16[ REG_SP ] ) ] ;
       op_result = *( uint16_t * )&regs16[ REG_AX ] = op_source ;
-      break ;
+      NEXT_OPCODE ;
 
     // 80186: BOUND
-    case 0x37 :
+    OPCODE( 0x37 ) :
       // Not implemented. Incompatible with PC/XT hardware.
       printf( "BOUND\n" ) ;
-      break ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: PUSH imm16
-    case 0x38 :
+    OPCODE( 0x38 ) :
       // PUSH i_data0.
       i_w = 1 ;
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&i_data0 ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-      break ;
+      STACK_DIRTY() ;
+      NEXT_OPCODE ;
 
     // 80186, NEC V20: PUSH imm8
-    case 0x39 :
+    OPCODE( 0x39 ) :
       // PUSH ( i_data0 & 0x00FF )
       i_w = 1 ;
       op_dest   = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] ;
       op_source = *( uint16_t * )&i_data0 & 0x00FF ;
       op_result = *( uint16_t * )&mem[ 16 * regs16[ REG_SS ] + ( uint16_t ) ( --regs16[ REG_SP ] ) ] = op_source ;
-      break ;
+      STACK_DIRTY() ;
+      NEXT_OPCODE ;
 
     // 80186 IMUL
-    case 0x3A :
+    OPCODE( 0x3A ) :
       // Not implemented.
       printf( "IMUL at %04X:%04X\n" , regs16[ REG_CS ] , reg_ip ) ;
-      break ;
+      TRACE_FAULT( "80186 IMUL" ) ;
+      NEXT_OPCODE ;
 
     // 80186: INSB INSW
-    case 0x3B :
+    OPCODE( 0x3B ) :
       // Loads data from port to the destination ES:DI.
       // DI is adjusted by the size of the operand and increased if the
       // Direction Flag is cleared and decreased if the Direction Flag is set.
       scratch2_uint = regs16[ REG_DX ] ;
+      sync_devices() ;
+      cycles_deadline = 0 ;
 
       scratch_uint = ( rep_override_en ) ? ( regs16[REG_CX] ) : ( 1 ) ;
       while( scratch_uint )
@@ -2519,15 +6469,15 @@ int main(int argc, char **argv)
         // Execute arithmetic/logic operations.
         if( i_w )
         {
-          op_dest   = *( uint16_t * )&mem[ addr ] ;
+          op_dest   = *( uint16_t * )operand_ptr( addr ) ;
           op_source = *( uint16_t * )&io_ports[ scratch_uint ]  ;
-          op_result = *( uint16_t * )&mem[ addr ] = op_source ;
+          op_result = *( uint16_t * )operand_ptr( addr ) = op_source ;
         }
         else
         {
-          op_dest   = mem[ addr ] ;
+          op_dest   = *operand_ptr( addr ) ;
           op_source = *( uint8_t * )&io_ports[ scratch_uint ] ;
-          op_result = mem[ addr ] = op_source ;
+          op_result = *operand_ptr( addr ) = op_source ;
         }
 
         regs16[ REG_DI ] -= ( 2 * regs8[ FLAG_DF ] - 1 ) * ( i_w + 1 ) ;
@@ -2538,16 +6488,18 @@ int main(int argc, char **argv)
       {
         regs16[ REG_CX ] = 0 ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // 80186: OUTSB OUTSW
-    case 0x3C :
+    OPCODE( 0x3C ) :
       // Transfers a byte or word "src" to the hardware port specified in DX.
       // The "src" is located at DS:SI and SI is incremented or decremented
       // by the size dictated by the instruction format.
       // When the Direction Flag is set SI is decremented, when clear, SI is
       // incremented.
       scratch2_uint = regs16[ REG_DX ] ;
+      sync_devices() ;
+      cycles_deadline = 0 ;
 
       scratch_uint = ( rep_override_en ) ? ( regs16[ REG_CX ] ) : ( 1 ) ;
       while( scratch_uint )
@@ -2563,13 +6515,13 @@ int main(int argc, char **argv)
         if( i_w )
         {
           op_dest   = *( uint16_t * )&io_ports[ scratch2_uint ] ;
-          op_source = *( uint16_t * )&mem[ addr ]  ;
+          op_source = *( uint16_t * )operand_ptr( addr )  ;
           op_result = *( uint16_t * )&io_ports[ scratch2_uint ] = op_source ;
         }
         else
         {
           op_dest   = io_ports[ scratch2_uint ] ;
-          op_source = *( uint8_t * )&mem[ addr ] ;
+          op_source = *( uint8_t * )operand_ptr( addr ) ;
           op_result = io_ports[ scratch2_uint ] = op_source ;
         }
 
@@ -2587,116 +6539,256 @@ int main(int argc, char **argv)
       {
         regs16[ REG_CX ] = 0 ;
       }
-      break ;
+      NEXT_OPCODE ;
 
     // 8087 MATH Coprocessor
-    case 0x45 :
+    OPCODE( 0x45 ) :
       printf( "8087 coprocessor instruction: 0x%02X\n" , stOpcode.raw_opcode_id ) ;
-      ExitEmulation = true ;
-      break ;
+      TRACE_FAULT( "8087 instruction" ) ;
+      exit_emulation = true ;
+      NEXT_OPCODE ;
 
     // 80286+
-    case 0x46 :
+    OPCODE( 0x46 ) :
       printf( "80286+ only op code: 0x%02X at %04X:%04X\n" , stOpcode.raw_opcode_id , regs16[ REG_CS ] , reg_ip ) ;
-      break ;
+      TRACE_FAULT( "80286 instruction" ) ;
+      NEXT_OPCODE ;
 
     // 80386+
-    case 0x47 :
+    OPCODE( 0x47 ) :
       printf( "80386+ only op code: 0x%02X at %04X:%04X\n" , stOpcode.raw_opcode_id , regs16[ REG_CS ] , reg_ip ) ;
-      break ;
+      TRACE_FAULT( "80386 instruction" ) ;
+      NEXT_OPCODE ;
 
     // BAD OP CODE
-    case 0x48 :
+    OPCODE( 0x48 ) :
       printf( "Bad op code: %02x  at %04X:%04X\n" , stOpcode.raw_opcode_id , regs16[ REG_CS ] , reg_ip ) ;
-      break ;
+      TRACE_FAULT( "bad opcode" ) ;
+      NEXT_OPCODE ;
 
-    default :
+    OPCODE_DEFAULT :
       printf( "Unknown opcode %02Xh\n" , stOpcode.raw_opcode_id ) ;
-      break ;
+      TRACE_FAULT( "unknown opcode" ) ;
+      NEXT_OPCODE ;
     }
 
-    // Increment instruction pointer by computed instruction length. Tables in the BIOS binary
-    // help us here.
-    reg_ip += ( i_mod * ( i_mod != 3 ) + 2 * ( !i_mod && i_rm == 6 ) ) * stOpcode.i_mod_size ;
-    reg_ip += bios_table_lookup[ TABLE_BASE_INST_SIZE ][ stOpcode.raw_opcode_id ] ;
-    reg_ip += bios_table_lookup[ TABLE_I_W_SIZE       ][ stOpcode.raw_opcode_id ] * ( i_w + 1 ) ;
+    retire_instruction() ;
+  } // for each instruction
+
+#if THREADED_DISPATCH
+run_exit :
+#endif
 
-    // If instruction needs to update SF, ZF and PF, set them as appropriate
-    if( stOpcode.set_flags_type & FLAGS_UPDATE_SZP )
+#if TRACE
+  // The faulting instruction has been recorded by now
+  if( trace_fault_reason != NULL )
+  {
+    trace_faulted = true ;
+    if( !TraceDump( trace_fault_file , trace_fault_reason ) )
     {
-      // Returns sign bit of an 8-bit or 16-bit operand
-      regs8[ FLAG_SF ] = ( 1 & ( ( i_w ) ? *( int16_t * )&( op_result ) : ( op_result ) ) >> ( 8 * ( i_w + 1 ) - 1 ) ) ;
-      regs8[ FLAG_ZF ] = !op_result ;
-      regs8[ FLAG_PF ] = bios_table_lookup[ TABLE_PARITY_FLAG ][ ( uint8_t ) op_result ] ;
+      printf( "Could not write trace %s\n" , trace_fault_file ) ;
+    }
+    trace_fault_reason = NULL ;
+  }
+#endif
 
-      // If instruction is an arithmetic or logic operation, also set AF/OF/CF as appropriate.
-      if( stOpcode.set_flags_type & FLAGS_UPDATE_AO_ARITH )
-      {
-        set_AF_OF_arith() ;
-      }
-      if( stOpcode.set_flags_type & FLAGS_UPDATE_OC_LOGIC )
-      {
-        set_CF( 0 ) ;
-        set_OF( 0 ) ;
-      }
+  // A halted CPU has made passes but run nothing
+  executed -= halt_passes ;
+  counter_instructions += executed ;
+
+  return( executed ) ;
+}
+
+#if THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+// Emulator entry point. Builds that drive CPU8086 themselves, such as the
+// tests, define NO_MAIN.
+
+#ifndef NO_MAIN
+
+// Save or load a snapshot if the interface asks for one
+static void snapshot_request( CPU8086 * cpu , T8086TinyInterface_t & Interface )
+{
+  const char * snapshot_file ;
+  bool         snapshot_save ;
+
+  if( Interface.SnapshotRequest( snapshot_file , snapshot_save ) )
+  {
+    if( ( snapshot_save ) ? ( !cpu->SaveSnapshot( snapshot_file ) ) : ( !cpu->LoadSnapshot( snapshot_file ) ) )
+    {
+      printf( "Could not %s snapshot %s\n" , ( snapshot_save ) ? "save" : "load" , snapshot_file ) ;
+    }
+  }
+}
+
+#if defined(_WIN32)
+int CALLBACK WinMain(
+  HINSTANCE hInstance,
+  HINSTANCE /* hPrevInstance */,
+  LPSTR     /* lpCmdLine */,
+  int       /* nCmdShow */)
+#else
+int main(int argc, char **argv)
+#endif
+{
+  T8086TinyInterface_t   Interface ;
+  CPU8086              * cpu       ;
+  int                    status    ;
+
+  status = 0 ;
+
+#if defined(_WIN32)
+  Interface.SetInstance(hInstance);
+#else
+  Interface.SetArgs(argc, argv);
+#endif
+
+  cpu = new CPU8086( Interface ) ;
+
+#ifndef BENCHMARK
+  unsigned int rewind_interval ;
+  unsigned int rewind_budget   ;
+  unsigned int rewind_clock    ;
+
+  Interface.GetRewindConfig( rewind_interval , rewind_budget , rewind_clock ) ;
+  if( ( rewind_budget != 0 ) && ( !cpu->RewindEnable( rewind_interval , rewind_budget , rewind_clock ) ) )
+  {
+    printf( "Could not enable rewind\n" ) ;
+  }
+#endif
+
+#if PROFILE
+  unsigned int profile_period ;
+  const char * profile_map    ;
+  const char * profile_report ;
+
+  Interface.GetProfileConfig( profile_period , profile_map , profile_report ) ;
+  if( ( profile_period != 0 ) && ( !cpu->ProfileEnable( profile_period , profile_map ) ) )
+  {
+    printf( "Could not enable the profiler\n" ) ;
+  }
+#endif
+
+#if TRACE
+  unsigned int trace_records ;
+  const char * trace_file    ;
+
+  Interface.GetTraceConfig( trace_records , trace_file ) ;
+  if( ( trace_records != 0 ) && ( !cpu->TraceEnable( trace_records , trace_file ) ) )
+  {
+    printf( "Could not enable the trace\n" ) ;
+  }
+#endif
+
+#ifdef BENCHMARK
+  struct timeb start_time ;
+  struct timeb stop_time  ;
+  uint64_t     executed   ;
+  double       seconds    ;
+
+  ftime( &start_time ) ;
+  executed = 0 ;
+  while( ( !cpu->Exited() ) && ( executed < ( uint64_t ) BENCHMARK ) )
+  {
+    executed += cpu->Run( RUN_SLICE ) ;
+  }
+  ftime( &stop_time ) ;
+
+  seconds  = ( double ) ( stop_time.time - start_time.time ) ;
+  seconds += ( double ) ( stop_time.millitm - start_time.millitm ) / 1000.0 ;
+  printf( "%s dispatch: %.0f instructions in %.2f s, %.2f MIPS\n" ,
+          ( THREADED_DISPATCH ) ? "Threaded" : "Switch" ,
+          ( double ) executed , seconds , ( double ) executed / seconds / 1000000.0 ) ;
+#else
+  uint64_t        limit    ;
+  uint64_t        executed ;
+  uint32_t        slice    ;
+  stCpuCounters_t counters ;
+
+  limit    = Interface.GetInstructionLimit() ;
+  executed = 0 ;
+
+  // A snapshot to start from
+  snapshot_request( cpu , Interface ) ;
+
+  while( ( !cpu->Exited() ) && ( ( limit == 0 ) || ( executed < limit ) ) )
+  {
+    unsigned int rewind_ms ;
+    int          children  ;
+
+    slice = RUN_SLICE ;
+    if( ( limit != 0 ) && ( ( limit - executed ) < slice ) )
+    {
+      slice = ( uint32_t ) ( limit - executed ) ;
     }
+    TIMELINE_BEGIN( "run" ) ;
+    executed += cpu->Run( slice ) ;
+    TIMELINE_END( "run" ) ;
 
-    regs16[ REG_IP ] = reg_ip ;
+    snapshot_request( cpu , Interface ) ;
 
-    // Update the interface module
-    if( Interface.TimerTick( 4 ) )
+    if( Interface.ForkRequest( children ) )
     {
-      if( Interface.ExitEmulation() )
-      {
-        ExitEmulation = true ;
-      }
-      else
-      {
-        if( Interface.FDChanged() )
-        {
-          close( disk[ 1 ] ) ;
-          disk[ 1 ] = open( Interface.GetFDImageFilename() , O_BINARY | O_NOINHERIT | O_RDWR ) ;
-        }
+      Interface.ForkStarted( cpu->Fork( children ) ) ;
 
-        if( Interface.Reset() )
-        {
-          Reset() ;
-        }
-      }
+      // A child may have an instruction limit of its own
+      limit = Interface.GetInstructionLimit() ;
     }
 
-    // Application has set trap flag, so fire INT 1
-    if( trap_flag )
+    if( ( Interface.RewindRequest( rewind_ms ) ) && ( !cpu->Rewind( rewind_ms ) ) )
     {
-      pc_interrupt( 1 ) ;
+      printf( "Could not rewind\n" ) ;
     }
 
-    trap_flag = regs8[ FLAG_TF ] ;
+#if TRACE
+    if( ( Interface.TraceRequest() ) && ( !cpu->TraceDump( trace_file , "request" ) ) )
+    {
+      printf( "Could not write trace %s\n" , trace_file ) ;
+    }
+#endif
 
-    // Check for interrupts triggered by system interfaces
-    int IntNo ;
-    static int InstrSinceInt8 = 0 ;
-    InstrSinceInt8++ ;
-    if( !seg_override_en && !rep_override_en && regs8[ FLAG_IF ] && !regs8[ FLAG_TF ] && Interface.IntPending( IntNo ) )
+    if( Interface.StatsRequest() )
     {
-      if( ( IntNo == 8 ) && ( InstrSinceInt8 < 300 ) )
-      {
-        //printf("*** Int8 after %d instructions\n", InstrSinceInt8);
-      }
-      else
-      {
-        if( IntNo == 8 )
-        {
-          InstrSinceInt8 = 0 ;
-        }
-        pc_interrupt( IntNo ) ;
+      cpu->GetCounters( counters ) ;
+      Interface.WriteStats( counters ) ;
+    }
+  }
+
+  // Last stats, for runs shorter than the stats period
+  cpu->GetCounters( counters ) ;
+  Interface.WriteStats( counters ) ;
 
-        regs16[ REG_IP ] = reg_ip ;
+  status = Interface.ExitStatus( executed ) ;
+
+  // A snapshot of the machine as it ended
+  snapshot_request( cpu , Interface ) ;
+#endif
+
+#if PROFILE
+  if( profile_period != 0 )
+  {
+    FILE * fp = ( profile_report != NULL ) ? fopen( profile_report , "w" ) : stdout ;
+
+    if( fp == NULL )
+    {
+      printf( "Could not write the profile to %s\n" , profile_report ) ;
+    }
+    else
+    {
+      cpu->ProfileReport( fp ) ;
+      if( fp != stdout )
+      {
+        fclose( fp ) ;
       }
     }
-  } // for each instruction
+  }
+#endif
 
-  Interface.Cleanup() ;
+  delete cpu ;
 
-  return( 0 ) ;
+  return( status ) ;
 }
+
+#endif // NO_MAIN
@@ -0,0 +1,257 @@
+; REP string instruction microbenchmark for tinyXT. Compiles with NASM:
+;
+;   nasm -f bin repbench.asm -o repbench.com
+;
+; Run REPBENCH.COM under DOS in the emulator. Each test copies, fills or
+; scans 64K PASSES times and prints the host time it took in milliseconds.
+; The emulator runs a whole REP instruction as one instruction, so the
+; emulated timer does not see it; the host clock is read with the emulator
+; specific 0F 01 instruction instead. The last copy overlaps its own source
+; and always takes the element by element path, for comparison.
+;
+; This work is licensed under the MIT License. See included LICENSE.TXT.
+
+	cpu	8086
+
+PASSES		equ	1000
+SRC_SEG		equ	0x5000
+DST_SEG		equ	0x6000
+
+org	100h
+
+main:
+	mov	si, tests
+
+next_test:
+	lodsw			; Test name
+	or	ax, ax
+	jz	all_done
+	mov	dx, ax
+	lodsw			; Test routine
+	mov	bp, ax
+	push	si
+
+	mov	ah, 0x09
+	int	0x21
+
+	call	get_ms		; Start time in DX:AX
+	push	dx
+	push	ax
+
+	mov	cx, PASSES
+
+next_pass:
+	push	cx
+	call	bp
+	pop	cx
+	loop	next_pass
+
+	call	get_ms
+	pop	bx
+	pop	cx
+	sub	ax, bx
+	sbb	dx, cx
+	jnc	elapsed_ok
+	add	ax, 0xee80	; Passed the hour, add 3600000 ms
+	adc	dx, 0x36
+
+elapsed_ok:
+	call	print_dec
+
+	mov	dx, ms_msg
+	mov	ah, 0x09
+	int	0x21
+
+	pop	si
+	jmp	next_test
+
+all_done:
+	ret
+
+; Return the host time in milliseconds since the start of the hour in DX:AX
+
+get_ms:
+	push	es
+	push	bx
+	push	ds
+	pop	es
+	mov	bx, rtc_buf
+	db	0x0f, 0x01	; extended_get_rtc: struct tm at ES:BX, ms at ES:BX+36
+	mov	ax, [rtc_buf+4]	; tm_min
+	mov	dx, 60
+	mul	dx
+	add	ax, [rtc_buf]	; tm_sec
+	mov	dx, 1000
+	mul	dx
+	add	ax, [rtc_buf+36]
+	adc	dx, 0
+	pop	bx
+	pop	es
+	ret
+
+; Print DX:AX in decimal
+
+print_dec:
+	mov	bx, 10
+	xor	cx, cx
+
+print_dec_div:
+	mov	si, ax		; Divide DX:AX by 10, high word first
+	mov	ax, dx
+	xor	dx, dx
+	div	bx
+	mov	di, ax
+	mov	ax, si
+	div	bx
+	push	dx
+	inc	cx
+	mov	dx, di
+	or	di, ax
+	jnz	print_dec_div
+
+print_dec_out:
+	pop	dx
+	add	dl, '0'
+	mov	ah, 0x02
+	int	0x21
+	loop	print_dec_out
+	ret
+
+; Tests. Each one sets up its own segments and restores DS and ES.
+
+set_segs:
+	mov	ax, SRC_SEG
+	mov	ds, ax
+	mov	ax, DST_SEG
+	mov	es, ax
+	ret
+
+movsw_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	xor	si, si
+	xor	di, di
+	mov	cx, 0x8000
+	cld
+	rep	movsw
+	pop	es
+	pop	ds
+	ret
+
+movsw_bwd:
+	push	ds
+	push	es
+	call	set_segs
+	mov	si, 0xfffe
+	mov	di, 0xfffe
+	mov	cx, 0x8000
+	std
+	rep	movsw
+	cld
+	pop	es
+	pop	ds
+	ret
+
+movsb_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	xor	si, si
+	xor	di, di
+	mov	cx, 0xffff
+	cld
+	rep	movsb
+	pop	es
+	pop	ds
+	ret
+
+stosw_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	xor	di, di
+	mov	ax, 0x0720
+	mov	cx, 0x8000
+	cld
+	rep	stosw
+	pop	es
+	pop	ds
+	ret
+
+stosb_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	xor	di, di
+	xor	al, al
+	mov	cx, 0xffff
+	cld
+	rep	stosb
+	pop	es
+	pop	ds
+	ret
+
+cmpsw_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	mov	ds, ax		; Compare the destination with itself
+	xor	si, si
+	xor	di, di
+	mov	cx, 0x8000
+	cld
+	repe	cmpsw
+	pop	es
+	pop	ds
+	ret
+
+scasb_fwd:
+	push	ds
+	push	es
+	call	set_segs
+	xor	di, di
+	mov	al, 0xff	; Not found, the fill above stored zeros
+	mov	cx, 0xffff
+	cld
+	repne	scasb
+	pop	es
+	pop	ds
+	ret
+
+movsw_overlap:
+	push	ds
+	push	es
+	call	set_segs
+	mov	ds, ax
+	xor	si, si
+	mov	di, 2
+	mov	cx, 0x7fff
+	cld
+	rep	movsw
+	pop	es
+	pop	ds
+	ret
+
+tests:
+	dw	movsw_fwd_msg, movsw_fwd
+	dw	movsw_bwd_msg, movsw_bwd
+	dw	movsb_fwd_msg, movsb_fwd
+	dw	stosw_fwd_msg, stosw_fwd
+	dw	stosb_fwd_msg, stosb_fwd
+	dw	cmpsw_fwd_msg, cmpsw_fwd
+	dw	scasb_fwd_msg, scasb_fwd
+	dw	movsw_overlap_msg, movsw_overlap
+	dw	0
+
+movsw_fwd_msg		db	'REP MOVSW 64K        : $'
+movsw_bwd_msg		db	'REP MOVSW 64K, DF=1  : $'
+movsb_fwd_msg		db	'REP MOVSB 64K        : $'
+stosw_fwd_msg		db	'REP STOSW 64K        : $'
+stosb_fwd_msg		db	'REP STOSB 64K        : $'
+cmpsw_fwd_msg		db	'REPE CMPSW 64K       : $'
+scasb_fwd_msg		db	'REPNE SCASB 64K      : $'
+movsw_overlap_msg	db	'REP MOVSW overlapping: $'
+ms_msg			db	' ms', 13, 10, '$'
+
+rtc_buf			times 64 db 0
@@ -0,0 +1,41 @@
+/**
+ * @file XTcounters.h
+ * @brief Performance counters of the CPU.
+ *
+ * The CPU counts what it does in plain members of its own, which only the
+ * thread running it writes, and CPU8086::GetCounters() copies them out
+ * between Run() calls. The counters only go up: they are not part of the
+ * machine state, so a snapshot load or a rewind leaves them as they are.
+ * The clock count is the exception, it is the emulated time of the machine
+ * and goes back with it.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTCOUNTERS_
+ #define _XTCOUNTERS_
+
+ #include <stdint.h>
+
+/**
+ * @brief The counters.
+ *
+ * instructions         : Instructions run, translated ones included.
+ * cycles               : CPU clocks of emulated time since power on.
+ * interrupts           : Interrupts taken on each vector, hardware, CPU
+ *                        exceptions and INT instructions.
+ * disk_sectors_read    : 512 byte sectors read by the BIOS disk calls.
+ * disk_sectors_written : 512 byte sectors written by the BIOS disk calls.
+ */
+typedef struct STCPUCOUNTERS_T
+{
+  uint64_t  instructions          ;
+  uint64_t  cycles                ;
+  uint64_t  interrupts[ 256 ]     ;
+  uint64_t  disk_sectors_read     ;
+  uint64_t  disk_sectors_written  ;
+} stCpuCounters_t ;
+
+#endif // _XTCOUNTERS_
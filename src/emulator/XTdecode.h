@@ -0,0 +1,1014 @@
+/**
+ * @file XTdecode.h
+ * @brief Instruction decode tables.
+ *
+ * The tables the CPU core uses to decode 8086/80186 instructions. They used
+ * to be read from the BIOS image on every reset, through the table pointers
+ * the 8086tiny BIOS keeps at F000:0102. They are now compiled in, so the
+ * lookups can be folded by the compiler and do not depend on the BIOS
+ * image that is loaded. The values are the ones in bios_src/bios_cga.asm.
+ *
+ * Based on:
+ * 8086tiny:
+ * Copyright (c) 2013-2014 Adrian Cable - http://www.megalith.co.uk/8086tiny
+ * 8086tiny modifications and WIN32 interface class implementation:
+ * Copyright (c) 2014 Julian Olds - https://jaybertsoftware.weebly.com/8086-tiny-plus.html
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTDECODE_
+ #define _XTDECODE_
+
+ #include <stdint.h>
+
+/**
+ * @brief Decode descriptor of one opcode byte.
+ *
+ * set_flags_type : Flags the instruction updates, see FLAGS_UPDATE_xx.
+ * raw_opcode_id  : The opcode byte itself.
+ * xlat_opcode_id : Function that executes the instruction. Many encodings
+ *                  of similar instructions share the same function. The
+ *                  common ALU and MOV forms have one per operand width,
+ *                  and MOV sreg, LEA and POP r/m one each, so it does not
+ *                  test the W and D bits.
+ * extra          : Function specific data, e.g. the ALU operation.
+ * i_mod_size     : 1 if a ModRM byte follows the opcode.
+ * base_size      : Instruction size in bytes, ModRM displacement and
+ *                  immediate operand size excluded.
+ * i_w_size       : 1 if the immediate operand grows with the operand width.
+ */
+typedef struct STOPCODE_T
+{
+  uint8_t  set_flags_type  ;
+  uint8_t  raw_opcode_id   ;
+  uint8_t  xlat_opcode_id  ;
+  uint8_t  extra           ;
+  uint8_t  i_mod_size      ;
+  uint8_t  base_size       ;
+  uint8_t  i_w_size        ;
+} stOpcode_t ;
+
+/**
+ * @brief Effective address of one ModRM r/m encoding.
+ *
+ * ea_reg1, ea_reg2 : 16-bit registers added together, 12 (always zero) if
+ *                    unused.
+ * disp_mult        : 1 if the displacement is added.
+ * ea_seg           : Default segment register, SS (10) or DS (11).
+ */
+typedef struct STMODRM_T
+{
+  uint8_t  ea_reg1   ;
+  uint8_t  ea_reg2   ;
+  uint8_t  disp_mult ;
+  uint8_t  ea_seg    ;
+} stModRM_t ;
+
+/**
+ * @brief Decode descriptor of every opcode byte.
+ *
+ * Fields: set_flags_type, raw_opcode_id, xlat_opcode_id, extra, i_mod_size,
+ * base_size, i_w_size.
+ */
+constexpr stOpcode_t xt_opcode_table[ 256 ] =
+{
+  { 3 , 0x00 ,  9 ,   0 , 1 , 2 , 0 } , // 00 ADD Eb,Gb
+  { 3 , 0x01 , 64 ,   0 , 1 , 2 , 0 } , // 01 ADD Ev,Gv
+  { 3 , 0x02 ,  9 ,   0 , 1 , 2 , 0 } , // 02 ADD Gb,Eb
+  { 3 , 0x03 , 64 ,   0 , 1 , 2 , 0 } , // 03 ADD Gv,Ev
+  { 3 , 0x04 ,  7 ,   0 , 0 , 1 , 1 } , // 04 ADD AL,Ib
+  { 3 , 0x05 , 67 ,   0 , 0 , 1 , 1 } , // 05 ADD AX,Iv
+  { 0 , 0x06 , 25 ,   8 , 0 , 1 , 0 } , // 06 PUSH ES
+  { 0 , 0x07 , 26 ,   8 , 0 , 1 , 0 } , // 07 POP ES
+  { 5 , 0x08 ,  9 ,   1 , 1 , 2 , 0 } , // 08 OR Eb,Gb
+  { 5 , 0x09 , 64 ,   1 , 1 , 2 , 0 } , // 09 OR Ev,Gv
+  { 5 , 0x0A ,  9 ,   1 , 1 , 2 , 0 } , // 0A OR Gb,Eb
+  { 5 , 0x0B , 64 ,   1 , 1 , 2 , 0 } , // 0B OR Gv,Ev
+  { 5 , 0x0C ,  7 ,   1 , 0 , 1 , 1 } , // 0C OR AL,Ib
+  { 5 , 0x0D , 67 ,   1 , 0 , 1 , 1 } , // 0D OR AX,Iv
+  { 0 , 0x0E , 25 ,   9 , 0 , 1 , 0 } , // 0E PUSH CS
+  { 0 , 0x0F , 50 ,  36 , 0 , 2 , 0 } , // 0F (emulator specific)
+  { 1 , 0x10 ,  9 ,   2 , 1 , 2 , 0 } , // 10 ADC Eb,Gb
+  { 1 , 0x11 , 64 ,   2 , 1 , 2 , 0 } , // 11 ADC Ev,Gv
+  { 1 , 0x12 ,  9 ,   2 , 1 , 2 , 0 } , // 12 ADC Gb,Eb
+  { 1 , 0x13 , 64 ,   2 , 1 , 2 , 0 } , // 13 ADC Gv,Ev
+  { 1 , 0x14 ,  7 ,   2 , 0 , 1 , 1 } , // 14 ADC AL,Ib
+  { 1 , 0x15 , 67 ,   2 , 0 , 1 , 1 } , // 15 ADC AX,Iv
+  { 0 , 0x16 , 25 ,  10 , 0 , 1 , 0 } , // 16 PUSH SS
+  { 0 , 0x17 , 26 ,  10 , 0 , 1 , 0 } , // 17 POP SS
+  { 1 , 0x18 ,  9 ,   3 , 1 , 2 , 0 } , // 18 SBB Eb,Gb
+  { 1 , 0x19 , 64 ,   3 , 1 , 2 , 0 } , // 19 SBB Ev,Gv
+  { 1 , 0x1A ,  9 ,   3 , 1 , 2 , 0 } , // 1A SBB Gb,Eb
+  { 1 , 0x1B , 64 ,   3 , 1 , 2 , 0 } , // 1B SBB Gv,Ev
+  { 1 , 0x1C ,  7 ,   3 , 0 , 1 , 1 } , // 1C SBB AL,Ib
+  { 1 , 0x1D , 67 ,   3 , 0 , 1 , 1 } , // 1D SBB AX,Iv
+  { 0 , 0x1E , 25 ,  11 , 0 , 1 , 0 } , // 1E PUSH DS
+  { 0 , 0x1F , 26 ,  11 , 0 , 1 , 0 } , // 1F POP DS
+  { 5 , 0x20 ,  9 ,   4 , 1 , 2 , 0 } , // 20 AND Eb,Gb
+  { 5 , 0x21 , 64 ,   4 , 1 , 2 , 0 } , // 21 AND Ev,Gv
+  { 5 , 0x22 ,  9 ,   4 , 1 , 2 , 0 } , // 22 AND Gb,Eb
+  { 5 , 0x23 , 64 ,   4 , 1 , 2 , 0 } , // 23 AND Gv,Ev
+  { 5 , 0x24 ,  7 ,   4 , 0 , 1 , 1 } , // 24 AND AL,Ib
+  { 5 , 0x25 , 67 ,   4 , 0 , 1 , 1 } , // 25 AND AX,Iv
+  { 0 , 0x26 , 27 ,   8 , 0 , 1 , 0 } , // 26 ES:
+  { 1 , 0x27 , 28 ,   0 , 0 , 1 , 0 } , // 27 DAA
+  { 3 , 0x28 ,  9 ,   5 , 1 , 2 , 0 } , // 28 SUB Eb,Gb
+  { 3 , 0x29 , 64 ,   5 , 1 , 2 , 0 } , // 29 SUB Ev,Gv
+  { 3 , 0x2A ,  9 ,   5 , 1 , 2 , 0 } , // 2A SUB Gb,Eb
+  { 3 , 0x2B , 64 ,   5 , 1 , 2 , 0 } , // 2B SUB Gv,Ev
+  { 3 , 0x2C ,  7 ,   5 , 0 , 1 , 1 } , // 2C SUB AL,Ib
+  { 3 , 0x2D , 67 ,   5 , 0 , 1 , 1 } , // 2D SUB AX,Iv
+  { 0 , 0x2E , 27 ,   9 , 0 , 1 , 0 } , // 2E CS:
+  { 1 , 0x2F , 28 ,   1 , 0 , 1 , 0 } , // 2F DAS
+  { 5 , 0x30 ,  9 ,   6 , 1 , 2 , 0 } , // 30 XOR Eb,Gb
+  { 5 , 0x31 , 64 ,   6 , 1 , 2 , 0 } , // 31 XOR Ev,Gv
+  { 5 , 0x32 ,  9 ,   6 , 1 , 2 , 0 } , // 32 XOR Gb,Eb
+  { 5 , 0x33 , 64 ,   6 , 1 , 2 , 0 } , // 33 XOR Gv,Ev
+  { 5 , 0x34 ,  7 ,   6 , 0 , 1 , 1 } , // 34 XOR AL,Ib
+  { 5 , 0x35 , 67 ,   6 , 0 , 1 , 1 } , // 35 XOR AX,Iv
+  { 0 , 0x36 , 27 ,  10 , 0 , 1 , 0 } , // 36 SS:
+  { 1 , 0x37 , 29 ,   2 , 0 , 1 , 0 } , // 37 AAA
+  { 3 , 0x38 ,  9 ,   7 , 1 , 2 , 0 } , // 38 CMP Eb,Gb
+  { 3 , 0x39 , 64 ,   7 , 1 , 2 , 0 } , // 39 CMP Ev,Gv
+  { 3 , 0x3A ,  9 ,   7 , 1 , 2 , 0 } , // 3A CMP Gb,Eb
+  { 3 , 0x3B , 64 ,   7 , 1 , 2 , 0 } , // 3B CMP Gv,Ev
+  { 3 , 0x3C ,  7 ,   7 , 0 , 1 , 1 } , // 3C CMP AL,Ib
+  { 3 , 0x3D , 67 ,   7 , 0 , 1 , 1 } , // 3D CMP AX,Iv
+  { 0 , 0x3E , 27 ,  11 , 0 , 1 , 0 } , // 3E DS:
+  { 1 , 0x3F , 29 ,   0 , 0 , 1 , 0 } , // 3F AAS
+  { 1 , 0x40 ,  2 ,   0 , 0 , 1 , 0 } , // 40 INC AX
+  { 1 , 0x41 ,  2 ,   0 , 0 , 1 , 0 } , // 41 INC CX
+  { 1 , 0x42 ,  2 ,   0 , 0 , 1 , 0 } , // 42 INC DX
+  { 1 , 0x43 ,  2 ,   0 , 0 , 1 , 0 } , // 43 INC BX
+  { 1 , 0x44 ,  2 ,   0 , 0 , 1 , 0 } , // 44 INC SP
+  { 1 , 0x45 ,  2 ,   0 , 0 , 1 , 0 } , // 45 INC BP
+  { 1 , 0x46 ,  2 ,   0 , 0 , 1 , 0 } , // 46 INC SI
+  { 1 , 0x47 ,  2 ,   0 , 0 , 1 , 0 } , // 47 INC DI
+  { 1 , 0x48 ,  2 ,   1 , 0 , 1 , 0 } , // 48 DEC AX
+  { 1 , 0x49 ,  2 ,   1 , 0 , 1 , 0 } , // 49 DEC CX
+  { 1 , 0x4A ,  2 ,   1 , 0 , 1 , 0 } , // 4A DEC DX
+  { 1 , 0x4B ,  2 ,   1 , 0 , 1 , 0 } , // 4B DEC BX
+  { 1 , 0x4C ,  2 ,   1 , 0 , 1 , 0 } , // 4C DEC SP
+  { 1 , 0x4D ,  2 ,   1 , 0 , 1 , 0 } , // 4D DEC BP
+  { 1 , 0x4E ,  2 ,   1 , 0 , 1 , 0 } , // 4E DEC SI
+  { 1 , 0x4F ,  2 ,   1 , 0 , 1 , 0 } , // 4F DEC DI
+  { 0 , 0x50 ,  3 ,   0 , 0 , 1 , 0 } , // 50 PUSH AX
+  { 0 , 0x51 ,  3 ,   0 , 0 , 1 , 0 } , // 51 PUSH CX
+  { 0 , 0x52 ,  3 ,   0 , 0 , 1 , 0 } , // 52 PUSH DX
+  { 0 , 0x53 ,  3 ,   0 , 0 , 1 , 0 } , // 53 PUSH BX
+  { 0 , 0x54 ,  3 ,   0 , 0 , 1 , 0 } , // 54 PUSH SP
+  { 0 , 0x55 ,  3 ,   0 , 0 , 1 , 0 } , // 55 PUSH BP
+  { 0 , 0x56 ,  3 ,   0 , 0 , 1 , 0 } , // 56 PUSH SI
+  { 0 , 0x57 ,  3 ,   0 , 0 , 1 , 0 } , // 57 PUSH DI
+  { 0 , 0x58 ,  4 ,   0 , 0 , 1 , 0 } , // 58 POP AX
+  { 0 , 0x59 ,  4 ,   0 , 0 , 1 , 0 } , // 59 POP CX
+  { 0 , 0x5A ,  4 ,   0 , 0 , 1 , 0 } , // 5A POP DX
+  { 0 , 0x5B ,  4 ,   0 , 0 , 1 , 0 } , // 5B POP BX
+  { 0 , 0x5C ,  4 ,   0 , 0 , 1 , 0 } , // 5C POP SP
+  { 0 , 0x5D ,  4 ,   0 , 0 , 1 , 0 } , // 5D POP BP
+  { 0 , 0x5E ,  4 ,   0 , 0 , 1 , 0 } , // 5E POP SI
+  { 0 , 0x5F ,  4 ,   0 , 0 , 1 , 0 } , // 5F POP DI
+  { 0 , 0x60 , 53 ,   0 , 0 , 1 , 0 } , // 60 PUSHA
+  { 0 , 0x61 , 54 ,   0 , 0 , 1 , 0 } , // 61 POPA
+  { 0 , 0x62 , 55 ,  21 , 0 , 1 , 0 } , // 62 BOUND
+  { 0 , 0x63 , 70 ,  21 , 0 , 1 , 0 } , // 63 -
+  { 0 , 0x64 , 71 ,  21 , 0 , 1 , 0 } , // 64 -
+  { 0 , 0x65 , 71 ,  21 , 0 , 1 , 0 } , // 65 -
+  { 0 , 0x66 , 72 ,  21 , 0 , 1 , 0 } , // 66 -
+  { 0 , 0x67 , 72 ,  21 , 0 , 1 , 0 } , // 67 -
+  { 0 , 0x68 , 56 ,   0 , 0 , 3 , 0 } , // 68 PUSH Iv
+  { 0 , 0x69 , 58 ,   0 , 0 , 1 , 1 } , // 69 IMUL Gv,Ev,Iv
+  { 0 , 0x6A , 57 ,   0 , 0 , 2 , 0 } , // 6A PUSH Ib
+  { 0 , 0x6B , 58 ,   0 , 0 , 1 , 1 } , // 6B IMUL Gv,Ev,Ib
+  { 0 , 0x6C , 59 ,  21 , 0 , 1 , 0 } , // 6C INSB
+  { 0 , 0x6D , 59 ,  21 , 0 , 1 , 0 } , // 6D INSW
+  { 0 , 0x6E , 60 ,  21 , 0 , 1 , 0 } , // 6E OUTSB
+  { 0 , 0x6F , 60 ,  21 , 0 , 1 , 0 } , // 6F OUTSW
+  { 0 , 0x70 ,  0 ,  21 , 0 , 2 , 0 } , // 70 JO
+  { 0 , 0x71 ,  0 ,  21 , 0 , 2 , 0 } , // 71 JNO
+  { 0 , 0x72 ,  0 ,  21 , 0 , 2 , 0 } , // 72 JB
+  { 0 , 0x73 ,  0 ,  21 , 0 , 2 , 0 } , // 73 JNB
+  { 0 , 0x74 ,  0 ,  21 , 0 , 2 , 0 } , // 74 JZ
+  { 0 , 0x75 ,  0 ,  21 , 0 , 2 , 0 } , // 75 JNZ
+  { 0 , 0x76 ,  0 ,  21 , 0 , 2 , 0 } , // 76 JBE
+  { 0 , 0x77 ,  0 ,  21 , 0 , 2 , 0 } , // 77 JA
+  { 0 , 0x78 ,  0 ,  21 , 0 , 2 , 0 } , // 78 JS
+  { 0 , 0x79 ,  0 ,  21 , 0 , 2 , 0 } , // 79 JNS
+  { 0 , 0x7A ,  0 ,  21 , 0 , 2 , 0 } , // 7A JP
+  { 0 , 0x7B ,  0 ,  21 , 0 , 2 , 0 } , // 7B JNP
+  { 0 , 0x7C ,  0 ,  21 , 0 , 2 , 0 } , // 7C JL
+  { 0 , 0x7D ,  0 ,  21 , 0 , 2 , 0 } , // 7D JGE
+  { 0 , 0x7E ,  0 ,  21 , 0 , 2 , 0 } , // 7E JLE
+  { 0 , 0x7F ,  0 ,  21 , 0 , 2 , 0 } , // 7F JG
+  { 1 , 0x80 ,  8 ,   0 , 1 , 2 , 1 } , // 80 GRP1 Eb,Ib
+  { 1 , 0x81 , 65 ,   0 , 1 , 2 , 1 } , // 81 GRP1 Ev,Iv
+  { 1 , 0x82 ,  8 ,   0 , 1 , 2 , 1 } , // 82 GRP1 Eb,Ib
+  { 1 , 0x83 , 66 ,   0 , 1 , 2 , 1 } , // 83 GRP1 Ev,Ib
+  { 5 , 0x84 , 15 ,   0 , 1 , 2 , 0 } , // 84 TEST Eb,Gb
+  { 5 , 0x85 , 15 ,   0 , 1 , 2 , 0 } , // 85 TEST Ev,Gv
+  { 0 , 0x86 , 24 ,   0 , 1 , 2 , 0 } , // 86 XCHG Eb,Gb
+  { 0 , 0x87 , 24 ,   0 , 1 , 2 , 0 } , // 87 XCHG Ev,Gv
+  { 0 , 0x88 ,  9 ,   8 , 1 , 2 , 0 } , // 88 MOV Eb,Gb
+  { 0 , 0x89 , 64 ,   8 , 1 , 2 , 0 } , // 89 MOV Ev,Gv
+  { 0 , 0x8A ,  9 ,   8 , 1 , 2 , 0 } , // 8A MOV Gb,Eb
+  { 0 , 0x8B , 64 ,   8 , 1 , 2 , 0 } , // 8B MOV Gv,Ev
+  { 0 , 0x8C , 10 ,  12 , 1 , 2 , 0 } , // 8C MOV Ew,Sw
+  { 0 , 0x8D , 61 ,  12 , 1 , 2 , 0 } , // 8D LEA Gv,M
+  { 0 , 0x8E , 62 ,  12 , 1 , 2 , 0 } , // 8E MOV Sw,Ew
+  { 0 , 0x8F , 63 ,  12 , 1 , 2 , 0 } , // 8F POP Ev
+  { 0 , 0x90 , 16 ,   0 , 0 , 1 , 0 } , // 90 NOP
+  { 0 , 0x91 , 16 ,   0 , 0 , 1 , 0 } , // 91 XCHG CX,AX
+  { 0 , 0x92 , 16 ,   0 , 0 , 1 , 0 } , // 92 XCHG DX,AX
+  { 0 , 0x93 , 16 ,   0 , 0 , 1 , 0 } , // 93 XCHG BX,AX
+  { 0 , 0x94 , 16 ,   0 , 0 , 1 , 0 } , // 94 XCHG SP,AX
+  { 0 , 0x95 , 16 ,   0 , 0 , 1 , 0 } , // 95 XCHG BP,AX
+  { 0 , 0x96 , 16 ,   0 , 0 , 1 , 0 } , // 96 XCHG SI,AX
+  { 0 , 0x97 , 16 ,   0 , 0 , 1 , 0 } , // 97 XCHG DI,AX
+  { 0 , 0x98 , 30 ,   0 , 0 , 1 , 0 } , // 98 CBW
+  { 0 , 0x99 , 31 ,   0 , 0 , 1 , 0 } , // 99 CWD
+  { 0 , 0x9A , 32 ,   0 , 0 , 0 , 0 } , // 9A CALL Ap
+  { 0 , 0x9B , 69 ,   0 , 0 , 1 , 0 } , // 9B WAIT
+  { 0 , 0x9C , 33 ,   0 , 0 , 1 , 0 } , // 9C PUSHF
+  { 0 , 0x9D , 34 ,   0 , 0 , 1 , 0 } , // 9D POPF
+  { 0 , 0x9E , 35 , 255 , 0 , 1 , 0 } , // 9E SAHF
+  { 0 , 0x9F , 36 ,   0 , 0 , 1 , 0 } , // 9F LAHF
+  { 0 , 0xA0 , 11 ,   0 , 0 , 3 , 0 } , // A0 MOV AL,Ob
+  { 0 , 0xA1 , 11 ,   0 , 0 , 3 , 0 } , // A1 MOV AX,Ov
+  { 0 , 0xA2 , 11 ,   0 , 0 , 3 , 0 } , // A2 MOV Ob,AL
+  { 0 , 0xA3 , 11 ,   0 , 0 , 3 , 0 } , // A3 MOV Ov,AX
+  { 0 , 0xA4 , 17 ,   0 , 0 , 1 , 0 } , // A4 MOVSB
+  { 0 , 0xA5 , 17 ,   0 , 0 , 1 , 0 } , // A5 MOVSW
+  { 0 , 0xA6 , 18 ,   0 , 0 , 1 , 0 } , // A6 CMPSB
+  { 0 , 0xA7 , 18 ,   0 , 0 , 1 , 0 } , // A7 CMPSW
+  { 5 , 0xA8 , 47 ,   0 , 0 , 1 , 1 } , // A8 TEST AL,Ib
+  { 5 , 0xA9 , 47 ,   0 , 0 , 1 , 1 } , // A9 TEST AX,Iv
+  { 0 , 0xAA , 17 ,   1 , 0 , 1 , 0 } , // AA STOSB
+  { 0 , 0xAB , 17 ,   1 , 0 , 1 , 0 } , // AB STOSW
+  { 0 , 0xAC , 17 ,   2 , 0 , 1 , 0 } , // AC LODSB
+  { 0 , 0xAD , 17 ,   2 , 0 , 1 , 0 } , // AD LODSW
+  { 0 , 0xAE , 18 ,   1 , 0 , 1 , 0 } , // AE SCASB
+  { 0 , 0xAF , 18 ,   1 , 0 , 1 , 0 } , // AF SCASW
+  { 0 , 0xB0 ,  1 ,   0 , 0 , 1 , 1 } , // B0 MOV AL,Ib
+  { 0 , 0xB1 ,  1 ,   0 , 0 , 1 , 1 } , // B1 MOV CL,Ib
+  { 0 , 0xB2 ,  1 ,   0 , 0 , 1 , 1 } , // B2 MOV DL,Ib
+  { 0 , 0xB3 ,  1 ,   0 , 0 , 1 , 1 } , // B3 MOV BL,Ib
+  { 0 , 0xB4 ,  1 ,   0 , 0 , 1 , 1 } , // B4 MOV AH,Ib
+  { 0 , 0xB5 ,  1 ,   0 , 0 , 1 , 1 } , // B5 MOV CH,Ib
+  { 0 , 0xB6 ,  1 ,   0 , 0 , 1 , 1 } , // B6 MOV DH,Ib
+  { 0 , 0xB7 ,  1 ,   0 , 0 , 1 , 1 } , // B7 MOV BH,Ib
+  { 0 , 0xB8 , 68 ,   0 , 0 , 1 , 1 } , // B8 MOV AX,Iv
+  { 0 , 0xB9 , 68 ,   0 , 0 , 1 , 1 } , // B9 MOV CX,Iv
+  { 0 , 0xBA , 68 ,   0 , 0 , 1 , 1 } , // BA MOV DX,Iv
+  { 0 , 0xBB , 68 ,   0 , 0 , 1 , 1 } , // BB MOV BX,Iv
+  { 0 , 0xBC , 68 ,   0 , 0 , 1 , 1 } , // BC MOV SP,Iv
+  { 0 , 0xBD , 68 ,   0 , 0 , 1 , 1 } , // BD MOV BP,Iv
+  { 0 , 0xBE , 68 ,   0 , 0 , 1 , 1 } , // BE MOV SI,Iv
+  { 0 , 0xBF , 68 ,   0 , 0 , 1 , 1 } , // BF MOV DI,Iv
+  { 0 , 0xC0 , 12 ,   1 , 1 , 3 , 0 } , // C0 GRP2 Eb,Ib
+  { 0 , 0xC1 , 12 ,   1 , 1 , 3 , 0 } , // C1 GRP2 Ev,Ib
+  { 0 , 0xC2 , 19 ,   0 , 0 , 0 , 0 } , // C2 RET Iw
+  { 0 , 0xC3 , 19 ,   0 , 0 , 0 , 0 } , // C3 RET
+  { 0 , 0xC4 , 37 ,  16 , 1 , 2 , 0 } , // C4 LES Gv,Mp
+  { 0 , 0xC5 , 37 ,  22 , 1 , 2 , 0 } , // C5 LDS Gv,Mp
+  { 0 , 0xC6 , 20 ,   0 , 1 , 2 , 1 } , // C6 MOV Eb,Ib
+  { 0 , 0xC7 , 20 ,   0 , 1 , 2 , 1 } , // C7 MOV Ev,Iv
+  { 0 , 0xC8 , 51 ,   0 , 0 , 4 , 0 } , // C8 ENTER
+  { 0 , 0xC9 , 52 ,   0 , 0 , 1 , 0 } , // C9 LEAVE
+  { 0 , 0xCA , 19 ,   1 , 0 , 0 , 0 } , // CA RETF Iw
+  { 0 , 0xCB , 19 ,   1 , 0 , 0 , 0 } , // CB RETF
+  { 0 , 0xCC , 38 ,   0 , 0 , 0 , 0 } , // CC INT 3
+  { 0 , 0xCD , 39 , 255 , 0 , 0 , 0 } , // CD INT Ib
+  { 0 , 0xCE , 40 ,  48 , 0 , 0 , 0 } , // CE INTO
+  { 0 , 0xCF , 19 ,   2 , 0 , 0 , 0 } , // CF IRET
+  { 0 , 0xD0 , 12 ,   0 , 1 , 2 , 0 } , // D0 GRP2 Eb,1
+  { 0 , 0xD1 , 12 ,   0 , 1 , 2 , 0 } , // D1 GRP2 Ev,1
+  { 0 , 0xD2 , 12 ,   0 , 1 , 2 , 0 } , // D2 GRP2 Eb,CL
+  { 0 , 0xD3 , 12 ,   0 , 1 , 2 , 0 } , // D3 GRP2 Ev,CL
+  { 5 , 0xD4 , 41 , 255 , 0 , 2 , 0 } , // D4 AAM
+  { 5 , 0xD5 , 42 , 255 , 0 , 2 , 0 } , // D5 AAD
+  { 0 , 0xD6 , 43 ,  40 , 0 , 1 , 0 } , // D6 SALC
+  { 0 , 0xD7 , 44 ,  11 , 0 , 1 , 0 } , // D7 XLAT
+  { 0 , 0xD8 , 69 ,   3 , 1 , 2 , 0 } , // D8 ESC
+  { 0 , 0xD9 , 69 ,   3 , 1 , 2 , 0 } , // D9 ESC
+  { 0 , 0xDA , 69 ,   3 , 1 , 2 , 0 } , // DA ESC
+  { 0 , 0xDB , 69 ,   3 , 1 , 2 , 0 } , // DB ESC
+  { 0 , 0xDC , 69 ,   3 , 1 , 2 , 0 } , // DC ESC
+  { 0 , 0xDD , 69 ,   3 , 1 , 2 , 0 } , // DD ESC
+  { 0 , 0xDE , 69 ,   3 , 1 , 2 , 0 } , // DE ESC
+  { 0 , 0xDF , 69 ,   3 , 1 , 2 , 0 } , // DF ESC
+  { 0 , 0xE0 , 13 ,  43 , 0 , 2 , 0 } , // E0 LOOPNZ
+  { 0 , 0xE1 , 13 ,  43 , 0 , 2 , 0 } , // E1 LOOPZ
+  { 0 , 0xE2 , 13 ,  43 , 0 , 2 , 0 } , // E2 LOOP
+  { 0 , 0xE3 , 13 ,  43 , 0 , 2 , 0 } , // E3 JCXZ
+  { 0 , 0xE4 , 21 ,   0 , 0 , 2 , 0 } , // E4 IN AL,Ib
+  { 0 , 0xE5 , 21 ,   0 , 0 , 2 , 0 } , // E5 IN AX,Ib
+  { 0 , 0xE6 , 22 ,   0 , 0 , 2 , 0 } , // E6 OUT Ib,AL
+  { 0 , 0xE7 , 22 ,   0 , 0 , 2 , 0 } , // E7 OUT Ib,AX
+  { 0 , 0xE8 , 14 ,   0 , 0 , 0 , 0 } , // E8 CALL Jv
+  { 0 , 0xE9 , 14 ,   0 , 0 , 0 , 0 } , // E9 JMP Jv
+  { 0 , 0xEA , 14 ,   0 , 0 , 0 , 0 } , // EA JMP Ap
+  { 0 , 0xEB , 14 ,   0 , 0 , 0 , 0 } , // EB JMP Jb
+  { 0 , 0xEC , 21 ,   1 , 0 , 1 , 0 } , // EC IN AL,DX
+  { 0 , 0xED , 21 ,   1 , 0 , 1 , 0 } , // ED IN AX,DX
+  { 0 , 0xEE , 22 ,   1 , 0 , 1 , 0 } , // EE OUT DX,AL
+  { 0 , 0xEF , 22 ,   1 , 0 , 1 , 0 } , // EF OUT DX,AX
+  { 0 , 0xF0 , 48 ,   1 , 0 , 1 , 0 } , // F0 LOCK
+  { 0 , 0xF1 ,  0 ,  21 , 0 , 2 , 0 } , // F1 -
+  { 0 , 0xF2 , 23 ,   0 , 0 , 1 , 0 } , // F2 REPNZ
+  { 0 , 0xF3 , 23 ,   0 , 0 , 1 , 0 } , // F3 REPZ
+  { 0 , 0xF4 , 49 ,   2 , 0 , 1 , 0 } , // F4 HLT
+  { 0 , 0xF5 , 45 ,  40 , 0 , 1 , 0 } , // F5 CMC
+  { 0 , 0xF6 ,  6 ,  21 , 1 , 2 , 0 } , // F6 GRP3 Eb
+  { 0 , 0xF7 ,  6 ,  21 , 1 , 2 , 0 } , // F7 GRP3 Ev
+  { 0 , 0xF8 , 46 ,  80 , 0 , 1 , 0 } , // F8 CLC
+  { 0 , 0xF9 , 46 ,  81 , 0 , 1 , 0 } , // F9 STC
+  { 0 , 0xFA , 46 ,  92 , 0 , 1 , 0 } , // FA CLI
+  { 0 , 0xFB , 46 ,  93 , 0 , 1 , 0 } , // FB STI
+  { 0 , 0xFC , 46 ,  94 , 0 , 1 , 0 } , // FC CLD
+  { 0 , 0xFD , 46 ,  95 , 0 , 1 , 0 } , // FD STD
+  { 0 , 0xFE ,  5 ,   0 , 1 , 2 , 0 } , // FE GRP4 Eb
+  { 0 , 0xFF ,  5 ,   0 , 1 , 2 , 0 }   // FF GRP5 Ev
+} ;
+
+/**
+ * @brief Effective address of each r/m value, indexed by [ i_mod == 0 ][ i_rm ].
+ *
+ * Only i_mod 0, 1 and 2 address memory. With i_mod 0 r/m 6 is a direct
+ * 16-bit address and no register is used.
+ */
+constexpr stModRM_t xt_modrm_table[ 2 ][ 8 ] =
+{
+  // i_mod 1 and 2: [BX+SI+d], [BX+DI+d], [BP+SI+d], [BP+DI+d], [SI+d], [DI+d], [BP+d], [BX+d]
+  {
+    { 6 , 3 , 1 , 11 } , { 7 , 3 , 1 , 11 } , { 6 , 5 , 1 , 10 } , { 7 , 5 , 1 , 10 } ,
+    { 12 , 6 , 1 , 11 } , { 12 , 7 , 1 , 11 } , { 12 , 5 , 1 , 10 } , { 12 , 3 , 1 , 11 }
+  } ,
+  // i_mod 0: [BX+SI], [BX+DI], [BP+SI], [BP+DI], [SI], [DI], [d16], [BX]
+  {
+    { 6 , 3 , 0 , 11 } , { 7 , 3 , 0 , 11 } , { 6 , 5 , 0 , 10 } , { 7 , 5 , 0 , 10 } ,
+    { 12 , 6 , 0 , 11 } , { 12 , 7 , 0 , 11 } , { 12 , 12 , 1 , 11 } , { 12 , 3 , 0 , 11 }
+  }
+} ;
+
+/**
+ * @brief Parity flag of each byte value, 1 when the number of set bits is even.
+ */
+constexpr uint8_t xt_parity_table[ 256 ] =
+{
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  0 , 1 , 1 , 0 , 1 , 0 , 0 , 1 , 1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 ,
+  1 , 0 , 0 , 1 , 0 , 1 , 1 , 0 , 0 , 1 , 1 , 0 , 1 , 0 , 0 , 1
+} ;
+
+/**
+ * @brief Flags tested by each conditional jump, indexed by [ table ][ ( opcode >> 1 ) & 7 ].
+ *
+ * The jump is taken when ( A || B || C ^ D ) differs from the opcode low bit.
+ * The values are regs8[] offsets of the flags, 49 is the always-zero XF.
+ */
+constexpr uint8_t xt_jcc_table[ 4 ][ 8 ] =
+{
+  { 48 , 40 , 43 , 40 , 44 , 41 , 49 , 49 } , // A
+  { 49 , 49 , 49 , 43 , 49 , 49 , 49 , 43 } , // B
+  { 49 , 49 , 49 , 49 , 49 , 49 , 44 , 44 } , // C
+  { 49 , 49 , 49 , 49 , 49 , 49 , 48 , 48 }   // D
+} ;
+
+/**
+ * @brief Bit position in FLAGS of CF, PF, AF, ZF, SF, TF, IF, DF and OF.
+ */
+constexpr uint8_t xt_flags_bitfields[ 9 ] = { 0 , 2 , 4 , 6 , 7 , 8 , 9 , 10 , 11 } ;
+
+/**
+ * @brief 8088 clock count of one instruction form.
+ *
+ * reg : Clocks with a register (or no) operand.
+ * mem : Clocks with a memory operand, effective address calculation
+ *       excluded, see xt_ea_cycles. 0 if the opcode has no ModRM byte.
+ */
+typedef struct STCYCLES_T
+{
+  uint8_t  reg ;
+  uint8_t  mem ;
+} stCycles_t ;
+
+/**
+ * @brief 8088 clocks of every opcode byte, from the Intel 8086 family user's
+ * manual with 4 clocks added per word memory transfer on the 8-bit bus.
+ *
+ * Taken jumps, shift counts and repeated string instructions add clocks at
+ * run time. The group opcodes 80-83, F6, F7, FE and FF depend on the ModRM
+ * reg field and are 0 here, see xt_group_cycles.
+ */
+constexpr stCycles_t xt_cycles_table[ 256 ] =
+{
+  {   3 ,  16 } , // 00 ADD Eb,Gb
+  {   3 ,  24 } , // 01 ADD Ev,Gv
+  {   3 ,   9 } , // 02 ADD Gb,Eb
+  {   3 ,  13 } , // 03 ADD Gv,Ev
+  {   4 ,   0 } , // 04 ADD AL,Ib
+  {   4 ,   0 } , // 05 ADD AX,Iv
+  {  14 ,   0 } , // 06 PUSH ES
+  {  12 ,   0 } , // 07 POP ES
+  {   3 ,  16 } , // 08 OR Eb,Gb
+  {   3 ,  24 } , // 09 OR Ev,Gv
+  {   3 ,   9 } , // 0A OR Gb,Eb
+  {   3 ,  13 } , // 0B OR Gv,Ev
+  {   4 ,   0 } , // 0C OR AL,Ib
+  {   4 ,   0 } , // 0D OR AX,Iv
+  {  14 ,   0 } , // 0E PUSH CS
+  {   4 ,   0 } , // 0F (emulator specific)
+  {   3 ,  16 } , // 10 ADC Eb,Gb
+  {   3 ,  24 } , // 11 ADC Ev,Gv
+  {   3 ,   9 } , // 12 ADC Gb,Eb
+  {   3 ,  13 } , // 13 ADC Gv,Ev
+  {   4 ,   0 } , // 14 ADC AL,Ib
+  {   4 ,   0 } , // 15 ADC AX,Iv
+  {  14 ,   0 } , // 16 PUSH SS
+  {  12 ,   0 } , // 17 POP SS
+  {   3 ,  16 } , // 18 SBB Eb,Gb
+  {   3 ,  24 } , // 19 SBB Ev,Gv
+  {   3 ,   9 } , // 1A SBB Gb,Eb
+  {   3 ,  13 } , // 1B SBB Gv,Ev
+  {   4 ,   0 } , // 1C SBB AL,Ib
+  {   4 ,   0 } , // 1D SBB AX,Iv
+  {  14 ,   0 } , // 1E PUSH DS
+  {  12 ,   0 } , // 1F POP DS
+  {   3 ,  16 } , // 20 AND Eb,Gb
+  {   3 ,  24 } , // 21 AND Ev,Gv
+  {   3 ,   9 } , // 22 AND Gb,Eb
+  {   3 ,  13 } , // 23 AND Gv,Ev
+  {   4 ,   0 } , // 24 AND AL,Ib
+  {   4 ,   0 } , // 25 AND AX,Iv
+  {   2 ,   0 } , // 26 ES:
+  {   4 ,   0 } , // 27 DAA
+  {   3 ,  16 } , // 28 SUB Eb,Gb
+  {   3 ,  24 } , // 29 SUB Ev,Gv
+  {   3 ,   9 } , // 2A SUB Gb,Eb
+  {   3 ,  13 } , // 2B SUB Gv,Ev
+  {   4 ,   0 } , // 2C SUB AL,Ib
+  {   4 ,   0 } , // 2D SUB AX,Iv
+  {   2 ,   0 } , // 2E CS:
+  {   4 ,   0 } , // 2F DAS
+  {   3 ,  16 } , // 30 XOR Eb,Gb
+  {   3 ,  24 } , // 31 XOR Ev,Gv
+  {   3 ,   9 } , // 32 XOR Gb,Eb
+  {   3 ,  13 } , // 33 XOR Gv,Ev
+  {   4 ,   0 } , // 34 XOR AL,Ib
+  {   4 ,   0 } , // 35 XOR AX,Iv
+  {   2 ,   0 } , // 36 SS:
+  {   8 ,   0 } , // 37 AAA
+  {   3 ,   9 } , // 38 CMP Eb,Gb
+  {   3 ,  13 } , // 39 CMP Ev,Gv
+  {   3 ,   9 } , // 3A CMP Gb,Eb
+  {   3 ,  13 } , // 3B CMP Gv,Ev
+  {   4 ,   0 } , // 3C CMP AL,Ib
+  {   4 ,   0 } , // 3D CMP AX,Iv
+  {   2 ,   0 } , // 3E DS:
+  {   8 ,   0 } , // 3F AAS
+  {   3 ,   0 } , // 40 INC AX
+  {   3 ,   0 } , // 41 INC CX
+  {   3 ,   0 } , // 42 INC DX
+  {   3 ,   0 } , // 43 INC BX
+  {   3 ,   0 } , // 44 INC SP
+  {   3 ,   0 } , // 45 INC BP
+  {   3 ,   0 } , // 46 INC SI
+  {   3 ,   0 } , // 47 INC DI
+  {   3 ,   0 } , // 48 DEC AX
+  {   3 ,   0 } , // 49 DEC CX
+  {   3 ,   0 } , // 4A DEC DX
+  {   3 ,   0 } , // 4B DEC BX
+  {   3 ,   0 } , // 4C DEC SP
+  {   3 ,   0 } , // 4D DEC BP
+  {   3 ,   0 } , // 4E DEC SI
+  {   3 ,   0 } , // 4F DEC DI
+  {  15 ,   0 } , // 50 PUSH AX
+  {  15 ,   0 } , // 51 PUSH CX
+  {  15 ,   0 } , // 52 PUSH DX
+  {  15 ,   0 } , // 53 PUSH BX
+  {  15 ,   0 } , // 54 PUSH SP
+  {  15 ,   0 } , // 55 PUSH BP
+  {  15 ,   0 } , // 56 PUSH SI
+  {  15 ,   0 } , // 57 PUSH DI
+  {  12 ,   0 } , // 58 POP AX
+  {  12 ,   0 } , // 59 POP CX
+  {  12 ,   0 } , // 5A POP DX
+  {  12 ,   0 } , // 5B POP BX
+  {  12 ,   0 } , // 5C POP SP
+  {  12 ,   0 } , // 5D POP BP
+  {  12 ,   0 } , // 5E POP SI
+  {  12 ,   0 } , // 5F POP DI
+  {  68 ,   0 } , // 60 PUSHA
+  {  83 ,   0 } , // 61 POPA
+  {   0 ,  41 } , // 62 BOUND
+  {   4 ,   0 } , // 63 -
+  {   4 ,   0 } , // 64 -
+  {   4 ,   0 } , // 65 -
+  {   4 ,   0 } , // 66 -
+  {   4 ,   0 } , // 67 -
+  {  14 ,   0 } , // 68 PUSH Iv
+  {  24 ,  34 } , // 69 IMUL Gv,Ev,Iv
+  {  14 ,   0 } , // 6A PUSH Ib
+  {  24 ,  34 } , // 6B IMUL Gv,Ev,Ib
+  {  14 ,   0 } , // 6C INSB
+  {  18 ,   0 } , // 6D INSW
+  {  14 ,   0 } , // 6E OUTSB
+  {  18 ,   0 } , // 6F OUTSW
+  {   4 ,   0 } , // 70 JO
+  {   4 ,   0 } , // 71 JNO
+  {   4 ,   0 } , // 72 JB
+  {   4 ,   0 } , // 73 JNB
+  {   4 ,   0 } , // 74 JZ
+  {   4 ,   0 } , // 75 JNZ
+  {   4 ,   0 } , // 76 JBE
+  {   4 ,   0 } , // 77 JA
+  {   4 ,   0 } , // 78 JS
+  {   4 ,   0 } , // 79 JNS
+  {   4 ,   0 } , // 7A JP
+  {   4 ,   0 } , // 7B JNP
+  {   4 ,   0 } , // 7C JL
+  {   4 ,   0 } , // 7D JGE
+  {   4 ,   0 } , // 7E JLE
+  {   4 ,   0 } , // 7F JG
+  {   0 ,   0 } , // 80 GRP1 Eb,Ib
+  {   0 ,   0 } , // 81 GRP1 Ev,Iv
+  {   0 ,   0 } , // 82 GRP1 Eb,Ib
+  {   0 ,   0 } , // 83 GRP1 Ev,Ib
+  {   3 ,   9 } , // 84 TEST Eb,Gb
+  {   3 ,  13 } , // 85 TEST Ev,Gv
+  {   4 ,  17 } , // 86 XCHG Eb,Gb
+  {   4 ,  25 } , // 87 XCHG Ev,Gv
+  {   2 ,   9 } , // 88 MOV Eb,Gb
+  {   2 ,  13 } , // 89 MOV Ev,Gv
+  {   2 ,   8 } , // 8A MOV Gb,Eb
+  {   2 ,  12 } , // 8B MOV Gv,Ev
+  {   2 ,  13 } , // 8C MOV Ew,Sw
+  {   2 ,   2 } , // 8D LEA Gv,M
+  {   2 ,  12 } , // 8E MOV Sw,Ew
+  {  12 ,  25 } , // 8F POP Ev
+  {   3 ,   0 } , // 90 NOP
+  {   3 ,   0 } , // 91 XCHG CX,AX
+  {   3 ,   0 } , // 92 XCHG DX,AX
+  {   3 ,   0 } , // 93 XCHG BX,AX
+  {   3 ,   0 } , // 94 XCHG SP,AX
+  {   3 ,   0 } , // 95 XCHG BP,AX
+  {   3 ,   0 } , // 96 XCHG SI,AX
+  {   3 ,   0 } , // 97 XCHG DI,AX
+  {   2 ,   0 } , // 98 CBW
+  {   5 ,   0 } , // 99 CWD
+  {  36 ,   0 } , // 9A CALL Ap
+  {   4 ,   0 } , // 9B WAIT
+  {  14 ,   0 } , // 9C PUSHF
+  {  12 ,   0 } , // 9D POPF
+  {   4 ,   0 } , // 9E SAHF
+  {   4 ,   0 } , // 9F LAHF
+  {  10 ,   0 } , // A0 MOV AL,Ob
+  {  14 ,   0 } , // A1 MOV AX,Ov
+  {  10 ,   0 } , // A2 MOV Ob,AL
+  {  14 ,   0 } , // A3 MOV Ov,AX
+  {  18 ,   0 } , // A4 MOVSB
+  {  26 ,   0 } , // A5 MOVSW
+  {  22 ,   0 } , // A6 CMPSB
+  {  30 ,   0 } , // A7 CMPSW
+  {   4 ,   0 } , // A8 TEST AL,Ib
+  {   4 ,   0 } , // A9 TEST AX,Iv
+  {  11 ,   0 } , // AA STOSB
+  {  15 ,   0 } , // AB STOSW
+  {  12 ,   0 } , // AC LODSB
+  {  16 ,   0 } , // AD LODSW
+  {  15 ,   0 } , // AE SCASB
+  {  19 ,   0 } , // AF SCASW
+  {   4 ,   0 } , // B0 MOV AL,Ib
+  {   4 ,   0 } , // B1 MOV CL,Ib
+  {   4 ,   0 } , // B2 MOV DL,Ib
+  {   4 ,   0 } , // B3 MOV BL,Ib
+  {   4 ,   0 } , // B4 MOV AH,Ib
+  {   4 ,   0 } , // B5 MOV CH,Ib
+  {   4 ,   0 } , // B6 MOV DH,Ib
+  {   4 ,   0 } , // B7 MOV BH,Ib
+  {   4 ,   0 } , // B8 MOV AX,Iv
+  {   4 ,   0 } , // B9 MOV CX,Iv
+  {   4 ,   0 } , // BA MOV DX,Iv
+  {   4 ,   0 } , // BB MOV BX,Iv
+  {   4 ,   0 } , // BC MOV SP,Iv
+  {   4 ,   0 } , // BD MOV BP,Iv
+  {   4 ,   0 } , // BE MOV SI,Iv
+  {   4 ,   0 } , // BF MOV DI,Iv
+  {   5 ,  17 } , // C0 GRP2 Eb,Ib
+  {   5 ,  25 } , // C1 GRP2 Ev,Ib
+  {  24 ,   0 } , // C2 RET Iw
+  {  20 ,   0 } , // C3 RET
+  {   0 ,  24 } , // C4 LES Gv,Mp
+  {   0 ,  24 } , // C5 LDS Gv,Mp
+  {   4 ,  10 } , // C6 MOV Eb,Ib
+  {   4 ,  14 } , // C7 MOV Ev,Iv
+  {  23 ,   0 } , // C8 ENTER
+  {  12 ,   0 } , // C9 LEAVE
+  {  31 ,   0 } , // CA RETF Iw
+  {  32 ,   0 } , // CB RETF
+  {  72 ,   0 } , // CC INT 3
+  {  71 ,   0 } , // CD INT Ib
+  {   4 ,   0 } , // CE INTO
+  {  44 ,   0 } , // CF IRET
+  {   2 ,  15 } , // D0 GRP2 Eb,1
+  {   2 ,  23 } , // D1 GRP2 Ev,1
+  {   8 ,  20 } , // D2 GRP2 Eb,CL
+  {   8 ,  28 } , // D3 GRP2 Ev,CL
+  {  83 ,   0 } , // D4 AAM
+  {  60 ,   0 } , // D5 AAD
+  {   4 ,   0 } , // D6 SALC
+  {  11 ,   0 } , // D7 XLAT
+  {   2 ,   8 } , // D8 ESC
+  {   2 ,   8 } , // D9 ESC
+  {   2 ,   8 } , // DA ESC
+  {   2 ,   8 } , // DB ESC
+  {   2 ,   8 } , // DC ESC
+  {   2 ,   8 } , // DD ESC
+  {   2 ,   8 } , // DE ESC
+  {   2 ,   8 } , // DF ESC
+  {   5 ,   0 } , // E0 LOOPNZ
+  {   6 ,   0 } , // E1 LOOPZ
+  {   5 ,   0 } , // E2 LOOP
+  {   6 ,   0 } , // E3 JCXZ
+  {  10 ,   0 } , // E4 IN AL,Ib
+  {  14 ,   0 } , // E5 IN AX,Ib
+  {  10 ,   0 } , // E6 OUT Ib,AL
+  {  14 ,   0 } , // E7 OUT Ib,AX
+  {  23 ,   0 } , // E8 CALL Jv
+  {  15 ,   0 } , // E9 JMP Jv
+  {  15 ,   0 } , // EA JMP Ap
+  {  15 ,   0 } , // EB JMP Jb
+  {   8 ,   0 } , // EC IN AL,DX
+  {  12 ,   0 } , // ED IN AX,DX
+  {   8 ,   0 } , // EE OUT DX,AL
+  {  12 ,   0 } , // EF OUT DX,AX
+  {   2 ,   0 } , // F0 LOCK
+  {   4 ,   0 } , // F1 -
+  {   9 ,   0 } , // F2 REPNZ
+  {   9 ,   0 } , // F3 REPZ
+  {   2 ,   0 } , // F4 HLT
+  {   2 ,   0 } , // F5 CMC
+  {   0 ,   0 } , // F6 GRP3 Eb
+  {   0 ,   0 } , // F7 GRP3 Ev
+  {   2 ,   0 } , // F8 CLC
+  {   2 ,   0 } , // F9 STC
+  {   2 ,   0 } , // FA CLI
+  {   2 ,   0 } , // FB STI
+  {   2 ,   0 } , // FC CLD
+  {   2 ,   0 } , // FD STD
+  {   0 ,   0 } , // FE GRP4 Eb
+  {   0 ,   0 }   // FF GRP5 Ev
+} ;
+
+/**
+ * @brief 8088 clocks of the group opcodes, indexed by [ group ][ i_reg ].
+ *
+ * group is 0-3 for opcodes 80-83, 4 for F6, 5 for F7, 6 for FE and 7 for FF.
+ */
+constexpr stCycles_t xt_group_cycles[ 8 ][ 8 ] =
+{
+  // 80: ADD, OR, ADC, SBB, AND, SUB, XOR, CMP Eb,Ib
+  { {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  10 } } ,
+  // 81: ADD, OR, ADC, SBB, AND, SUB, XOR, CMP Ev,Iv
+  { {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  14 } } ,
+  // 82: as 80
+  { {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  17 } , {   4 ,  10 } } ,
+  // 83: as 81, sign extended Ib
+  { {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  25 } , {   4 ,  14 } } ,
+  // F6: TEST, TEST, NOT, NEG, MUL, IMUL, DIV, IDIV Eb
+  { {   5 ,  11 } , {   5 ,  11 } , {   3 ,  16 } , {   3 ,  16 } , {  77 ,  83 } , {  90 ,  96 } , {  90 ,  96 } , { 112 , 118 } } ,
+  // F7: TEST, TEST, NOT, NEG, MUL, IMUL, DIV, IDIV Ev
+  { {   5 ,  15 } , {   5 ,  15 } , {   3 ,  24 } , {   3 ,  24 } , { 133 , 143 } , { 154 , 164 } , { 162 , 172 } , { 184 , 194 } } ,
+  // FE: INC, DEC Eb
+  { {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } , {   3 ,  15 } } ,
+  // FF: INC, DEC, CALL, CALL FAR, JMP, JMP FAR, PUSH, PUSH Ev
+  { {   3 ,  23 } , {   3 ,  23 } , {  20 ,  29 } , {   0 ,  53 } , {  11 ,  22 } , {   0 ,  32 } , {  15 ,  24 } , {  15 ,  24 } }
+} ;
+
+/**
+ * @brief Effective address clocks of each r/m value, indexed by [ i_mod == 0 ][ i_rm ].
+ *
+ * A segment override prefix is an instruction of its own, 2 clocks.
+ */
+constexpr uint8_t xt_ea_cycles[ 2 ][ 8 ] =
+{
+  { 11 , 12 , 12 , 11 ,  9 ,  9 ,  9 ,  9 } , // i_mod 1 and 2
+  {  7 ,  8 ,  8 ,  7 ,  5 ,  5 ,  6 ,  5 }   // i_mod 0
+} ;
+
+/**
+ * @brief Clocks per repetition of the string instructions A4-AF under a REP
+ * prefix, 0 for TEST (A8, A9). The instruction adds 9 clocks once.
+ */
+constexpr uint8_t xt_rep_cycles[ 12 ] = { 17 , 25 , 22 , 30 , 0 , 0 , 10 , 14 , 13 , 17 , 15 , 19 } ;
+
+/**
+ * @brief How an instruction uses its memory operand.
+ *
+ * XT_MEM_READ  : The operand is read.
+ * XT_MEM_WRITE : The operand is written.
+ */
+ #define XT_MEM_READ                             1
+ #define XT_MEM_WRITE                            2
+ #define XT_MEM_RW                               ( XT_MEM_READ | XT_MEM_WRITE )
+
+/**
+ * @brief Use of the r/m (or direct address) memory operand of every opcode
+ * byte, 0 if it has none or does not access it (LEA, ESC).
+ *
+ * The group opcodes 80-83, F6, F7, FE and FF depend on the ModRM reg field
+ * and are 0 here, see xt_group_mem_access.
+ */
+constexpr uint8_t xt_mem_access[ 256 ] =
+{
+  XT_MEM_RW    , // 00 ADD Eb,Gb
+  XT_MEM_RW    , // 01 ADD Ev,Gv
+  XT_MEM_READ  , // 02 ADD Gb,Eb
+  XT_MEM_READ  , // 03 ADD Gv,Ev
+  0            , // 04 ADD AL,Ib
+  0            , // 05 ADD AX,Iv
+  0            , // 06 PUSH ES
+  0            , // 07 POP ES
+  XT_MEM_RW    , // 08 OR Eb,Gb
+  XT_MEM_RW    , // 09 OR Ev,Gv
+  XT_MEM_READ  , // 0A OR Gb,Eb
+  XT_MEM_READ  , // 0B OR Gv,Ev
+  0            , // 0C OR AL,Ib
+  0            , // 0D OR AX,Iv
+  0            , // 0E PUSH CS
+  0            , // 0F (emulator specific)
+  XT_MEM_RW    , // 10 ADC Eb,Gb
+  XT_MEM_RW    , // 11 ADC Ev,Gv
+  XT_MEM_READ  , // 12 ADC Gb,Eb
+  XT_MEM_READ  , // 13 ADC Gv,Ev
+  0            , // 14 ADC AL,Ib
+  0            , // 15 ADC AX,Iv
+  0            , // 16 PUSH SS
+  0            , // 17 POP SS
+  XT_MEM_RW    , // 18 SBB Eb,Gb
+  XT_MEM_RW    , // 19 SBB Ev,Gv
+  XT_MEM_READ  , // 1A SBB Gb,Eb
+  XT_MEM_READ  , // 1B SBB Gv,Ev
+  0            , // 1C SBB AL,Ib
+  0            , // 1D SBB AX,Iv
+  0            , // 1E PUSH DS
+  0            , // 1F POP DS
+  XT_MEM_RW    , // 20 AND Eb,Gb
+  XT_MEM_RW    , // 21 AND Ev,Gv
+  XT_MEM_READ  , // 22 AND Gb,Eb
+  XT_MEM_READ  , // 23 AND Gv,Ev
+  0            , // 24 AND AL,Ib
+  0            , // 25 AND AX,Iv
+  0            , // 26 ES:
+  0            , // 27 DAA
+  XT_MEM_RW    , // 28 SUB Eb,Gb
+  XT_MEM_RW    , // 29 SUB Ev,Gv
+  XT_MEM_READ  , // 2A SUB Gb,Eb
+  XT_MEM_READ  , // 2B SUB Gv,Ev
+  0            , // 2C SUB AL,Ib
+  0            , // 2D SUB AX,Iv
+  0            , // 2E CS:
+  0            , // 2F DAS
+  XT_MEM_RW    , // 30 XOR Eb,Gb
+  XT_MEM_RW    , // 31 XOR Ev,Gv
+  XT_MEM_READ  , // 32 XOR Gb,Eb
+  XT_MEM_READ  , // 33 XOR Gv,Ev
+  0            , // 34 XOR AL,Ib
+  0            , // 35 XOR AX,Iv
+  0            , // 36 SS:
+  0            , // 37 AAA
+  XT_MEM_READ  , // 38 CMP Eb,Gb
+  XT_MEM_READ  , // 39 CMP Ev,Gv
+  XT_MEM_READ  , // 3A CMP Gb,Eb
+  XT_MEM_READ  , // 3B CMP Gv,Ev
+  0            , // 3C CMP AL,Ib
+  0            , // 3D CMP AX,Iv
+  0            , // 3E DS:
+  0            , // 3F AAS
+  0            , // 40 INC AX
+  0            , // 41 INC CX
+  0            , // 42 INC DX
+  0            , // 43 INC BX
+  0            , // 44 INC SP
+  0            , // 45 INC BP
+  0            , // 46 INC SI
+  0            , // 47 INC DI
+  0            , // 48 DEC AX
+  0            , // 49 DEC CX
+  0            , // 4A DEC DX
+  0            , // 4B DEC BX
+  0            , // 4C DEC SP
+  0            , // 4D DEC BP
+  0            , // 4E DEC SI
+  0            , // 4F DEC DI
+  0            , // 50 PUSH AX
+  0            , // 51 PUSH CX
+  0            , // 52 PUSH DX
+  0            , // 53 PUSH BX
+  0            , // 54 PUSH SP
+  0            , // 55 PUSH BP
+  0            , // 56 PUSH SI
+  0            , // 57 PUSH DI
+  0            , // 58 POP AX
+  0            , // 59 POP CX
+  0            , // 5A POP DX
+  0            , // 5B POP BX
+  0            , // 5C POP SP
+  0            , // 5D POP BP
+  0            , // 5E POP SI
+  0            , // 5F POP DI
+  0            , // 60 PUSHA
+  0            , // 61 POPA
+  0            , // 62 BOUND
+  0            , // 63 -
+  0            , // 64 -
+  0            , // 65 -
+  0            , // 66 -
+  0            , // 67 -
+  0            , // 68 PUSH Iv
+  0            , // 69 IMUL Gv,Ev,Iv
+  0            , // 6A PUSH Ib
+  0            , // 6B IMUL Gv,Ev,Ib
+  0            , // 6C INSB
+  0            , // 6D INSW
+  0            , // 6E OUTSB
+  0            , // 6F OUTSW
+  0            , // 70 JO
+  0            , // 71 JNO
+  0            , // 72 JB
+  0            , // 73 JNB
+  0            , // 74 JZ
+  0            , // 75 JNZ
+  0            , // 76 JBE
+  0            , // 77 JA
+  0            , // 78 JS
+  0            , // 79 JNS
+  0            , // 7A JP
+  0            , // 7B JNP
+  0            , // 7C JL
+  0            , // 7D JGE
+  0            , // 7E JLE
+  0            , // 7F JG
+  0            , // 80 GRP1 Eb,Ib
+  0            , // 81 GRP1 Ev,Iv
+  0            , // 82 GRP1 Eb,Ib
+  0            , // 83 GRP1 Ev,Ib
+  XT_MEM_READ  , // 84 TEST Eb,Gb
+  XT_MEM_READ  , // 85 TEST Ev,Gv
+  XT_MEM_RW    , // 86 XCHG Eb,Gb
+  XT_MEM_RW    , // 87 XCHG Ev,Gv
+  XT_MEM_WRITE , // 88 MOV Eb,Gb
+  XT_MEM_WRITE , // 89 MOV Ev,Gv
+  XT_MEM_READ  , // 8A MOV Gb,Eb
+  XT_MEM_READ  , // 8B MOV Gv,Ev
+  XT_MEM_WRITE , // 8C MOV Ew,Sw
+  0            , // 8D LEA Gv,M
+  XT_MEM_READ  , // 8E MOV Sw,Ew
+  XT_MEM_WRITE , // 8F POP Ev
+  0            , // 90 NOP
+  0            , // 91 XCHG CX,AX
+  0            , // 92 XCHG DX,AX
+  0            , // 93 XCHG BX,AX
+  0            , // 94 XCHG SP,AX
+  0            , // 95 XCHG BP,AX
+  0            , // 96 XCHG SI,AX
+  0            , // 97 XCHG DI,AX
+  0            , // 98 CBW
+  0            , // 99 CWD
+  0            , // 9A CALL Ap
+  0            , // 9B WAIT
+  0            , // 9C PUSHF
+  0            , // 9D POPF
+  0            , // 9E SAHF
+  0            , // 9F LAHF
+  XT_MEM_READ  , // A0 MOV AL,Ob
+  XT_MEM_READ  , // A1 MOV AX,Ov
+  XT_MEM_WRITE , // A2 MOV Ob,AL
+  XT_MEM_WRITE , // A3 MOV Ov,AX
+  0            , // A4 MOVSB
+  0            , // A5 MOVSW
+  0            , // A6 CMPSB
+  0            , // A7 CMPSW
+  0            , // A8 TEST AL,Ib
+  0            , // A9 TEST AX,Iv
+  0            , // AA STOSB
+  0            , // AB STOSW
+  0            , // AC LODSB
+  0            , // AD LODSW
+  0            , // AE SCASB
+  0            , // AF SCASW
+  0            , // B0 MOV AL,Ib
+  0            , // B1 MOV CL,Ib
+  0            , // B2 MOV DL,Ib
+  0            , // B3 MOV BL,Ib
+  0            , // B4 MOV AH,Ib
+  0            , // B5 MOV CH,Ib
+  0            , // B6 MOV DH,Ib
+  0            , // B7 MOV BH,Ib
+  0            , // B8 MOV AX,Iv
+  0            , // B9 MOV CX,Iv
+  0            , // BA MOV DX,Iv
+  0            , // BB MOV BX,Iv
+  0            , // BC MOV SP,Iv
+  0            , // BD MOV BP,Iv
+  0            , // BE MOV SI,Iv
+  0            , // BF MOV DI,Iv
+  XT_MEM_RW    , // C0 GRP2 Eb,Ib
+  XT_MEM_RW    , // C1 GRP2 Ev,Ib
+  0            , // C2 RET Iw
+  0            , // C3 RET
+  XT_MEM_READ  , // C4 LES Gv,Mp
+  XT_MEM_READ  , // C5 LDS Gv,Mp
+  XT_MEM_WRITE , // C6 MOV Eb,Ib
+  XT_MEM_WRITE , // C7 MOV Ev,Iv
+  0            , // C8 ENTER
+  0            , // C9 LEAVE
+  0            , // CA RETF Iw
+  0            , // CB RETF
+  0            , // CC INT 3
+  0            , // CD INT Ib
+  0            , // CE INTO
+  0            , // CF IRET
+  XT_MEM_RW    , // D0 GRP2 Eb,1
+  XT_MEM_RW    , // D1 GRP2 Ev,1
+  XT_MEM_RW    , // D2 GRP2 Eb,CL
+  XT_MEM_RW    , // D3 GRP2 Ev,CL
+  0            , // D4 AAM
+  0            , // D5 AAD
+  0            , // D6 SALC
+  0            , // D7 XLAT
+  0            , // D8 ESC
+  0            , // D9 ESC
+  0            , // DA ESC
+  0            , // DB ESC
+  0            , // DC ESC
+  0            , // DD ESC
+  0            , // DE ESC
+  0            , // DF ESC
+  0            , // E0 LOOPNZ
+  0            , // E1 LOOPZ
+  0            , // E2 LOOP
+  0            , // E3 JCXZ
+  0            , // E4 IN AL,Ib
+  0            , // E5 IN AX,Ib
+  0            , // E6 OUT Ib,AL
+  0            , // E7 OUT Ib,AX
+  0            , // E8 CALL Jv
+  0            , // E9 JMP Jv
+  0            , // EA JMP Ap
+  0            , // EB JMP Jb
+  0            , // EC IN AL,DX
+  0            , // ED IN AX,DX
+  0            , // EE OUT DX,AL
+  0            , // EF OUT DX,AX
+  0            , // F0 LOCK
+  0            , // F1 -
+  0            , // F2 REPNZ
+  0            , // F3 REPZ
+  0            , // F4 HLT
+  0            , // F5 CMC
+  0            , // F6 GRP3 Eb
+  0            , // F7 GRP3 Ev
+  0            , // F8 CLC
+  0            , // F9 STC
+  0            , // FA CLI
+  0            , // FB STI
+  0            , // FC CLD
+  0            , // FD STD
+  0            , // FE GRP4 Eb
+  0              // FF GRP5 Ev
+} ;
+
+/**
+ * @brief Use of the memory operand by the group opcodes, indexed by
+ * [ group ][ i_reg ] as xt_group_cycles.
+ */
+constexpr uint8_t xt_group_mem_access[ 8 ][ 8 ] =
+{
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ } , // 80
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ } , // 81
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ } , // 82
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ } , // 83
+  { XT_MEM_READ , XT_MEM_READ , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ } , // F6
+  { XT_MEM_READ , XT_MEM_READ , XT_MEM_RW , XT_MEM_RW , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ } , // F7
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ } , // FE
+  { XT_MEM_RW , XT_MEM_RW , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ , XT_MEM_READ }   // FF
+} ;
+
+#endif // _XTDECODE_
@@ -0,0 +1,370 @@
+/**
+ * @file XTjit.h
+ * @brief x86-64 machine code emitter used by the dynamic translator.
+ *
+ * The translator in 8086tiny_new.cpp turns hot blocks of 8086 code into
+ * x86-64 host code. This file only knows how to encode the few host
+ * instructions it needs; what they mean for the guest is decided there.
+ *
+ * Translated code runs with a fixed register assignment:
+ *
+ *   rbx : The CPU register file, see regfile_t. Other CPU8086 members are
+ *         reached with their offset from it.
+ *   r12 : Guest memory, mem[ 0 ].
+ *   rcx : Linear address of the guest memory operand, if any.
+ *   rax : Destination operand and result (al/ax).
+ *   rdx : Source operand (dl/dx) and scratch.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTJIT_
+ #define _XTJIT_
+
+ #include <stdint.h>
+ #include <string.h>
+
+/**
+ * @brief Host registers, by their x86 encoding.
+ */
+ #define JIT_EAX                                 0
+ #define JIT_ECX                                 1
+ #define JIT_EDX                                 2
+
+/**
+ * @brief Host condition codes, as used by Jcc/SETcc.
+ */
+ #define JIT_CC_O                                0x0
+ #define JIT_CC_C                                0x2
+ #define JIT_CC_Z                                0x4
+ #define JIT_CC_NZ                               0x5
+ #define JIT_CC_S                                0x8
+ #define JIT_CC_P                                0xA
+ #define JIT_CC_L                                0xC
+
+/**
+ * @brief Kinds of guest operand.
+ *
+ * JIT_OPERAND_REG : Byte offset in the register file.
+ * JIT_OPERAND_MEM : Guest memory at the linear address in rcx.
+ * JIT_OPERAND_IMM : Immediate value.
+ */
+ #define JIT_OPERAND_REG                         0
+ #define JIT_OPERAND_MEM                         1
+ #define JIT_OPERAND_IMM                         2
+
+/**
+ * @brief One guest operand of a translated instruction.
+ */
+typedef struct STJITOPERAND_T
+{
+  uint8_t  kind  ;
+  int32_t  value ; // Register file offset or immediate value
+} stJitOperand_t ;
+
+/**
+ * @brief Writes x86-64 instructions at a moving code pointer.
+ *
+ * The caller makes sure there is room for what it emits.
+ */
+class XTJitEmitter
+{
+public:
+  uint8_t * p ;
+
+  void b( uint8_t v )  { *p++ = v ; }
+  void w( uint16_t v ) { memcpy( p , &v , 2 ) ; p += 2 ; }
+  void d( uint32_t v ) { memcpy( p , &v , 4 ) ; p += 4 ; }
+  void q( uint64_t v ) { memcpy( p , &v , 8 ) ; p += 8 ; }
+
+  /**
+   * @brief ModRM (and displacement) for [rbx + disp].
+   */
+  void rf( uint8_t reg , int32_t disp )
+  {
+    if( ( disp >= -128 ) && ( disp <= 127 ) )
+    {
+      b( 0x43 | ( reg << 3 ) ) ;
+      b( ( uint8_t ) disp ) ;
+    }
+    else
+    {
+      b( 0x83 | ( reg << 3 ) ) ;
+      d( ( uint32_t ) disp ) ;
+    }
+  }
+
+  /**
+   * @brief ModRM and SIB for [r12 + rcx]. Needs REX.B.
+   */
+  void guest( uint8_t reg )
+  {
+    b( 0x04 | ( reg << 3 ) ) ;
+    b( 0x0C ) ;
+  }
+
+  /**
+   * @brief ModRM, SIB and displacement for [rbx + index + disp].
+   */
+  void rf_index( uint8_t reg , uint8_t index , int32_t disp )
+  {
+    b( 0x84 | ( reg << 3 ) ) ;
+    b( ( index << 3 ) | 0x03 ) ;
+    d( ( uint32_t ) disp ) ;
+  }
+
+  /**
+   * @brief ModRM, SIB and displacement for [r12 + disp]. Needs REX.B.
+   */
+  void guest_abs( uint8_t reg , uint32_t disp )
+  {
+    b( 0x84 | ( reg << 3 ) ) ;
+    b( 0x24 ) ;
+    d( disp ) ;
+  }
+
+  /**
+   * @brief Emits an instruction with a register file or guest memory operand.
+   *
+   * @param w16    Operand size prefix.
+   * @param opcode One or two opcode bytes, 0x0Fxx for the latter.
+   * @param reg    ModRM reg field.
+   * @param op     JIT_OPERAND_REG or JIT_OPERAND_MEM operand.
+   */
+  void op_rm( bool w16 , uint16_t opcode , uint8_t reg , const stJitOperand_t & op )
+  {
+    if( w16 )
+    {
+      b( 0x66 ) ;
+    }
+
+    if( op.kind == JIT_OPERAND_MEM )
+    {
+      b( 0x41 ) ;
+    }
+
+    if( opcode > 0xFF )
+    {
+      b( opcode >> 8 ) ;
+    }
+    b( ( uint8_t ) opcode ) ;
+
+    if( op.kind == JIT_OPERAND_MEM )
+    {
+      guest( reg ) ;
+    }
+    else
+    {
+      rf( reg , op.value ) ;
+    }
+  }
+
+  /**
+   * @brief mov al/ax, operand. Immediates are loaded as 32 bits.
+   */
+  void load( bool w16 , uint8_t reg , const stJitOperand_t & op )
+  {
+    if( op.kind == JIT_OPERAND_IMM )
+    {
+      b( 0xB8 + reg ) ;
+      d( ( uint32_t ) op.value ) ;
+    }
+    else
+    {
+      op_rm( w16 , ( w16 ) ? ( 0x8B ) : ( 0x8A ) , reg , op ) ;
+    }
+  }
+
+  /**
+   * @brief mov operand, al/ax.
+   */
+  void store( bool w16 , uint8_t reg , const stJitOperand_t & op )
+  {
+    op_rm( w16 , ( w16 ) ? ( 0x89 ) : ( 0x88 ) , reg , op ) ;
+  }
+
+  /**
+   * @brief 8086 ALU operation 0..7 (ADD..CMP) of al/ax with dl/dx.
+   */
+  void alu( uint8_t alu_op , bool w16 )
+  {
+    if( w16 )
+    {
+      b( 0x66 ) ;
+    }
+    b( ( alu_op << 3 ) | ( w16 ) ) ;
+    b( 0xC0 | ( JIT_EDX << 3 ) | JIT_EAX ) ;
+  }
+
+  /**
+   * @brief setcc byte [rbx + disp].
+   */
+  void setcc( uint8_t cc , int32_t disp )
+  {
+    b( 0x0F ) ;
+    b( 0x90 + cc ) ;
+    rf( 0 , disp ) ;
+  }
+
+  /**
+   * @brief movzx reg, word [rbx + disp].
+   */
+  void movzx_rf( uint8_t reg , int32_t disp )
+  {
+    b( 0x0F ) ;
+    b( 0xB7 ) ;
+    rf( reg , disp ) ;
+  }
+
+  /**
+   * @brief mov word [rbx + disp], reg16.
+   */
+  void store16_rf( uint8_t reg , int32_t disp )
+  {
+    b( 0x66 ) ;
+    b( 0x89 ) ;
+    rf( reg , disp ) ;
+  }
+
+  /**
+   * @brief mov byte [rbx + disp], imm8.
+   */
+  void mov8_rf_imm( int32_t disp , uint8_t imm )
+  {
+    b( 0xC6 ) ;
+    rf( 0 , disp ) ;
+    b( imm ) ;
+  }
+
+  /**
+   * @brief mov word [rbx + disp], imm16.
+   */
+  void mov16_rf_imm( int32_t disp , uint16_t imm )
+  {
+    b( 0x66 ) ;
+    b( 0xC7 ) ;
+    rf( 0 , disp ) ;
+    w( imm ) ;
+  }
+
+  /**
+   * @brief Group 1 operation (0 add, 5 sub, 7 cmp) of dword [rbx + disp] with imm32.
+   */
+  void grp1_32_rf_imm( uint8_t alu_op , int32_t disp , uint32_t imm )
+  {
+    b( 0x81 ) ;
+    rf( alu_op , disp ) ;
+    d( imm ) ;
+  }
+
+  /**
+   * @brief Group 1 operation of reg32 with imm32.
+   */
+  void grp1_32_r_imm( uint8_t alu_op , uint8_t reg , uint32_t imm )
+  {
+    b( 0x81 ) ;
+    b( 0xC0 | ( alu_op << 3 ) | reg ) ;
+    d( imm ) ;
+  }
+
+  /**
+   * @brief Byte operation 0x02 (add), 0x0A (or), 0x32 (xor) of al with [rbx + disp].
+   */
+  void op8_al_rf( uint8_t opcode , int32_t disp )
+  {
+    b( opcode ) ;
+    rf( JIT_EAX , disp ) ;
+  }
+
+  /**
+   * @brief add dst32, src32.
+   */
+  void add_r_r( uint8_t dst , uint8_t src )
+  {
+    b( 0x01 ) ;
+    b( 0xC0 | ( src << 3 ) | dst ) ;
+  }
+
+  /**
+   * @brief movzx dst32, src16.
+   */
+  void movzx_r_r16( uint8_t dst , uint8_t src )
+  {
+    b( 0x0F ) ;
+    b( 0xB7 ) ;
+    b( 0xC0 | ( dst << 3 ) | src ) ;
+  }
+
+  /**
+   * @brief mov dst32, src32.
+   */
+  void mov_r_r( uint8_t dst , uint8_t src )
+  {
+    b( 0x89 ) ;
+    b( 0xC0 | ( src << 3 ) | dst ) ;
+  }
+
+  /**
+   * @brief shl reg32, imm8.
+   */
+  void shl_r_imm( uint8_t reg , uint8_t imm )
+  {
+    b( 0xC1 ) ;
+    b( 0xE0 | reg ) ;
+    b( imm ) ;
+  }
+
+  /**
+   * @brief shr reg32, imm8.
+   */
+  void shr_r_imm( uint8_t reg , uint8_t imm )
+  {
+    b( 0xC1 ) ;
+    b( 0xE8 | reg ) ;
+    b( imm ) ;
+  }
+
+  /**
+   * @brief Jcc rel32. Returns the rel32 field for link().
+   */
+  uint8_t * jcc( uint8_t cc )
+  {
+    uint8_t * site ;
+
+    b( 0x0F ) ;
+    b( 0x80 + cc ) ;
+    site = p ;
+    d( 0 ) ;
+
+    return( site ) ;
+  }
+
+  /**
+   * @brief JMP rel32. Returns the rel32 field for link().
+   */
+  uint8_t * jmp( void )
+  {
+    uint8_t * site ;
+
+    b( 0xE9 ) ;
+    site = p ;
+    d( 0 ) ;
+
+    return( site ) ;
+  }
+
+  /**
+   * @brief Points the rel32 field of a jump at target.
+   */
+  static void link( uint8_t * site , const uint8_t * target )
+  {
+    int32_t rel ;
+
+    rel = ( int32_t ) ( target - ( site + 4 ) ) ;
+    memcpy( site , &rel , 4 ) ;
+  }
+} ;
+
+#endif // _XTJIT_
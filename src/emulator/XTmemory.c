@@ -1,4 +0,0 @@
-#include "XTmemory.h"
-
-unsigned char mem[ RAM_SIZE ] ;
-unsigned char io_ports[ IO_PORT_COUNT ] ;
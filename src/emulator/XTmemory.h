@@ -5,8 +5,8 @@
  * @version 0
  * @brief Header file of memory control library.
  *
- * This library controls the Emulator memory. It'll provide 1MB of RAM memory
- * and 64K of IO.
+ * This library defines the Emulator memory: 1MB of RAM memory and 64K of IO.
+ * The memory itself is owned by each emulated machine (see CPU8086).
  *
  * Based on:
  * 8086tiny:
@@ -25,7 +25,60 @@
  #define RAM_SIZE                                0x10FFF0 // 1M + 65,520 B
  #define IO_PORT_COUNT                           0x10000  // 64KB
 
-extern unsigned char mem[] ;
-extern unsigned char io_ports[] ;
+/**
+ * @brief Memory map.
+ *
+ * The address space is split in pages of MEM_PAGE_SIZE bytes and each page
+ * has one of the MEM_PAGE_xx types below, see CPU8086::MapMemory(). RAM
+ * pages are read and written directly in the emulator memory. Everything
+ * else is reached through the CPU's bounce buffer, MEM_BOUNCE_SIZE bytes
+ * just past RAM_SIZE, so the instruction handlers never need to know.
+ *
+ * MEM_FETCH_SLACK bytes follow the bounce buffer. An instruction at
+ * FFFF:FFFF starts at RAM_SIZE - 1, and fetching it reads 8 bytes from
+ * there, see fetch_instruction(). The slack keeps that read inside the
+ * emulator memory.
+ *
+ * MEM_PAGE_RAM   : Plain RAM.
+ * MEM_PAGE_ROM   : Read only, writes are ignored.
+ * MEM_PAGE_VIDEO : Video RAM, read and written through the interface's
+ *                  VMemRead()/VMemWrite() for the MCGA latches and write
+ *                  modes.
+ */
+ #define MEM_PAGE_BITS                           12
+ #define MEM_PAGE_SIZE                           ( 1 << MEM_PAGE_BITS )
+ #define MEM_PAGE_COUNT                          ( ( RAM_SIZE + MEM_PAGE_SIZE - 1 ) >> MEM_PAGE_BITS )
+
+ #define MEM_PAGE_RAM                            0
+ #define MEM_PAGE_ROM                            1
+ #define MEM_PAGE_VIDEO                          2
+
+ #define MEM_BOUNCE_SIZE                         4
+ #define MEM_FETCH_SLACK                         8
+
+/**
+ * @brief Size of the dirty page bitmap, see CPU8086::GetDirtyPages().
+ */
+ #define MEM_DIRTY_BITMAP_SIZE                   ( ( MEM_PAGE_COUNT + 7 ) / 8 )
+
+/**
+ * @brief Dirty page map bits, one for each reader of the map.
+ *
+ * A store to a page sets all of them and each reader clears its own.
+ *
+ * MEM_DIRTY_USER   : CPU8086::GetDirtyPages().
+ * MEM_DIRTY_REWIND : Rewind checkpoints.
+ */
+ #define MEM_DIRTY_USER                          0x01
+ #define MEM_DIRTY_REWIND                        0x02
+ #define MEM_DIRTY_ALL                           0xFF
+
+/**
+ * @brief Video RAM windows: MCGA graphics at A000 and CGA at B800.
+ */
+ #define MEM_VIDEO_MCGA_BASE                     0xA0000
+ #define MEM_VIDEO_MCGA_SIZE                     0x10000
+ #define MEM_VIDEO_CGA_BASE                      0xB8000
+ #define MEM_VIDEO_CGA_SIZE                      0x8000
 
 #endif // _XTMEMORY_
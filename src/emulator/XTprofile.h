@@ -0,0 +1,70 @@
+/**
+ * @file XTprofile.h
+ * @brief Guest profiler.
+ *
+ * The profiler samples the guest every so many CPU clocks, see
+ * CPU8086::ProfileEnable(). Each sample counts the linear address of CS:IP,
+ * the opcode of the instruction there and, while CS is the BIOS segment,
+ * the BIOS service it is in. The service is the interrupt vector whose BIOS
+ * entry point is the nearest one at or below IP, so helper code that follows
+ * a handler counts towards that handler. Entry points are remembered from
+ * the vector table as they are seen, so a service still counts after DOS or
+ * a TSR has hooked its vector.
+ *
+ * A sample is taken between two instructions, so it counts the instruction
+ * about to run rather than the one that used up the clocks.
+ *
+ * A symbol map names guest code for the report. Each line holds a segment
+ * and offset in hex and a name, "SSSS:OOOO name", and a symbol covers the
+ * addresses from its own up to the next symbol, at most 64KB. Blank lines
+ * and lines starting with ; or # are skipped. A DOS program is loaded at a
+ * segment that depends on what is loaded before it, so its map has to use
+ * the segment it runs at.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTPROFILE_
+ #define _XTPROFILE_
+
+ #include <stdint.h>
+
+/**
+ * @brief Entries in the hotspot and symbol tables of the report.
+ */
+ #define PROFILE_TOP_COUNT                       32
+
+ #define PROFILE_NAME_SIZE                       48
+
+/**
+ * @brief Interrupt vector of a BIOS sample with no entry point below it.
+ */
+ #define PROFILE_BIOS_OTHER                      256
+
+/**
+ * @brief A symbol of the symbol map.
+ *
+ * addr : Linear address.
+ * name : Name, zero terminated.
+ */
+typedef struct STPROFILESYMBOL_T
+{
+  uint32_t  addr                      ;
+  char      name[ PROFILE_NAME_SIZE ] ;
+} stProfileSymbol_t ;
+
+/**
+ * @brief A line of a report table.
+ *
+ * key  : Linear address, symbol, opcode or interrupt vector.
+ * hits : Samples.
+ */
+typedef struct STPROFILEHITS_T
+{
+  uint32_t  key  ;
+  uint32_t  hits ;
+} stProfileHits_t ;
+
+#endif // _XTPROFILE_
@@ -0,0 +1,62 @@
+/**
+ * @file XTrewind.h
+ * @brief Rewind checkpoints.
+ *
+ * A running machine can keep a ring of checkpoints to be stepped back to,
+ * see CPU8086::RewindEnable(). Only the newest checkpoint is held in full:
+ * a copy of RAM and of the machine state, which is laid out as
+ *
+ *   stSnapshotCPU_t.
+ *   IO port space, IO_PORT_COUNT bytes.
+ *   Hardware state, written by the interface's SaveState().
+ *
+ * Every checkpoint holds the difference from the one before it, the XOR of
+ * the two versions of each RAM page written in between and of the state:
+ *
+ *   For each page: uint16_t page number, then the page delta.
+ *   uint16_t REWIND_PAGE_END.
+ *   The state delta.
+ *
+ * A delta is a list of runs, each one a uint32_t count of unchanged bytes,
+ * a uint32_t count of changed bytes and the XOR of the changed bytes, that
+ * ends when the runs cover the whole page or state. As the XOR goes both
+ * ways, applying the deltas from the newest checkpoint back turns the full
+ * copy into any older checkpoint.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTREWIND_
+ #define _XTREWIND_
+
+ #include <stdint.h>
+
+ #define REWIND_PAGE_END                         0xFFFF
+
+/**
+ * @brief Shortest run of unchanged bytes worth ending a changed run for.
+ */
+ #define REWIND_MIN_SKIP                         8
+
+/**
+ * @brief Size of the run header.
+ */
+ #define REWIND_RUN_BYTES                        8
+
+/**
+ * @brief One checkpoint in the ring.
+ *
+ * cycles : CPU8086::cycles_elapsed when it was taken.
+ * delta  : Difference from the checkpoint before, NULL for the oldest one.
+ * size   : Size of delta in bytes.
+ */
+typedef struct STREWINDPOINT_T
+{
+  uint64_t  cycles ;
+  uint8_t * delta  ;
+  uint32_t  size   ;
+} stRewindPoint_t ;
+
+#endif // _XTREWIND_
@@ -0,0 +1,82 @@
+/**
+ * @file XTsnapshot.h
+ * @brief Machine snapshot file format.
+ *
+ * A snapshot holds everything needed to resume an emulated machine, see
+ * CPU8086::SaveSnapshot(). The file is laid out as:
+ *
+ *   stSnapshotHeader_t, padded to SNAPSHOT_RAM_OFFSET.
+ *   RAM, RAM_SIZE bytes padded to whole memory pages.
+ *   stSnapshotCPU_t at state_offset.
+ *   IO port space, IO_PORT_COUNT bytes.
+ *   Hardware state, written by the interface's SaveState().
+ *
+ * The RAM image starts on a page boundary of the file so that it can be
+ * mapped straight into the emulator memory. Any change to the layout or to
+ * the state saved by the interface needs a new SNAPSHOT_VERSION.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTSNAPSHOT_
+ #define _XTSNAPSHOT_
+
+ #include <stdint.h>
+
+ #include "XTmemory.h"
+
+ #define SNAPSHOT_MAGIC                          "TinyXTSS"
+ #define SNAPSHOT_VERSION                        1
+
+ #define SNAPSHOT_RAM_OFFSET                     MEM_PAGE_SIZE
+ #define SNAPSHOT_RAM_PAGES                      ( RAM_SIZE >> MEM_PAGE_BITS )
+
+/**
+ * @brief Snapshot file header.
+ *
+ * magic        : SNAPSHOT_MAGIC, without its terminating zero.
+ * version      : SNAPSHOT_VERSION of the program that wrote it.
+ * ram_offset   : File offset of the RAM image.
+ * ram_size     : RAM_SIZE of the program that wrote it.
+ * state_offset : File offset of the stSnapshotCPU_t record.
+ */
+typedef struct STSNAPSHOTHEADER_T
+{
+  char      magic[ 8 ]   ;
+  uint32_t  version      ;
+  uint32_t  ram_offset   ;
+  uint32_t  ram_size     ;
+  uint32_t  state_offset ;
+} stSnapshotHeader_t ;
+
+/**
+ * @brief CPU state in a snapshot.
+ *
+ * regs     : The register file, flags included.
+ * disk_pos : File position of the HD and FD images.
+ *
+ * The other fields are the CPU8086 members of the same name.
+ */
+typedef struct STSNAPSHOTCPU_T
+{
+  uint8_t   regs[ 64 ]       ;
+  uint16_t  reg_ip           ;
+  uint16_t  seg_override     ;
+  uint8_t   seg_override_en  ;
+  uint8_t   rep_override_en  ;
+  uint8_t   rep_mode         ;
+  uint8_t   trap_flag        ;
+  uint8_t   halt_state       ;
+  uint8_t   idle_woken       ;
+  uint8_t   idle_polls       ;
+  uint8_t   reserved         ;
+  int32_t   instr_since_int8 ;
+  uint32_t  cycles_pending   ;
+  uint64_t  cycles_elapsed   ;
+  uint64_t  idle_poll_time   ;
+  int64_t   disk_pos[ 2 ]    ;
+} stSnapshotCPU_t ;
+
+#endif // _XTSNAPSHOT_
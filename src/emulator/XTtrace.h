@@ -0,0 +1,118 @@
+/**
+ * @file XTtrace.h
+ * @brief Instruction trace.
+ *
+ * A running machine can keep the last instructions it has run in a ring of
+ * fixed size records, see CPU8086::TraceEnable(). Filling in a record takes
+ * the same few stores for every instruction, so a ring of millions of
+ * instructions costs no more to keep than a small one.
+ *
+ * A record holds where the instruction ran, its bytes, the registers it
+ * changed and the last memory it wrote. Only the first TRACE_REG_VALUES
+ * changed registers have their values kept, in register order. The memory
+ * write is the last address passed to MEM_DIRTY(), with the word found there
+ * after the instruction, so a byte write also shows the byte after it and a
+ * REP string instruction only its last write.
+ *
+ * The ring is written to a trace file, as
+ *
+ *   stTraceHeader_t.
+ *   count records, stTraceRecord_t, the oldest first.
+ *
+ * all little endian, which the trace_dump tool disassembles and prints.
+ *
+ * This work is licensed under the MIT License. See included LICENSE.TXT.
+ *
+ * @see https://github.com/francescosacco/tinyXT
+ */
+
+ #ifndef _XTTRACE_
+ #define _XTTRACE_
+
+ #include <stdint.h>
+
+ #define TRACE_MAGIC                             "XTTRACE1"
+
+/**
+ * @brief Registers in reg_mask and regs, in the order of regs16.
+ */
+ #define TRACE_REG_COUNT                         12
+
+ #define TRACE_REG_VALUES                        3
+
+/**
+ * @brief reg_mask bit set when more registers changed than have values.
+ */
+ #define TRACE_REG_MORE                          0x8000
+
+/**
+ * @brief Bits of info.
+ *
+ * TRACE_INFO_WRITE     : The instruction wrote memory, see write_addr.
+ * TRACE_INFO_INTERRUPT : A hardware or trap interrupt was taken just before
+ *                        the instruction, see interrupt.
+ * TRACE_INFO_FAULT     : The instruction faulted, see reason.
+ */
+ #define TRACE_INFO_WRITE                        0x01
+ #define TRACE_INFO_INTERRUPT                    0x02
+ #define TRACE_INFO_FAULT                        0x04
+
+ #define TRACE_BYTES                             6
+
+ #define TRACE_REASON_SIZE                       48
+
+/**
+ * @brief One instruction.
+ *
+ * cs, ip      : Where it ran.
+ * write_addr  : Linear address of the last memory write.
+ * bytes       : The instruction bytes.
+ * interrupt   : The interrupt taken before it.
+ * info        : TRACE_INFO_xx bits.
+ * reg_mask    : A bit for each register it changed, TRACE_REG_MORE.
+ * flags       : FLAGS after it.
+ * reg_value   : The new value of the first changed registers.
+ * write_value : The word at write_addr after it.
+ * clock       : Low 32 bits of the CPU clock count after it.
+ */
+typedef struct STTRACERECORD_T
+{
+  uint16_t  cs                            ;
+  uint16_t  ip                            ;
+  uint32_t  write_addr                    ;
+  uint8_t   bytes[ TRACE_BYTES ]          ;
+  uint8_t   interrupt                     ;
+  uint8_t   info                          ;
+  uint16_t  reg_mask                      ;
+  uint16_t  flags                         ;
+  uint16_t  reg_value[ TRACE_REG_VALUES ] ;
+  uint16_t  write_value                   ;
+  uint32_t  clock                         ;
+} stTraceRecord_t ;
+
+/**
+ * @brief Trace file header.
+ *
+ * magic       : TRACE_MAGIC, not zero terminated.
+ * record_size : sizeof( stTraceRecord_t ).
+ * count       : Records in the file.
+ * total       : Records written since the trace was started, the last one
+ *               in the file is number total - 1.
+ * regs        : The registers after the last record.
+ * ip          : IP after the last record.
+ * flags       : FLAGS after the last record.
+ * reason      : Why the trace was written, zero terminated.
+ */
+typedef struct STTRACEHEADER_T
+{
+  char      magic[ 8 ]                  ;
+  uint32_t  record_size                 ;
+  uint32_t  count                       ;
+  uint64_t  total                       ;
+  uint16_t  regs[ TRACE_REG_COUNT ]     ;
+  uint16_t  ip                          ;
+  uint16_t  flags                       ;
+  char      reason[ TRACE_REASON_SIZE ] ;
+} stTraceHeader_t ;
+
+#endif // _XTTRACE_
@@ -0,0 +1,1852 @@
+// =============================================================================
+// File: headless_8086tiny_interface.cpp
+//
+// Description:
+// Headless implementation of the 8086tiny interface class, for running
+// batch jobs on hosts with no display, sound or serial ports.
+//
+// The emulation runs as fast as the host allows, with the emulation clock
+// and the real time clock following the emulated CPU time, until:
+//
+//   The guest runs HLT with interrupts disabled. Exit status 0.
+//   The guest jumps to 0000:0000, as QUITEMU.COM on disks/fd.img does.
+//   Exit status 0.
+//   The guest writes a byte to port 0xF4. Exit status: the byte.
+//   The instruction limit is reached. Exit status 2.
+//   The CPU stops on an unsupported instruction. Exit status 1.
+//   The command line is wrong or an image cannot be opened. Exit status 3.
+//   The machine has forked and its children have ended. Exit status: the
+//   highest of theirs.
+//
+// The guest's PUTCHAR output goes to stdout, or the -out file, as it runs.
+// At the end the text screen and a line with how the emulation ended are
+// written as well.
+//
+// Each interface object holds the emulated hardware, the options, the text
+// output and the input log of its own machine, so several machines can run
+// in one process, on threads of their own. The stats output, the timeline
+// and the trace signal are per process: only one machine of a process may
+// use them.
+//
+// Command line:
+//
+//   -bios <file>   : BIOS image, bios/bios_cga by default.
+//   -fd <file>     : Floppy disk image.
+//   -hd <file>     : Hard disk image.
+//   -type <text>   : Keys to type, \n is Enter, \t Tab, \e Escape, \\ a \.
+//   -typeat <ms>   : Emulated time to start typing at, 0 by default. The
+//                    keys wait as well until the guest first waits for one,
+//                    see GuestWaitsForKey(), so that the guest booting does
+//                    not take them, e.g. the FreeDOS kernel looking for
+//                    F5/F8.
+//   -limit <n>     : Number of instructions to run at most, not counting
+//                    the time the CPU is halted. Exit status 2.
+//   -time <ms>     : Emulated time to run at most. Exit status 2.
+//   -out <file>    : File to write the text output to instead of stdout.
+//   -rtc <s>       : Real time clock at power on in seconds since 1970,
+//                    the host clock by default. Runs with the same -rtc,
+//                    options and images are repeatable.
+//   -private       : Keep the guest's disk writes from the image files.
+//   -load <file>   : Snapshot to start from instead of booting, saved with
+//                    the same images. The -type text starts over, and
+//                    -typeat and -time count from power on.
+//   -save <file>   : Save a snapshot of the machine when the run ends.
+//   -forkat <ms>   : Emulated time to fork the machine at, see
+//                    CPU8086::Fork(), with one child for each -child.
+//   -child         : Starts the options of the next child. A child takes
+//                    -type, -typeat, -replay, -out, -limit, -time and
+//                    -save, and has the other options of the machine. Its
+//                    -replay log is timed from power on, and the events
+//                    up to the fork are skipped as the machine had them.
+//                    -limit and -time count from power on. The machine
+//                    waits for its children and writes how many ended
+//                    with a status other than 0. Not with -stats or
+//                    -timeline.
+//   -replay <file> : Input log to replay, see input_log.h. The machine has
+//                    no mouse or serial ports: the run stops with exit
+//                    status 3 when a mouse or serial event of the log is
+//                    due.
+//   -record <file> : Input log to record the -type keys to, see
+//                    input_log.h. Not with -replay, -load or -forkat.
+//   -profile <n>   : Sample the guest every n CPU clocks, for builds with
+//                    PROFILE. The report goes to stdout at the end.
+//   -profmap <file>: Symbol map for the profile, see XTprofile.h.
+//   -profout <file>: File to write the profile to instead of stdout.
+//   -trace <n>     : Keep a trace of the last n instructions, for builds
+//                    with TRACE. It is written on a CPU fault or when the
+//                    process gets SIGUSR1.
+//   -traceout <file>: The trace file, trace.bin by default.
+//   -stats <target>: Write the performance counters to a file, or to
+//                    unix:<path>, see perf_stats.h.
+//   -statsms <ms>  : Host time between two stats writes, 1000 by default.
+//   -timeline <file>: Write a timeline of the CPU slices and the guest disk
+//                    and video mode calls, for builds with TIMELINE. See
+//                    timeline.h.
+//
+// Farm mode runs the jobs of a manifest instead, see headless_farm.h:
+//
+//   -farm <file>      : The manifest.
+//   -results <file>   : The results file, farm_results.txt by default.
+//   -workers <n>      : Worker threads, one per host core by default.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include "8086tiny_interface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "state_io.h"
+#include "input_log.h"
+#include "perf_stats.h"
+#include "timeline.h"
+#include "headless_farm.h"
+
+// Port written by the guest to exit, with the exit status
+#define EXIT_PORT 0xF4
+
+#define EXIT_STATUS_HALT  0
+#define EXIT_STATUS_CPU   1
+#define EXIT_STATUS_LIMIT 2
+#define EXIT_STATUS_ERROR 3
+
+// BIOS data area: keyboard buffer, video mode, columns and page offset
+#define BDA_KEYBUF_HEAD 0x41A
+#define BDA_KEYBUF_TAIL 0x41C
+#define BDA_VIDEO_MODE  0x449
+#define BDA_VIDEO_COLS  0x44A
+#define BDA_VIDEO_PAGE  0x44E
+
+#define TEXT_ROWS 25
+
+#define FORK_MAX_CHILDREN 64
+
+enum ExitReason_t
+{
+  EXIT_NONE,
+  EXIT_HALT,
+  EXIT_QUIT,
+  EXIT_PORT_WRITE,
+  EXIT_LIMIT,
+  EXIT_TIME,
+  EXIT_CPU,
+  EXIT_CHILDREN,
+  EXIT_ERROR
+};
+
+static const char *ExitReasonName[] =
+{
+  "running",
+  "HLT with interrupts disabled",
+  "guest quit",
+  "exit port write",
+  "instruction limit",
+  "time limit",
+  "unsupported instruction",
+  "children ended",
+  "error"
+};
+
+const int PIT_Clock_Hz = 1193181;
+
+// Set by SIGUSR1, which asks for the instruction trace
+static volatile sig_atomic_t TracePending = 0;
+
+// =============================================================================
+// PIT 8253 stuff
+//
+
+struct TimerData_t
+{
+  bool BCD;             // BCD mode
+  int Mode;             // Timer mode
+  int RLMode;           // Read/Load mode
+  int ResetHolding;     // Holding area for timer reset count
+  int ResetCount;       // Reload value when count = 0
+  int Count;            // Current timer counter
+  int Latch;            // Latched timer count: -1 = not latched
+  bool LSBToggle;       // Read load LSB (true) /MSB(false) next?
+};
+
+const TimerData_t PIT_Channel0Default = { false, 2, 3, 0, 0, 0, -1 , true};
+const TimerData_t PIT_Channel1Default = { false, 2, 3, 1024, 1024, 1024, -1, true };
+const TimerData_t PIT_Channel2Default = { false, 3, 3, 1024, 1024, 1024, -1, true };
+
+// =============================================================================
+// Keyboard stuff
+//
+
+#define KEYBUFFER_LEN 64
+
+#define SCAN_LSHIFT 0x2A
+#define SCAN_SPACE  0x39
+
+// Set 1 scan codes 0x00 .. 0x35 of a US keyboard, without and with shift
+static const char ScanToASCII[2][0x36] =
+{
+  {
+    0, 27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', 8, '\t',
+    'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n', 0,
+    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`', 0, '\\',
+    'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/'
+  },
+  {
+    0, 0, '!', '@', '#', '$', '%', '^', '&', '*', '(', ')', '_', '+', 0, 0,
+    'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', 0, 0,
+    'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~', 0, '|',
+    'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?'
+  }
+};
+
+// =============================================================================
+// Machine state
+//
+
+// The emulated hardware and the options of one machine
+struct T8086TinyInterface_t::State_t
+{
+  State_t();
+  ~State_t();
+
+  // emulation state control flags
+  bool ExitPending;
+  ExitReason_t ExitReason;
+  int ExitCode;
+  bool ResetPending;
+  unsigned long long InstructionLimit;
+  unsigned long long InstructionsRun;
+  long long TimeLimitTicks;
+
+  // Keep the guest's disk writes from the image files
+  bool PrivateDisks;
+
+  // Guest profiler, see CPU8086::ProfileEnable()
+  unsigned int ProfilePeriodClocks;
+  const char *ProfileSymbolFilename;
+  const char *ProfileReportFilename;
+
+  // Instruction trace, see CPU8086::TraceEnable()
+  unsigned int TraceRecords;
+  const char *TraceFilename;
+
+  // Performance counters output, see perf_stats.h. There is no display, so
+  // every frame counts as skipped.
+  const char *StatsTarget;
+  unsigned int StatsPeriodMs;
+  PerfHostCounters_t HostCounters;
+
+  // Timeline, see timeline.h
+  const char *TimelineFilename;
+
+  // The text output, stdout or the -out file
+  FILE *Out;
+
+  // The input log of this machine. It replays or records it.
+  InputLog_t *InputLog;
+  bool Replaying;
+  bool Recording;
+
+  // Snapshots to start from and to save at the end, NULL once requested.
+  // LoadPending until the loaded state has been restored.
+  const char *LoadFilename;
+  const char *SaveFilename;
+  bool LoadPending;
+
+  // -forkat and the argv index of the first option of each -child.
+  // ForkPending until the children have been started.
+  long long ForkAtTicks;
+  int ForkChildren;
+  int ChildArg[FORK_MAX_CHILDREN];
+  bool ForkPending;
+  int Argc;
+  char **Argv;
+
+  // The result of a farm job, NULL outside farm mode
+  FarmResult_t *FarmResult;
+
+  // disk and bios image file names
+  char BiosFilename[1024];
+  char HDFilename[1024];
+  char FDFilename[1024];
+
+  int CPU_Clock_Hz;
+
+  int CPU_Counter;
+  int CPU_Frame;
+  long long CPU_TotalTicks;
+  long long PIT_Counter;
+
+  int Int8Pending;
+
+  // Real time clock at power on in ms since 1970
+  long long StartTime;
+
+  // Keys to type and when, in CPU ticks, to start. They wait as well until
+  // the guest has waited for a key.
+  char TypeText[1024];
+  int TypeIndex;
+  long long TypeAtTicks;
+  bool KeyWaited;
+
+  // CGA status register and when the vertical retrace ends, in CPU ticks
+  unsigned char CGAStatus;
+  long long CGARetraceEnd;
+
+  // PIC 8259
+  int PIC_OCW_Idx;
+  unsigned char PIC_OCW[3];
+  int PIC_ICW_Idx;
+  unsigned char PIC_ICW[4];
+
+  // PIT 8253
+  TimerData_t PIT_Channel[3];
+
+  // Keyboard
+  int KeyBufferHead;
+  int KeyBufferTail;
+  int KeyBufferCount;
+  unsigned char KeyBuffer[KEYBUFFER_LEN];
+
+  unsigned char KeyInputBuffer;
+  bool KeyInputFull;
+
+  void ResetPIT(void);
+  void PIT_UpdateTimers(int Ticks);
+  void PIT_WriteTimer(int T, unsigned char Val);
+  unsigned char PIT_ReadTimer(int T);
+  void PIT_WriteControl(unsigned char Val);
+
+  void AddKeyEvent(unsigned char code);
+  void TypeKeyEvent(unsigned char code);
+  bool IsKeyEventAvailable(void) const { return (KeyBufferCount > 0); }
+  unsigned char NextKeyEvent(void);
+  void TypeKey(char c);
+  void TypeNext(unsigned char *mem);
+  void SetTypeText(const char *Text);
+  bool ReplayEvents(bool Skip);
+
+  void RequestExit(ExitReason_t Reason, int Code);
+  bool SetOut(const char *Filename);
+  bool Transfer(FILE *fp, bool Save, unsigned char *Port);
+  bool StartChild(int Child);
+  void WaitChildren(void);
+};
+
+T8086TinyInterface_t::State_t::State_t()
+{
+  ExitPending = false;
+  ExitReason = EXIT_NONE;
+  ExitCode = 0;
+  ResetPending = false;
+  InstructionLimit = 0;
+  InstructionsRun = 0;
+  TimeLimitTicks = 0;
+
+  PrivateDisks = false;
+
+  ProfilePeriodClocks = 0;
+  ProfileSymbolFilename = NULL;
+  ProfileReportFilename = NULL;
+
+  TraceRecords = 0;
+  TraceFilename = "trace.bin";
+
+  StatsTarget = NULL;
+  StatsPeriodMs = PERF_DEFAULT_PERIOD_MS;
+  memset(&HostCounters, 0, sizeof(HostCounters));
+
+  TimelineFilename = NULL;
+  Out = stdout;
+  InputLog = INPUT_Create();
+  Replaying = false;
+  Recording = false;
+  FarmResult = NULL;
+
+  LoadFilename = NULL;
+  SaveFilename = NULL;
+  LoadPending = false;
+
+  ForkAtTicks = 0;
+  ForkChildren = 0;
+  ForkPending = false;
+  Argc = 0;
+  Argv = NULL;
+
+  strcpy(BiosFilename, "bios/bios_cga");
+  HDFilename[0] = 0;
+  FDFilename[0] = 0;
+
+  CPU_Clock_Hz = 4770000;
+  CPU_Counter = 0;
+  CPU_Frame = 0;
+  CPU_TotalTicks = 0;
+  PIT_Counter = 0;
+  Int8Pending = 0;
+  StartTime = 0;
+
+  TypeText[0] = 0;
+  TypeIndex = 0;
+  TypeAtTicks = 0;
+  KeyWaited = false;
+
+  CGAStatus = 0;
+  CGARetraceEnd = 0;
+
+  PIC_OCW_Idx = 0;
+  memset(PIC_OCW, 0, sizeof(PIC_OCW));
+  PIC_ICW_Idx = 0;
+  memset(PIC_ICW, 0, sizeof(PIC_ICW));
+
+  ResetPIT();
+
+  KeyBufferHead = 0;
+  KeyBufferTail = 0;
+  KeyBufferCount = 0;
+  memset(KeyBuffer, 0, sizeof(KeyBuffer));
+  KeyInputBuffer = 0;
+  KeyInputFull = false;
+}
+
+T8086TinyInterface_t::State_t::~State_t()
+{
+  INPUT_Destroy(InputLog);
+  if (Out != stdout) fclose(Out);
+}
+
+// =============================================================================
+// PIT 8253 emulation
+//
+
+void T8086TinyInterface_t::State_t::ResetPIT(void)
+{
+  PIT_Channel[0] = PIT_Channel0Default;
+  PIT_Channel[1] = PIT_Channel1Default;
+  PIT_Channel[2] = PIT_Channel2Default;
+}
+
+void T8086TinyInterface_t::State_t::PIT_UpdateTimers(int Ticks)
+{
+  PIT_Channel[0].Count -= Ticks;
+  while (PIT_Channel[0].Count <= 0)
+  {
+    if (PIT_Channel[0].ResetCount == 0)
+    {
+      PIT_Channel[0].Count += 65536;
+    }
+    else
+    {
+      PIT_Channel[0].Count += PIT_Channel[0].ResetCount;
+    }
+
+    Int8Pending++;
+  }
+
+  // Channel 1 is only used for DRAM refresh, and with no speaker channel 2
+  // is only read back by timing loops.
+  PIT_Channel[2].Count -= Ticks;
+  while (PIT_Channel[2].Count <= 0)
+  {
+    if (PIT_Channel[2].ResetCount == 0)
+    {
+      PIT_Channel[2].Count += 65536;
+    }
+    else
+    {
+      PIT_Channel[2].Count += PIT_Channel[2].ResetCount;
+    }
+  }
+}
+
+void T8086TinyInterface_t::State_t::PIT_WriteTimer(int T, unsigned char Val)
+{
+  TimerData_t *Timer = &PIT_Channel[T];
+  bool WriteLSB = false;
+
+  if (Timer->RLMode == 1)
+  {
+    WriteLSB = true;
+  }
+  else if (Timer->RLMode == 3)
+  {
+    WriteLSB = Timer->LSBToggle;
+    Timer->LSBToggle = !Timer->LSBToggle;
+  }
+
+  if (WriteLSB)
+  {
+    Timer->ResetHolding = (Timer->ResetHolding & 0xFF00) | Val;
+  }
+  else
+  {
+    Timer->ResetHolding = (Timer->ResetHolding & 0x00FF) | (((int) Val) << 8);
+    Timer->ResetCount = Timer->ResetHolding;
+
+    if (Timer->Mode == 0)
+    {
+      Timer->Count = Timer->ResetCount;
+    }
+  }
+}
+
+unsigned char T8086TinyInterface_t::State_t::PIT_ReadTimer(int T)
+{
+  TimerData_t *Timer = &PIT_Channel[T];
+  int ReadValue;
+  bool ReadLSB = false;
+  unsigned char Val;
+
+  if (Timer->Latch != -1)
+  {
+    ReadValue = Timer->Latch;
+  }
+  else
+  {
+    ReadValue = Timer->Count;
+  }
+
+  if (Timer->RLMode == 1)
+  {
+    ReadLSB = true;
+  }
+  else if (Timer->RLMode == 3)
+  {
+    ReadLSB = Timer->LSBToggle;
+    Timer->LSBToggle = !Timer->LSBToggle;
+  }
+
+  if (ReadLSB)
+  {
+    Val = (unsigned char)(ReadValue & 0xFF);
+  }
+  else
+  {
+    Val = (unsigned char)((ReadValue >> 8) & 0xFF);
+    Timer->Latch = -1;
+  }
+
+  return Val;
+}
+
+void T8086TinyInterface_t::State_t::PIT_WriteControl(unsigned char Val)
+{
+  int T = (Val >> 6) & 0x03;
+  TimerData_t *Timer;
+
+  // Read back (8254 only) is not supported
+  if (T == 3) return;
+
+  Timer = &PIT_Channel[T];
+
+  int RLMode = (Val >> 4) & 0x03;
+  if (RLMode == 0)
+  {
+    Timer->Latch = Timer->Count;
+    Timer->LSBToggle = true;
+  }
+  else
+  {
+    Timer->RLMode = RLMode;
+    if (RLMode == 3) Timer->LSBToggle = true;
+  }
+
+  int Mode = (Val >> 1) & 0x07;
+  Timer->Mode = Mode;
+
+  Timer->BCD = (Val & 1) == 1;
+}
+
+// =============================================================================
+// Keyboard emulation
+//
+
+void T8086TinyInterface_t::State_t::AddKeyEvent(unsigned char code)
+{
+  if (KeyBufferCount < KEYBUFFER_LEN)
+  {
+    KeyBuffer[KeyBufferTail] = code;
+    KeyBufferTail = (KeyBufferTail + 1) % KEYBUFFER_LEN;
+    KeyBufferCount++;
+  }
+}
+
+unsigned char T8086TinyInterface_t::State_t::NextKeyEvent(void)
+{
+  unsigned char code = 0xff;
+
+  if (KeyBufferCount > 0)
+  {
+    code = KeyBuffer[KeyBufferHead];
+    KeyBufferHead = (KeyBufferHead + 1) % KEYBUFFER_LEN;
+    KeyBufferCount--;
+  }
+
+  return code;
+}
+
+// A key typed from the -type text, which is logged when recording
+void T8086TinyInterface_t::State_t::TypeKeyEvent(unsigned char code)
+{
+  INPUT_Record(INPUT_KEY, &code, 1, InputLog);
+  AddKeyEvent(code);
+}
+
+// Presses and releases the key for a character, with shift if it needs it
+void T8086TinyInterface_t::State_t::TypeKey(char c)
+{
+  if (c == '\r') c = '\n';
+
+  if (c == ' ')
+  {
+    TypeKeyEvent(SCAN_SPACE);
+    TypeKeyEvent(SCAN_SPACE | 0x80);
+    return;
+  }
+
+  for (int Shift = 0 ; Shift < 2 ; Shift++)
+  {
+    for (int Scan = 1 ; Scan < (int) sizeof(ScanToASCII[0]) ; Scan++)
+    {
+      if (ScanToASCII[Shift][Scan] == c)
+      {
+        if (Shift) TypeKeyEvent(SCAN_LSHIFT);
+        TypeKeyEvent((unsigned char) Scan);
+        TypeKeyEvent((unsigned char) (Scan | 0x80));
+        if (Shift) TypeKeyEvent(SCAN_LSHIFT | 0x80);
+        return;
+      }
+    }
+  }
+
+  fprintf(Out, "Cannot type character 0x%02x\n", (unsigned char) c);
+}
+
+// Types the next character once the guest has taken the one before
+void T8086TinyInterface_t::State_t::TypeNext(unsigned char *mem)
+{
+  if ((TypeText[TypeIndex] == 0) || (CPU_TotalTicks < TypeAtTicks) || !KeyWaited) return;
+
+  if (IsKeyEventAvailable() || KeyInputFull) return;
+
+  if ((mem[BDA_KEYBUF_HEAD] != mem[BDA_KEYBUF_TAIL]) ||
+      (mem[BDA_KEYBUF_HEAD + 1] != mem[BDA_KEYBUF_TAIL + 1]))
+  {
+    return;
+  }
+
+  TypeKey(TypeText[TypeIndex++]);
+}
+
+// Takes the logged events due at the current CPU time: the keys and resets
+// are replayed, or with Skip dropped. There is no mouse or serial port to
+// replay the other events to, so false if one is due.
+bool T8086TinyInterface_t::State_t::ReplayEvents(bool Skip)
+{
+  InputEvent_t Event;
+
+  INPUT_SetTime(CPU_TotalTicks, InputLog);
+
+  while (INPUT_Replay(INPUT_KEY, Event, InputLog))
+  {
+    if (!Skip) AddKeyEvent(Event.Data[0]);
+  }
+
+  while (INPUT_Replay(INPUT_RESET, Event, InputLog))
+  {
+    if (!Skip) ResetPending = true;
+  }
+
+  if (INPUT_Replay(INPUT_MOUSE, Event, InputLog) || INPUT_Replay(INPUT_SERIAL, Event, InputLog))
+  {
+    fprintf(Out, "Cannot replay the %s event of the input log at %lld ms: there is no %s\n",
+           (Event.Type == INPUT_MOUSE) ? "mouse" : "serial",
+           (CPU_TotalTicks * 1000) / CPU_Clock_Hz,
+           (Event.Type == INPUT_MOUSE) ? "mouse" : "serial port");
+    return false;
+  }
+
+  return true;
+}
+
+// Copies the -type text, turning the escapes into the characters
+void T8086TinyInterface_t::State_t::SetTypeText(const char *Text)
+{
+  int Len = 0;
+
+  while ((*Text != 0) && (Len < (int) sizeof(TypeText) - 1))
+  {
+    char c = *Text++;
+
+    if ((c == '\\') && (*Text != 0))
+    {
+      c = *Text++;
+      switch (c)
+      {
+        case 'n':
+        case 'r':
+          c = '\n';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'e':
+          c = 27;
+          break;
+        default:
+          break;
+      }
+    }
+
+    TypeText[Len++] = c;
+  }
+
+  TypeText[Len] = 0;
+  TypeIndex = 0;
+}
+
+// Starts the exit of the emulation, unless it is already on the way out
+void T8086TinyInterface_t::State_t::RequestExit(ExitReason_t Reason, int Code)
+{
+  if (ExitReason != EXIT_NONE) return;
+
+  ExitReason = Reason;
+  ExitCode = Code;
+  ExitPending = true;
+}
+
+// Sends the text output to a new file. false if it cannot be created.
+bool T8086TinyInterface_t::State_t::SetOut(const char *Filename)
+{
+  FILE *fp = fopen(Filename, "w");
+
+  if (fp == NULL)
+  {
+    fprintf(Out, "Could not create %s\n", Filename);
+    return false;
+  }
+
+  if (Out != stdout) fclose(Out);
+  Out = fp;
+
+  return true;
+}
+
+// =============================================================================
+// Output
+//
+
+// Writes the text screen, without the blank lines at the end
+static void WriteScreen(FILE *fp, unsigned char *mem)
+{
+  int Mode = mem[BDA_VIDEO_MODE];
+  int Cols = mem[BDA_VIDEO_COLS] | (mem[BDA_VIDEO_COLS + 1] << 8);
+  int Base;
+  int Rows;
+  char Line[256];
+
+  if ((Mode > 3) && (Mode != 7))
+  {
+    fprintf(fp, "[Graphics mode %02Xh]\n", Mode);
+    return;
+  }
+
+  if ((Cols <= 0) || (Cols >= (int) sizeof(Line))) Cols = 80;
+
+  Base = (Mode == 7) ? 0xB0000 : 0xB8000;
+  Base += mem[BDA_VIDEO_PAGE] | (mem[BDA_VIDEO_PAGE + 1] << 8);
+  if (Base + TEXT_ROWS * Cols * 2 > 0xC0000) Base = 0xB8000;
+
+  // Leave out the blank rows at the bottom
+  for (Rows = TEXT_ROWS ; Rows > 0 ; Rows--)
+  {
+    int c;
+    for (c = 0 ; c < Cols ; c++)
+    {
+      unsigned char ch = mem[Base + ((Rows - 1) * Cols + c) * 2];
+      if ((ch != ' ') && (ch != 0)) break;
+    }
+    if (c < Cols) break;
+  }
+
+  for (int r = 0 ; r < Rows ; r++)
+  {
+    int Len = 0;
+
+    for (int c = 0 ; c < Cols ; c++)
+    {
+      unsigned char ch = mem[Base + (r * Cols + c) * 2];
+      Line[c] = ((ch >= 32) && (ch < 127)) ? (char) ch : ' ';
+      if (Line[c] != ' ') Len = c + 1;
+    }
+    Line[Len] = 0;
+
+    fprintf(fp, "%s\n", Line);
+  }
+}
+
+static void Usage(FILE *fp)
+{
+  fprintf(fp, "Usage: tinyxt_headless [-bios <file>] [-fd <file>] [-hd <file>]\n"
+         "                       [-type <text>] [-typeat <ms>] [-limit <n>]\n"
+         "                       [-time <ms>] [-out <file>] [-rtc <s>]\n"
+         "                       [-private] [-load <file>] [-save <file>]\n"
+         "                       [-forkat <ms> -child [<child options>] ...]\n"
+         "                       [-replay <file>] [-record <file>]\n"
+         "                       [-profile <n>]\n"
+         "                       [-profmap <file>] [-profout <file>]\n"
+         "                       [-trace <n>] [-traceout <file>]\n"
+         "                       [-stats <target>] [-statsms <ms>]\n"
+         "                       [-timeline <file>]\n"
+         "       tinyxt_headless -farm <file> [-results <file>] [-workers <n>]\n");
+}
+
+// Checks if an option can be given to a -child
+static bool IsChildOption(const char *Option)
+{
+  static const char *ChildOptions[] = { "-type", "-typeat", "-replay", "-out", "-limit", "-time", "-save" };
+
+  for (unsigned int i = 0 ; i < sizeof(ChildOptions) / sizeof(ChildOptions[0]) ; i++)
+  {
+    if (strcmp(Option, ChildOptions[i]) == 0) return true;
+  }
+
+  return false;
+}
+
+// Checks an image file given can be opened
+static bool CheckImage(FILE *Out, const char *Filename)
+{
+  FILE *fp;
+
+  if (Filename[0] == 0) return true;
+
+  fp = fopen(Filename, "rb");
+  if (fp == NULL)
+  {
+    fprintf(Out, "Could not open %s\n", Filename);
+    return false;
+  }
+
+  fclose(fp);
+  return true;
+}
+
+// SIGUSR1 asks for the instruction trace
+static void TraceSignal(int)
+{
+  TracePending = 1;
+}
+
+// =============================================================================
+// Snapshot state
+//
+
+// Writes or reads the timer, interrupt controller, keyboard and video
+// state.
+bool T8086TinyInterface_t::State_t::Transfer(FILE *fp, bool Save, unsigned char *Port)
+{
+  STATE_ITEM(fp, Save, CPU_Counter);
+  STATE_ITEM(fp, Save, CPU_Frame);
+  STATE_ITEM(fp, Save, CPU_TotalTicks);
+  STATE_ITEM(fp, Save, PIT_Counter);
+  STATE_ITEM(fp, Save, Int8Pending);
+  STATE_ITEM(fp, Save, PIT_Channel);
+
+  STATE_ITEM(fp, Save, PIC_OCW_Idx);
+  STATE_ITEM(fp, Save, PIC_OCW);
+  STATE_ITEM(fp, Save, PIC_ICW_Idx);
+  STATE_ITEM(fp, Save, PIC_ICW);
+
+  STATE_ITEM(fp, Save, KeyBufferHead);
+  STATE_ITEM(fp, Save, KeyBufferTail);
+  STATE_ITEM(fp, Save, KeyBufferCount);
+  STATE_ITEM(fp, Save, KeyBuffer);
+  STATE_ITEM(fp, Save, KeyInputBuffer);
+  STATE_ITEM(fp, Save, KeyInputFull);
+  STATE_ITEM(fp, Save, TypeIndex);
+  STATE_ITEM(fp, Save, KeyWaited);
+
+  STATE_ITEM(fp, Save, CGAStatus);
+  STATE_ITEM(fp, Save, CGARetraceEnd);
+
+  return STATE_Transfer(fp, Save, Port, 65536);
+}
+
+// =============================================================================
+// Forked children
+//
+
+// Takes up the options of a -child, in its process. false if one of them
+// cannot be used.
+bool T8086TinyInterface_t::State_t::StartChild(int Child)
+{
+  for (int i = ChildArg[Child - 1] ; (i + 1 < Argc) && (strcmp(Argv[i], "-child") != 0) ; i += 2)
+  {
+    const char *Value = Argv[i + 1];
+
+    if (strcmp(Argv[i], "-type") == 0)
+    {
+      SetTypeText(Value);
+    }
+    else if (strcmp(Argv[i], "-typeat") == 0)
+    {
+      TypeAtTicks = (atoll(Value) * CPU_Clock_Hz) / 1000;
+    }
+    else if (strcmp(Argv[i], "-limit") == 0)
+    {
+      InstructionLimit = strtoull(Value, NULL, 0);
+    }
+    else if (strcmp(Argv[i], "-time") == 0)
+    {
+      TimeLimitTicks = (atoll(Value) * CPU_Clock_Hz) / 1000;
+    }
+    else if (strcmp(Argv[i], "-save") == 0)
+    {
+      SaveFilename = Value;
+    }
+    else if (strcmp(Argv[i], "-out") == 0)
+    {
+      if (!SetOut(Value)) return false;
+    }
+    else if (strcmp(Argv[i], "-replay") == 0)
+    {
+      int LogClockHz;
+      long long LogStartTime;
+
+      // In place of the log of the machine, if any
+      Replaying = INPUT_StartReplay(Value, LogClockHz, LogStartTime, InputLog);
+      if (!Replaying) return false;
+
+      if (LogClockHz != CPU_Clock_Hz)
+      {
+        fprintf(Out, "%s is of a machine with another CPU clock\n", Value);
+        return false;
+      }
+
+      // The machine had the events up to the fork
+      if (!ReplayEvents(true)) return false;
+    }
+  }
+
+  return true;
+}
+
+// Waits for the children to end. The exit status is the highest of theirs.
+void T8086TinyInterface_t::State_t::WaitChildren(void)
+{
+  int Children = 0;
+  int NonZero = 0;
+  int Highest = 0;
+  int WaitStatus;
+
+  while (wait(&WaitStatus) > 0)
+  {
+    int Status = WIFEXITED(WaitStatus) ? WEXITSTATUS(WaitStatus) : EXIT_STATUS_ERROR;
+
+    Children++;
+    if (Status != 0) NonZero++;
+    if (Status > Highest) Highest = Status;
+  }
+
+  fprintf(Out, "Children: %d ended, %d with a status other than 0\n", Children, NonZero);
+  RequestExit(EXIT_CHILDREN, Highest);
+}
+
+// =============================================================================
+// Interface class.
+//
+
+T8086TinyInterface_t::T8086TinyInterface_t()
+{
+  IntLine = false;
+  State = new State_t;
+}
+
+T8086TinyInterface_t::~T8086TinyInterface_t()
+{
+  delete State;
+}
+
+void T8086TinyInterface_t::SetArgs(int argc, char **argv)
+{
+  State_t &S = *State;
+  long long TypeAtMs = 0;
+  long long TimeLimitMs = 0;
+  long long RTCSeconds = -1;
+  long long ForkAtMs = -1;
+  const char *ReplayFilename = NULL;
+  const char *RecordFilename = NULL;
+
+  // Farm mode runs the jobs, each on a machine of its own, and exits
+  if ((argc >= 3) && (strcmp(argv[1], "-farm") == 0))
+  {
+    const char *ResultsFilename = "farm_results.txt";
+    int Workers = 0;
+
+    for (int i = 3 ; i < argc ; i++)
+    {
+      if ((strcmp(argv[i], "-results") == 0) && (i + 1 < argc))
+      {
+        ResultsFilename = argv[++i];
+      }
+      else if ((strcmp(argv[i], "-workers") == 0) && (i + 1 < argc))
+      {
+        Workers = atoi(argv[++i]);
+      }
+      else
+      {
+        printf("Unknown option %s\n", argv[i]);
+        Usage(stdout);
+        exit(EXIT_STATUS_ERROR);
+      }
+    }
+
+    FARM_Run(argv[2], ResultsFilename, Workers);
+  }
+
+  S.Argc = argc;
+  S.Argv = argv;
+
+  for (int i = 1 ; i < argc ; i++)
+  {
+    if (strcmp(argv[i], "-child") == 0)
+    {
+      if (S.ForkChildren == FORK_MAX_CHILDREN)
+      {
+        fprintf(S.Out, "At most %d children\n", FORK_MAX_CHILDREN);
+        S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+        return;
+      }
+      S.ChildArg[S.ForkChildren++] = i + 1;
+    }
+    else if (S.ForkChildren > 0)
+    {
+      // An option of a child, taken up by StartChild()
+      if (!IsChildOption(argv[i]) || (i + 1 >= argc))
+      {
+        fprintf(S.Out, "Option %s cannot be given to a child\n", argv[i]);
+        Usage(S.Out);
+        S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+        return;
+      }
+      i++;
+    }
+    else if ((strcmp(argv[i], "-forkat") == 0) && (i + 1 < argc))
+    {
+      ForkAtMs = atoll(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-bios") == 0) && (i + 1 < argc))
+    {
+      strncpy(S.BiosFilename, argv[++i], sizeof(S.BiosFilename) - 1);
+    }
+    else if ((strcmp(argv[i], "-fd") == 0) && (i + 1 < argc))
+    {
+      strncpy(S.FDFilename, argv[++i], sizeof(S.FDFilename) - 1);
+    }
+    else if ((strcmp(argv[i], "-hd") == 0) && (i + 1 < argc))
+    {
+      strncpy(S.HDFilename, argv[++i], sizeof(S.HDFilename) - 1);
+    }
+    else if ((strcmp(argv[i], "-type") == 0) && (i + 1 < argc))
+    {
+      S.SetTypeText(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-typeat") == 0) && (i + 1 < argc))
+    {
+      TypeAtMs = atoll(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-limit") == 0) && (i + 1 < argc))
+    {
+      S.InstructionLimit = strtoull(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-time") == 0) && (i + 1 < argc))
+    {
+      TimeLimitMs = atoll(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-out") == 0) && (i + 1 < argc))
+    {
+      if (!S.SetOut(argv[++i]))
+      {
+        S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+        return;
+      }
+    }
+    else if ((strcmp(argv[i], "-rtc") == 0) && (i + 1 < argc))
+    {
+      RTCSeconds = atoll(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-private") == 0)
+    {
+      S.PrivateDisks = true;
+    }
+    else if ((strcmp(argv[i], "-load") == 0) && (i + 1 < argc))
+    {
+      S.LoadFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-save") == 0) && (i + 1 < argc))
+    {
+      S.SaveFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-replay") == 0) && (i + 1 < argc))
+    {
+      ReplayFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-record") == 0) && (i + 1 < argc))
+    {
+      RecordFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-profile") == 0) && (i + 1 < argc))
+    {
+      S.ProfilePeriodClocks = (unsigned int) strtoul(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-profmap") == 0) && (i + 1 < argc))
+    {
+      S.ProfileSymbolFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-profout") == 0) && (i + 1 < argc))
+    {
+      S.ProfileReportFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-trace") == 0) && (i + 1 < argc))
+    {
+      S.TraceRecords = (unsigned int) strtoul(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-traceout") == 0) && (i + 1 < argc))
+    {
+      S.TraceFilename = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-stats") == 0) && (i + 1 < argc))
+    {
+      S.StatsTarget = argv[++i];
+    }
+    else if ((strcmp(argv[i], "-statsms") == 0) && (i + 1 < argc))
+    {
+      S.StatsPeriodMs = (unsigned int) strtoul(argv[++i], NULL, 0);
+    }
+    else if ((strcmp(argv[i], "-timeline") == 0) && (i + 1 < argc))
+    {
+      S.TimelineFilename = argv[++i];
+    }
+    else
+    {
+      fprintf(S.Out, "Unknown option %s\n", argv[i]);
+      Usage(S.Out);
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+      return;
+    }
+  }
+
+  S.StartTime = (RTCSeconds >= 0) ? RTCSeconds * 1000 : (long long) time(NULL) * 1000;
+
+  if (ReplayFilename != NULL)
+  {
+    if (!INPUT_StartReplay(ReplayFilename, S.CPU_Clock_Hz, S.StartTime, S.InputLog))
+    {
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+      return;
+    }
+    S.Replaying = true;
+  }
+
+  if (RecordFilename != NULL)
+  {
+    // The log starts at power on, with the keys of this machine only
+    if ((ReplayFilename != NULL) || (S.LoadFilename != NULL) || (S.ForkChildren > 0))
+    {
+      fprintf(S.Out, "-record cannot be used with -replay, -load or -forkat\n");
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+      return;
+    }
+
+    if (!INPUT_StartRecord(RecordFilename, S.CPU_Clock_Hz, S.StartTime, S.InputLog))
+    {
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+      return;
+    }
+    S.Recording = true;
+  }
+
+  S.TypeAtTicks = (TypeAtMs * S.CPU_Clock_Hz) / 1000;
+  S.TimeLimitTicks = (TimeLimitMs * S.CPU_Clock_Hz) / 1000;
+
+  if ((ForkAtMs >= 0) != (S.ForkChildren > 0))
+  {
+    fprintf(S.Out, "-forkat and -child go together\n");
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    return;
+  }
+
+  if ((S.ForkChildren > 0) && ((S.StatsTarget != NULL) || (S.TimelineFilename != NULL)))
+  {
+    fprintf(S.Out, "-child cannot be used with -stats or -timeline\n");
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    return;
+  }
+
+  S.ForkAtTicks = (ForkAtMs * S.CPU_Clock_Hz) / 1000;
+  S.ForkPending = (S.ForkChildren > 0);
+
+  if (!CheckImage(S.Out, S.BiosFilename) || !CheckImage(S.Out, S.FDFilename) || !CheckImage(S.Out, S.HDFilename))
+  {
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    return;
+  }
+
+  if ((S.StatsTarget != NULL) && !PERF_Open(S.StatsTarget, S.StatsPeriodMs))
+  {
+    fprintf(S.Out, "Could not write the stats to %s\n", S.StatsTarget);
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    return;
+  }
+
+#if TIMELINE
+  if ((S.TimelineFilename != NULL) && !TIMELINE_Open(S.TimelineFilename, "emulation"))
+  {
+    fprintf(S.Out, "Could not write the timeline to %s\n", S.TimelineFilename);
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+  }
+#endif
+}
+
+void T8086TinyInterface_t::SetFarmResult(FarmResult_t *Result)
+{
+  State->FarmResult = Result;
+}
+
+bool T8086TinyInterface_t::Initialise(unsigned char *mem_in)
+{
+  // Store a pointer to system memory
+  mem = mem_in;
+
+  // Initialise ports
+  for (int i = 0 ; i < 65536 ; i++)
+  {
+    Port[i] = 0xff;
+  }
+
+  return true;
+}
+
+void T8086TinyInterface_t::Cleanup(void)
+{
+  State_t &S = *State;
+  long long EmulatedMs = (S.CPU_TotalTicks * 1000) / S.CPU_Clock_Hz;
+
+  if (S.Replaying || S.Recording)
+  {
+    INPUT_Stop(S.InputLog);
+    S.Replaying = false;
+    S.Recording = false;
+  }
+
+  if (S.StatsTarget != NULL)
+  {
+    PERF_Close();
+  }
+
+#if TIMELINE
+  if ((S.TimelineFilename != NULL) && !TIMELINE_Close())
+  {
+    fprintf(S.Out, "Could not write the timeline to %s\n", S.TimelineFilename);
+  }
+#endif
+
+  if (S.ExitReason != EXIT_ERROR)
+  {
+    WriteScreen(S.Out, mem);
+
+    fprintf(S.Out, "Exit: %s, status %d, %llu instructions, %lld ms\n",
+           ExitReasonName[S.ExitReason], S.ExitCode, S.InstructionsRun, EmulatedMs);
+  }
+  fflush(S.Out);
+
+  if (S.FarmResult != NULL)
+  {
+    S.FarmResult->Status = S.ExitCode;
+    S.FarmResult->Reason = ExitReasonName[S.ExitReason];
+    S.FarmResult->Instructions = S.InstructionsRun;
+    S.FarmResult->EmulatedMs = EmulatedMs;
+  }
+}
+
+bool T8086TinyInterface_t::ExitEmulation(void)
+{
+  return State->ExitPending;
+}
+
+bool T8086TinyInterface_t::GuestHalted(void)
+{
+  State->RequestExit(EXIT_HALT, EXIT_STATUS_HALT);
+  return true;
+}
+
+bool T8086TinyInterface_t::GuestQuit(void)
+{
+  State->RequestExit(EXIT_QUIT, EXIT_STATUS_HALT);
+  return true;
+}
+
+void T8086TinyInterface_t::GuestWaitsForKey(void)
+{
+  State->KeyWaited = true;
+}
+
+void T8086TinyInterface_t::PutChar(unsigned char c)
+{
+  fputc(c, State->Out);
+}
+
+unsigned long long T8086TinyInterface_t::GetInstructionLimit(void)
+{
+  return State->InstructionLimit;
+}
+
+int T8086TinyInterface_t::ExitStatus(unsigned long long Instructions)
+{
+  State_t &S = *State;
+
+  S.InstructionsRun = Instructions;
+
+  if ((S.InstructionLimit != 0) && (Instructions >= S.InstructionLimit))
+  {
+    S.RequestExit(EXIT_LIMIT, EXIT_STATUS_LIMIT);
+  }
+
+  // Nothing here asked to stop, so the CPU did
+  S.RequestExit(EXIT_CPU, EXIT_STATUS_CPU);
+
+  return S.ExitCode;
+}
+
+bool T8086TinyInterface_t::Reset(void)
+{
+  State_t &S = *State;
+
+  if (S.ResetPending)
+  {
+    S.CPU_Counter = 0;
+    S.CPU_Frame = 0;
+    S.PIT_Counter = 0;
+
+    // Reset keyboard
+    S.KeyBufferHead = 0;
+    S.KeyBufferTail = 0;
+    S.KeyBufferCount = 0;
+    S.KeyInputBuffer = 0;
+    S.KeyInputFull = false;
+    S.KeyWaited = false;
+
+    S.CGAStatus = 0;
+    S.CGARetraceEnd = 0;
+
+    S.ResetPIT();
+    S.Int8Pending = 0;
+    S.ResetPending = false;
+
+    for (int i = 0 ; i < 4 ; i++) S.PIC_ICW[i] = 0;
+    for (int i = 0 ; i < 3 ; i++) S.PIC_OCW[i] = 0;
+    S.PIC_ICW_Idx = 0;
+    S.PIC_OCW_Idx = 0;
+
+    UpdateIntLine();
+
+    return true;
+  }
+  return false;
+}
+
+char *T8086TinyInterface_t::GetBIOSFilename(void)
+{
+  if (State->BiosFilename[0] == 0)
+  {
+    return NULL;
+  }
+
+  return State->BiosFilename;
+}
+
+char *T8086TinyInterface_t::GetFDImageFilename(void)
+{
+  if (State->FDFilename[0] == 0)
+  {
+    return NULL;
+  }
+
+  return State->FDFilename;
+}
+
+char *T8086TinyInterface_t::GetHDImageFilename(void)
+{
+  if (State->HDFilename[0] == 0)
+  {
+    return NULL;
+  }
+
+  return State->HDFilename;
+}
+
+bool T8086TinyInterface_t::FDChanged(void)
+{
+  return false;
+}
+
+bool T8086TinyInterface_t::DiskCopyOnWrite(void)
+{
+  return State->PrivateDisks;
+}
+
+bool T8086TinyInterface_t::SnapshotRequest(const char *&Filename, bool &Save)
+{
+  State_t &S = *State;
+
+  // -load before the first instruction. The run fails unless LoadState()
+  // restores the snapshot.
+  if (S.LoadFilename != NULL)
+  {
+    Filename = S.LoadFilename;
+    Save = false;
+    S.LoadFilename = NULL;
+    S.LoadPending = true;
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    return true;
+  }
+
+  // -save once the run has ended
+  if ((S.SaveFilename != NULL) && (S.ExitReason != EXIT_NONE))
+  {
+    Filename = S.SaveFilename;
+    Save = true;
+    S.SaveFilename = NULL;
+    return true;
+  }
+
+  return false;
+}
+
+bool T8086TinyInterface_t::ForkRequest(int &Children)
+{
+  State_t &S = *State;
+
+  if (!S.ForkPending || (S.CPU_TotalTicks < S.ForkAtTicks)) return false;
+
+  S.ForkPending = false;
+  Children = S.ForkChildren;
+
+  return true;
+}
+
+void T8086TinyInterface_t::ForkStarted(int Child)
+{
+  State_t &S = *State;
+
+  if (Child > 0)
+  {
+    if (!S.StartChild(Child))
+    {
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    }
+    return;
+  }
+
+  // The children that did start are waited for all the same
+  if (Child < 0)
+  {
+    fprintf(S.Out, "Could not start the children\n");
+    S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+  }
+
+  S.WaitChildren();
+}
+
+void T8086TinyInterface_t::GetRewindConfig(unsigned int &IntervalMs, unsigned int &BudgetKB, unsigned int &ClockHz)
+{
+  IntervalMs = 0;
+  BudgetKB = 0;
+  ClockHz = (unsigned int) State->CPU_Clock_Hz;
+}
+
+bool T8086TinyInterface_t::RewindRequest(unsigned int & /* Ms */)
+{
+  return false;
+}
+
+void T8086TinyInterface_t::GetProfileConfig(unsigned int &PeriodClocks, const char *&SymbolFilename, const char *&ReportFilename)
+{
+  PeriodClocks = State->ProfilePeriodClocks;
+  SymbolFilename = State->ProfileSymbolFilename;
+  ReportFilename = State->ProfileReportFilename;
+}
+
+void T8086TinyInterface_t::GetTraceConfig(unsigned int &Records, const char *&Filename)
+{
+  Records = State->TraceRecords;
+  Filename = State->TraceFilename;
+
+  if (State->TraceRecords != 0)
+  {
+    signal(SIGUSR1, TraceSignal);
+  }
+}
+
+bool T8086TinyInterface_t::TraceRequest(void)
+{
+  if ((State->TraceRecords == 0) || !TracePending)
+  {
+    return false;
+  }
+
+  TracePending = 0;
+
+  return true;
+}
+
+bool T8086TinyInterface_t::StatsRequest(void)
+{
+  return (State->StatsTarget != NULL) && PERF_Due();
+}
+
+void T8086TinyInterface_t::WriteStats(const stCpuCounters_t &Counters)
+{
+  if (State->StatsTarget != NULL)
+  {
+    PERF_Write(Counters, State->HostCounters);
+  }
+}
+
+bool T8086TinyInterface_t::SaveState(FILE *fp)
+{
+  return State->Transfer(fp, true, Port);
+}
+
+bool T8086TinyInterface_t::LoadState(FILE *fp)
+{
+  State_t &S = *State;
+  bool Loaded = S.Transfer(fp, false, Port);
+
+  // The -load snapshot is in: the run goes on, typing this run's text
+  if (S.LoadPending && Loaded)
+  {
+    S.ExitPending = false;
+    S.ExitReason = EXIT_NONE;
+    S.ExitCode = 0;
+    S.TypeIndex = 0;
+  }
+  S.LoadPending = false;
+
+  UpdateIntLine();
+
+  return Loaded;
+}
+
+bool T8086TinyInterface_t::TimerTick(int nTicks)
+{
+  State_t &S = *State;
+  bool NextVideoFrame = false;
+
+  // Split nTicks at the 4 ms frame boundaries, as the Win32 interface does
+  while (nTicks > 0)
+  {
+    int Ticks = (S.CPU_Clock_Hz / 250) + 1 - S.CPU_Counter;
+
+    if ((Ticks <= 0) || (Ticks > nTicks))
+    {
+      Ticks = nTicks;
+    }
+    nTicks -= Ticks;
+
+    if (FrameTick(Ticks))
+    {
+      NextVideoFrame = true;
+    }
+  }
+
+  UpdateIntLine();
+
+  return NextVideoFrame || S.ExitPending || S.ResetPending;
+}
+
+int T8086TinyInterface_t::NextEventTicks(void)
+{
+  State_t &S = *State;
+  long long EventTicks;
+
+  // An exit or reset is seen on the next TimerTick()
+  if (S.ExitPending || S.ResetPending)
+  {
+    return 1;
+  }
+
+  // Next frame: the keyboard processing
+  int Ticks = (S.CPU_Clock_Hz / 250) + 1 - S.CPU_Counter;
+
+  // Next PIT channel 0 reload, which raises IRQ 0
+  EventTicks = (long long) S.PIT_Channel[0].Count * S.CPU_Clock_Hz - S.PIT_Counter;
+  EventTicks = (EventTicks + PIT_Clock_Hz - 1) / PIT_Clock_Hz;
+  if (EventTicks < Ticks)
+  {
+    Ticks = (int) EventTicks;
+  }
+
+  return (Ticks > 0) ? Ticks : 1;
+}
+
+bool T8086TinyInterface_t::FrameTick(int nTicks)
+{
+  State_t &S = *State;
+  int PIT_Ticks;
+  bool NextVideoFrame = false;
+
+  // Update PIT
+
+  S.PIT_Counter = S.PIT_Counter + (long long) PIT_Clock_Hz * nTicks;
+  PIT_Ticks = (int) (S.PIT_Counter / S.CPU_Clock_Hz);
+  S.PIT_Counter = S.PIT_Counter % S.CPU_Clock_Hz;
+
+  S.PIT_UpdateTimers(PIT_Ticks);
+
+  // main update processing is every 4 ms of CPU time.
+
+  S.CPU_TotalTicks += nTicks;
+
+  S.CPU_Counter += nTicks;
+  if (S.CPU_Counter > (S.CPU_Clock_Hz / 250))
+  {
+    S.CPU_Counter = 0;
+    S.CPU_Frame++;
+
+    if (S.CPU_Frame == 4)
+    {
+      // Vertical retrace for 2 ms in each 16 ms frame
+      NextVideoFrame = true;
+      S.CPU_Frame = 0;
+      S.HostCounters.FramesSkipped++;
+      S.CGAStatus |= 0x08;
+      S.CGARetraceEnd = S.CPU_TotalTicks + (S.CPU_Clock_Hz / 500);
+    }
+
+    if (S.Replaying && !S.ReplayEvents(false))
+    {
+      S.RequestExit(EXIT_ERROR, EXIT_STATUS_ERROR);
+    }
+    else if (S.Recording)
+    {
+      INPUT_SetTime(S.CPU_TotalTicks, S.InputLog);
+    }
+
+    S.TypeNext(mem);
+
+    if ((S.TimeLimitTicks != 0) && (S.CPU_TotalTicks >= S.TimeLimitTicks))
+    {
+      S.RequestExit(EXIT_TIME, EXIT_STATUS_LIMIT);
+    }
+  }
+
+  return NextVideoFrame;
+}
+
+void T8086TinyInterface_t::GetRTCTime(struct timeb &Now)
+{
+  long long Milliseconds;
+
+  memset(&Now, 0, sizeof(Now));
+
+  Milliseconds = State->StartTime + (State->CPU_TotalTicks * 1000) / State->CPU_Clock_Hz;
+
+  Now.time = (time_t) (Milliseconds / 1000);
+  Now.millitm = (unsigned short) (Milliseconds % 1000);
+}
+
+void T8086TinyInterface_t::WritePort(int Address, unsigned char Value)
+{
+  State_t &S = *State;
+
+  Port[Address] = Value;
+
+  switch (Address)
+  {
+    // PIC Registers
+    case 0x20:
+      if (S.PIC_OCW_Idx == 0)
+      {
+        if ((Value & 0x10) != 0)
+        {
+          S.PIC_ICW[0] = Value;
+          S.PIC_ICW_Idx = 1;
+        }
+      }
+      else
+      {
+        S.PIC_OCW[S.PIC_OCW_Idx] = Value;
+        S.PIC_OCW_Idx++;
+        if (S.PIC_OCW_Idx > 2) S.PIC_OCW_Idx = 0;
+      }
+      break;
+    case 0x21:
+      if (S.PIC_ICW_Idx == 0)
+      {
+        S.PIC_OCW[0] = Value;
+        S.PIC_OCW_Idx = 1;
+      }
+      else
+      {
+        S.PIC_ICW[S.PIC_ICW_Idx] = Value;
+        S.PIC_ICW_Idx++;
+        if ((S.PIC_ICW[0] & 0x02) != 0)
+        {
+          // No ICW3 needed
+          if (S.PIC_ICW_Idx > 1) S.PIC_ICW_Idx = 0;
+        }
+        if ((S.PIC_ICW[0] & 0x01) == 0)
+        {
+          // No ICW 4 needed
+          if (S.PIC_ICW_Idx > 2) S.PIC_ICW_Idx = 0;
+        }
+        if (S.PIC_ICW_Idx > 3) S.PIC_ICW_Idx = 0;
+      }
+      break;
+
+    // PIT Registers
+    case 0x40:
+      S.PIT_WriteTimer(0, Value);
+      break;
+    case 0x41:
+      S.PIT_WriteTimer(1, Value);
+      break;
+    case 0x42:
+      S.PIT_WriteTimer(2, Value);
+      break;
+    case 0x43:
+      S.PIT_WriteControl(Value);
+      break;
+
+    case EXIT_PORT:
+      S.RequestExit(EXIT_PORT_WRITE, Value);
+      break;
+
+    default:
+      break;
+  }
+}
+
+unsigned char T8086TinyInterface_t::ReadPort(int Address)
+{
+  State_t &S = *State;
+
+  // By default return the last value written to the port.
+  unsigned char retval = Port[Address];
+
+  // Handle specific processing for ports that do something different.
+  switch (Address)
+  {
+    case 0x0020:
+      retval = 0;
+      break;
+    case 0x0021:
+      retval = S.PIC_OCW[0];
+      break;
+    case 0x0040:
+      retval = S.PIT_ReadTimer(0);
+      break;
+    case 0x0041:
+      retval = S.PIT_ReadTimer(1);
+      break;
+    case 0x0042:
+      retval = S.PIT_ReadTimer(2);
+      break;
+    case 0x0043:
+      break;
+
+    case 0x0060:
+      retval = S.KeyInputBuffer;
+      S.KeyInputFull = false;
+      break;
+
+    case 0x0064:
+      retval = 0x14;
+      if (S.KeyInputFull) retval |= 0x01;
+      break;
+
+    case 0x0201:
+      // joystick is unsupported
+      retval = 0xff;
+      break;
+
+    case 0x03DA:
+      if (S.CPU_TotalTicks > S.CGARetraceEnd)
+      {
+        // clear retrace
+        S.CGAStatus &= 0xf7;
+      }
+      retval = S.CGAStatus;
+
+      // VMem access goes high/low every scan line, so alternate it
+      S.CGAStatus ^= 0x01;
+      break;
+
+    default:
+      break;
+  }
+
+  UpdateIntLine();
+
+  return retval;
+}
+
+unsigned int T8086TinyInterface_t::VMemRead(int i_w, int addr)
+{
+  if (i_w)
+  {
+    return mem[addr] | (mem[addr+1] << 8);
+  }
+
+  return mem[addr];
+}
+
+unsigned int T8086TinyInterface_t::VMemWrite(int i_w, int addr, unsigned int val)
+{
+  mem[addr] = (unsigned char) (val & 0x00ff);
+
+  if (i_w)
+  {
+    mem[addr+1] = (unsigned char) ((val >> 8) & 0x00ff);
+  }
+
+  return 0;
+}
+
+bool T8086TinyInterface_t::IntPending(int &IntNumber)
+{
+  State_t &S = *State;
+  bool Pending = true;
+
+  if (S.Int8Pending > 0)
+  {
+    IntNumber = 8;
+    S.Int8Pending--;
+  }
+  else if (S.IsKeyEventAvailable() && !S.KeyInputFull)
+  {
+    S.KeyInputBuffer = S.NextKeyEvent();
+    S.KeyInputFull = true;
+    IntNumber = 9;
+  }
+  else
+  {
+    Pending = false;
+  }
+
+  UpdateIntLine();
+
+  return Pending;
+}
+
+void T8086TinyInterface_t::UpdateIntLine(void)
+{
+  IntLine = (State->Int8Pending > 0) ||
+            (State->IsKeyEventAvailable() && !State->KeyInputFull);
+}
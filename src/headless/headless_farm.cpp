@@ -0,0 +1,451 @@
+// =============================================================================
+// File: headless_farm.cpp
+//
+// Description:
+// Farm mode of the headless runner.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "8086tiny_interface.h"
+#include "8086tiny_cpu.h"
+#include "headless_farm.h"
+
+#define FARM_LINE_MAX   4096
+#define FARM_ARGS_MAX   64
+
+// Instructions per Run() call, as the emulator main loop does, and the
+// Run() calls of a machine before its worker takes the next one
+#define RUN_SLICE       100000
+#define FARM_TURN       10
+
+// Machines a worker starts jobs on until it has, so that there are some to
+// steal without the memory of every job at once
+#define FARM_LIVE_PER_WORKER 2
+
+// Host time an idle worker waits before it looks for a machine again
+#define FARM_IDLE_MS    10
+
+// Exit status of the farm when it cannot start
+#define FARM_STATUS_ERROR 3
+
+struct FarmJob_t
+{
+  char *Text;                   // The manifest line, split into Argv
+  int Argc;
+  char *Argv[FARM_ARGS_MAX + 1];
+};
+
+// A job running on a machine of its own
+struct FarmMachine_t
+{
+  int Job;
+  char OutFilename[FARM_LINE_MAX];
+  char *Argv[FARM_ARGS_MAX + 3];  // The job arguments, with -out if needed
+  T8086TinyInterface_t *Interface;
+  CPU8086 *Cpu;
+  unsigned long long Executed;
+  unsigned long long Limit;
+  FarmResult_t Result;
+  long long StartMs;
+};
+
+struct FarmWorker_t
+{
+  std::mutex Lock;              // Guards Machines
+  std::deque<FarmMachine_t *> Machines;
+};
+
+struct Farm_t
+{
+  FarmJob_t *Jobs;
+  int JobCount;
+  FarmWorker_t *Workers;
+  int WorkerCount;
+
+  std::mutex Lock;              // Guards the fields below and Results
+  std::condition_variable Idle;
+  int NextJob;
+  int Live;
+  int Failed;
+  unsigned long long TotalInstructions;
+  FILE *Results;
+};
+
+// Options a farm job cannot have, see headless_farm.h
+static const char *FarmRejected[] = { "-farm", "-stats", "-timeline", "-trace", "-profile", "-forkat", "-child" };
+
+// =============================================================================
+// Local Functions
+//
+
+static long long WallMs(void)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (long long) Now.tv_sec * 1000 + Now.tv_nsec / 1000000;
+}
+
+// Splits a manifest line in place at the blanks outside double quotes.
+// Returns false if the line has too many options.
+static bool SplitLine(char *Text, FarmJob_t &Job)
+{
+  char *In = Text;
+  char *Out = Text;
+
+  Job.Argc = 0;
+
+  for (;;)
+  {
+    while ((*In == ' ') || (*In == '\t')) In++;
+    if (*In == 0) break;
+
+    if (Job.Argc == FARM_ARGS_MAX) return false;
+    Job.Argv[Job.Argc++] = Out;
+
+    bool Quoted = false;
+    while ((*In != 0) && (Quoted || ((*In != ' ') && (*In != '\t'))))
+    {
+      if (*In == '"')
+      {
+        Quoted = !Quoted;
+        In++;
+      }
+      else
+      {
+        *Out++ = *In++;
+      }
+    }
+
+    if (*In != 0) In++;
+    *Out++ = 0;
+  }
+
+  Job.Argv[Job.Argc] = NULL;
+
+  return true;
+}
+
+// Reads the jobs of a manifest. Returns the number of jobs, -1 on error.
+static int ReadManifest(const char *Manifest, FarmJob_t *&Jobs)
+{
+  FILE *fp;
+  char Line[FARM_LINE_MAX];
+  int Count = 0;
+  int LineNumber = 0;
+
+  Jobs = NULL;
+
+  fp = fopen(Manifest, "r");
+  if (fp == NULL)
+  {
+    printf("Could not open farm manifest %s\n", Manifest);
+    return -1;
+  }
+
+  while (fgets(Line, sizeof(Line), fp) != NULL)
+  {
+    int Len = strlen(Line);
+
+    LineNumber++;
+    while ((Len > 0) && ((Line[Len - 1] == '\n') || (Line[Len - 1] == '\r'))) Line[--Len] = 0;
+
+    char *Text = Line;
+    while ((*Text == ' ') || (*Text == '\t')) Text++;
+    if ((*Text == 0) || (*Text == '#')) continue;
+
+    Jobs = (FarmJob_t *) realloc(Jobs, (Count + 1) * sizeof(FarmJob_t));
+    Jobs[Count].Text = strdup(Text);
+    if (!SplitLine(Jobs[Count].Text, Jobs[Count]))
+    {
+      printf("%s line %d: more than %d options\n", Manifest, LineNumber, FARM_ARGS_MAX);
+      fclose(fp);
+      return -1;
+    }
+    Count++;
+  }
+
+  fclose(fp);
+
+  return Count;
+}
+
+// Saves or loads a snapshot when the interface asks, as main() does
+static void SnapshotRequest(FarmMachine_t *M)
+{
+  const char *Filename;
+  bool Save;
+
+  if (M->Interface->SnapshotRequest(Filename, Save))
+  {
+    if (Save) M->Cpu->SaveSnapshot(Filename);
+    else M->Cpu->LoadSnapshot(Filename);
+  }
+}
+
+// Writes the result line of a job and counts it. Call with Farm.Lock held.
+static void WriteResult(Farm_t &Farm, int Job, const FarmResult_t &Result, long long WallMsTaken)
+{
+  fprintf(Farm.Results, "%s\t%d\t%s\t%llu\t%lld\t%lld\n",
+          Farm.Jobs[Job].Argv[0], Result.Status, Result.Reason, Result.Instructions,
+          Result.EmulatedMs, WallMsTaken);
+  fflush(Farm.Results);
+
+  Farm.TotalInstructions += Result.Instructions;
+  if (Result.Status != 0) Farm.Failed++;
+}
+
+// Starts the machine of a job. Returns NULL if the job cannot run on the
+// farm, after writing its result.
+static FarmMachine_t *StartMachine(Farm_t &Farm, int Job)
+{
+  FarmJob_t &J = Farm.Jobs[Job];
+  FarmMachine_t *M;
+  bool HasOut = false;
+  int Argc = 0;
+
+  for (int i = 1 ; i < J.Argc ; i++)
+  {
+    for (unsigned int r = 0 ; r < sizeof(FarmRejected) / sizeof(FarmRejected[0]) ; r++)
+    {
+      if (strcmp(J.Argv[i], FarmRejected[r]) == 0)
+      {
+        FarmResult_t Result = { FARM_STATUS_ERROR, "not started", 0, 0 };
+
+        std::lock_guard<std::mutex> Guard(Farm.Lock);
+        printf("Job %s: %s cannot be used on the farm\n", J.Argv[0], J.Argv[i]);
+        WriteResult(Farm, Job, Result, 0);
+        return NULL;
+      }
+    }
+
+    if (strcmp(J.Argv[i], "-out") == 0) HasOut = true;
+  }
+
+  M = new FarmMachine_t;
+  M->Job = Job;
+  M->StartMs = WallMs();
+
+  // The job's text output goes to <name>.out unless it has -out
+  M->Argv[Argc++] = J.Argv[0];
+  if (!HasOut)
+  {
+    snprintf(M->OutFilename, sizeof(M->OutFilename), "%s.out", J.Argv[0]);
+    M->Argv[Argc++] = (char *) "-out";
+    M->Argv[Argc++] = M->OutFilename;
+  }
+  for (int i = 1 ; i <= J.Argc ; i++) M->Argv[Argc++] = J.Argv[i];
+  Argc--;
+
+  M->Result.Status = FARM_STATUS_ERROR;
+  M->Result.Reason = "crashed";
+  M->Result.Instructions = 0;
+  M->Result.EmulatedMs = 0;
+
+  M->Interface = new T8086TinyInterface_t;
+  M->Interface->SetArgs(Argc, M->Argv);
+  M->Interface->SetFarmResult(&M->Result);
+  M->Cpu = new CPU8086(*M->Interface);
+  M->Executed = 0;
+  M->Limit = M->Interface->GetInstructionLimit();
+
+  // A snapshot to start from
+  SnapshotRequest(M);
+
+  return M;
+}
+
+// Runs a machine for a turn. Returns false once it has ended.
+static bool RunTurn(FarmMachine_t *M)
+{
+  for (int t = 0 ; t < FARM_TURN ; t++)
+  {
+    if (M->Cpu->Exited() || ((M->Limit != 0) && (M->Executed >= M->Limit))) return false;
+
+    unsigned int Slice = RUN_SLICE;
+    if ((M->Limit != 0) && ((M->Limit - M->Executed) < Slice))
+    {
+      Slice = (unsigned int) (M->Limit - M->Executed);
+    }
+    M->Executed += M->Cpu->Run(Slice);
+
+    SnapshotRequest(M);
+  }
+
+  return true;
+}
+
+// Ends the machine of a job and writes its result
+static void EndMachine(Farm_t &Farm, FarmMachine_t *M)
+{
+  M->Interface->ExitStatus(M->Executed);
+
+  // A snapshot of the machine as it ended
+  SnapshotRequest(M);
+
+  // Cleanup() fills in the result and closes the text output
+  delete M->Cpu;
+  delete M->Interface;
+
+  std::lock_guard<std::mutex> Guard(Farm.Lock);
+  WriteResult(Farm, M->Job, M->Result, WallMs() - M->StartMs);
+  Farm.Live--;
+  Farm.Idle.notify_all();
+
+  delete M;
+}
+
+// Takes the next machine for a worker: the machine of the next job while
+// the worker has fewer than FARM_LIVE_PER_WORKER, else the first of its own
+// deque, else one stolen from the back of another worker's deque. Returns
+// NULL once all the jobs have ended.
+static FarmMachine_t *TakeMachine(Farm_t &Farm, int w)
+{
+  FarmWorker_t &Own = Farm.Workers[w];
+
+  for (;;)
+  {
+    size_t OwnCount;
+    int Job = -1;
+
+    {
+      std::lock_guard<std::mutex> Guard(Own.Lock);
+      OwnCount = Own.Machines.size();
+    }
+
+    if (OwnCount < FARM_LIVE_PER_WORKER)
+    {
+      std::lock_guard<std::mutex> Guard(Farm.Lock);
+
+      if (Farm.NextJob < Farm.JobCount)
+      {
+        Job = Farm.NextJob++;
+        Farm.Live++;
+      }
+    }
+
+    if (Job >= 0)
+    {
+      FarmMachine_t *M = StartMachine(Farm, Job);
+      if (M != NULL) return M;
+
+      std::lock_guard<std::mutex> Guard(Farm.Lock);
+      Farm.Live--;
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> Guard(Own.Lock);
+
+      if (!Own.Machines.empty())
+      {
+        FarmMachine_t *M = Own.Machines.front();
+        Own.Machines.pop_front();
+        return M;
+      }
+    }
+
+    for (int i = 1 ; i < Farm.WorkerCount ; i++)
+    {
+      FarmWorker_t &Victim = Farm.Workers[(w + i) % Farm.WorkerCount];
+      std::lock_guard<std::mutex> Guard(Victim.Lock);
+
+      if (!Victim.Machines.empty())
+      {
+        FarmMachine_t *M = Victim.Machines.back();
+        Victim.Machines.pop_back();
+        return M;
+      }
+    }
+
+    // Every live machine is running on another worker
+    std::unique_lock<std::mutex> Guard(Farm.Lock);
+    if ((Farm.NextJob >= Farm.JobCount) && (Farm.Live == 0)) return NULL;
+    Farm.Idle.wait_for(Guard, std::chrono::milliseconds(FARM_IDLE_MS));
+  }
+}
+
+static void Worker(Farm_t *Farm, int w)
+{
+  FarmMachine_t *M;
+
+  while ((M = TakeMachine(*Farm, w)) != NULL)
+  {
+    if (!RunTurn(M))
+    {
+      EndMachine(*Farm, M);
+      continue;
+    }
+
+    FarmWorker_t &Own = Farm->Workers[w];
+    {
+      std::lock_guard<std::mutex> Guard(Own.Lock);
+      Own.Machines.push_back(M);
+    }
+    Farm->Idle.notify_one();
+  }
+}
+
+// =============================================================================
+// Exported Functions
+//
+
+void FARM_Run(const char *Manifest, const char *ResultsFilename, int WorkerCount)
+{
+  Farm_t Farm;
+  std::vector<std::thread> Threads;
+  long long FarmStartMs = WallMs();
+
+  Farm.JobCount = ReadManifest(Manifest, Farm.Jobs);
+  if (Farm.JobCount < 0) exit(FARM_STATUS_ERROR);
+
+  Farm.Results = fopen(ResultsFilename, "w");
+  if (Farm.Results == NULL)
+  {
+    printf("Could not create farm results %s\n", ResultsFilename);
+    exit(FARM_STATUS_ERROR);
+  }
+
+  if (WorkerCount <= 0)
+  {
+    WorkerCount = (int) std::thread::hardware_concurrency();
+    if (WorkerCount <= 0) WorkerCount = 1;
+  }
+
+  Farm.Workers = new FarmWorker_t[WorkerCount];
+  Farm.WorkerCount = WorkerCount;
+  Farm.NextJob = 0;
+  Farm.Live = 0;
+  Farm.Failed = 0;
+  Farm.TotalInstructions = 0;
+
+  printf("Farm: %d jobs on %d workers\n", Farm.JobCount, WorkerCount);
+  fflush(stdout);
+
+  for (int w = 0 ; w < WorkerCount ; w++) Threads.push_back(std::thread(Worker, &Farm, w));
+  for (int w = 0 ; w < WorkerCount ; w++) Threads[w].join();
+
+  long long FarmMs = WallMs() - FarmStartMs;
+  if (FarmMs == 0) FarmMs = 1;
+
+  fprintf(Farm.Results, "# %d jobs, %d failed, %d workers, %lld ms, %.1f jobs/hour, %llu instructions, %.2f MIPS\n",
+          Farm.JobCount, Farm.Failed, WorkerCount, FarmMs, (Farm.JobCount * 3600000.0) / FarmMs,
+          Farm.TotalInstructions, Farm.TotalInstructions / (FarmMs * 1000.0));
+  fclose(Farm.Results);
+
+  printf("Farm: %d jobs, %d failed, %lld ms\n", Farm.JobCount, Farm.Failed, FarmMs);
+
+  exit((Farm.Failed == 0) ? 0 : 1);
+}
@@ -0,0 +1,79 @@
+// =============================================================================
+// File: headless_farm.h
+//
+// Description:
+// Farm mode of the headless runner: runs the jobs of a manifest, each on a
+// machine of its own, on all the host cores.
+//
+// The jobs run in the farm process, each on a machine with an interface and
+// a CPU8086 of its own, which has its own text output and input log. A
+// pool of worker threads, one per host core by default, runs the machines
+// a bounded slice of instructions at a time. Each worker keeps the machines
+// it runs in a deque and takes them in turn; a worker with none left starts
+// the next job of the manifest, or steals a machine from the deque of
+// another worker. So long and short jobs share the cores, and a core never
+// waits while a machine is ready to run.
+//
+// The stats output, the timeline, the trace and the profile are per process
+// and the machines do not fork: farm jobs cannot have -stats, -timeline,
+// -trace, -profile, -forkat or -child.
+//
+// A job ends with exit status 0 when the guest halts or quits, e.g. with
+// QUITEMU.COM on disks/fd.img, see headless/example.farm.
+//
+// The manifest has one job per line: a name followed by the headless
+// command line options for it, see headless_8086tiny_interface.cpp. Text in
+// double quotes is one option. Blank lines and lines starting with # are
+// skipped. A job's text output goes to <name>.out unless it has -out. Jobs
+// that share a disk image at the same time need -private.
+//
+// The results file has a line for each job, in the order they end, with
+// these fields separated by tabs:
+//
+//   name, exit status, reason, instructions, emulated ms, wall ms
+//
+// then a line starting with # with the totals and the throughput.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __HEADLESS_FARM_H
+#define __HEADLESS_FARM_H
+
+// =============================================================================
+// Struct: FarmResult_t
+//
+// Description:
+// The result of a job, filled in when the machine of the job ends, see
+// T8086TinyInterface_t::SetFarmResult().
+//
+struct FarmResult_t
+{
+  int Status;                   // The exit status of the job
+  const char *Reason;           // Why the job ended
+  unsigned long long Instructions;
+  long long EmulatedMs;
+};
+
+// =============================================================================
+// Function: FARM_Run
+//
+// Description:
+// Runs the jobs of a manifest and exits once all of them have ended, with
+// status 0 if they all ended with status 0, 1 otherwise.
+//
+// Parameters:
+//
+//   Manifest : The manifest file.
+//
+//   ResultsFilename : The results file.
+//
+//   WorkerCount : The number of worker threads, 0 for one per host core.
+//
+// Returns:
+//
+//   None.
+//
+void FARM_Run(const char *Manifest, const char *ResultsFilename, int WorkerCount);
+
+#endif // __HEADLESS_FARM_H
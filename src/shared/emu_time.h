@@ -0,0 +1,37 @@
+// =============================================================================
+// File: emu_time.h
+//
+// Description:
+// Millisecond clock for the device emulation.
+//
+// Device timing the guest can see (retrace status, serial port events) is
+// taken from this clock instead of the host clock, so it stays in step with
+// the emulated CPU when the emulation is not tied to real time.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __EMU_TIME_H
+#define __EMU_TIME_H
+
+#include <windows.h>
+
+// =============================================================================
+// Function: EMU_GetTicks
+//
+// Description:
+// Gets the emulation clock. It runs with the host clock normally, and with
+// the emulated CPU time in turbo mode. It never goes backwards when turbo
+// mode is switched on or off.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   DWORD : The emulation clock in milliseconds.
+//
+DWORD EMU_GetTicks(void);
+
+#endif // __EMU_TIME_H
@@ -0,0 +1,271 @@
+// =============================================================================
+// File: input_log.cpp
+//
+// Description:
+// Record and replay of the inputs from the host.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "input_log.h"
+
+#define INPUT_LOG_MAGIC "TinyXTIL"
+#define INPUT_LOG_VERSION 1
+
+// Events read from the log that are due but not yet taken
+#define PENDING_MAX 256
+
+// =============================================================================
+// Local Data
+//
+
+// The state of a log
+struct InputLog_t
+{
+  InputLogMode_t Mode;
+  FILE *LogFile;
+
+  long long CurrentTicks; // The time set by INPUT_SetTime()
+  long long LastTicks;    // Time of the last event written or read
+
+  // Replay read ahead: the next event in the file and the due ones
+  bool NextValid;
+  long long NextTicks;
+  InputEvent_t NextEvent;
+
+  InputEvent_t Pending[PENDING_MAX];
+  int PendingCount;
+};
+
+// The log of the process, for the calls without one
+static InputLog_t ProcessLog;
+
+// =============================================================================
+// Local Functions
+//
+
+static InputLog_t &LogOf(InputLog_t *Log)
+{
+  return (Log != NULL) ? *Log : ProcessLog;
+}
+
+static void WriteVarint(InputLog_t &L, unsigned long long Value)
+{
+  while (Value >= 0x80)
+  {
+    fputc((int) ((Value & 0x7F) | 0x80), L.LogFile);
+    Value >>= 7;
+  }
+  fputc((int) Value, L.LogFile);
+}
+
+static bool ReadVarint(InputLog_t &L, unsigned long long &Value)
+{
+  int Shift = 0;
+  int c;
+
+  Value = 0;
+  do
+  {
+    c = fgetc(L.LogFile);
+    if ((c == EOF) || (Shift > 63))
+    {
+      return false;
+    }
+    Value |= (unsigned long long) (c & 0x7F) << Shift;
+    Shift += 7;
+  } while (c & 0x80);
+
+  return true;
+}
+
+// Read the next event in the log into NextEvent
+static void ReadNext(InputLog_t &L)
+{
+  unsigned long long Delta;
+  int Type;
+  int Length;
+
+  L.NextValid = false;
+
+  if (!ReadVarint(L, Delta)) return;
+
+  Type = fgetc(L.LogFile);
+  Length = fgetc(L.LogFile);
+  if ((Type == EOF) || (Length == EOF)) return;
+
+  L.NextEvent.Type = (InputEventType_t) Type;
+  L.NextEvent.Length = Length;
+  if ((Length > 0) && (fread(L.NextEvent.Data, Length, 1, L.LogFile) != 1)) return;
+
+  L.NextTicks = L.LastTicks + (long long) Delta;
+  L.LastTicks = L.NextTicks;
+  L.NextValid = true;
+}
+
+// =============================================================================
+// Exported Functions
+//
+
+InputLog_t *INPUT_Create(void)
+{
+  return new InputLog_t();
+}
+
+void INPUT_Destroy(InputLog_t *Log)
+{
+  if (Log == NULL) return;
+
+  INPUT_Stop(Log);
+  delete Log;
+}
+
+bool INPUT_StartRecord(const char *Filename, int ClockHz, long long StartTime, InputLog_t *Log)
+{
+  InputLog_t &L = LogOf(Log);
+  uint32_t Version = INPUT_LOG_VERSION;
+  uint32_t Clock = (uint32_t) ClockHz;
+  int64_t  Start = StartTime;
+
+  INPUT_Stop(Log);
+
+  L.LogFile = fopen(Filename, "wb");
+  if (L.LogFile == NULL)
+  {
+    printf("Could not create input log %s\n", Filename);
+    return false;
+  }
+
+  if ((fwrite(INPUT_LOG_MAGIC, 8, 1, L.LogFile) != 1) ||
+      (fwrite(&Version, sizeof(Version), 1, L.LogFile) != 1) ||
+      (fwrite(&Clock, sizeof(Clock), 1, L.LogFile) != 1) ||
+      (fwrite(&Start, sizeof(Start), 1, L.LogFile) != 1))
+  {
+    printf("Could not write input log %s\n", Filename);
+    INPUT_Stop(Log);
+    return false;
+  }
+
+  L.Mode = INPUT_LOG_RECORD;
+  L.CurrentTicks = 0;
+  L.LastTicks = 0;
+
+  return true;
+}
+
+bool INPUT_StartReplay(const char *Filename, int &ClockHz, long long &StartTime, InputLog_t *Log)
+{
+  InputLog_t &L = LogOf(Log);
+  char     Magic[8];
+  uint32_t Version;
+  uint32_t Clock;
+  int64_t  Start;
+
+  INPUT_Stop(Log);
+
+  L.LogFile = fopen(Filename, "rb");
+  if (L.LogFile == NULL)
+  {
+    printf("Could not open input log %s\n", Filename);
+    return false;
+  }
+
+  if ((fread(Magic, 8, 1, L.LogFile) != 1) ||
+      (memcmp(Magic, INPUT_LOG_MAGIC, 8) != 0) ||
+      (fread(&Version, sizeof(Version), 1, L.LogFile) != 1) ||
+      (Version != INPUT_LOG_VERSION) ||
+      (fread(&Clock, sizeof(Clock), 1, L.LogFile) != 1) ||
+      (fread(&Start, sizeof(Start), 1, L.LogFile) != 1))
+  {
+    printf("%s is not an input log\n", Filename);
+    INPUT_Stop(Log);
+    return false;
+  }
+
+  ClockHz = (int) Clock;
+  StartTime = Start;
+
+  L.Mode = INPUT_LOG_REPLAY;
+  L.CurrentTicks = 0;
+  L.LastTicks = 0;
+  L.PendingCount = 0;
+  ReadNext(L);
+
+  return true;
+}
+
+void INPUT_Stop(InputLog_t *Log)
+{
+  InputLog_t &L = LogOf(Log);
+
+  if (L.LogFile != NULL)
+  {
+    fclose(L.LogFile);
+    L.LogFile = NULL;
+  }
+
+  L.Mode = INPUT_LOG_OFF;
+  L.NextValid = false;
+  L.PendingCount = 0;
+}
+
+InputLogMode_t INPUT_GetMode(InputLog_t *Log)
+{
+  return LogOf(Log).Mode;
+}
+
+void INPUT_SetTime(long long Ticks, InputLog_t *Log)
+{
+  LogOf(Log).CurrentTicks = Ticks;
+}
+
+void INPUT_Record(InputEventType_t Type, const void *Data, int Length, InputLog_t *Log)
+{
+  InputLog_t &L = LogOf(Log);
+
+  if (L.Mode != INPUT_LOG_RECORD) return;
+
+  WriteVarint(L, (unsigned long long) (L.CurrentTicks - L.LastTicks));
+  fputc((int) Type, L.LogFile);
+  fputc(Length, L.LogFile);
+  if (Length > 0)
+  {
+    fwrite(Data, Length, 1, L.LogFile);
+  }
+
+  L.LastTicks = L.CurrentTicks;
+}
+
+bool INPUT_Replay(InputEventType_t Type, InputEvent_t &Event, InputLog_t *Log)
+{
+  InputLog_t &L = LogOf(Log);
+
+  if (L.Mode != INPUT_LOG_REPLAY) return false;
+
+  // Take the events that are due off the log
+  while (L.NextValid && (L.NextTicks <= L.CurrentTicks) && (L.PendingCount < PENDING_MAX))
+  {
+    L.Pending[L.PendingCount++] = L.NextEvent;
+    ReadNext(L);
+    if (!L.NextValid)
+    {
+      printf("End of input log\n");
+    }
+  }
+
+  for (int i = 0 ; i < L.PendingCount ; i++)
+  {
+    if (L.Pending[i].Type == Type)
+    {
+      Event = L.Pending[i];
+      L.PendingCount--;
+      memmove(&L.Pending[i], &L.Pending[i + 1], (L.PendingCount - i) * sizeof(InputEvent_t));
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,231 @@
+// =============================================================================
+// File: input_log.h
+//
+// Description:
+// Record and replay of the inputs from the host.
+//
+// Everything else the emulated machine sees follows from its own state, so
+// a run can be repeated exactly by logging the host inputs with the CPU
+// clock they arrived at and feeding them back at the same clock. While a log
+// is recorded or replayed the emulation clock and the real time clock follow
+// the CPU clock, see EMU_GetTicks().
+//
+// The log file is laid out as:
+//
+//   Header: "TinyXTIL", uint32_t version, uint32_t CPU clock in Hz and
+//   int64_t real time clock at the start in ms since 1970.
+//   Events: CPU clocks since the event before as a 7 bits per byte varint,
+//   uint8_t type, uint8_t data length and the data.
+//
+// A log starts with the machine at power on and replays only with the same
+// configuration and disk images, on a host in the same time zone.
+//
+// Each function takes the log to use as its last parameter. A host with one
+// machine leaves it out and uses the log of the process; one that runs
+// several machines in a process gives each its own, see INPUT_Create().
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __INPUT_LOG_H
+#define __INPUT_LOG_H
+
+#include <stddef.h>
+
+#define INPUT_LOG_MAX_DATA 255
+
+enum InputLogMode_t
+{
+  INPUT_LOG_OFF,    // Inputs come from the host
+  INPUT_LOG_RECORD, // Inputs come from the host and are logged
+  INPUT_LOG_REPLAY  // Inputs come from the log, the host ones are ignored
+};
+
+enum InputEventType_t
+{
+  INPUT_KEY = 1, // Data: the scan code
+  INPUT_MOUSE,   // Data: int16_t dx, dy and buttons (bit 0 left, bit 1 right)
+  INPUT_SERIAL,  // Data: COM port and what the host side did, see serial_emulation.cpp
+  INPUT_RESET    // No data
+};
+
+struct InputEvent_t
+{
+  InputEventType_t Type;
+  int              Length;
+  unsigned char    Data[INPUT_LOG_MAX_DATA];
+};
+
+// The state of one log
+struct InputLog_t;
+
+// =============================================================================
+// Function: INPUT_Create
+//
+// Description:
+// Creates a log of its own for a machine, neither recording nor replaying.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   InputLog_t * : The log.
+//
+InputLog_t *INPUT_Create(void);
+
+// =============================================================================
+// Function: INPUT_Destroy
+//
+// Description:
+// Stops a log from INPUT_Create() and frees it.
+//
+// Parameters:
+//
+//   Log : The log, or NULL.
+//
+// Returns:
+//
+//   None.
+//
+void INPUT_Destroy(InputLog_t *Log);
+
+// =============================================================================
+// Function: INPUT_StartRecord
+//
+// Description:
+// Starts logging the host inputs to a file.
+//
+// Parameters:
+//
+//   Filename : The log file.
+//
+//   ClockHz : The CPU clock in Hz.
+//
+//   StartTime : The real time clock in ms since 1970.
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   bool : true if the log file was created.
+//
+bool INPUT_StartRecord(const char *Filename, int ClockHz, long long StartTime, InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_StartReplay
+//
+// Description:
+// Starts replaying the inputs from a log file.
+//
+// Parameters:
+//
+//   Filename : The log file.
+//
+//   ClockHz : Set to the CPU clock the log was recorded with.
+//
+//   StartTime : Set to the real time clock at the start of the log.
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   bool : true if the log file was opened.
+//
+bool INPUT_StartReplay(const char *Filename, int &ClockHz, long long &StartTime, InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_Stop
+//
+// Description:
+// Stops recording or replaying and closes the log file.
+//
+// Parameters:
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   None.
+//
+void INPUT_Stop(InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_GetMode
+//
+// Description:
+// Gets whether the inputs are recorded or replayed.
+//
+// Parameters:
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   InputLogMode_t : The mode.
+//
+InputLogMode_t INPUT_GetMode(InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_SetTime
+//
+// Description:
+// Sets the CPU clock count the events are recorded or replayed at.
+//
+// Parameters:
+//
+//   Ticks : CPU clocks since the log was started.
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   None.
+//
+void INPUT_SetTime(long long Ticks, InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_Record
+//
+// Description:
+// Logs an input at the current time, if recording.
+//
+// Parameters:
+//
+//   Type : The event type.
+//
+//   Data : The event data.
+//
+//   Length : The event data length in bytes, up to INPUT_LOG_MAX_DATA.
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   None.
+//
+void INPUT_Record(InputEventType_t Type, const void *Data, int Length, InputLog_t *Log = NULL);
+
+// =============================================================================
+// Function: INPUT_Replay
+//
+// Description:
+// Gets the next logged input of a type that is due at the current time, if
+// replaying. Inputs of each type come back in the order they were logged.
+//
+// Parameters:
+//
+//   Type : The event type.
+//
+//   Event : Set to the event.
+//
+//   Log : The log, NULL for the log of the process.
+//
+// Returns:
+//
+//   bool : true if there was an event due.
+//
+bool INPUT_Replay(InputEventType_t Type, InputEvent_t &Event, InputLog_t *Log = NULL);
+
+#endif // __INPUT_LOG_H
@@ -0,0 +1,323 @@
+// =============================================================================
+// File: perf_stats.cpp
+//
+// Description:
+// Performance counters output, for monitoring a running emulator.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "perf_stats.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Room for the JSON object, with every interrupt vector listed
+#define JSON_SIZE 32768
+
+// =============================================================================
+// Local Data
+//
+
+static bool StatsOn = false;
+static char Target[1024];
+static char TempTarget[1024 + 8];
+static unsigned long long PeriodUs = 0;
+
+static unsigned long long StartUs = 0;
+static unsigned long long LastUs = 0;   // When the last period started
+static stCpuCounters_t LastCpu;         // The counters then
+static PerfHostCounters_t LastHost;
+
+#if !defined(_WIN32)
+static int ListenSocket = -1;
+#endif
+
+static char Json[JSON_SIZE];
+static int JsonLen = 0;
+
+// =============================================================================
+// Local Functions
+//
+
+static void JsonAdd(const char *Format, ...)
+{
+  va_list Args;
+  int Len;
+
+  va_start(Args, Format);
+  Len = vsnprintf(Json + JsonLen, JSON_SIZE - JsonLen, Format, Args);
+  va_end(Args);
+
+  if (Len > 0)
+  {
+    JsonLen += Len;
+    if (JsonLen >= JSON_SIZE)
+    {
+      JsonLen = JSON_SIZE - 1;
+    }
+  }
+}
+
+// Counters go back with the emulated time when a snapshot is loaded or the
+// machine is rewound, that period counts as nothing
+static unsigned long long Delta(unsigned long long Now, unsigned long long Last)
+{
+  return (Now >= Last) ? (Now - Last) : 0;
+}
+
+static double Rate(unsigned long long Count, double Seconds)
+{
+  return (Seconds > 0.0) ? ((double) Count / Seconds) : 0.0;
+}
+
+static int GetPid(void)
+{
+#if defined(_WIN32)
+  return (int) GetCurrentProcessId();
+#else
+  return (int) getpid();
+#endif
+}
+
+static void WriteFile(void)
+{
+  FILE *fp;
+
+  fp = fopen(TempTarget, "wb");
+  if (fp == NULL)
+  {
+    return;
+  }
+
+  fwrite(Json, 1, JsonLen, fp);
+  fclose(fp);
+
+#if defined(_WIN32)
+  // rename() does not replace a file on Windows
+  MoveFileExA(TempTarget, Target, MOVEFILE_REPLACE_EXISTING);
+#else
+  rename(TempTarget, Target);
+#endif
+}
+
+#if !defined(_WIN32)
+static void WriteSocket(void)
+{
+  int Client;
+
+  // Serve every client waiting, none of them blocks the emulation
+  while ((Client = accept(ListenSocket, NULL, NULL)) >= 0)
+  {
+    send(Client, Json, JsonLen, MSG_NOSIGNAL);
+    close(Client);
+  }
+}
+
+static bool OpenSocket(const char *Path)
+{
+  struct sockaddr_un Address;
+
+  if (strlen(Path) >= sizeof(Address.sun_path))
+  {
+    return false;
+  }
+
+  ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ListenSocket < 0)
+  {
+    return false;
+  }
+
+  memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  strcpy(Address.sun_path, Path);
+
+  // A socket left by an instance that did not exit cleanly is in the way
+  unlink(Path);
+
+  if ((bind(ListenSocket, (struct sockaddr *) &Address, sizeof(Address)) != 0) ||
+      (listen(ListenSocket, 8) != 0) ||
+      (fcntl(ListenSocket, F_SETFL, fcntl(ListenSocket, F_GETFL) | O_NONBLOCK) != 0))
+  {
+    close(ListenSocket);
+    ListenSocket = -1;
+    return false;
+  }
+
+  return true;
+}
+#endif
+
+// =============================================================================
+// Exported Functions
+//
+
+bool PERF_Open(const char *TargetIn, unsigned int PeriodMs)
+{
+  PERF_Close();
+
+  if ((TargetIn == NULL) || (strlen(TargetIn) >= sizeof(Target)) || (PeriodMs == 0))
+  {
+    return false;
+  }
+
+  strcpy(Target, TargetIn);
+  sprintf(TempTarget, "%s.tmp", Target);
+
+  if (strncmp(Target, "unix:", 5) == 0)
+  {
+#if defined(_WIN32)
+    return false;
+#else
+    if (!OpenSocket(Target + 5))
+    {
+      return false;
+    }
+#endif
+  }
+
+  PeriodUs = (unsigned long long) PeriodMs * 1000;
+  StartUs = PERF_GetMicroseconds();
+  LastUs = StartUs;
+  memset(&LastCpu, 0, sizeof(LastCpu));
+  memset(&LastHost, 0, sizeof(LastHost));
+  StatsOn = true;
+
+  return true;
+}
+
+void PERF_Close(void)
+{
+#if !defined(_WIN32)
+  if (ListenSocket >= 0)
+  {
+    close(ListenSocket);
+    ListenSocket = -1;
+    unlink(Target + 5);
+  }
+#endif
+
+  StatsOn = false;
+}
+
+bool PERF_Due(void)
+{
+  return StatsOn && (PERF_GetMicroseconds() - LastUs >= PeriodUs);
+}
+
+void PERF_Write(const stCpuCounters_t &Cpu, const PerfHostCounters_t &Host)
+{
+  unsigned long long NowUs;
+  unsigned long long Interrupts = 0;
+  unsigned long long LastInterrupts = 0;
+  unsigned long long Frames;
+  double Seconds;
+
+  if (!StatsOn)
+  {
+    return;
+  }
+
+  NowUs = PERF_GetMicroseconds();
+  Seconds = (double) (NowUs - LastUs) / 1000000.0;
+
+  for (int i = 0 ; i < 256 ; i++)
+  {
+    Interrupts += Cpu.interrupts[i];
+    LastInterrupts += LastCpu.interrupts[i];
+  }
+
+  Frames = Delta(Host.FramesRendered + Host.FramesSkipped, LastHost.FramesRendered + LastHost.FramesSkipped);
+
+  JsonLen = 0;
+  JsonAdd("{\n");
+  JsonAdd("  \"pid\": %d, \"uptime_ms\": %llu, \"period_ms\": %llu,\n",
+          GetPid(), (NowUs - StartUs) / 1000, (NowUs - LastUs) / 1000);
+  JsonAdd("  \"instructions\": %llu, \"mips\": %.3f,\n",
+          (unsigned long long) Cpu.instructions,
+          Rate(Delta(Cpu.instructions, LastCpu.instructions), Seconds) / 1000000.0);
+  JsonAdd("  \"cycles\": %llu, \"emulated_mhz\": %.3f,\n",
+          (unsigned long long) Cpu.cycles,
+          Rate(Delta(Cpu.cycles, LastCpu.cycles), Seconds) / 1000000.0);
+  JsonAdd("  \"interrupts\": %llu, \"interrupts_per_s\": %.1f,\n",
+          Interrupts, Rate(Delta(Interrupts, LastInterrupts), Seconds));
+
+  JsonAdd("  \"interrupt_vectors\": {");
+  for (int i = 0, Listed = 0 ; i < 256 ; i++)
+  {
+    if (Cpu.interrupts[i] != 0)
+    {
+      JsonAdd("%s\n    \"%02X\": { \"count\": %llu, \"per_s\": %.1f }", (Listed++ != 0) ? "," : "", i,
+              (unsigned long long) Cpu.interrupts[i], Rate(Delta(Cpu.interrupts[i], LastCpu.interrupts[i]), Seconds));
+    }
+  }
+  JsonAdd(" },\n");
+
+  JsonAdd("  \"frames_rendered\": %llu, \"frames_skipped\": %llu, \"frames_per_s\": %.1f,\n",
+          Host.FramesRendered, Host.FramesSkipped, Rate(Frames, Seconds));
+  JsonAdd("  \"render_ms\": %.1f, \"render_ms_per_frame\": %.3f,\n",
+          (double) Host.RenderUs / 1000.0,
+          (Host.FramesRendered > LastHost.FramesRendered) ?
+            (double) Delta(Host.RenderUs, LastHost.RenderUs) / 1000.0 / (double) (Host.FramesRendered - LastHost.FramesRendered) : 0.0);
+  JsonAdd("  \"disk_sectors_read\": %llu, \"disk_sectors_written\": %llu,\n",
+          (unsigned long long) Cpu.disk_sectors_read, (unsigned long long) Cpu.disk_sectors_written);
+  JsonAdd("  \"disk_sectors_per_s\": %.1f,\n",
+          Rate(Delta(Cpu.disk_sectors_read + Cpu.disk_sectors_written, LastCpu.disk_sectors_read + LastCpu.disk_sectors_written), Seconds));
+  JsonAdd("  \"serial_bytes_in\": %llu, \"serial_bytes_out\": %llu, \"serial_bytes_per_s\": %.1f\n",
+          Host.SerialBytesIn, Host.SerialBytesOut,
+          Rate(Delta(Host.SerialBytesIn + Host.SerialBytesOut, LastHost.SerialBytesIn + LastHost.SerialBytesOut), Seconds));
+  JsonAdd("}\n");
+
+#if !defined(_WIN32)
+  if (ListenSocket >= 0)
+  {
+    WriteSocket();
+  }
+  else
+#endif
+  {
+    WriteFile();
+  }
+
+  LastUs = NowUs;
+  LastCpu = Cpu;
+  LastHost = Host;
+}
+
+unsigned long long PERF_GetMicroseconds(void)
+{
+#if defined(_WIN32)
+  static LARGE_INTEGER Frequency = { { 0, 0 } };
+  LARGE_INTEGER Count;
+
+  if (Frequency.QuadPart == 0)
+  {
+    QueryPerformanceFrequency(&Frequency);
+  }
+  QueryPerformanceCounter(&Count);
+
+  return (unsigned long long) (Count.QuadPart / Frequency.QuadPart) * 1000000 +
+         (unsigned long long) (Count.QuadPart % Frequency.QuadPart) * 1000000 / Frequency.QuadPart;
+#else
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+
+  return (unsigned long long) Now.tv_sec * 1000000 + (unsigned long long) Now.tv_nsec / 1000;
+#endif
+}
@@ -0,0 +1,142 @@
+// =============================================================================
+// File: perf_stats.h
+//
+// Description:
+// Performance counters output, for monitoring a running emulator.
+//
+// Every stats period of host time the counters of the CPU and of the
+// interface are written out as one JSON object, with the totals since power
+// on and the rates over the period:
+//
+//   {
+//     "pid": 1234, "uptime_ms": 5000, "period_ms": 1000,
+//     "instructions": 123456789, "mips": 24.600,
+//     "cycles": 23850000, "emulated_mhz": 4.770,
+//     "interrupts": 4200, "interrupts_per_s": 840.0,
+//     "interrupt_vectors": { "08": { "count": 91, "per_s": 18.2 }, ... },
+//     "frames_rendered": 300, "frames_skipped": 0, "frames_per_s": 60.0,
+//     "render_ms": 120.5, "render_ms_per_frame": 0.402,
+//     "disk_sectors_read": 800, "disk_sectors_written": 2,
+//     "disk_sectors_per_s": 12.0,
+//     "serial_bytes_in": 0, "serial_bytes_out": 0, "serial_bytes_per_s": 0.0
+//   }
+//
+// Only the interrupt vectors taken at least once are listed, by their number
+// in hex.
+//
+// The stats target is a file name, or unix:<path> for a Unix domain socket
+// on hosts that have them. A file is replaced as a whole at each period, so
+// a reader never sees half of one. A socket is listened on, and each client
+// that has connected is sent the next object written, then the connection
+// is closed.
+//
+// Each part of the emulation counts into counters of its own, written only
+// by the thread that runs it, and they are only gathered when the stats are
+// written, so counting costs a plain increment.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __PERF_STATS_H
+#define __PERF_STATS_H
+
+#include "emulator/XTcounters.h"
+
+// Default stats period in ms
+#define PERF_DEFAULT_PERIOD_MS 1000
+
+// Counters kept by the interface
+struct PerfHostCounters_t
+{
+  unsigned long long FramesRendered; // Frames drawn on the host
+  unsigned long long FramesSkipped;  // Frames not drawn, in turbo mode or with no display
+  unsigned long long RenderUs;       // Host time drawing the frames in us
+  unsigned long long SerialBytesIn;  // Bytes received by the guest's serial ports
+  unsigned long long SerialBytesOut; // Bytes sent by the guest's serial ports
+};
+
+// =============================================================================
+// Function: PERF_Open
+//
+// Description:
+// Starts writing the stats.
+//
+// Parameters:
+//
+//   Target : The stats file, or unix:<path> for a Unix domain socket.
+//
+//   PeriodMs : Host time between two writes in ms.
+//
+// Returns:
+//
+//   bool : true if the stats output is on.
+//
+bool PERF_Open(const char *Target, unsigned int PeriodMs);
+
+// =============================================================================
+// Function: PERF_Close
+//
+// Description:
+// Stops writing the stats. A socket is closed and removed, a file is kept.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   None.
+//
+void PERF_Close(void);
+
+// =============================================================================
+// Function: PERF_Due
+//
+// Description:
+// Checks if the stats period has passed since the last write.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   bool : true if the stats output is on and due.
+//
+bool PERF_Due(void);
+
+// =============================================================================
+// Function: PERF_Write
+//
+// Description:
+// Writes the stats, if the stats output is on, and starts the next period.
+//
+// Parameters:
+//
+//   Cpu : The CPU counters.
+//
+//   Host : The interface counters.
+//
+// Returns:
+//
+//   None.
+//
+void PERF_Write(const stCpuCounters_t &Cpu, const PerfHostCounters_t &Host);
+
+// =============================================================================
+// Function: PERF_GetMicroseconds
+//
+// Description:
+// Gets a host clock for timing the emulation, such as the render time.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   unsigned long long : The host clock in us, from an arbitrary start.
+//
+unsigned long long PERF_GetMicroseconds(void);
+
+#endif // __PERF_STATS_H
@@ -15,11 +15,15 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
 #include "serial_emulation.h"
 #include "serial_hw.h"
+#include "emu_time.h"
+#include "state_io.h"
+#include "input_log.h"
 
-#define GET_TICKS timeGetTime
+#define GET_TICKS EMU_GetTicks
 
 // =============================================================================
 // Local Functions
@@ -92,6 +96,10 @@ ComPortInfo_t ComData[4];
 // Winsock initialise status - windows only
 bool WinsockInitialised = false;
 
+// Bytes into and out of the guest, see SERIAL_GetCounters()
+static unsigned long long RxByteCount = 0;
+static unsigned long long TxByteCount = 0;
+
 // =============================================================================
 // Local Functions
 //
@@ -233,6 +241,7 @@ static void AddRxByte(int ComPort, unsigned char Byte)
   ComData[ComPort].RxBuffer[ComData[ComPort].RxTail] = Byte;
   ComData[ComPort].RxTail = (ComData[ComPort].RxTail + 1) % FIFO_SIZE;
   ComData[ComPort].RxBufferLen++;
+  RxByteCount++;
 
   ComData[ComPort].Reg[5] |= 0x01; // Set Data Ready
 
@@ -272,6 +281,7 @@ static void AddTxByte(int ComPort, unsigned char Byte)
   ComData[ComPort].TxBuffer[ComData[ComPort].TxTail] = Byte;
   ComData[ComPort].TxTail = (ComData[ComPort].TxTail + 1) % FIFO_SIZE;
   ComData[ComPort].TxBufferLen++;
+  TxByteCount++;
   ComData[ComPort].TxBufferLenI = ComData[ComPort].TxBufferLen;
 
   ComData[ComPort].Reg[5] &= 0xBF;  // Clear Transmitter Empty
@@ -397,6 +407,69 @@ void HandleHWComPort(int ComPort)
 }
 
 
+//
+// Input log functions
+//
+// The host side of a HW or TCP port is logged as what it did to the port
+// on each call to SERIAL_HandleSerial(): the bytes received, the number of
+// bytes sent and the new modem status. The INPUT_SERIAL event data is the
+// COM port, 1 if the MSR changed, the MSR, the bytes sent, the bytes
+// received and the received bytes.
+//
+
+static void RecordComPort(int ComPort, int RxBufferLen, int TxBufferLen, unsigned char MSR)
+{
+  unsigned char Data[5 + FIFO_SIZE];
+  int RxBytes = ComData[ComPort].RxBufferLen - RxBufferLen;
+  int TxBytes = TxBufferLen - ComData[ComPort].TxBufferLen;
+  bool MSRChanged = (ComData[ComPort].Reg[6] != MSR);
+
+  if ((RxBytes == 0) && (TxBytes == 0) && !MSRChanged) return;
+
+  Data[0] = (unsigned char) ComPort;
+  Data[1] = (MSRChanged) ? 1 : 0;
+  Data[2] = ComData[ComPort].Reg[6];
+  Data[3] = (unsigned char) TxBytes;
+  Data[4] = (unsigned char) RxBytes;
+  for (int i = 0 ; i < RxBytes ; i++)
+  {
+    Data[5 + i] = ComData[ComPort].RxBuffer[(ComData[ComPort].RxTail + FIFO_SIZE - RxBytes + i) % FIFO_SIZE];
+  }
+
+  INPUT_Record(INPUT_SERIAL, Data, 5 + RxBytes);
+}
+
+static void ReplayComPort(const InputEvent_t &Event)
+{
+  int ComPort = Event.Data[0] & 3;
+
+  for (int i = 0 ; i < Event.Data[4] ; i++)
+  {
+    AddRxByte(ComPort, Event.Data[5 + i]);
+  }
+
+  for (int i = 0 ; i < Event.Data[3] ; i++)
+  {
+    GetTxByte(ComPort);
+  }
+
+  if (Event.Data[1])
+  {
+    ComData[ComPort].Reg[6] = Event.Data[2];
+  }
+
+  ReevaluateInterrupts(ComPort);
+}
+
+static void MouseMove(int dx, int dy, bool LButtonDown, bool RButtonDown)
+{
+  Mouse_dx += dx;
+  Mouse_dy += dy;
+  Mouse_LBPressed = LButtonDown;
+  Mouse_RBPressed = RButtonDown;
+  MouseEventPending = true;
+}
+
 //
 // TCP/IP serial port emulation functions
 //
@@ -1038,17 +1111,39 @@ bool SERIAL_Configure(int ComPort, SerialMapping_t Mapping, const char *ComName)
 void SERIAL_MouseMove(int dx, int dy, bool LButtonDown, bool RButtonDown)
 {
   if (SerialMousePort == -1) return;
+  if (INPUT_GetMode() == INPUT_LOG_REPLAY) return;
 
-  Mouse_dx += dx;
-  Mouse_dy += dy;
-  Mouse_LBPressed = LButtonDown;
-  Mouse_RBPressed = RButtonDown;
-  MouseEventPending = true;
+  if (INPUT_GetMode() == INPUT_LOG_RECORD)
+  {
+    short Data[3];
+
+    Data[0] = (short) ((dx < -32768) ? -32768 : (dx > 32767) ? 32767 : dx);
+    Data[1] = (short) ((dy < -32768) ? -32768 : (dy > 32767) ? 32767 : dy);
+    Data[2] = (short) ((LButtonDown ? 1 : 0) | (RButtonDown ? 2 : 0));
+    INPUT_Record(INPUT_MOUSE, Data, sizeof(Data));
+    dx = Data[0];
+    dy = Data[1];
+  }
+
+  MouseMove(dx, dy, LButtonDown, RButtonDown);
 }
 
 void SERIAL_HandleSerial()
 {
   DWORD CurrentTime = GET_TICKS();
+  InputEvent_t Event;
+
+  // Logged mouse movements go in first, as host ones would have
+  while (INPUT_Replay(INPUT_MOUSE, Event))
+  {
+    short Data[3];
+
+    memcpy(Data, Event.Data, sizeof(Data));
+    if (SerialMousePort != -1)
+    {
+      MouseMove(Data[0], Data[1], (Data[2] & 1) != 0, (Data[2] & 2) != 0);
+    }
+  }
 
   if ((SerialMousePort != -1) &&
       ((ComData[SerialMousePort].Reg[4] & 0x10) == 0))
@@ -1095,8 +1190,31 @@ void SERIAL_HandleSerial()
     }
   }
 
+  if (INPUT_GetMode() == INPUT_LOG_REPLAY)
+  {
+    // The host side of the ports comes from the log
+    while (INPUT_Replay(INPUT_SERIAL, Event))
+    {
+      ReplayComPort(Event);
+    }
+
+    for (int ComPort = 0 ; ComPort < 4 ; ComPort++)
+    {
+      if (((ComData[ComPort].Reg[4] & 0x10) == 0) && (ComData[ComPort].Mapping == SERIAL_COM))
+      {
+        ReevaluateInterrupts(ComPort);
+      }
+    }
+
+    return;
+  }
+
   for (int ComPort = 0 ; ComPort < 4 ; ComPort++)
   {
+    int RxBufferLen = ComData[ComPort].RxBufferLen;
+    int TxBufferLen = ComData[ComPort].TxBufferLen;
+    unsigned char MSR = ComData[ComPort].Reg[6];
+
     if ((ComData[ComPort].Reg[4] & 0x10) == 0)
     {
       // Not in loop back mode, so process serial port
@@ -1112,6 +1230,11 @@ void SERIAL_HandleSerial()
       {
         HandleTCPClient(ComPort);
       }
+
+      if (INPUT_GetMode() == INPUT_LOG_RECORD)
+      {
+        RecordComPort(ComPort, RxBufferLen, TxBufferLen, MSR);
+      }
     }
   }
 
@@ -1434,4 +1557,71 @@ bool SERIAL_IntPending(int &IntNo)
   return false;
 }
 
+// Writes or reads the emulated UART and mouse state for
+// SERIAL_SaveState()/SERIAL_LoadState()
+static bool SERIAL_State(FILE *fp, bool Save)
+{
+  for (int i = 0 ; i < 4 ; i++)
+  {
+    ComPortInfo_t *Com = &ComData[i];
+
+    STATE_ITEM(fp, Save, Com->Reg);
+    STATE_ITEM(fp, Save, Com->DivisorLatch);
+    STATE_ITEM(fp, Save, Com->DivisorL);
+    STATE_ITEM(fp, Save, Com->DivisorH);
+    STATE_ITEM(fp, Save, Com->Divisor);
+    STATE_ITEM(fp, Save, Com->BaudRate);
+    STATE_ITEM(fp, Save, Com->DataBits);
+    STATE_ITEM(fp, Save, Com->StopBits);
+    STATE_ITEM(fp, Save, Com->Parity);
+    STATE_ITEM(fp, Save, Com->RxTriggerLevel);
+    STATE_ITEM(fp, Save, Com->RxBuffer);
+    STATE_ITEM(fp, Save, Com->RxBufferLen);
+    STATE_ITEM(fp, Save, Com->RxHead);
+    STATE_ITEM(fp, Save, Com->RxTail);
+    STATE_ITEM(fp, Save, Com->RTS_High);
+    STATE_ITEM(fp, Save, Com->DTR_High);
+    STATE_ITEM(fp, Save, Com->TxBuffer);
+    STATE_ITEM(fp, Save, Com->TxBufferLen);
+    STATE_ITEM(fp, Save, Com->TxBufferLenI);
+    STATE_ITEM(fp, Save, Com->TxHead);
+    STATE_ITEM(fp, Save, Com->TxTail);
+    STATE_ITEM(fp, Save, Com->IIR);
+    STATE_ITEM(fp, Save, Com->IRQ);
+  }
+
+  STATE_ITEM(fp, Save, MouseEventPending);
+  STATE_ITEM(fp, Save, Mouse_dx);
+  STATE_ITEM(fp, Save, Mouse_dy);
+  STATE_ITEM(fp, Save, Mouse_LBPressed);
+  STATE_ITEM(fp, Save, Mouse_RBPressed);
+  STATE_ITEM(fp, Save, MousePowerOn);
+  STATE_ITEM(fp, Save, MouseSendOK);
+
+  if (!Save)
+  {
+    // Give the host side of each port the restored line settings
+    for (int i = 0 ; i < 4 ; i++)
+    {
+      ConfigureComPort(i);
+    }
+  }
 
+  return true;
+}
+
+void SERIAL_GetCounters(unsigned long long &BytesIn, unsigned long long &BytesOut)
+{
+  BytesIn = RxByteCount;
+  BytesOut = TxByteCount;
+}
+
+bool SERIAL_SaveState(FILE *fp)
+{
+  return SERIAL_State(fp, true);
+}
+
+bool SERIAL_LoadState(FILE *fp)
+{
+  return SERIAL_State(fp, false);
+}
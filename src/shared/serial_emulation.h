@@ -246,4 +246,56 @@ bool SERIAL_ReadPort(int Address, unsigned char &Val);
 //
 bool SERIAL_IntPending(int &IntNo);
 
+// =============================================================================
+// Function: SERIAL_GetCounters
+//
+// Description:
+// Get the number of bytes the emulated serial ports have moved since the
+// emulator started, see perf_stats.h.
+//
+// Parameters:
+//
+//   BytesIn : Set to the bytes received by the guest.
+//
+//   BytesOut : Set to the bytes sent by the guest.
+//
+// Returns:
+//
+//   None.
+//
+void SERIAL_GetCounters(unsigned long long &BytesIn, unsigned long long &BytesOut);
+
+// =============================================================================
+// Function: SERIAL_SaveState
+//
+// Description:
+// Write the emulated UART registers and FIFOs and the serial mouse state to
+// a snapshot file. The port mappings and host connections are not saved.
+//
+// Parameters:
+//
+//   fp : The snapshot file.
+//
+// Returns:
+//
+//   bool : true if the state was written.
+//
+bool SERIAL_SaveState(FILE *fp);
+
+// =============================================================================
+// Function: SERIAL_LoadState
+//
+// Description:
+// Read back the state written by SERIAL_SaveState().
+//
+// Parameters:
+//
+//   fp : The snapshot file.
+//
+// Returns:
+//
+//   bool : true if the state was read.
+//
+bool SERIAL_LoadState(FILE *fp);
+
 #endif // __WIN32_SERIAL_H
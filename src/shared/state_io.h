@@ -0,0 +1,54 @@
+// =============================================================================
+// File: state_io.h
+//
+// Description:
+// Helpers for the hardware state kept in machine snapshots.
+//
+// Each module lists its state once, in a function that writes it or reads
+// it back depending on a Save flag, so saving and loading cannot get out of
+// step.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __STATE_IO_H
+#define __STATE_IO_H
+
+#include <stdio.h>
+
+// =============================================================================
+// Function: STATE_Transfer
+//
+// Description:
+// Writes or reads one block of state.
+//
+// Parameters:
+//
+//   fp : The snapshot file.
+//
+//   Save : true to write the block, false to read it.
+//
+//   Data : The block.
+//
+//   Size : The size of the block in bytes.
+//
+// Returns:
+//
+//   bool : true if the whole block was written or read.
+//
+static inline bool STATE_Transfer(FILE *fp, bool Save, void *Data, size_t Size)
+{
+  if (Save)
+  {
+    return (fwrite(Data, Size, 1, fp) == 1);
+  }
+
+  return (fread(Data, Size, 1, fp) == 1);
+}
+
+// Writes or reads a variable or array, returning false from the calling
+// function if that fails.
+#define STATE_ITEM(fp, Save, Item) \
+  if (!STATE_Transfer(fp, Save, &(Item), sizeof(Item))) return false
+
+#endif // __STATE_IO_H
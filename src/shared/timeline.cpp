@@ -0,0 +1,333 @@
+// =============================================================================
+// File: timeline.cpp
+//
+// Description:
+// Timeline of the emulator subsystems, written as a Chrome trace event file.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include "timeline.h"
+
+#if TIMELINE
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+// Events are kept in blocks, so a buffer grows without moving what it holds
+#define BLOCK_EVENTS 16384
+#define BLOCK_COUNT (TIMELINE_MAX_EVENTS / BLOCK_EVENTS)
+
+struct TimelineEvent_t
+{
+  long long   Time;     // Host clock, see GetClock()
+  const char *Name;
+  const char *Arg[2];
+  int         Value[2];
+  char        Phase;
+};
+
+struct TimelineThread_t
+{
+  const char       *Name;   // NULL for "thread <n>"
+  TimelineEvent_t  *Blocks[BLOCK_COUNT];
+  int               Count;
+  long long         Dropped;
+  int               Open;    // Spans begun in the buffer and not ended yet
+  int               Skipped; // Spans begun, not ended, whose begin was dropped
+};
+
+// =============================================================================
+// Local Data
+//
+
+static std::atomic<bool> Recording(false);
+static char Filename[1024];
+static long long StartTime = 0;
+
+// Each thread takes the next buffer the first time it records
+static TimelineThread_t Threads[TIMELINE_MAX_THREADS];
+static std::atomic<int> ThreadCount(0);
+static std::atomic<long long> ThreadsDropped(0); // Events of threads with no buffer
+static thread_local TimelineThread_t *CurrentThread = NULL;
+static thread_local bool NoBuffer = false;
+
+// =============================================================================
+// Local Functions
+//
+
+// Host clock in ticks, converted to us when the file is written
+static inline long long GetClock(void)
+{
+#if defined(_WIN32)
+  LARGE_INTEGER Count;
+
+  QueryPerformanceCounter(&Count);
+  return Count.QuadPart;
+#else
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (long long) Now.tv_sec * 1000000000LL + Now.tv_nsec;
+#endif
+}
+
+static double TicksToUs(long long Ticks)
+{
+#if defined(_WIN32)
+  LARGE_INTEGER Frequency;
+
+  QueryPerformanceFrequency(&Frequency);
+  return (double) Ticks * 1000000.0 / (double) Frequency.QuadPart;
+#else
+  return (double) Ticks / 1000.0;
+#endif
+}
+
+static int GetPid(void)
+{
+#if defined(_WIN32)
+  return (int) GetCurrentProcessId();
+#else
+  return (int) getpid();
+#endif
+}
+
+static TimelineThread_t *TakeThread(void)
+{
+  int Id = ThreadCount.fetch_add(1);
+
+  if (Id >= TIMELINE_MAX_THREADS)
+  {
+    NoBuffer = true;
+    return NULL;
+  }
+
+  CurrentThread = &Threads[Id];
+  return CurrentThread;
+}
+
+// Writes a JSON string, names are constants from the code so only quotes
+// and backslashes need escaping
+static void WriteString(FILE *fp, const char *Text)
+{
+  fputc('"', fp);
+  for ( ; *Text != 0 ; Text++)
+  {
+    if ((*Text == '"') || (*Text == '\\'))
+    {
+      fputc('\\', fp);
+    }
+    fputc(*Text, fp);
+  }
+  fputc('"', fp);
+}
+
+// =============================================================================
+// Exported Functions
+//
+
+bool TIMELINE_Open(const char *FilenameIn, const char *ThreadName)
+{
+  FILE *fp;
+
+  if (Recording || (strlen(FilenameIn) >= sizeof(Filename)))
+  {
+    return false;
+  }
+
+  // Find out now if the file cannot be written, rather than at the end
+  fp = fopen(FilenameIn, "w");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  fclose(fp);
+
+  strcpy(Filename, FilenameIn);
+  StartTime = GetClock();
+
+  if ((CurrentThread != NULL) || (TakeThread() != NULL))
+  {
+    CurrentThread->Name = ThreadName;
+  }
+
+  Recording = true;
+
+  return true;
+}
+
+void TIMELINE_Record(char Phase, const char *Name, const char *Arg1, int Value1, const char *Arg2, int Value2)
+{
+  TimelineThread_t *Thread = CurrentThread;
+  TimelineEvent_t *Event;
+  int Block;
+
+  if (!Recording.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  if (Thread == NULL)
+  {
+    if (NoBuffer || ((Thread = TakeThread()) == NULL))
+    {
+      ThreadsDropped++;
+      return;
+    }
+  }
+
+  // Spans nest, so an end closes the span begun last. It is only kept if
+  // that begin was, and the buffer keeps room for the end of every span it
+  // has open. A span begun inside one whose begin was dropped is dropped as
+  // well, so the spans skipped are always the innermost ones.
+  if (Phase == 'E')
+  {
+    if (Thread->Skipped > 0)
+    {
+      Thread->Skipped--;
+      Thread->Dropped++;
+      return;
+    }
+
+    if (Thread->Open == 0)
+    {
+      Thread->Dropped++;
+      return;
+    }
+
+    Thread->Open--;
+  }
+  else if ((Thread->Skipped > 0) ||
+           (Thread->Count + Thread->Open + ((Phase == 'B') ? 2 : 1) > TIMELINE_MAX_EVENTS))
+  {
+    if (Phase == 'B') Thread->Skipped++;
+    Thread->Dropped++;
+    return;
+  }
+
+  Block = Thread->Count / BLOCK_EVENTS;
+  if (Thread->Blocks[Block] == NULL)
+  {
+    Thread->Blocks[Block] = (TimelineEvent_t *) malloc(BLOCK_EVENTS * sizeof(TimelineEvent_t));
+    if (Thread->Blocks[Block] == NULL)
+    {
+      if (Phase == 'B') Thread->Skipped++;
+      Thread->Dropped++;
+      return;
+    }
+  }
+
+  Event = &Thread->Blocks[Block][Thread->Count % BLOCK_EVENTS];
+  Event->Time = GetClock();
+  Event->Name = Name;
+  Event->Arg[0] = Arg1;
+  Event->Arg[1] = Arg2;
+  Event->Value[0] = Value1;
+  Event->Value[1] = Value2;
+  Event->Phase = Phase;
+
+  if (Phase == 'B') Thread->Open++;
+  Thread->Count++;
+}
+
+bool TIMELINE_Close(void)
+{
+  FILE *fp;
+  int Pid = GetPid();
+  int Count;
+  long long Dropped;
+
+  if (!Recording)
+  {
+    return false;
+  }
+  Recording = false;
+
+  fp = fopen(Filename, "w");
+  if (fp == NULL)
+  {
+    return false;
+  }
+
+  Count = ThreadCount;
+  if (Count > TIMELINE_MAX_THREADS)
+  {
+    Count = TIMELINE_MAX_THREADS;
+  }
+
+  Dropped = ThreadsDropped;
+  for (int t = 0 ; t < Count ; t++)
+  {
+    Dropped += Threads[t].Dropped;
+  }
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%lld},\"traceEvents\":[\n", Dropped);
+
+  for (int t = 0 ; t < Count ; t++)
+  {
+    TimelineThread_t *Thread = &Threads[t];
+
+    fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+            (t == 0) ? "" : ",\n", Pid, t + 1);
+    if (Thread->Name != NULL)
+    {
+      WriteString(fp, Thread->Name);
+    }
+    else
+    {
+      fprintf(fp, "\"thread %d\"", t + 1);
+    }
+    fprintf(fp, "}}");
+
+    for (int i = 0 ; i < Thread->Count ; i++)
+    {
+      TimelineEvent_t *Event = &Thread->Blocks[i / BLOCK_EVENTS][i % BLOCK_EVENTS];
+
+      fprintf(fp, ",\n{\"name\":");
+      WriteString(fp, Event->Name);
+      fprintf(fp, ",\"cat\":\"tinyxt\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+              Event->Phase, TicksToUs(Event->Time - StartTime), Pid, t + 1);
+
+      if (Event->Phase == 'i')
+      {
+        fprintf(fp, ",\"s\":\"t\",\"args\":{");
+        for (int a = 0 ; a < 2 ; a++)
+        {
+          if (Event->Arg[a] != NULL)
+          {
+            fprintf(fp, "%s", (a == 1) && (Event->Arg[0] != NULL) ? "," : "");
+            WriteString(fp, Event->Arg[a]);
+            fprintf(fp, ":%d", Event->Value[a]);
+          }
+        }
+        fprintf(fp, "}");
+      }
+      fprintf(fp, "}");
+    }
+
+    for (int b = 0 ; b < BLOCK_COUNT ; b++)
+    {
+      free(Thread->Blocks[b]);
+      Thread->Blocks[b] = NULL;
+    }
+    Thread->Count = 0;
+    Thread->Open = 0;
+    Thread->Skipped = 0;
+  }
+
+  fprintf(fp, "\n]}\n");
+
+  return fclose(fp) == 0;
+}
+
+#endif // TIMELINE
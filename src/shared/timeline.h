@@ -0,0 +1,116 @@
+// =============================================================================
+// File: timeline.h
+//
+// Description:
+// Timeline of the emulator subsystems, written as a Chrome trace event file
+// that chrome://tracing or Perfetto can show.
+//
+// Spans mark the phases of the emulation, such as a Run() slice of the CPU
+// or the rendering of a frame, with a begin and an end event. Spans on one
+// thread nest. Instant events mark a point in time, such as a guest disk
+// call, with up to two integer arguments.
+//
+// Each thread records into a buffer of its own, taken the first time it
+// records, so recording an event is a clock read and a few stores with no
+// locking. Nothing is written while the emulator runs: TIMELINE_Close()
+// writes every buffer to the file, so it has to be called once the other
+// threads have stopped recording. A buffer holds TIMELINE_MAX_EVENTS events
+// at most and keeps room for the ends of the spans it has open, so that
+// every span begun in the file ends in it. An end whose begin was not
+// recorded, because the buffer was full or the timeline was opened inside
+// the span, is dropped as well. The count of the events dropped goes in the
+// file.
+//
+// Event and argument names are kept as pointers, so they have to be string
+// constants.
+//
+// Only builds with TIMELINE record anything: the Timeline32 target and the
+// Timeline target of the headless runner. In other builds the TIMELINE_xx
+// macros expand to nothing.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#ifndef __TIMELINE_H
+#define __TIMELINE_H
+
+#ifndef TIMELINE
+  #define TIMELINE 0
+#endif
+
+// Most events kept for each thread, and threads that can record
+#define TIMELINE_MAX_EVENTS (1 << 20)
+#define TIMELINE_MAX_THREADS 16
+
+#if TIMELINE
+
+#define TIMELINE_BEGIN(Name) TIMELINE_Record('B', Name, NULL, 0, NULL, 0)
+#define TIMELINE_END(Name) TIMELINE_Record('E', Name, NULL, 0, NULL, 0)
+#define TIMELINE_INSTANT(Name, Arg1, Value1, Arg2, Value2) TIMELINE_Record('i', Name, Arg1, Value1, Arg2, Value2)
+
+#else
+
+#define TIMELINE_BEGIN(Name)
+#define TIMELINE_END(Name)
+#define TIMELINE_INSTANT(Name, Arg1, Value1, Arg2, Value2)
+
+#endif
+
+// =============================================================================
+// Function: TIMELINE_Open
+//
+// Description:
+// Starts recording the timeline. The calling thread is named in the file.
+//
+// Parameters:
+//
+//   Filename : The trace event file written by TIMELINE_Close().
+//
+//   ThreadName : The name of the calling thread.
+//
+// Returns:
+//
+//   bool : true if the timeline is recorded.
+//
+bool TIMELINE_Open(const char *Filename, const char *ThreadName);
+
+// =============================================================================
+// Function: TIMELINE_Record
+//
+// Description:
+// Records an event on the calling thread, if the timeline is recorded. Use
+// the TIMELINE_xx macros rather than calling it.
+//
+// Parameters:
+//
+//   Phase : 'B' to begin a span, 'E' to end it, 'i' for an instant event.
+//
+//   Name : The event name.
+//
+//   Arg1, Arg2 : The argument names, NULL for none.
+//
+//   Value1, Value2 : The argument values.
+//
+// Returns:
+//
+//   None.
+//
+void TIMELINE_Record(char Phase, const char *Name, const char *Arg1, int Value1, const char *Arg2, int Value2);
+
+// =============================================================================
+// Function: TIMELINE_Close
+//
+// Description:
+// Stops recording and writes the timeline.
+//
+// Parameters:
+//
+//   None.
+//
+// Returns:
+//
+//   bool : true if the file was written.
+//
+bool TIMELINE_Close(void);
+
+#endif // __TIMELINE_H
@@ -0,0 +1,676 @@
+// =============================================================================
+// File: machine_tests.cpp
+//
+// Description:
+// Tests of the machine API: CPU8086 driven through the headless interface.
+//
+// Run from the src directory, the tests boot bios/bios_cga and
+// disks/fd.img. Each test prints PASS or FAIL with its name, and the exit
+// status is the number of tests that failed. The text output of the
+// machines goes to stdout as well.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+
+#include "8086tiny_interface.h"
+#include "8086tiny_cpu.h"
+#include "input_log.h"
+
+// Instructions per Run() call, as the emulator main loop does
+#define RUN_SLICE 100000
+
+// Options of every test machine: the bundled floppy, kept unchanged, and a
+// fixed real time clock so that runs can be compared
+#define MACHINE_ARGS "-fd", "disks/fd.img", "-private", "-rtc", "1000000000"
+
+// =============================================================================
+// Local Functions
+//
+
+static int Failed = 0;
+
+static bool Check(bool Passed, const char *Test, const char *What)
+{
+  if (!Passed)
+  {
+    printf("FAIL %s: %s\n", Test, What);
+    Failed++;
+  }
+
+  return Passed;
+}
+
+// Reads a whole file, NULL if it cannot be read
+static unsigned char *ReadFile(const char *Filename, long &Size)
+{
+  FILE *fp = fopen(Filename, "rb");
+  unsigned char *Data = NULL;
+
+  Size = 0;
+  if (fp == NULL) return NULL;
+
+  if ((fseek(fp, 0, SEEK_END) == 0) && ((Size = ftell(fp)) > 0) && (fseek(fp, 0, SEEK_SET) == 0))
+  {
+    Data = (unsigned char *) malloc(Size);
+    if ((Data != NULL) && (fread(Data, Size, 1, fp) != 1))
+    {
+      free(Data);
+      Data = NULL;
+    }
+  }
+
+  fclose(fp);
+  return Data;
+}
+
+static bool SameFiles(const char *Filename1, const char *Filename2)
+{
+  long Size1;
+  long Size2;
+  unsigned char *Data1 = ReadFile(Filename1, Size1);
+  unsigned char *Data2 = ReadFile(Filename2, Size2);
+  bool Same = (Data1 != NULL) && (Data2 != NULL) && (Size1 == Size2) && (memcmp(Data1, Data2, Size1) == 0);
+
+  free(Data1);
+  free(Data2);
+
+  return Same;
+}
+
+// Checks if two snapshots hold the same guest RAM and CPU state. The
+// interface state after them is left out.
+static bool SameMachineState(const char *Filename1, const char *Filename2)
+{
+  long Size1;
+  long Size2;
+  unsigned char *Data1 = ReadFile(Filename1, Size1);
+  unsigned char *Data2 = ReadFile(Filename2, Size2);
+  stSnapshotHeader_t *Header = (stSnapshotHeader_t *) Data1;
+  bool Same = (Data1 != NULL) && (Data2 != NULL) && (Size1 == Size2) &&
+              (memcmp(Data1, Data2, sizeof(stSnapshotHeader_t)) == 0) &&
+              ((long) (Header->state_offset + sizeof(stSnapshotCPU_t)) <= Size1) &&
+              (memcmp(Data1 + Header->ram_offset, Data2 + Header->ram_offset, RAM_SIZE) == 0) &&
+              (memcmp(Data1 + Header->state_offset, Data2 + Header->state_offset, sizeof(stSnapshotCPU_t)) == 0);
+
+  free(Data1);
+  free(Data2);
+
+  return Same;
+}
+
+// Checks if the text screen in a snapshot, CGA page 0, holds a text
+static bool ScreenContains(const char *Filename, const char *Text)
+{
+  long Size;
+  unsigned char *Data = ReadFile(Filename, Size);
+  stSnapshotHeader_t *Header = (stSnapshotHeader_t *) Data;
+  char Screen[80 * 25 + 1];
+  bool Found = false;
+
+  if ((Data != NULL) && ((long) (Header->ram_offset + 0xB8000 + 2 * 80 * 25) <= Size))
+  {
+    for (int i = 0 ; i < 80 * 25 ; i++)
+    {
+      // Cells never written hold 0
+      Screen[i] = (char) Data[Header->ram_offset + 0xB8000 + 2 * i];
+      if (Screen[i] == 0) Screen[i] = ' ';
+    }
+    Screen[80 * 25] = 0;
+    Found = (strstr(Screen, Text) != NULL);
+  }
+
+  free(Data);
+
+  return Found;
+}
+
+// A machine with its own interface, set up from a headless command line.
+// It saves and loads snapshots and forks when the interface asks, as main()
+// does.
+struct Machine_t
+{
+  T8086TinyInterface_t *Interface;
+  CPU8086 *Cpu;
+  unsigned long long Executed;
+  int Child;
+
+  Machine_t(int argc, const char **argv)
+  {
+    Interface = new T8086TinyInterface_t;
+    Interface->SetArgs(argc, (char **) argv);
+    Cpu = new CPU8086(*Interface);
+    Executed = 0;
+    Child = 0;
+    SnapshotRequest();
+  }
+
+  ~Machine_t()
+  {
+    Interface->ExitStatus(Executed);
+    SnapshotRequest();
+    delete Cpu;
+    delete Interface;
+  }
+
+  void SnapshotRequest(void)
+  {
+    const char *Filename;
+    bool Save;
+
+    if (Interface->SnapshotRequest(Filename, Save))
+    {
+      if (Save) Cpu->SaveSnapshot(Filename);
+      else Cpu->LoadSnapshot(Filename);
+    }
+  }
+
+  // Exit status of the headless runner, see headless_8086tiny_interface.cpp
+  int ExitStatus(void)
+  {
+    return Interface->ExitStatus(Executed);
+  }
+
+  // Runs until the machine exits, or for at most Instructions more
+  void Run(unsigned long long Instructions = 0)
+  {
+    unsigned long long Limit = Executed + Instructions;
+
+    while (!Cpu->Exited() && ((Instructions == 0) || (Executed < Limit)))
+    {
+      int Children;
+
+      Executed += Cpu->Run(RUN_SLICE);
+      SnapshotRequest();
+
+      if (Interface->ForkRequest(Children))
+      {
+        Child = Cpu->Fork(Children);
+        Interface->ForkStarted(Child);
+      }
+    }
+  }
+};
+
+// Writes a file, false if it cannot be written
+static bool WriteFile(const char *Filename, const void *Data, size_t Size)
+{
+  FILE *fp = fopen(Filename, "wb");
+  bool Written;
+
+  if (fp == NULL) return false;
+
+  Written = (fwrite(Data, Size, 1, fp) == 1);
+
+  return (fclose(fp) == 0) && Written;
+}
+
+// Checks if a file holds a text
+static bool FileContains(const char *Filename, const char *Text)
+{
+  long Size;
+  long Length = (long) strlen(Text);
+  unsigned char *Data = ReadFile(Filename, Size);
+  bool Found = false;
+
+  for (long i = 0 ; (Data != NULL) && !Found && (i + Length <= Size) ; i++)
+  {
+    Found = (memcmp(Data + i, Text, Length) == 0);
+  }
+
+  free(Data);
+
+  return Found;
+}
+
+// Runs a machine to its time limit and saves it as a snapshot
+static void RunToSnapshot(int argc, const char **argv, const char *Snapshot, bool *Saved)
+{
+  Machine_t Machine(argc, argv);
+
+  Machine.Run();
+  *Saved = Machine.Cpu->SaveSnapshot(Snapshot);
+}
+
+// =============================================================================
+// Tests
+//
+
+// Two machines in one process, run one after the other and then at the same
+// time on two threads, must end in the same state as when run alone.
+static void TestTwoMachines(void)
+{
+  const char *Test = "two machines";
+  const char *ArgsA[] = { "tests", MACHINE_ARGS, "-type", "ver\\n", "-typeat", "10000", "-time", "40000" };
+  const char *ArgsB[] = { "tests", MACHINE_ARGS, "-type", "dir\\n", "-typeat", "10000", "-time", "40000" };
+  int ArgcA = (int) (sizeof(ArgsA) / sizeof(ArgsA[0]));
+  int ArgcB = (int) (sizeof(ArgsB) / sizeof(ArgsB[0]));
+  bool Saved[4];
+
+  RunToSnapshot(ArgcA, ArgsA, "tests_a1.snp", &Saved[0]);
+  RunToSnapshot(ArgcB, ArgsB, "tests_b1.snp", &Saved[1]);
+
+  std::thread ThreadA(RunToSnapshot, ArgcA, ArgsA, "tests_a2.snp", &Saved[2]);
+  std::thread ThreadB(RunToSnapshot, ArgcB, ArgsB, "tests_b2.snp", &Saved[3]);
+  ThreadA.join();
+  ThreadB.join();
+
+  if (Check(Saved[0] && Saved[1] && Saved[2] && Saved[3], Test, "could not save the snapshots") &&
+      Check(!SameFiles("tests_a1.snp", "tests_b1.snp"), Test, "the machines did not run their own input") &&
+      Check(SameFiles("tests_a1.snp", "tests_a2.snp"), Test, "machine A differs when run on a thread next to B") &&
+      Check(SameFiles("tests_b1.snp", "tests_b2.snp"), Test, "machine B differs when run on a thread next to A"))
+  {
+    printf("PASS %s\n", Test);
+  }
+
+  remove("tests_a1.snp");
+  remove("tests_b1.snp");
+  remove("tests_a2.snp");
+  remove("tests_b2.snp");
+}
+
+// A word operand in the last byte of a RAM page has its high byte in the
+// next page, which must be handled by its own type: with the BIOS page
+// mapped as ROM, a word written at EFFFFh must leave F0000h unchanged.
+static void TestWordAcrossPages(void)
+{
+  const char *Test = "word across pages";
+  const char *Args[] = { "tests", "-bios", "tests_rom.bin", "-rtc", "1000000000", "-limit", "1000" };
+  static const unsigned char Code[] =
+  {
+    0xB8, 0x00, 0xE0,                   // mov ax, 0E000h
+    0x8E, 0xD8,                         // mov ds, ax
+    0xC7, 0x06, 0xFF, 0xFF, 0x34, 0x12, // mov word [0FFFFh], 1234h
+    0x8B, 0x06, 0xFF, 0xFF,             // mov ax, [0FFFFh]
+    0x00, 0xE0,                         // add al, ah
+    0xE6, 0xF4,                         // out 0F4h, al
+    0xF4                                // hlt
+  };
+  int Status = -1;
+
+  if (Check(WriteFile("tests_rom.bin", Code, sizeof(Code)), Test, "could not write the BIOS image"))
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Cpu->MapMemory(0xF0000, 0x10000, MEM_PAGE_ROM);
+    Machine.Run();
+    Status = Machine.ExitStatus();
+
+    // 34h, or 46h if the high byte was written to the ROM
+    if (Check(Status == 0x34, Test, "the high byte of the word went to the wrong page"))
+    {
+      printf("PASS %s\n", Test);
+    }
+  }
+
+  remove("tests_rom.bin");
+}
+
+// A BIOS image that writes known ranges of RAM must leave exactly their
+// pages dirty, and no page once they are cleared.
+static void TestDirtyPages(void)
+{
+  const char *Test = "dirty pages";
+  const char *Args[] = { "tests", "-bios", "tests_rom.bin", "-rtc", "1000000000", "-limit", "1000" };
+  static const unsigned char Code[] =
+  {
+    0xFA,                               // cli
+    0xFC,                               // cld
+    0x31, 0xC0,                         // xor ax, ax
+    0x8E, 0xC0,                         // mov es, ax
+    0x8E, 0xD8,                         // mov ds, ax
+    0xBF, 0x00, 0x38,                   // mov di, 3800h
+    0xB9, 0x00, 0x10,                   // mov cx, 1000h
+    0xF3, 0xAB,                         // rep stosw
+    0xC6, 0x06, 0x34, 0x92, 0x55,       // mov byte [9234h], 55h
+    0xC7, 0x06, 0xFF, 0xAF, 0x34, 0x12, // mov word [0AFFFh], 1234h
+    0xE6, 0xF4,                         // out 0F4h, al
+    0xF4                                // hlt
+  };
+  // 3800h to 57FFh, 9234h, and AFFFh to B000h
+  static const uint32_t Pages[] = { 0x3, 0x4, 0x5, 0x9, 0xA, 0xB };
+  uint8_t Expected[MEM_DIRTY_BITMAP_SIZE];
+  uint8_t Bitmap[MEM_DIRTY_BITMAP_SIZE];
+  uint32_t Count;
+  uint32_t Cleared;
+
+  memset(Expected, 0, sizeof(Expected));
+  for (unsigned int i = 0 ; i < sizeof(Pages) / sizeof(Pages[0]) ; i++)
+  {
+    Expected[Pages[i] >> 3] |= 1 << (Pages[i] & 7);
+  }
+
+  if (Check(WriteFile("tests_rom.bin", Code, sizeof(Code)), Test, "could not write the BIOS image"))
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Cpu->MapMemory(0xF0000, 0x10000, MEM_PAGE_ROM);
+    Machine.Cpu->GetDirtyPages(NULL, true);
+    Machine.Run();
+
+    Count = Machine.Cpu->GetDirtyPages(Bitmap, false);
+    if (Check(Machine.ExitStatus() == 0, Test, "the BIOS image did not run") &&
+        Check(Count == sizeof(Pages) / sizeof(Pages[0]), Test, "wrong number of dirty pages") &&
+        Check(memcmp(Bitmap, Expected, sizeof(Bitmap)) == 0, Test, "wrong dirty pages") &&
+        Check(Machine.Cpu->GetDirtyPages(NULL, true) == Count, Test, "reading the pages changed them"))
+    {
+      Cleared = Machine.Cpu->GetDirtyPages(Bitmap, false);
+      memset(Expected, 0, sizeof(Expected));
+      if (Check(Cleared == 0, Test, "pages left dirty once cleared") &&
+          Check(memcmp(Bitmap, Expected, sizeof(Bitmap)) == 0, Test, "bits left set once cleared"))
+      {
+        printf("PASS %s\n", Test);
+      }
+    }
+  }
+
+  remove("tests_rom.bin");
+}
+
+// A BIOS image halted with interrupts enabled, taking only the timer
+// interrupts, must not use up its -limit while halted: it ends at its -time
+// with few instructions run.
+static void TestLimitHalted(void)
+{
+  const char *Test = "limit while halted";
+  const char *Args[] = { "tests", "-bios", "tests_rom.bin", "-rtc", "1000000000", "-limit", "2000", "-time", "10000" };
+  static const unsigned char Code[] =
+  {
+    0x31, 0xC0,                         // xor ax, ax
+    0x8E, 0xD8,                         // mov ds, ax
+    0xC7, 0x06, 0x20, 0x00, 0x14, 0x01, // mov word [0020h], timer
+    0xC7, 0x06, 0x22, 0x00, 0x00, 0xF0, // mov word [0022h], 0F000h
+    0xFB,                               // sti
+    0xF4,                               // wait: hlt
+    0xEB, 0xFD,                         // jmp wait
+    0xB0, 0x20,                         // timer: mov al, 20h
+    0xE6, 0x20,                         // out 20h, al
+    0xCF                                // iret
+  };
+  int Status = -1;
+  unsigned long long Executed = 0;
+
+  if (Check(WriteFile("tests_rom.bin", Code, sizeof(Code)), Test, "could not write the BIOS image"))
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Cpu->MapMemory(0xF0000, 0x10000, MEM_PAGE_ROM);
+    Machine.Run();
+    Status = Machine.ExitStatus();
+    Executed = Machine.Executed;
+
+    // 18.2 timer interrupts a second, each running its three instructions
+    // and the jmp
+    if (Check(Status == 2, Test, "the machine did not end at a limit") &&
+        Check(Executed < 2000, Test, "the halted CPU used up the instruction limit") &&
+        Check(Executed >= 4 * 150, Test, "the timer interrupts did not run"))
+    {
+      printf("PASS %s\n", Test);
+    }
+  }
+
+  remove("tests_rom.bin");
+}
+
+// A BIOS image jumping to 0000:0000, as QUITEMU.COM does, must end the
+// emulation there with status 0.
+static void TestQuit(void)
+{
+  const char *Test = "quit";
+  const char *Args[] = { "tests", "-bios", "tests_rom.bin", "-rtc", "1000000000", "-limit", "1000" };
+  static const unsigned char Code[] =
+  {
+    0xEA, 0x00, 0x00, 0x00, 0x00        // jmp 0000h:0000h
+  };
+  int Status = -1;
+
+  if (Check(WriteFile("tests_rom.bin", Code, sizeof(Code)), Test, "could not write the BIOS image"))
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Cpu->MapMemory(0xF0000, 0x10000, MEM_PAGE_ROM);
+    Machine.Run();
+    Status = Machine.ExitStatus();
+
+    if (Check(Status == 0, Test, "the jump to 0000:0000 did not end the emulation") &&
+        Check(Machine.Executed == 1, Test, "instructions ran after the jump"))
+    {
+      printf("PASS %s\n", Test);
+    }
+  }
+
+  remove("tests_rom.bin");
+}
+
+// Writes the first Size bytes of a file to another
+static bool CopyFile(const char *From, const char *To, long Size)
+{
+  long FromSize;
+  unsigned char *Data = ReadFile(From, FromSize);
+  bool Copied = (Data != NULL) && (Size <= FromSize) && WriteFile(To, Data, Size);
+
+  free(Data);
+
+  return Copied;
+}
+
+// A snapshot cut short in the RAM image or in the CPU state, or whose RAM
+// image is past the end of the file, must not load and must leave the
+// machine as it was. A whole one must load, and -load
+// and -save must go on from it as the machine that saved it did.
+static void TestSnapshotFiles(void)
+{
+  const char *Test = "snapshot files";
+  const char *Args[] = { "tests", MACHINE_ARGS };
+  const char *LoadArgs[] = { "tests", MACHINE_ARGS, "-load", "tests_boot.snp", "-save", "tests_load.snp" };
+  stSnapshotHeader_t *Header;
+  unsigned char *Data;
+  long Size;
+  bool Passed = true;
+
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Run(1000000);
+    Passed = Check(Machine.Cpu->SaveSnapshot("tests_boot.snp"), Test, "could not save the snapshot");
+    Machine.Run(1000000);
+    Passed = Passed && Check(Machine.Cpu->SaveSnapshot("tests_run.snp"), Test, "could not save the snapshot");
+  }
+
+  Data = ReadFile("tests_boot.snp", Size);
+  Header = (stSnapshotHeader_t *) Data;
+  Passed = Passed && Check(Data != NULL, Test, "could not read the snapshot") &&
+           CopyFile("tests_boot.snp", "tests_ram.snp", Header->ram_offset + RAM_SIZE / 2) &&
+           CopyFile("tests_boot.snp", "tests_cpu.snp", Header->state_offset + sizeof(stSnapshotCPU_t) - 1);
+  if (Passed)
+  {
+    Header->ram_offset = (Size + MEM_PAGE_SIZE - 1) & ~(MEM_PAGE_SIZE - 1);
+    Passed = WriteFile("tests_end.snp", Data, Size);
+  }
+  free(Data);
+
+  if (Passed)
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Run(1000000);
+    Passed = Check(!Machine.Cpu->LoadSnapshot("tests_ram.snp"), Test, "loaded a short RAM image") &&
+             Check(!Machine.Cpu->LoadSnapshot("tests_cpu.snp"), Test, "loaded a short CPU state") &&
+             Check(!Machine.Cpu->LoadSnapshot("tests_end.snp"), Test, "loaded a RAM image past the end of the file") &&
+             Check(Machine.Cpu->SaveSnapshot("tests_same.snp"), Test, "could not save the snapshot") &&
+             Check(SameFiles("tests_boot.snp", "tests_same.snp"), Test, "a snapshot that did not load changed the machine");
+  }
+
+  if (Passed)
+  {
+    Machine_t Machine((int) (sizeof(LoadArgs) / sizeof(LoadArgs[0])), LoadArgs);
+
+    Machine.Run(1000000);
+  }
+
+  if (Passed && Check(SameFiles("tests_run.snp", "tests_load.snp"), Test, "the loaded machine did not go on as the saved one"))
+  {
+    printf("PASS %s\n", Test);
+  }
+
+  remove("tests_boot.snp");
+  remove("tests_run.snp");
+  remove("tests_ram.snp");
+  remove("tests_cpu.snp");
+  remove("tests_end.snp");
+  remove("tests_same.snp");
+  remove("tests_load.snp");
+}
+
+// A machine forked at the DOS prompt into two children typing different
+// commands: each child must run its own, and the machine must end with the
+// status of its children.
+static void TestFork(void)
+{
+  const char *Test = "fork";
+  const char *Args[] =
+  {
+    "tests", MACHINE_ARGS, "-time", "60000", "-forkat", "31000",
+    "-child", "-type", "ver\\n", "-time", "40000", "-out", "tests_child1.txt",
+    "-child", "-type", "dir\\n", "-time", "40000", "-out", "tests_child2.txt"
+  };
+  int Status;
+  int Child;
+
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Run();
+    Status = Machine.ExitStatus();
+    Child = Machine.Child;
+  }
+
+  // A child ends here, its output is in its -out file
+  if (Child > 0)
+  {
+    _exit(Status);
+  }
+
+  if (Check(Child == 0, Test, "could not fork") &&
+      Check(Status == 2, Test, "the children did not end at their time limit") &&
+      Check(FileContains("tests_child1.txt", "A:\\>ver"), Test, "child 1 did not run ver") &&
+      Check(!FileContains("tests_child1.txt", "A:\\>dir"), Test, "child 1 ran dir") &&
+      Check(FileContains("tests_child2.txt", "A:\\>dir"), Test, "child 2 did not run dir") &&
+      Check(!FileContains("tests_child2.txt", "A:\\>ver"), Test, "child 2 ran ver"))
+  {
+    printf("PASS %s\n", Test);
+  }
+
+  remove("tests_child1.txt");
+  remove("tests_child2.txt");
+}
+
+// A machine recording its -type keys and one replaying the log must end
+// with the same guest state, which a machine with no keys does not. A log with a mouse
+// event must stop the replay with an error once the event is due.
+static void TestRecordReplay(void)
+{
+  const char *Test = "record and replay";
+  const char *RecordArgs[] =
+  {
+    "tests", MACHINE_ARGS, "-type", "dir\\n", "-typeat", "10000", "-time", "40000",
+    "-record", "tests_input.log", "-save", "tests_record.snp"
+  };
+  const char *ReplayArgs[] = { "tests", MACHINE_ARGS, "-replay", "tests_input.log", "-time", "40000", "-save", "tests_replay.snp" };
+  const char *NoKeysArgs[] = { "tests", MACHINE_ARGS, "-time", "40000", "-save", "tests_nokeys.snp" };
+  const char *MouseArgs[] = { "tests", MACHINE_ARGS, "-replay", "tests_mouse.log", "-time", "40000" };
+  static const unsigned char Mouse[5] = { 1, 0, 1, 0, 0 };
+  int Status[4];
+
+  {
+    Machine_t Machine((int) (sizeof(RecordArgs) / sizeof(RecordArgs[0])), RecordArgs);
+
+    Machine.Run();
+    Status[0] = Machine.ExitStatus();
+  }
+
+  {
+    Machine_t Machine((int) (sizeof(ReplayArgs) / sizeof(ReplayArgs[0])), ReplayArgs);
+
+    Machine.Run();
+    Status[1] = Machine.ExitStatus();
+  }
+
+  {
+    Machine_t Machine((int) (sizeof(NoKeysArgs) / sizeof(NoKeysArgs[0])), NoKeysArgs);
+
+    Machine.Run();
+    Status[2] = Machine.ExitStatus();
+  }
+
+  // A mouse movement 1 s after power on
+  Status[3] = -1;
+  if (INPUT_StartRecord("tests_mouse.log", 4770000, 1000000000000LL))
+  {
+    INPUT_SetTime(4770000);
+    INPUT_Record(INPUT_MOUSE, Mouse, sizeof(Mouse));
+    INPUT_Stop();
+
+    Machine_t Machine((int) (sizeof(MouseArgs) / sizeof(MouseArgs[0])), MouseArgs);
+
+    Machine.Run();
+    Status[3] = Machine.ExitStatus();
+  }
+
+  if (Check((Status[0] == 2) && (Status[1] == 2) && (Status[2] == 2), Test, "a machine did not end at its time limit") &&
+      Check(SameMachineState("tests_record.snp", "tests_replay.snp"), Test, "the replay ended in another state") &&
+      Check(!SameMachineState("tests_record.snp", "tests_nokeys.snp"), Test, "the keys did not change the state") &&
+      Check(Status[3] == 3, Test, "the mouse event did not stop the replay"))
+  {
+    printf("PASS %s\n", Test);
+  }
+
+  remove("tests_input.log");
+  remove("tests_mouse.log");
+  remove("tests_record.snp");
+  remove("tests_replay.snp");
+  remove("tests_nokeys.snp");
+}
+
+// Keys typed from power on must wait for the shell rather than be taken by
+// the FreeDOS kernel looking for F5/F8 as it boots.
+static void TestTypeAtPowerOn(void)
+{
+  const char *Test = "type at power on";
+  const char *Args[] = { "tests", MACHINE_ARGS, "-type", "ver\\n", "-time", "40000", "-save", "tests_type.snp" };
+
+  {
+    Machine_t Machine((int) (sizeof(Args) / sizeof(Args[0])), Args);
+
+    Machine.Run();
+  }
+
+  if (Check(ScreenContains("tests_type.snp", "A:\\>ver"), Test, "the keys typed at power on were not all taken by the shell"))
+  {
+    printf("PASS %s\n", Test);
+  }
+
+  remove("tests_type.snp");
+}
+
+int main(void)
+{
+  TestTwoMachines();
+  TestWordAcrossPages();
+  TestDirtyPages();
+  TestLimitHalted();
+  TestQuit();
+  TestSnapshotFiles();
+  TestFork();
+  TestRecordReplay();
+  TestTypeAtPowerOn();
+
+  printf("%d test%s failed\n", Failed, (Failed == 1) ? "" : "s");
+
+  return Failed;
+}
@@ -0,0 +1,721 @@
+// =============================================================================
+// File: trace_dump.cpp
+//
+// Description:
+// Prints an instruction trace file written by tinyXT, see XTtrace.h: one
+// line per instruction with where it ran, its bytes, its disassembly, the
+// registers it changed, FLAGS when they changed and the memory it wrote.
+//
+// Command line:
+//
+//   trace_dump [-last <n>] <trace file>
+//
+//   -last <n> : Only print the last n instructions.
+//
+// This work is licensed under the MIT License. See included LICENSE.TXT.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "emulator/XTtrace.h"
+
+// Operand forms, named as in the opcode table of XTdecode.h
+enum OperandForm_t
+{
+  OP_NONE,
+  OP_EB_GB,   // r/m8, reg8
+  OP_EV_GV,   // r/m16, reg16
+  OP_GB_EB,   // reg8, r/m8
+  OP_GV_EV,   // reg16, r/m16
+  OP_AL_IB,   // al, imm8
+  OP_AX_IV,   // ax, imm16
+  OP_SEG,     // Segment register in bits 3-4 of the opcode
+  OP_REG16,   // 16 bit register in bits 0-2 of the opcode
+  OP_AX_REG,  // ax, 16 bit register in bits 0-2 of the opcode
+  OP_REG8_IB, // 8 bit register in bits 0-2 of the opcode, imm8
+  OP_REG_IV,  // 16 bit register in bits 0-2 of the opcode, imm16
+  OP_JB,      // rel8
+  OP_JV,      // rel16
+  OP_AP,      // seg:off
+  OP_EW_SW,   // r/m16, sreg
+  OP_SW_EW,   // sreg, r/m16
+  OP_GV_M,    // reg16, m
+  OP_GV_MP,   // reg16, m16:16
+  OP_EV,      // r/m16
+  OP_AL_OB,   // al, [off]
+  OP_AX_OV,   // ax, [off]
+  OP_OB_AL,   // [off], al
+  OP_OV_AX,   // [off], ax
+  OP_IB,      // imm8
+  OP_IBS,     // imm8 sign extended
+  OP_IV,      // imm16
+  OP_IW_IB,   // imm16, imm8
+  OP_GV_EV_IV,
+  OP_GV_EV_IB,
+  OP_AL_PORT, // al, imm8 port
+  OP_AX_PORT,
+  OP_PORT_AL,
+  OP_PORT_AX,
+  OP_AL_DX,
+  OP_AX_DX,
+  OP_DX_AL,
+  OP_DX_AX,
+  OP_EMU,     // Emulator specific, one byte of function
+  OP_ESC,     // 8087, ModRM
+  OP_G1_EB_IB,
+  OP_G1_EV_IV,
+  OP_G1_EV_IB,
+  OP_G2_EB_IB,
+  OP_G2_EV_IB,
+  OP_G2_EB_1,
+  OP_G2_EV_1,
+  OP_G2_EB_CL,
+  OP_G2_EV_CL,
+  OP_G3_EB,
+  OP_G3_EV,
+  OP_G4_EB,
+  OP_G5_EV,
+  OP_EB_IB,
+  OP_EV_IV
+};
+
+struct OpcodeInfo_t
+{
+  const char *Name;
+  OperandForm_t Form;
+};
+
+static const OpcodeInfo_t Opcodes[256] =
+{
+  { "add", OP_EB_GB }, { "add", OP_EV_GV }, { "add", OP_GB_EB }, { "add", OP_GV_EV },
+  { "add", OP_AL_IB }, { "add", OP_AX_IV }, { "push", OP_SEG }, { "pop", OP_SEG },
+  { "or", OP_EB_GB }, { "or", OP_EV_GV }, { "or", OP_GB_EB }, { "or", OP_GV_EV },
+  { "or", OP_AL_IB }, { "or", OP_AX_IV }, { "push", OP_SEG }, { "emu", OP_EMU },
+  { "adc", OP_EB_GB }, { "adc", OP_EV_GV }, { "adc", OP_GB_EB }, { "adc", OP_GV_EV },
+  { "adc", OP_AL_IB }, { "adc", OP_AX_IV }, { "push", OP_SEG }, { "pop", OP_SEG },
+  { "sbb", OP_EB_GB }, { "sbb", OP_EV_GV }, { "sbb", OP_GB_EB }, { "sbb", OP_GV_EV },
+  { "sbb", OP_AL_IB }, { "sbb", OP_AX_IV }, { "push", OP_SEG }, { "pop", OP_SEG },
+  { "and", OP_EB_GB }, { "and", OP_EV_GV }, { "and", OP_GB_EB }, { "and", OP_GV_EV },
+  { "and", OP_AL_IB }, { "and", OP_AX_IV }, { "es:", OP_NONE }, { "daa", OP_NONE },
+  { "sub", OP_EB_GB }, { "sub", OP_EV_GV }, { "sub", OP_GB_EB }, { "sub", OP_GV_EV },
+  { "sub", OP_AL_IB }, { "sub", OP_AX_IV }, { "cs:", OP_NONE }, { "das", OP_NONE },
+  { "xor", OP_EB_GB }, { "xor", OP_EV_GV }, { "xor", OP_GB_EB }, { "xor", OP_GV_EV },
+  { "xor", OP_AL_IB }, { "xor", OP_AX_IV }, { "ss:", OP_NONE }, { "aaa", OP_NONE },
+  { "cmp", OP_EB_GB }, { "cmp", OP_EV_GV }, { "cmp", OP_GB_EB }, { "cmp", OP_GV_EV },
+  { "cmp", OP_AL_IB }, { "cmp", OP_AX_IV }, { "ds:", OP_NONE }, { "aas", OP_NONE },
+  { "inc", OP_REG16 }, { "inc", OP_REG16 }, { "inc", OP_REG16 }, { "inc", OP_REG16 },
+  { "inc", OP_REG16 }, { "inc", OP_REG16 }, { "inc", OP_REG16 }, { "inc", OP_REG16 },
+  { "dec", OP_REG16 }, { "dec", OP_REG16 }, { "dec", OP_REG16 }, { "dec", OP_REG16 },
+  { "dec", OP_REG16 }, { "dec", OP_REG16 }, { "dec", OP_REG16 }, { "dec", OP_REG16 },
+  { "push", OP_REG16 }, { "push", OP_REG16 }, { "push", OP_REG16 }, { "push", OP_REG16 },
+  { "push", OP_REG16 }, { "push", OP_REG16 }, { "push", OP_REG16 }, { "push", OP_REG16 },
+  { "pop", OP_REG16 }, { "pop", OP_REG16 }, { "pop", OP_REG16 }, { "pop", OP_REG16 },
+  { "pop", OP_REG16 }, { "pop", OP_REG16 }, { "pop", OP_REG16 }, { "pop", OP_REG16 },
+  { "pusha", OP_NONE }, { "popa", OP_NONE }, { "bound", OP_GV_M }, { "db 0x63", OP_NONE },
+  { "db 0x64", OP_NONE }, { "db 0x65", OP_NONE }, { "db 0x66", OP_NONE }, { "db 0x67", OP_NONE },
+  { "push", OP_IV }, { "imul", OP_GV_EV_IV }, { "push", OP_IBS }, { "imul", OP_GV_EV_IB },
+  { "insb", OP_NONE }, { "insw", OP_NONE }, { "outsb", OP_NONE }, { "outsw", OP_NONE },
+  { "jo", OP_JB }, { "jno", OP_JB }, { "jb", OP_JB }, { "jnb", OP_JB },
+  { "jz", OP_JB }, { "jnz", OP_JB }, { "jbe", OP_JB }, { "ja", OP_JB },
+  { "js", OP_JB }, { "jns", OP_JB }, { "jp", OP_JB }, { "jnp", OP_JB },
+  { "jl", OP_JB }, { "jge", OP_JB }, { "jle", OP_JB }, { "jg", OP_JB },
+  { NULL, OP_G1_EB_IB }, { NULL, OP_G1_EV_IV }, { NULL, OP_G1_EB_IB }, { NULL, OP_G1_EV_IB },
+  { "test", OP_EB_GB }, { "test", OP_EV_GV }, { "xchg", OP_EB_GB }, { "xchg", OP_EV_GV },
+  { "mov", OP_EB_GB }, { "mov", OP_EV_GV }, { "mov", OP_GB_EB }, { "mov", OP_GV_EV },
+  { "mov", OP_EW_SW }, { "lea", OP_GV_M }, { "mov", OP_SW_EW }, { "pop", OP_EV },
+  { "nop", OP_NONE }, { "xchg", OP_AX_REG }, { "xchg", OP_AX_REG }, { "xchg", OP_AX_REG },
+  { "xchg", OP_AX_REG }, { "xchg", OP_AX_REG }, { "xchg", OP_AX_REG }, { "xchg", OP_AX_REG },
+  { "cbw", OP_NONE }, { "cwd", OP_NONE }, { "call", OP_AP }, { "wait", OP_NONE },
+  { "pushf", OP_NONE }, { "popf", OP_NONE }, { "sahf", OP_NONE }, { "lahf", OP_NONE },
+  { "mov", OP_AL_OB }, { "mov", OP_AX_OV }, { "mov", OP_OB_AL }, { "mov", OP_OV_AX },
+  { "movsb", OP_NONE }, { "movsw", OP_NONE }, { "cmpsb", OP_NONE }, { "cmpsw", OP_NONE },
+  { "test", OP_AL_IB }, { "test", OP_AX_IV }, { "stosb", OP_NONE }, { "stosw", OP_NONE },
+  { "lodsb", OP_NONE }, { "lodsw", OP_NONE }, { "scasb", OP_NONE }, { "scasw", OP_NONE },
+  { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB },
+  { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB }, { "mov", OP_REG8_IB },
+  { "mov", OP_REG_IV }, { "mov", OP_REG_IV }, { "mov", OP_REG_IV }, { "mov", OP_REG_IV },
+  { "mov", OP_REG_IV }, { "mov", OP_REG_IV }, { "mov", OP_REG_IV }, { "mov", OP_REG_IV },
+  { NULL, OP_G2_EB_IB }, { NULL, OP_G2_EV_IB }, { "ret", OP_IV }, { "ret", OP_NONE },
+  { "les", OP_GV_MP }, { "lds", OP_GV_MP }, { "mov", OP_EB_IB }, { "mov", OP_EV_IV },
+  { "enter", OP_IW_IB }, { "leave", OP_NONE }, { "retf", OP_IV }, { "retf", OP_NONE },
+  { "int3", OP_NONE }, { "int", OP_IB }, { "into", OP_NONE }, { "iret", OP_NONE },
+  { NULL, OP_G2_EB_1 }, { NULL, OP_G2_EV_1 }, { NULL, OP_G2_EB_CL }, { NULL, OP_G2_EV_CL },
+  { "aam", OP_IB }, { "aad", OP_IB }, { "salc", OP_NONE }, { "xlat", OP_NONE },
+  { "esc", OP_ESC }, { "esc", OP_ESC }, { "esc", OP_ESC }, { "esc", OP_ESC },
+  { "esc", OP_ESC }, { "esc", OP_ESC }, { "esc", OP_ESC }, { "esc", OP_ESC },
+  { "loopnz", OP_JB }, { "loopz", OP_JB }, { "loop", OP_JB }, { "jcxz", OP_JB },
+  { "in", OP_AL_PORT }, { "in", OP_AX_PORT }, { "out", OP_PORT_AL }, { "out", OP_PORT_AX },
+  { "call", OP_JV }, { "jmp", OP_JV }, { "jmp", OP_AP }, { "jmp", OP_JB },
+  { "in", OP_AL_DX }, { "in", OP_AX_DX }, { "out", OP_DX_AL }, { "out", OP_DX_AX },
+  { "lock", OP_NONE }, { "db 0xF1", OP_NONE }, { "repnz", OP_NONE }, { "repz", OP_NONE },
+  { "hlt", OP_NONE }, { "cmc", OP_NONE }, { NULL, OP_G3_EB }, { NULL, OP_G3_EV },
+  { "clc", OP_NONE }, { "stc", OP_NONE }, { "cli", OP_NONE }, { "sti", OP_NONE },
+  { "cld", OP_NONE }, { "std", OP_NONE }, { NULL, OP_G4_EB }, { NULL, OP_G5_EV }
+};
+
+static const char *Group1[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+static const char *Group2[8] = { "rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar" };
+static const char *Group3[8] = { "test", "test", "not", "neg", "mul", "imul", "div", "idiv" };
+static const char *Group4[8] = { "inc", "dec", "db", "db", "db", "db", "db", "db" };
+static const char *Group5[8] = { "inc", "dec", "call", "call far", "jmp", "jmp far", "push", "db" };
+
+static const char *Reg8[8] = { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" };
+static const char *Reg16[8] = { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di" };
+static const char *SegReg[4] = { "es", "cs", "ss", "ds" };
+static const char *EABase[8] = { "bx+si", "bx+di", "bp+si", "bp+di", "si", "di", "bp", "bx" };
+
+// Register names in the order of stTraceRecord_t reg_mask
+static const char *TraceReg[TRACE_REG_COUNT] =
+{
+  "AX", "CX", "DX", "BX", "SP", "BP", "SI", "DI", "ES", "CS", "SS", "DS"
+};
+
+// =============================================================================
+// Disassembler
+//
+
+// Instruction bytes being disassembled
+struct Decode_t
+{
+  const uint8_t *Bytes;
+  int Len;
+};
+
+static int Byte(Decode_t &d)
+{
+  return d.Bytes[d.Len++];
+}
+
+static int Word(Decode_t &d)
+{
+  int Value = d.Bytes[d.Len] | (d.Bytes[d.Len + 1] << 8);
+
+  d.Len += 2;
+  return Value;
+}
+
+// Formats the r/m operand of the ModRM byte. Size is "byte ", "word " or
+// "" and goes before a memory operand.
+static void RM(Decode_t &d, int ModRM, bool Wide, const char *Size, char *Out)
+{
+  int Mod = ModRM >> 6;
+  int Rm = ModRM & 7;
+
+  if (Mod == 3)
+  {
+    strcpy(Out, Wide ? Reg16[Rm] : Reg8[Rm]);
+  }
+  else if ((Mod == 0) && (Rm == 6))
+  {
+    sprintf(Out, "%s[0x%04X]", Size, Word(d));
+  }
+  else if (Mod == 0)
+  {
+    sprintf(Out, "%s[%s]", Size, EABase[Rm]);
+  }
+  else if (Mod == 1)
+  {
+    int Disp = (int8_t) Byte(d);
+    sprintf(Out, "%s[%s%c0x%02X]", Size, EABase[Rm], (Disp < 0) ? '-' : '+', (Disp < 0) ? -Disp : Disp);
+  }
+  else
+  {
+    sprintf(Out, "%s[%s+0x%04X]", Size, EABase[Rm], Word(d));
+  }
+}
+
+// Disassembles the instruction at Bytes, which runs at IP. Returns its length.
+static int Disassemble(const uint8_t *Bytes, uint16_t IP, char *Out)
+{
+  Decode_t d;
+  int Opcode;
+  int ModRM = 0;
+  const char *Name;
+  char Ops[64];
+  char Rm[48];
+
+  d.Bytes = Bytes;
+  d.Len = 0;
+
+  Opcode = Byte(d);
+  Name = Opcodes[Opcode].Name;
+  Ops[0] = 0;
+
+  switch (Opcodes[Opcode].Form)
+  {
+    case OP_NONE:
+      break;
+
+    case OP_EB_GB:
+    case OP_EV_GV:
+    case OP_GB_EB:
+    case OP_GV_EV:
+    {
+      bool Wide = (Opcodes[Opcode].Form == OP_EV_GV) || (Opcodes[Opcode].Form == OP_GV_EV);
+      const char *Reg = Wide ? Reg16[(Bytes[1] >> 3) & 7] : Reg8[(Bytes[1] >> 3) & 7];
+
+      ModRM = Byte(d);
+      RM(d, ModRM, Wide, "", Rm);
+      if ((Opcodes[Opcode].Form == OP_EB_GB) || (Opcodes[Opcode].Form == OP_EV_GV))
+      {
+        sprintf(Ops, "%s,%s", Rm, Reg);
+      }
+      else
+      {
+        sprintf(Ops, "%s,%s", Reg, Rm);
+      }
+      break;
+    }
+
+    case OP_AL_IB:
+      sprintf(Ops, "al,0x%02X", Byte(d));
+      break;
+
+    case OP_AX_IV:
+      sprintf(Ops, "ax,0x%04X", Word(d));
+      break;
+
+    case OP_SEG:
+      strcpy(Ops, SegReg[(Opcode >> 3) & 3]);
+      break;
+
+    case OP_REG16:
+      strcpy(Ops, Reg16[Opcode & 7]);
+      break;
+
+    case OP_AX_REG:
+      sprintf(Ops, "%s,ax", Reg16[Opcode & 7]);
+      break;
+
+    case OP_REG8_IB:
+      sprintf(Ops, "%s,0x%02X", Reg8[Opcode & 7], Byte(d));
+      break;
+
+    case OP_REG_IV:
+      sprintf(Ops, "%s,0x%04X", Reg16[Opcode & 7], Word(d));
+      break;
+
+    case OP_JB:
+    {
+      int Rel = (int8_t) Byte(d);
+      sprintf(Ops, "0x%04X", (IP + d.Len + Rel) & 0xFFFF);
+      break;
+    }
+
+    case OP_JV:
+    {
+      int Rel = Word(d);
+      sprintf(Ops, "0x%04X", (IP + d.Len + Rel) & 0xFFFF);
+      break;
+    }
+
+    case OP_AP:
+    {
+      int Off = Word(d);
+      sprintf(Ops, "0x%04X:0x%04X", Word(d), Off);
+      break;
+    }
+
+    case OP_EW_SW:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "", Rm);
+      sprintf(Ops, "%s,%s", Rm, SegReg[(ModRM >> 3) & 3]);
+      break;
+
+    case OP_SW_EW:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "", Rm);
+      sprintf(Ops, "%s,%s", SegReg[(ModRM >> 3) & 3], Rm);
+      break;
+
+    case OP_GV_M:
+    case OP_GV_MP:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "", Rm);
+      sprintf(Ops, "%s,%s", Reg16[(ModRM >> 3) & 7], Rm);
+      break;
+
+    case OP_EV:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "word ", Ops);
+      break;
+
+    case OP_AL_OB:
+      sprintf(Ops, "al,[0x%04X]", Word(d));
+      break;
+
+    case OP_AX_OV:
+      sprintf(Ops, "ax,[0x%04X]", Word(d));
+      break;
+
+    case OP_OB_AL:
+      sprintf(Ops, "[0x%04X],al", Word(d));
+      break;
+
+    case OP_OV_AX:
+      sprintf(Ops, "[0x%04X],ax", Word(d));
+      break;
+
+    case OP_IB:
+      sprintf(Ops, "0x%02X", Byte(d));
+      break;
+
+    case OP_IBS:
+      sprintf(Ops, "0x%04X", (uint16_t) (int8_t) Byte(d));
+      break;
+
+    case OP_IV:
+      sprintf(Ops, "0x%04X", Word(d));
+      break;
+
+    case OP_IW_IB:
+    {
+      int Size = Word(d);
+      sprintf(Ops, "0x%04X,0x%02X", Size, Byte(d));
+      break;
+    }
+
+    case OP_GV_EV_IV:
+    case OP_GV_EV_IB:
+    {
+      int Imm;
+
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "", Rm);
+      Imm = (Opcodes[Opcode].Form == OP_GV_EV_IV) ? Word(d) : (uint16_t) (int8_t) Byte(d);
+      sprintf(Ops, "%s,%s,0x%04X", Reg16[(ModRM >> 3) & 7], Rm, Imm);
+      break;
+    }
+
+    case OP_AL_PORT:
+      sprintf(Ops, "al,0x%02X", Byte(d));
+      break;
+
+    case OP_AX_PORT:
+      sprintf(Ops, "ax,0x%02X", Byte(d));
+      break;
+
+    case OP_PORT_AL:
+      sprintf(Ops, "0x%02X,al", Byte(d));
+      break;
+
+    case OP_PORT_AX:
+      sprintf(Ops, "0x%02X,ax", Byte(d));
+      break;
+
+    case OP_AL_DX:
+      strcpy(Ops, "al,dx");
+      break;
+
+    case OP_AX_DX:
+      strcpy(Ops, "ax,dx");
+      break;
+
+    case OP_DX_AL:
+      strcpy(Ops, "dx,al");
+      break;
+
+    case OP_DX_AX:
+      strcpy(Ops, "dx,ax");
+      break;
+
+    case OP_EMU:
+      sprintf(Ops, "0x%02X", Byte(d));
+      break;
+
+    case OP_ESC:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "", Rm);
+      sprintf(Ops, "0x%02X,%s", ((Opcode & 7) << 3) | ((ModRM >> 3) & 7), Rm);
+      break;
+
+    case OP_G1_EB_IB:
+    case OP_G2_EB_IB:
+    case OP_EB_IB:
+      ModRM = Byte(d);
+      RM(d, ModRM, false, "byte ", Rm);
+      sprintf(Ops, "%s,0x%02X", Rm, Byte(d));
+      break;
+
+    case OP_G1_EV_IV:
+    case OP_EV_IV:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "word ", Rm);
+      sprintf(Ops, "%s,0x%04X", Rm, Word(d));
+      break;
+
+    case OP_G1_EV_IB:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "word ", Rm);
+      sprintf(Ops, "%s,0x%04X", Rm, (uint16_t) (int8_t) Byte(d));
+      break;
+
+    case OP_G2_EV_IB:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "word ", Rm);
+      sprintf(Ops, "%s,0x%02X", Rm, Byte(d));
+      break;
+
+    case OP_G2_EB_1:
+    case OP_G2_EV_1:
+      ModRM = Byte(d);
+      RM(d, ModRM, Opcodes[Opcode].Form == OP_G2_EV_1, (Opcodes[Opcode].Form == OP_G2_EV_1) ? "word " : "byte ", Rm);
+      sprintf(Ops, "%s,1", Rm);
+      break;
+
+    case OP_G2_EB_CL:
+    case OP_G2_EV_CL:
+      ModRM = Byte(d);
+      RM(d, ModRM, Opcodes[Opcode].Form == OP_G2_EV_CL, (Opcodes[Opcode].Form == OP_G2_EV_CL) ? "word " : "byte ", Rm);
+      sprintf(Ops, "%s,cl", Rm);
+      break;
+
+    case OP_G3_EB:
+    case OP_G3_EV:
+    {
+      bool Wide = (Opcodes[Opcode].Form == OP_G3_EV);
+
+      ModRM = Byte(d);
+      RM(d, ModRM, Wide, Wide ? "word " : "byte ", Rm);
+      if (((ModRM >> 3) & 7) < 2)
+      {
+        // TEST has an immediate operand
+        if (Wide)
+        {
+          sprintf(Ops, "%s,0x%04X", Rm, Word(d));
+        }
+        else
+        {
+          sprintf(Ops, "%s,0x%02X", Rm, Byte(d));
+        }
+      }
+      else
+      {
+        strcpy(Ops, Rm);
+      }
+      break;
+    }
+
+    case OP_G4_EB:
+      ModRM = Byte(d);
+      RM(d, ModRM, false, "byte ", Ops);
+      break;
+
+    case OP_G5_EV:
+      ModRM = Byte(d);
+      RM(d, ModRM, true, "word ", Ops);
+      break;
+  }
+
+  // Group opcodes take the name from the ModRM reg field
+  switch (Opcodes[Opcode].Form)
+  {
+    case OP_G1_EB_IB:
+    case OP_G1_EV_IV:
+    case OP_G1_EV_IB:
+      Name = Group1[(ModRM >> 3) & 7];
+      break;
+
+    case OP_G2_EB_IB:
+    case OP_G2_EV_IB:
+    case OP_G2_EB_1:
+    case OP_G2_EV_1:
+    case OP_G2_EB_CL:
+    case OP_G2_EV_CL:
+      Name = Group2[(ModRM >> 3) & 7];
+      break;
+
+    case OP_G3_EB:
+    case OP_G3_EV:
+      Name = Group3[(ModRM >> 3) & 7];
+      break;
+
+    case OP_G4_EB:
+      Name = Group4[(ModRM >> 3) & 7];
+      break;
+
+    case OP_G5_EV:
+      Name = Group5[(ModRM >> 3) & 7];
+      break;
+
+    default:
+      break;
+  }
+
+  if (Ops[0] != 0)
+  {
+    sprintf(Out, "%s %s", Name, Ops);
+  }
+  else
+  {
+    strcpy(Out, Name);
+  }
+
+  // An instruction longer than the bytes kept is cut short
+  if (d.Len > TRACE_BYTES)
+  {
+    strcat(Out, " ?");
+    d.Len = TRACE_BYTES;
+  }
+
+  return d.Len;
+}
+
+// =============================================================================
+// Trace printing
+//
+
+static void PrintRecord(const stTraceRecord_t &Record, unsigned long long Number, uint16_t &Flags, bool First)
+{
+  // The bytes past TRACE_BYTES read as 0 so a cut short decode stays inside
+  uint8_t Bytes[TRACE_BYTES + 8];
+  char Text[128];
+  char Hex[TRACE_BYTES * 3 + 1];
+  int Len;
+  int Value = 0;
+
+  memset(Bytes, 0, sizeof(Bytes));
+  memcpy(Bytes, Record.bytes, TRACE_BYTES);
+
+  if (Record.info & TRACE_INFO_INTERRUPT)
+  {
+    printf("                  --- interrupt %02Xh ---\n", Record.interrupt);
+  }
+
+  Len = Disassemble(Bytes, Record.ip, Text);
+  Hex[0] = 0;
+  for (int i = 0 ; i < Len ; i++)
+  {
+    sprintf(Hex + 3 * i, "%02X ", Bytes[i]);
+  }
+
+  // The columns after the disassembly are only padded to when there are any
+  if ((Record.reg_mask != 0) || First || (Record.flags != Flags) || (Record.info & TRACE_INFO_WRITE))
+  {
+    printf("%10llu %04X:%04X %-18s %-28s", Number, Record.cs, Record.ip, Hex, Text);
+  }
+  else
+  {
+    printf("%10llu %04X:%04X %-18s %s", Number, Record.cs, Record.ip, Hex, Text);
+  }
+
+  for (int i = 0 ; i < TRACE_REG_COUNT ; i++)
+  {
+    if (Record.reg_mask & (1 << i))
+    {
+      if (Value < TRACE_REG_VALUES)
+      {
+        printf(" %s=%04X", TraceReg[i], Record.reg_value[Value++]);
+      }
+      else
+      {
+        printf(" %s=?", TraceReg[i]);
+      }
+    }
+  }
+
+  if (First || (Record.flags != Flags))
+  {
+    printf(" FL=%04X", Record.flags);
+    Flags = Record.flags;
+  }
+
+  if (Record.info & TRACE_INFO_WRITE)
+  {
+    printf(" [%05X]=%04X", Record.write_addr, Record.write_value);
+  }
+
+  printf("\n");
+
+  if (Record.info & TRACE_INFO_FAULT)
+  {
+    printf("                  *** fault ***\n");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *Filename = NULL;
+  unsigned long long Last = 0;
+  stTraceHeader_t Header;
+  stTraceRecord_t Record;
+  unsigned long long First;
+  uint16_t Flags = 0;
+  FILE *fp;
+
+  for (int i = 1 ; i < argc ; i++)
+  {
+    if ((strcmp(argv[i], "-last") == 0) && (i + 1 < argc))
+    {
+      Last = strtoull(argv[++i], NULL, 0);
+    }
+    else
+    {
+      Filename = argv[i];
+    }
+  }
+
+  if (Filename == NULL)
+  {
+    printf("Usage: trace_dump [-last <n>] <trace file>\n");
+    return 1;
+  }
+
+  fp = fopen(Filename, "rb");
+  if (fp == NULL)
+  {
+    printf("Could not open %s\n", Filename);
+    return 1;
+  }
+
+  if ((fread(&Header, sizeof(Header), 1, fp) != 1) ||
+      (memcmp(Header.magic, TRACE_MAGIC, sizeof(Header.magic)) != 0) ||
+      (Header.record_size != sizeof(stTraceRecord_t)))
+  {
+    printf("%s is not a trace file of this version\n", Filename);
+    fclose(fp);
+    return 1;
+  }
+
+  Header.reason[TRACE_REASON_SIZE - 1] = 0;
+  printf("Trace: %s, %u of %llu instructions\n\n", Header.reason, Header.count,
+         (unsigned long long) Header.total);
+
+  // Skip to the last instructions asked for
+  First = 0;
+  if ((Last != 0) && (Last < Header.count))
+  {
+    First = Header.count - Last;
+    if (fseek(fp, (long) (First * sizeof(stTraceRecord_t)), SEEK_CUR) != 0)
+    {
+      printf("Could not read %s\n", Filename);
+      fclose(fp);
+      return 1;
+    }
+  }
+
+  for (unsigned long long i = First ; i < Header.count ; i++)
+  {
+    if (fread(&Record, sizeof(Record), 1, fp) != 1)
+    {
+      printf("%s is cut short\n", Filename);
+      break;
+    }
+
+    PrintRecord(Record, Header.total - Header.count + i, Flags, i == First);
+  }
+
+  fclose(fp);
+
+  printf("\nAfter the last instruction:\n ");
+  for (int i = 0 ; i < TRACE_REG_COUNT ; i++)
+  {
+    printf(" %s=%04X", TraceReg[i], Header.regs[i]);
+  }
+  printf(" IP=%04X FL=%04X\n", Header.ip, Header.flags);
+
+  return 0;
+}
@@ -9,8 +9,13 @@
 #define IDD_DIALOG_SOUND_CFG                    108
 #define IDM_RESET                               40000
 #define IDM_QUIT                                40001
+#define IDM_TURBO                               40002
 #define IDM_TEXT_CGA                            40004
 #define IDM_TEXT_VGA_8x16                       40005
+#define IDM_SAVE_SNAPSHOT                       40006
+#define IDM_LOAD_SNAPSHOT                       40007
+#define IDM_REWIND                              40008
+#define IDM_DUMP_TRACE                          40009
 #define IDM_SET_SERIAL_PORTS                    40013
 #define IDM_CONFIGURE_SOUND                     40015
 #define IDC_EDIT_CS                             40101
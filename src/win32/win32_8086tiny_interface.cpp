@@ -13,12 +13,18 @@
 #include <Windows.h>
 #include <Windowsx.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 
 #include <math.h>
 
 #include "serial_emulation.h"
 #include "file_dialog.h"
+#include "emu_time.h"
+#include "state_io.h"
+#include "input_log.h"
+#include "perf_stats.h"
+#include "timeline.h"
 
 #include "win32_cga.h"
 #include "win32_serial_cfg.h"
@@ -42,18 +48,23 @@ static TextDisplay_t WindowTextDisplay = TD_VGA_8x16;
 static bool EmulationExitFlag = false;
 static bool ResetPending = false;
 static bool FDImageChanged = false;
+static bool SnapshotPending = false;
+static bool SnapshotSave = false;
+static bool RewindPending = false;
 
 // disk and bios image file names
 static char BiosFilename[1024];
 static char HDFilename[1024];
 static char FDFilename[1024];
+static char SnapshotFilename[1024];
 
 int CPU_Clock_Hz = 4770000;
 const int PIT_Clock_Hz = 1193181;
 
 int CPU_Counter = 0;
 int CPU_Frame = 0;
-int PIT_Counter = 0;
+long long CPU_TotalTicks = 0;
+long long PIT_Counter = 0;
 
 // timing control variables
 DWORD INT8_PERIOD_MS = 55;
@@ -62,6 +73,50 @@ static int Int8Pending = 0;
 
 static DWORD NextSlowdownTime = 0;
 
+// Turbo mode: run as fast as the host allows, with the emulation clock
+// following the emulated CPU time, see EMU_GetTicks(). Set from the [TURBO]
+// config entry, the -turbo command line option or the Emulation menu.
+static bool TurboMode = false;
+static DWORD TurboBaseTime = 0;      // EMU_GetTicks() when turbo mode started
+static long long TurboBaseTicks = 0; // CPU_TotalTicks when turbo mode started
+static DWORD TurboTimeOffset = 0;    // Time gained in turbo mode so far
+static DWORD NextTurboFrameTime = 0; // Host time of the next screen update
+
+// Input log, see input_log.h. Set from the -record and -replay command line
+// options. While it is on the emulation clock starts at 0 with the log.
+static long long InputStartTime = 0; // Real time clock at the start in ms
+
+// Rewind checkpoints, see CPU8086::RewindEnable(). Set from the optional
+// [REWIND] config entry, as "IntervalMs BudgetKB".
+static unsigned int RewindIntervalMs = 0;
+static unsigned int RewindBudgetKB = 0;
+static const unsigned int RewindStepMs = 5000; // For the Emulation menu
+
+// Guest profiler, see CPU8086::ProfileEnable(). Set from the -profile,
+// -profmap and -profout command line options, for builds with PROFILE.
+static unsigned int ProfilePeriodClocks = 0;
+static const char *ProfileSymbolFilename = NULL;
+static const char *ProfileReportFilename = "profile.txt";
+
+// Instruction trace, see CPU8086::TraceEnable(). Set from the -trace and
+// -traceout command line options, for builds with TRACE. The Emulation menu
+// asks for the trace to be written.
+static unsigned int TraceRecords = 0;
+static const char *TraceFilename = "trace.bin";
+static bool TraceOn = false;
+static bool TracePending = false;
+
+// Performance counters output, see perf_stats.h. Set from the -stats and
+// -statsms command line options. HostCounters holds the frame counts and
+// the render time, the serial ports count their own bytes.
+static const char *StatsTarget = NULL;
+static unsigned int StatsPeriodMs = PERF_DEFAULT_PERIOD_MS;
+static PerfHostCounters_t HostCounters;
+
+// Timeline, see timeline.h. Set from the -timeline command line option, for
+// builds with TIMELINE.
+static const char *TimelineFilename = NULL;
+
 // Mouse state variables
 
 static bool HaveCapture = false;
@@ -84,7 +139,7 @@ static bool SpkrT2US = false;  // Is T2 rate ultrasonic? Some games use this
 
 static short SndBuffer[2048];
 static int SndBufferLen = 0;
-static int SND_Counter = 0;
+static long long SND_Counter = 0;
 
 // =============================================================================
 // PIC 8259 stuff
@@ -167,7 +222,7 @@ void PIT_UpdateTimers(int Ticks)
   {
     SpkrT2Out = false;
 
-    if (PIT_Channel2.Count <= 0)
+    while (PIT_Channel2.Count <= 0)
     {
       if (PIT_Channel2.ResetCount == 0)
       {
@@ -182,7 +237,7 @@ void PIT_UpdateTimers(int Ticks)
   }
   else if (PIT_Channel2.Mode == 3)
   {
-    if (PIT_Channel2.Count <= 0)
+    while (PIT_Channel2.Count <= 0)
     {
       if (PIT_Channel2.ResetCount == 0)
       {
@@ -519,6 +574,15 @@ static inline void AddKeyEvent(unsigned char code)
   }
 }
 
+// A key from the host, which is logged or, in replay, ignored
+static void HostKeyEvent(unsigned char code)
+{
+  if (INPUT_GetMode() == INPUT_LOG_REPLAY) return;
+
+  INPUT_Record(INPUT_KEY, &code, 1);
+  AddKeyEvent(code);
+}
+
 static inline  bool IsKeyEventAvailable(void)
 {
   return (KeyBufferCount > 0);
@@ -550,6 +614,46 @@ static inline unsigned char NextKeyEvent(void)
   return code;
 }
 
+// =============================================================================
+// Emulation clock
+//
+
+DWORD EMU_GetTicks(void)
+{
+  if (TurboMode || (INPUT_GetMode() != INPUT_LOG_OFF))
+  {
+    return TurboBaseTime + (DWORD) (((CPU_TotalTicks - TurboBaseTicks) * 1000) / CPU_Clock_Hz);
+  }
+
+  return timeGetTime() + TurboTimeOffset;
+}
+
+static void SetTurboMode(bool Enable)
+{
+  if (Enable == TurboMode) return;
+
+  DWORD CurrentTime = EMU_GetTicks();
+
+  if (INPUT_GetMode() != INPUT_LOG_OFF)
+  {
+    // The emulation clock follows the CPU clock anyway
+  }
+  else if (Enable)
+  {
+    TurboBaseTime = CurrentTime;
+    TurboBaseTicks = CPU_TotalTicks;
+  }
+  else
+  {
+    // Carry on from the emulated time reached, at real time speed
+    TurboTimeOffset = CurrentTime - timeGetTime();
+  }
+
+  TurboMode = Enable;
+
+  SetWindowText(hwndMain, (TurboMode) ? "TinyXT - Turbo" : "TinyXT");
+}
+
 // ============================================================================
 // Windows stuff
 //
@@ -630,6 +734,30 @@ int ReadConfig(const char *Filename)
   // Read sound configuration
   SNDCFG_Read(fp);
 
+  // Read turbo mode and rewind, which older files do not have
+  if (fgets(Line, 256, fp) == NULL) Line[0] = 0;
+
+  if (strncmp(Line, "[TURBO]", 7) == 0)
+  {
+    int Turbo = 0;
+
+    fgets(Line, 256, fp);
+    sscanf(Line, "%d\n", &Turbo);
+    SetTurboMode(Turbo != 0);
+
+    if (fgets(Line, 256, fp) == NULL) Line[0] = 0;
+  }
+
+  if (strncmp(Line, "[REWIND]", 8) == 0)
+  {
+    fgets(Line, 256, fp);
+    if (sscanf(Line, "%u %u\n", &RewindIntervalMs, &RewindBudgetKB) != 2)
+    {
+      RewindIntervalMs = 0;
+      RewindBudgetKB = 0;
+    }
+  }
+
   fclose(fp);
 
   return 1;
@@ -657,30 +785,32 @@ LRESULT CALLBACK WindowProcedure (HWND hwnd, UINT message, WPARAM wParam, LPARAM
         CheckMenuItem((HMENU) wParam, IDM_TEXT_CGA, MF_BYCOMMAND | MF_UNCHECKED);
         CheckMenuItem((HMENU) wParam, IDM_TEXT_VGA_8x16, MF_BYCOMMAND | MF_CHECKED);
       }
+      CheckMenuItem((HMENU) wParam, IDM_TURBO, MF_BYCOMMAND | ((TurboMode) ? MF_CHECKED : MF_UNCHECKED));
+      EnableMenuItem((HMENU) wParam, IDM_DUMP_TRACE, MF_BYCOMMAND | ((TraceOn) ? MF_ENABLED : MF_GRAYED));
       break;
 
     case WM_KEYDOWN:
       KeyCode = VKtoSet1Code(wParam, ((lParam & 0x01000000) != 0));
-      if ((KeyCode & 0xFF00) != 0) AddKeyEvent((KeyCode >> 8) & 0xFF);
-      AddKeyEvent(KeyCode & 0xFF);
+      if ((KeyCode & 0xFF00) != 0) HostKeyEvent((KeyCode >> 8) & 0xFF);
+      HostKeyEvent(KeyCode & 0xFF);
       break;
 
     case WM_KEYUP:
       KeyCode = VKtoSet1Code(wParam, ((lParam & 0x01000000) != 0));
-      if ((KeyCode & 0xFF00) != 0) AddKeyEvent((KeyCode >> 8) & 0xFF);
-      AddKeyEvent((KeyCode & 0xFF) | 0x80);
+      if ((KeyCode & 0xFF00) != 0) HostKeyEvent((KeyCode >> 8) & 0xFF);
+      HostKeyEvent((KeyCode & 0xFF) | 0x80);
       break;
 
     case WM_SYSKEYDOWN:
       KeyCode = VKtoSet1Code(wParam, ((lParam & 0x01000000) != 0));
-      if ((KeyCode & 0xFF00) != 0) AddKeyEvent((KeyCode >> 8) & 0xFF);
-      AddKeyEvent(KeyCode & 0xFF);
+      if ((KeyCode & 0xFF00) != 0) HostKeyEvent((KeyCode >> 8) & 0xFF);
+      HostKeyEvent(KeyCode & 0xFF);
       break;
 
     case WM_SYSKEYUP:
       KeyCode = VKtoSet1Code(wParam, ((lParam & 0x01000000) != 0));
-      if ((KeyCode & 0xFF00) != 0) AddKeyEvent((KeyCode >> 8) & 0xFF);
-      AddKeyEvent((KeyCode & 0xFF) | 0x80);
+      if ((KeyCode & 0xFF00) != 0) HostKeyEvent((KeyCode >> 8) & 0xFF);
+      HostKeyEvent((KeyCode & 0xFF) | 0x80);
       break;
 
     case WM_CAPTURECHANGED:
@@ -729,7 +859,39 @@ LRESULT CALLBACK WindowProcedure (HWND hwnd, UINT message, WPARAM wParam, LPARAM
         // File menu
         //
         case IDM_RESET:
-          ResetPending = true;
+          if (INPUT_GetMode() != INPUT_LOG_REPLAY)
+          {
+            INPUT_Record(INPUT_RESET, NULL, 0);
+            ResetPending = true;
+          }
+          break;
+
+        case IDM_TURBO:
+          SetTurboMode(!TurboMode);
+          break;
+
+        case IDM_SAVE_SNAPSHOT:
+          if (SaveFileDialog("Save Snapshot", SnapshotFilename, 1024, "Snapshot\0*.snp\0All Files\0*.*\0"))
+          {
+            SnapshotSave = true;
+            SnapshotPending = true;
+          }
+          break;
+
+        case IDM_LOAD_SNAPSHOT:
+          if (OpenFileDialog("Load Snapshot", SnapshotFilename, 1024, "Snapshot\0*.snp\0All Files\0*.*\0"))
+          {
+            SnapshotSave = false;
+            SnapshotPending = true;
+          }
+          break;
+
+        case IDM_REWIND:
+          RewindPending = true;
+          break;
+
+        case IDM_DUMP_TRACE:
+          TracePending = true;
           break;
 
         case IDM_QUIT:
@@ -786,12 +948,58 @@ LRESULT CALLBACK WindowProcedure (HWND hwnd, UINT message, WPARAM wParam, LPARAM
   return 0;
 }
 
+// =============================================================================
+// Snapshot state
+//
+
+// Writes or reads the timer, interrupt controller, keyboard and speaker
+// state, then the CGA and serial port state.
+static bool InterfaceState(FILE *fp, bool Save, unsigned char *Port)
+{
+  STATE_ITEM(fp, Save, CPU_Counter);
+  STATE_ITEM(fp, Save, CPU_Frame);
+  STATE_ITEM(fp, Save, PIT_Counter);
+  STATE_ITEM(fp, Save, INT8_PERIOD_MS);
+  STATE_ITEM(fp, Save, Int8Pending);
+  STATE_ITEM(fp, Save, PIT_Channel0);
+  STATE_ITEM(fp, Save, PIT_Channel1);
+  STATE_ITEM(fp, Save, PIT_Channel2);
+
+  STATE_ITEM(fp, Save, PIC_OCW_Idx);
+  STATE_ITEM(fp, Save, PIC_OCW);
+  STATE_ITEM(fp, Save, PIC_ICW_Idx);
+  STATE_ITEM(fp, Save, PIC_ICW);
+
+  STATE_ITEM(fp, Save, KeyBufferHead);
+  STATE_ITEM(fp, Save, KeyBufferTail);
+  STATE_ITEM(fp, Save, KeyBufferCount);
+  STATE_ITEM(fp, Save, KeyBuffer);
+  STATE_ITEM(fp, Save, KeyInputBuffer);
+  STATE_ITEM(fp, Save, KeyInputFull);
+
+  STATE_ITEM(fp, Save, SpkrData);
+  STATE_ITEM(fp, Save, SpkrT2Gate);
+  STATE_ITEM(fp, Save, SpkrT2Out);
+  STATE_ITEM(fp, Save, SpkrT2US);
+  STATE_ITEM(fp, Save, SND_Counter);
+
+  if (!STATE_Transfer(fp, Save, Port, 65536)) return false;
+
+  if (Save)
+  {
+    return CGA_SaveState(fp) && SERIAL_SaveState(fp);
+  }
+
+  return CGA_LoadState(fp) && SERIAL_LoadState(fp);
+}
+
 // =============================================================================
 // Interface class.
 //
 
 T8086TinyInterface_t::T8086TinyInterface_t()
 {
+  IntLine = false;
 }
 
 T8086TinyInterface_t::~T8086TinyInterface_t()
@@ -875,6 +1083,81 @@ bool T8086TinyInterface_t::Initialise(unsigned char *mem_in)
 
   ReadConfig("default.cfg");
 
+  // Command line options
+  for (int i = 1 ; i < __argc ; i++)
+  {
+    if (strcmp(__argv[i], "-turbo") == 0)
+    {
+      SetTurboMode(true);
+    }
+    else if ((strcmp(__argv[i], "-record") == 0) && (i + 1 < __argc))
+    {
+      struct timeb Now;
+
+      ftime(&Now);
+      InputStartTime = (long long) Now.time * 1000 + Now.millitm;
+      INPUT_StartRecord(__argv[++i], CPU_Clock_Hz, InputStartTime);
+    }
+    else if ((strcmp(__argv[i], "-replay") == 0) && (i + 1 < __argc))
+    {
+      // Replay runs as fast as it can
+      if (INPUT_StartReplay(__argv[++i], CPU_Clock_Hz, InputStartTime))
+      {
+        SetTurboMode(true);
+      }
+    }
+    else if ((strcmp(__argv[i], "-profile") == 0) && (i + 1 < __argc))
+    {
+      ProfilePeriodClocks = (unsigned int) strtoul(__argv[++i], NULL, 0);
+    }
+    else if ((strcmp(__argv[i], "-profmap") == 0) && (i + 1 < __argc))
+    {
+      ProfileSymbolFilename = __argv[++i];
+    }
+    else if ((strcmp(__argv[i], "-profout") == 0) && (i + 1 < __argc))
+    {
+      ProfileReportFilename = __argv[++i];
+    }
+    else if ((strcmp(__argv[i], "-trace") == 0) && (i + 1 < __argc))
+    {
+      TraceRecords = (unsigned int) strtoul(__argv[++i], NULL, 0);
+    }
+    else if ((strcmp(__argv[i], "-traceout") == 0) && (i + 1 < __argc))
+    {
+      TraceFilename = __argv[++i];
+    }
+    else if ((strcmp(__argv[i], "-stats") == 0) && (i + 1 < __argc))
+    {
+      StatsTarget = __argv[++i];
+    }
+    else if ((strcmp(__argv[i], "-statsms") == 0) && (i + 1 < __argc))
+    {
+      StatsPeriodMs = (unsigned int) strtoul(__argv[++i], NULL, 0);
+    }
+    else if ((strcmp(__argv[i], "-timeline") == 0) && (i + 1 < __argc))
+    {
+      TimelineFilename = __argv[++i];
+    }
+  }
+
+#if TIMELINE
+  if ((TimelineFilename != NULL) && !TIMELINE_Open(TimelineFilename, "emulation"))
+  {
+    printf("Could not write the timeline to %s\n", TimelineFilename);
+  }
+#endif
+
+  if ((StatsTarget != NULL) && !PERF_Open(StatsTarget, StatsPeriodMs))
+  {
+    printf("Could not write the stats to %s\n", StatsTarget);
+  }
+
+  if (INPUT_GetMode() != INPUT_LOG_OFF)
+  {
+    TurboBaseTime = 0;
+    TurboBaseTicks = CPU_TotalTicks;
+  }
+
   WAVEFORMATEX wfx;
   wfx.cbSize = 0;
   wfx.wFormatTag = WAVE_FORMAT_PCM;
@@ -900,6 +1183,16 @@ void T8086TinyInterface_t::Cleanup(void)
 
   CGA_Cleanup();
   SERIAL_Cleanup();
+
+  INPUT_Stop();
+  PERF_Close();
+
+#if TIMELINE
+  if ((TimelineFilename != NULL) && !TIMELINE_Close())
+  {
+    printf("Could not write the timeline to %s\n", TimelineFilename);
+  }
+#endif
 }
 
 bool T8086TinyInterface_t::ExitEmulation(void)
@@ -907,6 +1200,38 @@ bool T8086TinyInterface_t::ExitEmulation(void)
   return EmulationExitFlag;
 }
 
+bool T8086TinyInterface_t::GuestHalted(void)
+{
+  // Leave the window open on the halted machine
+  return false;
+}
+
+bool T8086TinyInterface_t::GuestQuit(void)
+{
+  // The window is closed from the menu
+  return false;
+}
+
+void T8086TinyInterface_t::GuestWaitsForKey(void)
+{
+  // The keys come from the host as they are pressed
+}
+
+void T8086TinyInterface_t::PutChar(unsigned char c)
+{
+  putchar(c);
+}
+
+unsigned long long T8086TinyInterface_t::GetInstructionLimit(void)
+{
+  return 0;
+}
+
+int T8086TinyInterface_t::ExitStatus(unsigned long long /* Instructions */)
+{
+  return 0;
+}
+
 bool T8086TinyInterface_t::Reset(void)
 {
   if (ResetPending)
@@ -941,6 +1266,8 @@ bool T8086TinyInterface_t::Reset(void)
     PIC_ICW_Idx = 0;
     PIC_OCW_Idx = 0;
 
+    UpdateIntLine();
+
     return true;
   }
   return false;
@@ -982,22 +1309,78 @@ bool T8086TinyInterface_t::FDChanged(void)
   return FDImageChanged;
 }
 
+bool T8086TinyInterface_t::DiskCopyOnWrite(void)
+{
+  return false;
+}
+
 bool T8086TinyInterface_t::TimerTick(int nTicks)
+{
+  bool NextVideoFrame = false;
+
+  // nTicks can be anything from 2 clocks to a whole REP MOVSW, so split it
+  // at the 4 ms frame boundaries. The frame processing then runs once per
+  // frame, and each call to FrameTick() makes at most one frame of sound.
+  while (nTicks > 0)
+  {
+    int Ticks = (CPU_Clock_Hz / 250) + 1 - CPU_Counter;
+
+    if ((Ticks <= 0) || (Ticks > nTicks))
+    {
+      Ticks = nTicks;
+    }
+    nTicks -= Ticks;
+
+    if (FrameTick(Ticks))
+    {
+      NextVideoFrame = true;
+    }
+  }
+
+  UpdateIntLine();
+
+  return NextVideoFrame;
+}
+
+int T8086TinyInterface_t::NextEventTicks(void)
+{
+  long long EventTicks;
+
+  // Next frame: the screen, keyboard, mouse and serial port processing
+  int Ticks = (CPU_Clock_Hz / 250) + 1 - CPU_Counter;
+
+  // Next PIT channel 0 reload, which raises IRQ 0
+  EventTicks = (long long) PIT_Channel0.Count * CPU_Clock_Hz - PIT_Counter;
+  EventTicks = (EventTicks + PIT_Clock_Hz - 1) / PIT_Clock_Hz;
+  if (EventTicks < Ticks)
+  {
+    Ticks = (int) EventTicks;
+  }
+
+  // While channel 2 drives the speaker each sample needs its current output
+  if (SoundEnabled && SpkrT2Gate && !SpkrT2US)
+  {
+    EventTicks = CPU_Clock_Hz - SND_Counter;
+    EventTicks = (EventTicks + AudioSampleRate - 1) / AudioSampleRate;
+    if (EventTicks < Ticks)
+    {
+      Ticks = (int) EventTicks;
+    }
+  }
+
+  return (Ticks > 0) ? Ticks : 1;
+}
+
+bool T8086TinyInterface_t::FrameTick(int nTicks)
 {
   int PIT_Ticks;
   MSG messages;
   bool NextVideoFrame = false;
 
-  // TODO:
-  // This works OK for small values of nTicks, however, the following
-  // processing will break down horribly if nTicks is ever larger ( > about 10)
-  // If I ever get nTicks per instruction then this will need to change to
-  // a loop. Probably safe to process 4 ticks per loop.
-
   // Update PIT
 
-  PIT_Counter = PIT_Counter + PIT_Clock_Hz * nTicks;
-  PIT_Ticks = PIT_Counter / CPU_Clock_Hz;
+  PIT_Counter = PIT_Counter + (long long) PIT_Clock_Hz * nTicks;
+  PIT_Ticks = (int) (PIT_Counter / CPU_Clock_Hz);
   PIT_Counter = PIT_Counter % CPU_Clock_Hz;
 
   PIT_UpdateTimers(PIT_Ticks);
@@ -1006,8 +1389,8 @@ bool T8086TinyInterface_t::TimerTick(int nTicks)
   if (SoundEnabled)
   {
     int SoundTicks;
-    SND_Counter = SND_Counter + AudioSampleRate * nTicks;
-    SoundTicks = SND_Counter / CPU_Clock_Hz;
+    SND_Counter = SND_Counter + (long long) AudioSampleRate * nTicks;
+    SoundTicks = (int) (SND_Counter / CPU_Clock_Hz);
     SND_Counter = SND_Counter % CPU_Clock_Hz;
     for (int i = 0 ; i < SoundTicks ; i++)
     {
@@ -1032,21 +1415,44 @@ bool T8086TinyInterface_t::TimerTick(int nTicks)
 
   // main update processing is every 4 ms of CPU time.
 
+  CPU_TotalTicks += nTicks;
+  INPUT_SetTime(CPU_TotalTicks - TurboBaseTicks);
+
   CPU_Counter += nTicks;
   if (CPU_Counter > (CPU_Clock_Hz / 250))
   {
+    TIMELINE_BEGIN("frame");
 
     CPU_Counter = 0;
     CPU_Frame++;
 
-    if (CPU_Frame == 4)
+    if ((CPU_Frame == 4) && TurboMode && ((int) (timeGetTime() - NextTurboFrameTime) < 0))
     {
+      // In turbo mode the screen, mouse and messages only need to keep up
+      // with the host, so most frames skip them. The sound is dropped.
+      SndBufferLen = 0;
+      NextVideoFrame = true;
+      CPU_Frame = 0;
+      HostCounters.FramesSkipped++;
+    }
+    else if (CPU_Frame == 4)
+    {
+      NextTurboFrameTime = timeGetTime() + 16;
+
       if (SoundEnabled)
       {
-        WaveOut->Write((PBYTE) SndBuffer, SndBufferLen*2);
+        if (!TurboMode)
+        {
+          // Blocks while all the wave buffers are queued
+          TIMELINE_BEGIN("sound flush");
+          WaveOut->Write((PBYTE) SndBuffer, SndBufferLen*2);
+          TIMELINE_END("sound flush");
+        }
         SndBufferLen = 0;
       }
 
+      TIMELINE_BEGIN("render");
+
       int w, h;
       CGA_GetDisplaySize(w, h);
       if ((w != CurrentDispW) || (h != CurrentDispH))
@@ -1061,7 +1467,11 @@ bool T8086TinyInterface_t::TimerTick(int nTicks)
         SetWindowPos(hwndMain, NULL, 0, 0, w, h, SWP_NOMOVE | SWP_NOZORDER);
       }
 
+      unsigned long long RenderStart = PERF_GetMicroseconds();
       CGA_DrawScreen(hwndMain, mem);
+      HostCounters.RenderUs += PERF_GetMicroseconds() - RenderStart;
+      HostCounters.FramesRendered++;
+      TIMELINE_END("render");
       NextVideoFrame = true;
       CPU_Frame = 0;
 
@@ -1113,6 +1523,7 @@ bool T8086TinyInterface_t::TimerTick(int nTicks)
       }
 
       /* Run the message loop. It will run until PeekMessage() returns 0 */
+      TIMELINE_BEGIN("message pump");
       while (PeekMessage (&messages, NULL, 0, 0, PM_REMOVE))
       {
         /* Translate virtual-key messages into character messages */
@@ -1120,31 +1531,209 @@ bool T8086TinyInterface_t::TimerTick(int nTicks)
         /* Send message to WindowProcedure */
         DispatchMessage(&messages);
       }
+      TIMELINE_END("message pump");
     }
 
+    // Replayed keys and resets go in where the host ones would have
+    if (INPUT_GetMode() == INPUT_LOG_REPLAY)
+    {
+      InputEvent_t Event;
+
+      while (INPUT_Replay(INPUT_KEY, Event))
+      {
+        AddKeyEvent(Event.Data[0]);
+      }
+
+      while (INPUT_Replay(INPUT_RESET, Event))
+      {
+        ResetPending = true;
+      }
+    }
+
+    TIMELINE_BEGIN("serial");
     SERIAL_HandleSerial();
+    TIMELINE_END("serial");
 
+#ifndef BENCHMARK
     DWORD CurrentTime = timeGetTime();
-    if (CurrentTime >= NextSlowdownTime)
+    if (TurboMode || (CurrentTime >= NextSlowdownTime))
     {
       // No slowdown required
       NextSlowdownTime = CurrentTime + 4;
     }
     else
     {
+      TIMELINE_BEGIN("sleep");
       Sleep(NextSlowdownTime - CurrentTime);
+      TIMELINE_END("sleep");
       NextSlowdownTime += 4;
     }
+#endif
 
     if (NextVideoFrame)
     {
       CGA_VBlankStart();
     }
+
+    TIMELINE_END("frame");
   }
 
   return NextVideoFrame;
 }
 
+// Stop recording before the machine state is replaced. A replay goes on
+// and the request is ignored.
+static bool StopInputLog(void)
+{
+  if (INPUT_GetMode() == INPUT_LOG_REPLAY)
+  {
+    printf("Not while replaying the input log\n");
+    return false;
+  }
+
+  if (INPUT_GetMode() == INPUT_LOG_RECORD)
+  {
+    // Carry on from the emulated time reached, as when turbo mode ends
+    DWORD CurrentTime = EMU_GetTicks();
+
+    printf("Input log recording stopped\n");
+    INPUT_Stop();
+
+    TurboBaseTime = CurrentTime;
+    TurboBaseTicks = CPU_TotalTicks;
+    TurboTimeOffset = CurrentTime - timeGetTime();
+  }
+
+  return true;
+}
+
+bool T8086TinyInterface_t::SnapshotRequest(const char *&Filename, bool &Save)
+{
+  if (!SnapshotPending)
+  {
+    return false;
+  }
+
+  SnapshotPending = false;
+  Filename = SnapshotFilename;
+  Save = SnapshotSave;
+
+  // Loading a snapshot takes the machine off the input log
+  if (!Save && !StopInputLog())
+  {
+    return false;
+  }
+
+  return true;
+}
+
+bool T8086TinyInterface_t::ForkRequest(int & /* Children */)
+{
+  // Windows has no fork()
+  return false;
+}
+
+void T8086TinyInterface_t::ForkStarted(int /* Child */)
+{
+}
+
+void T8086TinyInterface_t::GetRewindConfig(unsigned int &IntervalMs, unsigned int &BudgetKB, unsigned int &ClockHz)
+{
+  IntervalMs = RewindIntervalMs;
+  BudgetKB = RewindBudgetKB;
+  ClockHz = (unsigned int) CPU_Clock_Hz;
+}
+
+bool T8086TinyInterface_t::RewindRequest(unsigned int &Ms)
+{
+  if (!RewindPending)
+  {
+    return false;
+  }
+
+  RewindPending = false;
+  Ms = RewindStepMs;
+
+  return StopInputLog();
+}
+
+void T8086TinyInterface_t::GetProfileConfig(unsigned int &PeriodClocks, const char *&SymbolFilename, const char *&ReportFilename)
+{
+  PeriodClocks = ProfilePeriodClocks;
+  SymbolFilename = ProfileSymbolFilename;
+  ReportFilename = ProfileReportFilename;
+}
+
+void T8086TinyInterface_t::GetTraceConfig(unsigned int &Records, const char *&Filename)
+{
+  Records = TraceRecords;
+  Filename = TraceFilename;
+
+  // Only a build with TRACE asks, so the menu item is for it alone
+  TraceOn = (TraceRecords != 0);
+}
+
+bool T8086TinyInterface_t::TraceRequest(void)
+{
+  if (!TracePending)
+  {
+    return false;
+  }
+
+  TracePending = false;
+
+  return true;
+}
+
+bool T8086TinyInterface_t::StatsRequest(void)
+{
+  return PERF_Due();
+}
+
+void T8086TinyInterface_t::WriteStats(const stCpuCounters_t &Counters)
+{
+  SERIAL_GetCounters(HostCounters.SerialBytesIn, HostCounters.SerialBytesOut);
+  PERF_Write(Counters, HostCounters);
+}
+
+bool T8086TinyInterface_t::SaveState(FILE *fp)
+{
+  return InterfaceState(fp, true, Port);
+}
+
+bool T8086TinyInterface_t::LoadState(FILE *fp)
+{
+  bool Loaded = InterfaceState(fp, false, Port);
+
+  // The sound queued is for the old state
+  SndBufferLen = 0;
+
+  UpdateIntLine();
+
+  return Loaded;
+}
+
+void T8086TinyInterface_t::GetRTCTime(struct timeb &Now)
+{
+  long long Milliseconds;
+
+  ftime(&Now);
+
+  if (INPUT_GetMode() != INPUT_LOG_OFF)
+  {
+    // The clock of the log
+    Milliseconds = InputStartTime + ((CPU_TotalTicks - TurboBaseTicks) * 1000) / CPU_Clock_Hz;
+  }
+  else
+  {
+    Milliseconds = (long long) Now.time * 1000 + Now.millitm;
+    Milliseconds += (int) (EMU_GetTicks() - timeGetTime());
+  }
+
+  Now.time = (time_t) (Milliseconds / 1000);
+  Now.millitm = (unsigned short) (Milliseconds % 1000);
+}
+
 void T8086TinyInterface_t::WritePort(int Address, unsigned char Value)
 {
   Port[Address] = Value;
@@ -1156,6 +1745,7 @@ void T8086TinyInterface_t::WritePort(int Address, unsigned char Value)
 
   if (SERIAL_WritePort(Address, Value))
   {
+    UpdateIntLine();
     return;
   }
 
@@ -1239,6 +1829,7 @@ unsigned char T8086TinyInterface_t::ReadPort(int Address)
 
   if (SERIAL_ReadPort(Address, retval))
   {
+    UpdateIntLine();
     return retval;
   }
 
@@ -1283,6 +1874,8 @@ unsigned char T8086TinyInterface_t::ReadPort(int Address)
       break;
   }
 
+  UpdateIntLine();
+
   return retval;
 }
 
@@ -1298,21 +1891,35 @@ unsigned int T8086TinyInterface_t::VMemWrite(int i_w, int addr, unsigned int val
 
 bool T8086TinyInterface_t::IntPending(int &IntNumber)
 {
+  bool Pending = true;
+
   if (Int8Pending > 0)
   {
     IntNumber = 8;
     Int8Pending--;
-    return true;
   }
-
-  if (IsKeyEventAvailable() && !KeyInputFull)
+  else if (IsKeyEventAvailable() && !KeyInputFull)
   {
     KeyInputBuffer = NextKeyEvent();
     KeyInputFull = true;
     IntNumber = 9;
-    return true;
   }
+  else
+  {
+    Pending = SERIAL_IntPending(IntNumber);
+  }
+
+  UpdateIntLine();
+
+  return Pending;
+}
+
+void T8086TinyInterface_t::UpdateIntLine(void)
+{
+  int IntNumber;
 
-  return SERIAL_IntPending(IntNumber);
+  IntLine = (Int8Pending > 0) ||
+            (IsKeyEventAvailable() && !KeyInputFull) ||
+            SERIAL_IntPending(IntNumber);
 }
 
@@ -11,6 +11,8 @@
 #include <stdio.h>
 
 #include "win32_cga.h"
+#include "emu_time.h"
+#include "state_io.h"
 #include "cga_glyphs.h"
 #include "vga_glyphs.h"
 
@@ -1601,7 +1603,7 @@ bool CGA_ReadPort(int Address, unsigned char &Val)
     case 0x3DA:
       Handled = true;
       // handle vblank at some approximation of accurate.
-      CurrentTime = timeGetTime();
+      CurrentTime = EMU_GetTicks();
       if (CurrentTime > CGARetraceEndTime)
       {
         // clear retrace
@@ -1627,11 +1629,80 @@ bool CGA_ReadPort(int Address, unsigned char &Val)
 
 void CGA_VBlankStart(void)
 {
-  DWORD CurrentTime = timeGetTime();
+  DWORD CurrentTime = EMU_GetTicks();
   CGAStatus |= 0x08;
   CGARetraceEndTime = CurrentTime + 2;
 }
 
+// Writes or reads the register state for CGA_SaveState()/CGA_LoadState()
+static bool CGA_State(FILE *fp, bool Save)
+{
+  int *Palettes[5] =
+  {
+    CGA320Palette1, CGA320Palette2, CGA320Palette3, CGA320Palette4, CGA320Palette5
+  };
+  int PaletteIdx = 0;
+
+  STATE_ITEM(fp, Save, CGAModeControlRegister);
+  STATE_ITEM(fp, Save, CGAColourControlRegister);
+  STATE_ITEM(fp, Save, CRTIndexRegister);
+  STATE_ITEM(fp, Save, CRTRegister);
+  STATE_ITEM(fp, Save, ACIndexState);
+  STATE_ITEM(fp, Save, ACIndex);
+  STATE_ITEM(fp, Save, ACRegisters);
+  STATE_ITEM(fp, Save, MiscOutputReg);
+  STATE_ITEM(fp, Save, ColourReadIndex);
+  STATE_ITEM(fp, Save, ColourReadComponent);
+  STATE_ITEM(fp, Save, ColourWriteIndex);
+  STATE_ITEM(fp, Save, ColourWriteComponent);
+  STATE_ITEM(fp, Save, SQIndex);
+  STATE_ITEM(fp, Save, SQRegisters);
+  STATE_ITEM(fp, Save, GCIndex);
+  STATE_ITEM(fp, Save, GCRegisters);
+  STATE_ITEM(fp, Save, HostOE);
+  STATE_ITEM(fp, Save, WriteMode);
+  STATE_ITEM(fp, Save, ReadMode);
+  STATE_ITEM(fp, Save, LogicOp);
+  STATE_ITEM(fp, Save, RotateCount);
+  STATE_ITEM(fp, Save, LatchRegisters);
+  STATE_ITEM(fp, Save, PageOffset);
+  STATE_ITEM(fp, Save, CursorLocation);
+  STATE_ITEM(fp, Save, CGAStatus);
+  STATE_ITEM(fp, Save, MCGAPalette);
+  STATE_ITEM(fp, Save, CGA320Palette1);
+  STATE_ITEM(fp, Save, CGA320Palette2);
+  STATE_ITEM(fp, Save, CGA320Palette3);
+  STATE_ITEM(fp, Save, CGA320Palette4);
+  STATE_ITEM(fp, Save, CGA320Palette5);
+  STATE_ITEM(fp, Save, CurrentScreenMode);
+
+  // The selected CGA 320x200 palette is saved as its number
+  while ((PaletteIdx < 4) && (Palettes[PaletteIdx] != CGA320Palette))
+  {
+    PaletteIdx++;
+  }
+  STATE_ITEM(fp, Save, PaletteIdx);
+
+  if (!Save)
+  {
+    CGA320Palette = Palettes[(PaletteIdx >= 0) && (PaletteIdx < 5) ? PaletteIdx : 1];
+    CGARetraceEndTime = 0;
+    ScreenFullRedraw = true;
+  }
+
+  return true;
+}
+
+bool CGA_SaveState(FILE *fp)
+{
+  return CGA_State(fp, true);
+}
+
+bool CGA_LoadState(FILE *fp)
+{
+  return CGA_State(fp, false);
+}
+
 void CGA_SetTextDisplay(TextDisplay_t Mode)
 {
   TextDisplay = Mode;
@@ -1654,8 +1725,6 @@ void CGA_GetDisplaySize(int &w, int &h)
 
 void CGA_DrawScreen(HWND hwnd, unsigned char *mem)
 {
-  //DWORD tickStart = timeGetTime();
-
   if (CurrentScreenMode == SM_BW40)
   {
     if (TextDisplay == TD_CGA)
@@ -1716,7 +1785,4 @@ void CGA_DrawScreen(HWND hwnd, unsigned char *mem)
   {
     MCGA_DrawMode13(hwnd, mem);
   }
-
-  //DWORD deltaTicks = timeGetTime() - tickStart;
-  //printf("DrawTicks = %d\n", deltaTicks);
 }
@@ -162,6 +162,39 @@ bool CGA_ReadPort(int Address, unsigned char &Val);
 //
 void CGA_VBlankStart(void);
 
+// =============================================================================
+// Function: CGA_SaveState
+//
+// Description:
+// Write the CGA/MCGA registers and palette to a snapshot file.
+//
+// Parameters:
+//
+//   fp : The snapshot file.
+//
+// Returns:
+//
+//   bool : true if the state was written.
+//
+bool CGA_SaveState(FILE *fp);
+
+// =============================================================================
+// Function: CGA_LoadState
+//
+// Description:
+// Read back the state written by CGA_SaveState(). The screen is redrawn in
+// full on the next frame.
+//
+// Parameters:
+//
+//   fp : The snapshot file.
+//
+// Returns:
+//
+//   bool : true if the state was read.
+//
+bool CGA_LoadState(FILE *fp);
+
 // =============================================================================
 // Function: CGA_SetTextDisplay
 //